@@ -36,6 +36,8 @@ enum openpcd_cmd_class {
         OPENPCD_CMD_CLS_PRESENCE        = 0x7,
 	/* SIM SCAN */
 	OPENPCD_CMD_CLS_SIM		= 0x8,
+	/* RF parameter sweep / benchmark */
+	OPENPCD_CMD_CLS_SWEEP		= 0x9,
 	/* PICC (transponder) side */
 	OPENPCD_CMD_CLS_PICC		= 0xe,
 
@@ -75,6 +77,26 @@ enum openpcd_cmd_class {
 #define OPENPCD_CMD_SSC_READ		(0x1|OPENPCD_CLS2CMD(OPENPCD_CMD_CLS_SSC))
 #define OPENPCD_CMD_SSC_WRITE		(0x2|OPENPCD_CLS2CMD(OPENPCD_CMD_CLS_SSC))
 
+/* Every OPENPCD_CMD_SSC_READ reply carries one SSC DMA buffer, preceded
+ * by this header.  Without OPENPCD_SSC_F_RLE the raw sample words follow.
+ * With it, the data is a sequence of segments, each starting with a
+ * little endian u_int16_t: bit 15 set means a run of (x & 0x7fff) idle
+ * (0xffffffff) words, otherwise x literal sample words follow.
+ * Completely idle buffers are not sent at all, their seq numbers are
+ * simply skipped. */
+struct openpcd_ssc_capture {
+	u_int32_t timestamp;	/* TC1 ticks (1.5MHz) at end of buffer */
+	u_int32_t seq;		/* buffer sequence number */
+	u_int16_t words;	/* uncompressed buffer length in words */
+	u_int8_t flags;
+	u_int8_t res;
+} __attribute__ ((packed));
+
+#define OPENPCD_SSC_F_RLE	0x01
+#define OPENPCD_SSC_F_OVERRUN	0x02	/* SSC overrun before this buffer */
+
+#define OPENPCD_SSC_SEG_IDLE	0x8000
+
 /* CMD_CLS_PWM */
 #define OPENPCD_CMD_PWM_ENABLE		(0x1|OPENPCD_CLS2CMD(OPENPCD_CMD_CLS_PWM))
 #define OPENPCD_CMD_PWM_DUTY_SET	(0x2|OPENPCD_CLS2CMD(OPENPCD_CMD_CLS_PWM))
@@ -91,10 +113,116 @@ enum openpcd_cmd_class {
 
 /* CMD_CLS_LIBRFID */
 #define OPENPCD_CMD_LRFID_DETECT_IRQ	(0x1|OPENPCD_CLS2CMD(OPENPCD_CMD_CLS_LIBRFID))
+#define OPENPCD_CMD_LRFID_MFCL_READ	(0x2|OPENPCD_CLS2CMD(OPENPCD_CMD_CLS_LIBRFID))
+
+/* OPENPCD_CMD_LRFID_MFCL_READ: authenticate and read a range of mifare
+ * classic sectors in one go.  The request carries a struct
+ * openpcd_mfcl_read_req as payload.  The firmware answers with any number
+ * of data packets (reg == OPENPCD_MFCL_R_BLOCKS, val == number of struct
+ * openpcd_mfcl_block records following the header), terminated by one
+ * summary packet (reg == OPENPCD_MFCL_R_DONE) carrying a struct
+ * openpcd_mfcl_read_rsp. */
+#define OPENPCD_MFCL_KEY_A		0x00
+#define OPENPCD_MFCL_KEY_B		0x01
+
+#define OPENPCD_MFCL_R_BLOCKS		0x01
+#define OPENPCD_MFCL_R_DONE		0x02
+
+#define OPENPCD_MFCL_S_OK		0x00	/* block read successfully */
+#define OPENPCD_MFCL_S_AUTH		0x01	/* sector authentication failed */
+#define OPENPCD_MFCL_S_TIMEOUT		0x02	/* no answer to READ */
+#define OPENPCD_MFCL_S_READ		0x03	/* other error during READ */
+
+#define OPENPCD_MFCL_E_NONE		0x00
+#define OPENPCD_MFCL_E_NO_CARD		0x01	/* no card in field */
+#define OPENPCD_MFCL_E_UID		0x02	/* card doesn't match UID filter */
+#define OPENPCD_MFCL_E_PROTO		0x03	/* card is no mifare classic */
+#define OPENPCD_MFCL_E_INVAL		0x04	/* malformed request */
+#define OPENPCD_MFCL_E_NO_BUF		0x05	/* no large req_ctx came free */
+
+struct openpcd_mfcl_read_req {
+	u_int8_t uid_len;		/* 0 == accept any card */
+	u_int8_t uid[10];
+	u_int8_t sector_first;
+	u_int8_t sector_last;		/* inclusive, max 39 (4k cards) */
+	u_int8_t key_type;		/* OPENPCD_MFCL_KEY_{A,B} */
+	u_int8_t key[6];
+} __attribute__ ((packed));
+
+struct openpcd_mfcl_block {
+	u_int8_t block;
+	u_int8_t status;		/* OPENPCD_MFCL_S_* */
+	u_int8_t data[16];
+} __attribute__ ((packed));
+
+struct openpcd_mfcl_read_rsp {
+	u_int8_t error;			/* OPENPCD_MFCL_E_* */
+	u_int8_t uid_len;
+	u_int8_t uid[10];
+	u_int16_t num_blocks;		/* records sent in data packets */
+	u_int16_t num_errors;		/* records with status != S_OK */
+} __attribute__ ((packed));
 
 /* CMD_CLS_LIBRFID */
 #define OPENPCD_CMD_PRESENCE_UID_GET    (0x1|OPENPCD_CLS2CMD(OPENPCD_CMD_CLS_PRESENCE))
 
+/* CMD_CLS_SWEEP */
+#define OPENPCD_CMD_SWEEP_RUN		(0x1|OPENPCD_CLS2CMD(OPENPCD_CMD_CLS_SWEEP))
+
+/* OPENPCD_CMD_SWEEP_RUN: iterate over the cartesian product of up to
+ * OPENPCD_SWEEP_AXES_MAX parameter ranges (the first axis varies fastest).
+ * At every grid point, each enabled test is run 'iterations' times with a
+ * field reset in between.  Results are streamed as packets with
+ * reg == OPENPCD_SWEEP_R_POINTS, val == number of struct
+ * openpcd_sweep_point records, followed by a final packet with
+ * reg == OPENPCD_SWEEP_R_DONE and val == OPENPCD_SWEEP_E_* */
+#define OPENPCD_SWEEP_AXES_MAX		6
+#define OPENPCD_SWEEP_FRAME_MAX		16
+
+/* parameters < 0x40 are RC632 registers (e.g. CwConductance 0x12,
+ * ModConductance 0x13, BitPhase 0x1b, RxThreshold 0x1c) */
+#define OPENPCD_SWEEP_P_SPEED_RX	0x80	/* 0..3: 106..848 kBps */
+#define OPENPCD_SWEEP_P_SPEED_TX	0x81
+
+#define OPENPCD_SWEEP_T_REQA		0x01
+#define OPENPCD_SWEEP_T_ANTICOL		0x02
+#define OPENPCD_SWEEP_T_TRANSCEIVE	0x04	/* anticol + 'frame' */
+
+#define OPENPCD_SWEEP_R_POINTS		0x01
+#define OPENPCD_SWEEP_R_DONE		0x02
+
+#define OPENPCD_SWEEP_E_NONE		0x00
+#define OPENPCD_SWEEP_E_INVAL		0x01
+#define OPENPCD_SWEEP_E_NO_BUF		0x02	/* no large req_ctx came free */
+
+struct openpcd_sweep_axis {
+	u_int8_t param;			/* register or OPENPCD_SWEEP_P_* */
+	u_int8_t first;
+	u_int8_t last;			/* inclusive */
+	u_int8_t step;
+} __attribute__ ((packed));
+
+struct openpcd_sweep_req {
+	u_int8_t iterations;		/* attempts per test and point */
+	u_int8_t tests;			/* OPENPCD_SWEEP_T_* */
+	u_int8_t num_axes;
+	u_int8_t frame_len;		/* for OPENPCD_SWEEP_T_TRANSCEIVE */
+	struct openpcd_sweep_axis axis[OPENPCD_SWEEP_AXES_MAX];
+	u_int8_t frame[OPENPCD_SWEEP_FRAME_MAX];
+} __attribute__ ((packed));
+
+struct openpcd_sweep_test {
+	u_int8_t ok;			/* successful attempts */
+	u_int16_t avg_us;		/* mean duration of successful ones */
+} __attribute__ ((packed));
+
+struct openpcd_sweep_point {
+	u_int16_t index;		/* position in the grid */
+	struct openpcd_sweep_test reqa;
+	struct openpcd_sweep_test anticol;
+	struct openpcd_sweep_test transceive;
+} __attribute__ ((packed));
+
 /* CMD_CLS_USBTEST */
 #define OPENPCD_CMD_USBTEST_IN		(0x1|OPENPCD_CLS2CMD(OPENPCD_CMD_CLS_USBTEST))
 #define OPENPCD_CMD_USBTEST_OUT		(0x2|OPENPCD_CLS2CMD(OPENPCD_CMD_CLS_USBTEST))
@@ -32,6 +32,6 @@ struct simtrace_stats {
 	u_int32_t parity_err;
 	u_int32_t frame_err;
 	u_int32_t overrun;
-} stats;
+};
 
 #endif /* SIMTRACE_USB_H */
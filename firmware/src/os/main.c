@@ -28,6 +28,7 @@
 #include <os/power.h>
 #include <os/system_irq.h>
 #include <os/pit.h>
+#include <os/tc_usec.h>
 #include <os/wdt.h>
 #include <os/usbcmd_generic.h>
 #include <os/pcd_enumerate.h>
@@ -51,6 +52,7 @@ int main(void)
 	AT91F_PIOA_CfgPMC();
 	wdt_init();
 	pit_init();
+	tc_usec_init();
 	blinkcode_init();
 
 	/* initialize USB */
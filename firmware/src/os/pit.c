@@ -15,8 +15,6 @@
  *  along with this program; if not, write to the Free Software
  *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
- *
- * TODO: handle jiffies wrap correctly!
  */
 
 #include <errno.h>
@@ -34,52 +32,53 @@
 /* PIT runs at MCK/16 (= 3MHz) */
 #define PIV_MS(x)		(x * 3000)
 
-static struct timer_list *timers;
+/* Timers are kept in a hashed timer wheel: each timer is hashed into one of
+ * TIMER_WHEEL_SIZE buckets by its expiry time, so insertion and removal are
+ * O(1).  Every jiffy we only have to look at a single bucket.  Timers that
+ * expire more than one wheel revolution in the future simply stay in their
+ * bucket until the wheel comes round for the right time. */
+#define TIMER_WHEEL_BITS	5
+#define TIMER_WHEEL_SIZE	(1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK	(TIMER_WHEEL_SIZE - 1)
+
+static struct timer_list *timer_wheel[TIMER_WHEEL_SIZE];
+
+/* the next jiffy whose bucket has not yet been processed */
+static unsigned long wheel_jiffies;
 
 volatile unsigned long jiffies;
 
 static void __timer_insert(struct timer_list *new)
 {
-	struct timer_list *tl, *tl_prev = NULL;
+	struct timer_list **bucket;
+	unsigned long expires = new->expires;
 
-	if (!timers) {
-		/* optimize for the common, fast case */
-		new->next = NULL;
-		timers = new;
-		return;
-	}
+	/* timers that are already due go into the next bucket to be run,
+	 * otherwise they'd wait for a whole revolution of the wheel */
+	if (time_before(expires, wheel_jiffies))
+		expires = wheel_jiffies;
 
-	for (tl = timers; tl != NULL; tl = tl->next) {
-		if (tl->expires < new->expires) {
-			/* we need ot add just before this one */
-			if (!tl_prev) {
-				new->next = timers;
-				timers = new;
-			} else {
-				new->next = tl;
-				tl_prev->next = new;
-			}
-		}
-		tl_prev = tl;
-	}
+	bucket = &timer_wheel[expires & TIMER_WHEEL_MASK];
+
+	new->next = *bucket;
+	if (new->next)
+		new->next->pprev = &new->next;
+	new->pprev = bucket;
+	*bucket = new;
 }
 
 static int __timer_remove(struct timer_list *old)
 {
-	struct timer_list *tl, *tl_prev = NULL;
-
-	for (tl = timers; tl != NULL; tl = tl->next) {
-		if (tl == old) {
-			if (tl == timers)
-				timers = tl->next;
-			else
-				tl_prev->next = tl->next;
-			return 1;
-		}
-		tl_prev = tl;
-	}
+	if (!old->pprev)
+		return 0;
 
-	return 0;
+	*old->pprev = old->next;
+	if (old->next)
+		old->next->pprev = old->pprev;
+	old->next = NULL;
+	old->pprev = NULL;
+
+	return 1;
 }
 
 int timer_del(struct timer_list *tl)
@@ -99,30 +98,40 @@ void timer_add(struct timer_list *tl)
 	unsigned long flags;
 
 	local_irq_save(flags);
+	/* re-adding a pending timer just moves it */
+	__timer_remove(tl);
 	__timer_insert(tl);
 	local_irq_restore(flags);
 }
 
-static void pit_irq(u_int32_t sr)
+static void __timer_run_bucket(unsigned long now)
 {
 	struct timer_list *tl, *next;
 
+	for (tl = timer_wheel[now & TIMER_WHEEL_MASK]; tl; tl = next) {
+		next = tl->next;
+		if (time_after(tl->expires, now))
+			continue;
+		/* the callback may re-add the timer (or delete others from
+		 * this bucket), so unlink first and restart from the head */
+		__timer_remove(tl);
+		tl->function(tl->data);
+		next = timer_wheel[now & TIMER_WHEEL_MASK];
+	}
+}
+
+static void pit_irq(u_int32_t sr)
+{
 	if (!(sr & 0x1))
 		return;
 
 	jiffies += *AT91C_PITC_PIVR >> 20;
 
-	/* this is the most simple/stupid algorithm one can come up with, but
-	 * hey, we're on a small embedded platform with only a hand ful
-	 * of timers, at all */
-	for (tl = timers; tl != NULL; tl = next) {
-		next = tl->next;
-		if (tl->expires <= jiffies) {
-			/* delete timer from list */
-			timer_del(tl);
-			tl->function(tl->data);
-		}
-	}
+	/* advance wheel_jiffies before running a bucket, so that timers
+	 * (re-)added from a callback can never end up in the bucket that is
+	 * currently being processed */
+	while (!time_after(wheel_jiffies, jiffies))
+		__timer_run_bucket(wheel_jiffies++);
 }
 
 void pit_mdelay(u_int32_t ms)
@@ -151,6 +160,8 @@ void pit_init(void)
 
 	AT91F_PITInit(AT91C_BASE_PITC, 1000000/HZ /* uS */, 48 /* MHz */);
 
+	wheel_jiffies = jiffies;
+
 	sysirq_register(AT91SAM7_SYSIRQ_PIT, &pit_irq);	
 
 	AT91F_PITEnableInt(AT91C_BASE_PITC);
@@ -9,6 +9,7 @@
 
 struct timer_list {
 	struct timer_list *next;
+	struct timer_list **pprev;	/* NULL if not pending */
 	unsigned long expires;
 	void (*function)(void *data);
 	void *data;
@@ -16,6 +17,10 @@ struct timer_list {
 
 extern volatile unsigned long jiffies;
 
+/* wrap-safe comparison of jiffies (or any other free running counter) */
+#define time_after(a, b)	((long)(b) - (long)(a) < 0)
+#define time_before(a, b)	time_after(b, a)
+
 extern void timer_add(struct timer_list *timer);
 extern int timer_del(struct timer_list *timer);
 
@@ -101,5 +101,6 @@ void req_ctx_init(void)
 	for (i = 0; i < NUM_RCTX_LARGE; i++) {
 		req_ctx[NUM_RCTX_SMALL+i].size = RCTX_SIZE_LARGE;
 		req_ctx[NUM_RCTX_SMALL+i].data = rctx_data_large[i];
+		req_ctx[NUM_RCTX_SMALL+i].state = RCTX_STATE_FREE;
 	}
 }
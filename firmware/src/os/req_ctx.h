@@ -33,6 +33,7 @@ struct req_ctx {
 #define RCTX_STATE_UDP_EP3_BUSY		0x13
 
 #define RCTX_STATE_SSC_RX_BUSY		0x20
+#define RCTX_STATE_SSC_RX_DONE		0x21
 
 #define RCTX_STATE_LIBRFID_BUSY		0x30
 
@@ -24,6 +24,7 @@
 #include <lib_AT91SAM7.h>
 #include <AT91SAM7.h>
 #include <os/dbgu.h>
+#include <os/tc_usec.h>
 
 #include "../openpcd.h"
 #include <os/tc_cdiv.h>
@@ -85,7 +86,7 @@ void tc_cdiv_init(void)
 	tc_cdiv_set_divider(128);
 
 	/* Reset to start timers */
-	tcb->TCB_BCR = 1;
+	tc_usec_resync();
 }
 
 void tc_cdiv_print(void)
@@ -0,0 +1,261 @@
+/* Microsecond timer service for OpenPCD / OpenPICC / SIMtrace
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by 
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * TC1 is not used by any of the boards, so we let it count MCK/32 freely
+ * and extend its 16bit counter value to 32bit in software.  The RC compare
+ * is used to fire one-shot timers kept in a small binary min-heap, and in
+ * the absence of timers at least every 0x8000 ticks (~22ms) to make sure we
+ * never miss a counter wrap.
+ *
+ * The board code starts TC0 and TC2 with a SYNC on the TC block, which
+ * resets TC1 as well.  It has to use tc_usec_resync() for that, so the
+ * software counter follows.
+ */
+
+#include <errno.h>
+#include <sys/types.h>
+#include <asm/system.h>
+
+#include <lib_AT91SAM7.h>
+#include <AT91SAM7.h>
+#include <os/dbgu.h>
+#include <os/usb_handler.h>
+#include <os/tc_usec.h>
+
+#include "../openpcd.h"
+
+#define USEC_TIMERS_MAX		8
+#define TC_USEC_MAX_SLEEP	0x8000
+#define TC_USEC_MIN_SLEEP	16
+
+static AT91PS_TC tcusec = AT91C_BASE_TC1;
+
+static u_int32_t now_ticks;
+static u_int16_t last_cv;
+
+static struct usec_timer *heap[USEC_TIMERS_MAX];
+static u_int8_t heap_len;
+
+/* has to be called at least once per 16bit counter wrap */
+static u_int32_t __tc_usec_now(void)
+{
+	u_int16_t cv = tcusec->TC_CV;
+
+	now_ticks += (u_int16_t) (cv - last_cv);
+	last_cv = cv;
+
+	return now_ticks;
+}
+
+u_int32_t tc_usec_now(void)
+{
+	unsigned long flags;
+	u_int32_t ret;
+
+	local_irq_save(flags);
+	ret = __tc_usec_now();
+	local_irq_restore(flags);
+
+	return ret;
+}
+
+/* binary min-heap on ->expires, O(log n) insert and removal */
+
+static inline void heap_set(u_int8_t idx, struct usec_timer *ut)
+{
+	heap[idx] = ut;
+	ut->slot = idx + 1;
+}
+
+static void heap_sift_up(u_int8_t idx)
+{
+	struct usec_timer *ut = heap[idx];
+
+	while (idx > 0) {
+		u_int8_t parent = (idx - 1) / 2;
+		if (!tc_usec_before(ut->expires, heap[parent]->expires))
+			break;
+		heap_set(idx, heap[parent]);
+		idx = parent;
+	}
+	heap_set(idx, ut);
+}
+
+static void heap_sift_down(u_int8_t idx)
+{
+	struct usec_timer *ut = heap[idx];
+
+	while (1) {
+		u_int8_t child = idx * 2 + 1;
+		if (child >= heap_len)
+			break;
+		if (child + 1 < heap_len &&
+		    tc_usec_before(heap[child+1]->expires, heap[child]->expires))
+			child++;
+		if (!tc_usec_before(heap[child]->expires, ut->expires))
+			break;
+		heap_set(idx, heap[child]);
+		idx = child;
+	}
+	heap_set(idx, ut);
+}
+
+static void __heap_remove(struct usec_timer *ut)
+{
+	u_int8_t idx = ut->slot - 1;
+
+	ut->slot = 0;
+	if (--heap_len == idx)
+		return;
+
+	heap_set(idx, heap[heap_len]);
+	if (idx > 0 && tc_usec_before(heap[idx]->expires,
+				      heap[(idx-1)/2]->expires))
+		heap_sift_up(idx);
+	else
+		heap_sift_down(idx);
+}
+
+/* program RC for the next event, assumes IRQs are disabled.  Returns
+ * non-zero if the counter has already passed the compare value, in which
+ * case no compare IRQ would happen until after the next counter wrap */
+static int __tc_usec_reprogram(void)
+{
+	u_int32_t now = __tc_usec_now();
+	u_int32_t delta = TC_USEC_MAX_SLEEP;
+
+	if (heap_len) {
+		if (tc_usec_before(heap[0]->expires, now + TC_USEC_MIN_SLEEP))
+			delta = TC_USEC_MIN_SLEEP;
+		else if (heap[0]->expires - now < delta)
+			delta = heap[0]->expires - now;
+	}
+
+	tcusec->TC_RC = (u_int16_t) (last_cv + delta);
+
+	return ((u_int16_t) (tcusec->TC_CV - last_cv) >= delta);
+}
+
+/* run all expired timers, assumes IRQs are disabled */
+static void __tc_usec_run(void)
+{
+	do {
+		u_int32_t now = __tc_usec_now();
+
+		while (heap_len && !tc_usec_after(heap[0]->expires, now)) {
+			struct usec_timer *ut = heap[0];
+			__heap_remove(ut);
+			ut->function(ut->data);
+		}
+	} while (__tc_usec_reprogram());
+}
+
+static void tc_usec_irq(void)
+{
+	u_int32_t sr = tcusec->TC_SR;
+
+	if (sr & AT91C_TC_CPCS)
+		__tc_usec_run();
+}
+
+int usec_timer_add(struct usec_timer *ut)
+{
+	unsigned long flags;
+
+	local_irq_save(flags);
+	if (ut->slot)
+		__heap_remove(ut);
+	if (heap_len >= USEC_TIMERS_MAX) {
+		local_irq_restore(flags);
+		return -ENOSPC;
+	}
+	heap[heap_len] = ut;
+	heap_sift_up(heap_len++);
+	/* if this is the new earliest timer and already due, it is run
+	 * right away from our caller's context */
+	if (heap[0] == ut)
+		__tc_usec_run();
+	local_irq_restore(flags);
+
+	return 0;
+}
+
+int usec_timer_del(struct usec_timer *ut)
+{
+	unsigned long flags;
+	int ret = 0;
+
+	local_irq_save(flags);
+	if (ut->slot) {
+		__heap_remove(ut);
+		ret = 1;
+	}
+	local_irq_restore(flags);
+
+	return ret;
+}
+
+void udelay(u_int32_t us)
+{
+	u_int32_t end = tc_usec_now() + USEC_TO_TICKS(us);
+
+	while (tc_usec_before(tc_usec_now(), end)) { }
+}
+
+void delay_us(u_int32_t us)
+{
+	u_int32_t end = tc_usec_now() + USEC_TO_TICKS(us);
+
+	while (tc_usec_before(tc_usec_now(), end))
+		usb_out_process();
+}
+
+/* SYNC all three TC channels, TC1 restarts from 0 */
+void tc_usec_resync(void)
+{
+	unsigned long flags;
+
+	local_irq_save(flags);
+	__tc_usec_now();
+	AT91C_BASE_TCB->TCB_BCR = AT91C_TCB_SYNC;
+	last_cv = 0;
+	__tc_usec_run();
+	local_irq_restore(flags);
+}
+
+void tc_usec_init(void)
+{
+	AT91F_PMC_EnablePeriphClock(AT91C_BASE_PMC,
+				    ((unsigned int) 1 << AT91C_ID_TC1));
+
+	/* MCK/32, free running up-counter, no TIOA1/TIOB1 output */
+	tcusec->TC_CCR = AT91C_TC_CLKDIS;
+	tcusec->TC_IDR = 0xff;
+	tcusec->TC_CMR = AT91C_TC_CLKS_TIMER_DIV3_CLOCK | AT91C_TC_WAVE |
+			 AT91C_TC_WAVESEL_UP;
+	tcusec->TC_CCR = AT91C_TC_CLKEN | AT91C_TC_SWTRG;
+
+	last_cv = tcusec->TC_CV;
+	now_ticks = 0;
+	__tc_usec_run();
+
+	AT91F_AIC_ConfigureIt(AT91C_BASE_AIC, AT91C_ID_TC1,
+			      OPENPCD_IRQ_PRIO_TC_USEC,
+			      AT91C_AIC_SRCTYPE_INT_HIGH_LEVEL, &tc_usec_irq);
+	AT91F_AIC_EnableIt(AT91C_BASE_AIC, AT91C_ID_TC1);
+
+	tcusec->TC_IER = AT91C_TC_CPCS;
+}
@@ -0,0 +1,40 @@
+#ifndef _TC_USEC_H
+#define _TC_USEC_H
+
+#include <sys/types.h>
+#include <os/pit.h>
+
+/* TC1 runs freely at MCK/32 = 1.5MHz, extended to 32bit in software */
+#define TC_USEC_HZ		1500000
+#define USEC_TO_TICKS(us)	(((us) * 3) >> 1)
+#define TICKS_TO_USEC(t)	(((t) << 1) / 3)
+
+/* wrap-safe comparison of tick values.  Unlike time_after() this does
+ * not depend on long being 32 bit wide, so it also holds on the host */
+#define tc_usec_after(a, b)	(((u_int32_t) ((b) - (a))) & 0x80000000)
+#define tc_usec_before(a, b)	tc_usec_after(b, a)
+
+/* one-shot timer with TC tick resolution.  The callback is run from IRQ
+ * context.  Zero-initialized timers are valid (not pending). */
+struct usec_timer {
+	u_int32_t expires;		/* absolute, in tc_usec_now() ticks */
+	void (*function)(void *data);
+	void *data;
+	u_int8_t slot;			/* heap index + 1, 0 if not pending */
+};
+
+extern u_int32_t tc_usec_now(void);
+
+extern int usec_timer_add(struct usec_timer *ut);
+extern int usec_timer_del(struct usec_timer *ut);
+
+/* busy-wait, usable from any context */
+extern void udelay(u_int32_t us);
+/* cooperative wait for the main loop: keeps the USB IN endpoints going */
+extern void delay_us(u_int32_t us);
+
+extern void tc_usec_init(void);
+/* instead of TCB_BCR = SYNC, which would make tc_usec_now() jump */
+extern void tc_usec_resync(void);
+
+#endif
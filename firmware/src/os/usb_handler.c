@@ -28,6 +28,7 @@
 #include <os/req_ctx.h>
 #include <os/led.h>
 #include <os/dbgu.h>
+#include <os/tc_usec.h>
 
 #include "../openpcd.h"
 
@@ -99,3 +100,99 @@ void usb_in_process(void)
 	udp_unthrottle();
 }
 
+static inline int rctx_tx_busy(struct req_ctx *rctx)
+{
+	return (rctx->state == RCTX_STATE_UDP_EP2_PENDING ||
+		rctx->state == RCTX_STATE_UDP_EP2_BUSY);
+}
+
+void usb_stream_init(struct usb_stream *us, u_int8_t cmd, u_int8_t reg)
+{
+	us->rctx = NULL;
+	us->in_flight = NULL;
+	us->cmd = cmd;
+	us->reg = reg;
+}
+
+/* is the previously flushed packet still waiting for the host? */
+int usb_stream_busy(struct usb_stream *us)
+{
+	return us->in_flight && rctx_tx_busy(us->in_flight);
+}
+
+/* Pending req_ctx are not sent in FIFO order, so we never queue a packet
+ * before the host has fetched the previous one */
+void usb_stream_flush(struct usb_stream *us)
+{
+	struct openpcd_hdr *poh;
+
+	if (!us->rctx)
+		return;
+
+	poh = (struct openpcd_hdr *) us->rctx->data;
+	if (poh->val == 0) {
+		req_ctx_put(us->rctx);
+		us->rctx = NULL;
+		return;
+	}
+
+	while (usb_stream_busy(us))
+		usb_out_process();
+
+	req_ctx_set_state(us->rctx, RCTX_STATE_UDP_EP2_PENDING);
+	udp_refill_ep(2);
+	us->in_flight = us->rctx;
+	us->rctx = NULL;
+}
+
+/* return room for @len bytes of record data in the current packet,
+ * flushing it and starting a new one if it is too full.  Returns NULL if
+ * no large req_ctx comes free within USB_STREAM_WAIT_US. */
+void *usb_stream_reserve(struct usb_stream *us, unsigned int len)
+{
+	struct openpcd_hdr *poh;
+	u_int32_t end;
+
+	if (us->rctx && us->rctx->tot_len + len > us->rctx->size)
+		usb_stream_flush(us);
+
+	if (!us->rctx) {
+		end = tc_usec_now() + USEC_TO_TICKS(USB_STREAM_WAIT_US);
+		/* the SAM7S64 has only one large context, which is free
+		 * again once the host has fetched the previous packet */
+		while (!(us->rctx = req_ctx_find_get(1, RCTX_STATE_FREE,
+						     RCTX_STATE_MAIN_PROCESSING))) {
+			if (tc_usec_after(tc_usec_now(), end)) {
+				DEBUGPCRF("no large req_ctx");
+				return NULL;
+			}
+			usb_out_process();
+		}
+		poh = (struct openpcd_hdr *) us->rctx->data;
+		poh->cmd = us->cmd;
+		poh->flags = 0x00;
+		poh->reg = us->reg;
+		poh->val = 0;
+		us->rctx->tot_len = sizeof(*poh);
+	}
+
+	return us->rctx->data + us->rctx->tot_len;
+}
+
+/* account one record of @len bytes previously returned by reserve() */
+void usb_stream_commit(struct usb_stream *us, unsigned int len)
+{
+	struct openpcd_hdr *poh = (struct openpcd_hdr *) us->rctx->data;
+
+	poh->val++;
+	us->rctx->tot_len += len;
+}
+
+/* send the last packet and wait until the host has fetched it */
+void usb_stream_finish(struct usb_stream *us)
+{
+	usb_stream_flush(us);
+	while (usb_stream_busy(us))
+		usb_out_process();
+}
+
@@ -14,6 +14,8 @@ enum usbapi_err {
 	USB_ERR_NONE,
 	USB_ERR_CMD_UNKNOWN,
 	USB_ERR_CMD_NOT_IMPL,
+	USB_ERR_CMD_INVAL,
+	USB_ERR_CMD_FAILED,
 };
 
 typedef int usb_cmd_fn(struct req_ctx *rctx);
@@ -24,4 +26,26 @@ extern void usb_hdlr_unregister(u_int8_t class);
 extern void usb_in_process(void);
 extern void usb_out_process(void);
 
+/* Stream a sequence of fixed-size records to the host in large req_ctx on
+ * the IN endpoint.  Each packet starts with a struct openpcd_hdr (cmd and
+ * reg as given by the caller), val counts the records in the packet.  Only
+ * one packet is in flight at any time, so packets arrive in order. */
+struct usb_stream {
+	struct req_ctx *rctx;		/* packet currently being filled */
+	struct req_ctx *in_flight;	/* packet queued to EP2 */
+	u_int8_t cmd;
+	u_int8_t reg;
+};
+
+/* how long usb_stream_reserve() waits for a large req_ctx, stays below
+ * the watchdog period */
+#define USB_STREAM_WAIT_US	500000
+
+extern void usb_stream_init(struct usb_stream *us, u_int8_t cmd, u_int8_t reg);
+extern void *usb_stream_reserve(struct usb_stream *us, unsigned int len);
+extern void usb_stream_commit(struct usb_stream *us, unsigned int len);
+extern void usb_stream_flush(struct usb_stream *us);
+extern int usb_stream_busy(struct usb_stream *us);
+extern void usb_stream_finish(struct usb_stream *us);
+
 #endif
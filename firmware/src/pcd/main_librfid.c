@@ -32,9 +32,14 @@
 #include <os/pcd_enumerate.h>
 #include <os/trigger.h>
 #include <os/req_ctx.h>
+#include <os/tc_usec.h>
 
 #include "../openpcd.h"
 
+/* how long to switch off the field between two scans, enough for any card
+ * to lose power and reset */
+#define RF_OFF_US	100000
+
 static struct rfid_reader_handle *rh;
 static struct rfid_layer2_handle *l2h;
 static struct rfid_protocol_handle *ph;
@@ -208,7 +213,7 @@ void _main_func(void)
 		rfid_layer2_close(l2h);
 
 	rc632_turn_off_rf(NULL);
-	{ volatile int i; for (i = 0; i < 0xfffff; i++) ; }
+	delay_us(RF_OFF_US);
 	rc632_turn_on_rf(NULL);
 
 	led_switch(1, 0);
@@ -30,18 +30,27 @@
 #include <os/dbgu.h>
 #include <os/led.h>
 #include <os/pcd_enumerate.h>
+#include <os/usb_handler.h>
 #include <os/trigger.h>
+#include <os/wdt.h>
 #include <os/req_ctx.h>
+#include <os/tc_usec.h>
 #include <pcd/rc632.h>
 
 #include "../openpcd.h"
 
+/* how long to switch off the field between two scans, enough for any card
+ * to lose power and reset */
+#define RF_OFF_US	100000
+
 static struct rfid_reader_handle *rh;
 static struct rfid_layer2_handle *l2h;
 static struct rfid_protocol_handle *ph;
 
 static u_int8_t sector = 0;
 
+static int opcd_mfcl_usb_rx(struct req_ctx *rctx);
+
 void _init_func(void)
 {
 	trigger_init();
@@ -52,6 +61,7 @@ void _init_func(void)
 	rh = rfid_reader_open(NULL, RFID_READER_OPENPCD);
 	DEBUGP("rh=%p ", rh);
 #endif
+	usb_hdlr_register(&opcd_mfcl_usb_rx, OPENPCD_CMD_CLS_LIBRFID);
 	led_switch(2, 1);
 }
 
@@ -249,10 +259,190 @@ static int init_proto(void)
 	return 4;
 }
 
-static int opcd_lrfid_usb_in(struct req_ctx *rctx)
+/* streaming multi-sector read (OPENPCD_CMD_LRFID_MFCL_READ) */
+
+#define MFCL_SECTORS_MAX	40
+
+static inline int mfcl_sector_first_block(int sector)
+{
+	if (sector < 32)
+		return sector * 4;
+	return 128 + (sector - 32) * 16;
+}
+
+static inline int mfcl_sector_num_blocks(int sector)
+{
+	return sector < 32 ? 4 : 16;
+}
+
+/* (re-)select the card and make sure it still is the one we're reading */
+static int mfcl_select(struct rfid_layer2_handle **l2, 
+		       struct rfid_protocol_handle **proto,
+		       struct openpcd_mfcl_read_rsp *rsp)
+{
+	if (*proto) {
+		rfid_protocol_close(*proto);
+		*proto = NULL;
+	}
+	if (*l2) {
+		rfid_layer2_close(*l2);
+		*l2 = NULL;
+	}
+
+	*l2 = rfid_layer2_scan(rh);
+	if (!*l2)
+		return OPENPCD_MFCL_E_NO_CARD;
+
+	if (rsp->uid_len && 
+	    ((*l2)->uid_len != rsp->uid_len ||
+	     memcmp((*l2)->uid, rsp->uid, rsp->uid_len)))
+		return OPENPCD_MFCL_E_UID;
+
+	rsp->uid_len = (*l2)->uid_len;
+	memcpy(rsp->uid, (*l2)->uid, rsp->uid_len);
+
+	*proto = rfid_protocol_scan(*l2);
+	if (!*proto || (*proto)->proto->id != RFID_PROTOCOL_MIFARE_CLASSIC)
+		return OPENPCD_MFCL_E_PROTO;
+
+	return OPENPCD_MFCL_E_NONE;
+}
+
+static int mfcl_read_range(struct openpcd_mfcl_read_req *req,
+			   struct openpcd_mfcl_read_rsp *rsp)
+{
+	struct rfid_layer2_handle *l2 = NULL;
+	struct rfid_protocol_handle *proto = NULL;
+	struct usb_stream us;
+	unsigned char buf[20];
+	unsigned int len;
+	int s, block, first, num, ret;
+
+	usb_stream_init(&us, OPENPCD_CMD_LRFID_MFCL_READ, OPENPCD_MFCL_R_BLOCKS);
+
+	rsp->uid_len = req->uid_len;
+	memcpy(rsp->uid, req->uid, sizeof(rsp->uid));
+	rsp->error = mfcl_select(&l2, &proto, rsp);
+	if (rsp->error != OPENPCD_MFCL_E_NONE)
+		goto out_close;
+
+	for (s = req->sector_first; s <= req->sector_last; s++) {
+		struct openpcd_mfcl_block *mb;
+		int auth_ok;
+
+		first = mfcl_sector_first_block(s);
+		num = mfcl_sector_num_blocks(s);
+
+		/* a failed authentication halts the card, so we have to
+		 * select it again before we can continue with the next
+		 * sector */
+		ret = mfcl_set_key(proto, req->key);
+		if (ret >= 0)
+			ret = mfcl_auth(proto, req->key_type == OPENPCD_MFCL_KEY_B ?
+					RFID_CMD_MIFARE_AUTH1B :
+					RFID_CMD_MIFARE_AUTH1A, first);
+		auth_ok = (ret >= 0);
+		if (!auth_ok)
+			DEBUGPCR("mifare auth error sector %u", s);
+
+		/* keep all blocks of a sector in one packet, the reserve()
+		 * calls for the single blocks then always succeed */
+		if (!usb_stream_reserve(&us, num * sizeof(*mb))) {
+			rsp->error = OPENPCD_MFCL_E_NO_BUF;
+			break;
+		}
+		for (block = first; block < first + num; block++) {
+			mb = usb_stream_reserve(&us, sizeof(*mb));
+			mb->block = block & 0xff;
+			memset(mb->data, 0, sizeof(mb->data));
+
+			if (!auth_ok)
+				mb->status = OPENPCD_MFCL_S_AUTH;
+			else {
+				len = sizeof(buf);
+				ret = rfid_protocol_read(proto, block, buf, &len);
+				if (ret == -ETIMEDOUT)
+					mb->status = OPENPCD_MFCL_S_TIMEOUT;
+				else if (ret < 0)
+					mb->status = OPENPCD_MFCL_S_READ;
+				else {
+					mb->status = OPENPCD_MFCL_S_OK;
+					if (len > sizeof(mb->data))
+						len = sizeof(mb->data);
+					memcpy(mb->data, buf, len);
+				}
+			}
+
+			rsp->num_blocks++;
+			if (mb->status != OPENPCD_MFCL_S_OK)
+				rsp->num_errors++;
+			usb_stream_commit(&us, sizeof(*mb));
+		}
+
+		/* hand out each completed sector as early as possible */
+		if (!usb_stream_busy(&us))
+			usb_stream_flush(&us);
+		wdt_restart();
+
+		if (!auth_ok && s < req->sector_last) {
+			rsp->error = mfcl_select(&l2, &proto, rsp);
+			if (rsp->error != OPENPCD_MFCL_E_NONE)
+				break;
+		}
+	}
+
+	usb_stream_finish(&us);
+
+out_close:
+	if (proto)
+		rfid_protocol_close(proto);
+	if (l2)
+		rfid_layer2_close(l2);
+
+	return rsp->error;
+}
+
+static int opcd_mfcl_usb_rx(struct req_ctx *rctx)
 {
 	struct openpcd_hdr *poh = (struct openpcd_hdr *) rctx->data;
-	return 0;
+	struct openpcd_mfcl_read_req req;
+	struct openpcd_mfcl_read_rsp *rsp = 
+			(struct openpcd_mfcl_read_rsp *) poh->data;
+
+	switch (poh->cmd) {
+	case OPENPCD_CMD_LRFID_MFCL_READ:
+		if (rctx->tot_len < sizeof(*poh) + sizeof(req))
+			return USB_ERR(USB_ERR_CMD_INVAL);
+
+		/* copy the request, the answer is built in the same buffer */
+		memcpy(&req, poh->data, sizeof(req));
+		memset(rsp, 0, sizeof(*rsp));
+		poh->flags = 0x00;
+		poh->reg = OPENPCD_MFCL_R_DONE;
+		rctx->tot_len = sizeof(*poh) + sizeof(*rsp);
+
+		if (req.uid_len > sizeof(req.uid) ||
+		    req.sector_first > req.sector_last ||
+		    req.sector_last >= MFCL_SECTORS_MAX) {
+			rsp->error = OPENPCD_MFCL_E_INVAL;
+			return USB_ERR(USB_ERR_CMD_INVAL);
+		}
+
+		DEBUGPCR("MFCL_READ sectors %u..%u", req.sector_first,
+			 req.sector_last);
+		led_switch(1, 1);
+		if (mfcl_read_range(&req, rsp) != OPENPCD_MFCL_E_NONE) {
+			led_switch(1, 0);
+			return USB_ERR(USB_ERR_CMD_FAILED);
+		}
+		led_switch(1, 0);
+		break;
+	default:
+		DEBUGP("UNKNOWN ");
+		return USB_ERR(USB_ERR_CMD_UNKNOWN);
+	}
+
+	return USB_RET_RESPOND;
 }
 
 
@@ -271,7 +461,7 @@ void _main_func(void)
 		rfid_layer2_close(l2h);
 
 	rc632_turn_off_rf(NULL);
-	{ volatile int i; for (i = 0; i < 0xfffff; i++) ; }
+	delay_us(RF_OFF_US);
 	rc632_turn_on_rf(NULL);
 
 	led_switch(1, 0);
@@ -32,7 +32,10 @@
 #include <os/dbgu.h>
 #include <os/led.h>
 #include <os/pcd_enumerate.h>
+#include <os/usb_handler.h>
 #include <os/trigger.h>
+#include <os/tc_usec.h>
+#include <os/wdt.h>
 #include <pcd/rc632_highlevel.h>
 
 #include <librfid/rfid_reader.h>
@@ -46,9 +49,14 @@
 
 #define RAH NULL
 
+/* pause between two REQA attempts */
+#define REQA_INTERVAL_US	100000
+
 static struct rfid_reader_handle *rh;
 static struct rfid_layer2_handle *l2h;
 
+static int sweep_usb_rx(struct req_ctx *rctx);
+
 void _init_func(void)
 {
 	trigger_init();
@@ -63,6 +71,7 @@ void _init_func(void)
 	DEBUGPCRF("initializing 14443A operation");
 	rh = rfid_reader_open(NULL, RFID_READER_OPENPCD);
 	l2h = rfid_layer2_init(rh, RFID_LAYER2_ISO14443A);
+	usb_hdlr_register(&sweep_usb_rx, OPENPCD_CMD_CLS_SWEEP);
 }
 
 #define MODE_REQA	0x01
@@ -103,6 +112,21 @@ static u_int8_t ana_out_sel;
 static u_int8_t mfout_sel;
 static u_int8_t speed_idx;
 
+/* bit rates last set on l2h, librfid has no getopt to read them back */
+static u_int8_t speed_rx, speed_tx;
+
+static void set_speed_rx(u_int8_t val)
+{
+	rfid_layer2_setopt(l2h, RFID_OPT_14443A_SPEED_RX, &val, sizeof(val));
+	speed_rx = val;
+}
+
+static void set_speed_tx(u_int8_t val)
+{
+	rfid_layer2_setopt(l2h, RFID_OPT_14443A_SPEED_TX, &val, sizeof(val));
+	speed_tx = val;
+}
+
 static void help(void)
 {
 	DEBUGPCR("r: REQA         w: WUPA        a: ANTICOL\r\n"
@@ -225,11 +249,244 @@ int _main_dbgu(char key)
 	return ret;
 }
 
+/* automated RF parameter sweep (OPENPCD_CMD_SWEEP_RUN) */
+
+#define SWEEP_RF_OFF_US		10000	/* field reset, ISO 14443-3 wants >5ms */
+#define SWEEP_RF_ON_US		5000	/* let the card power up */
+#define SWEEP_FWT_US		10000	/* frame waiting time for transceive */
+
+static void sweep_apply(u_int8_t param, u_int8_t val)
+{
+	switch (param) {
+	case OPENPCD_SWEEP_P_SPEED_RX:
+		set_speed_rx(val);
+		break;
+	case OPENPCD_SWEEP_P_SPEED_TX:
+		set_speed_tx(val);
+		break;
+	default:
+		opcd_rc632_reg_write(RAH, param, val);
+		break;
+	}
+}
+
+/* reset the field, so every attempt starts with the card in IDLE state,
+ * then (re-)apply the parameters of the current grid point */
+static void sweep_prepare(struct openpcd_sweep_req *req, u_int8_t *cur)
+{
+	int a;
+
+	rc632_turn_off_rf(RAH);
+	delay_us(SWEEP_RF_OFF_US);
+	rc632_turn_on_rf(RAH);
+
+	for (a = 0; a < req->num_axes; a++)
+		sweep_apply(req->axis[a].param, cur[a]);
+
+	delay_us(SWEEP_RF_ON_US);
+}
+
+static void sweep_test(struct openpcd_sweep_req *req, u_int8_t *cur,
+		       u_int8_t test, struct openpcd_sweep_test *res)
+{
+	struct iso14443a_atqa atqa;
+	unsigned char rx_buf[32];
+	unsigned int rx_len;
+	u_int32_t start, total = 0;
+	int i, ret;
+
+	res->ok = 0;
+	res->avg_us = 0;
+	if (!(req->tests & test))
+		return;
+
+	for (i = 0; i < req->iterations; i++) {
+		sweep_prepare(req, cur);
+
+		start = tc_usec_now();
+		switch (test) {
+		case OPENPCD_SWEEP_T_REQA:
+			ret = iso14443a_transceive_sf(l2h, ISO14443A_SF_CMD_REQA,
+						      &atqa);
+			break;
+		case OPENPCD_SWEEP_T_ANTICOL:
+			ret = rfid_layer2_open(l2h);
+			if (ret >= 0)
+				rfid_layer2_close(l2h);
+			break;
+		case OPENPCD_SWEEP_T_TRANSCEIVE:
+			ret = rfid_layer2_open(l2h);
+			if (ret < 0)
+				break;
+			/* only time the exchange itself */
+			start = tc_usec_now();
+			rx_len = sizeof(rx_buf);
+			ret = rfid_layer2_transceive(l2h, RFID_14443A_FRAME_REGULAR,
+						     req->frame, req->frame_len,
+						     rx_buf, &rx_len,
+						     SWEEP_FWT_US, 0);
+			if (ret >= 0 && rx_len == 0)
+				ret = -EIO;
+			rfid_layer2_close(l2h);
+			break;
+		default:
+			ret = -EINVAL;
+			break;
+		}
+
+		if (ret >= 0) {
+			res->ok++;
+			total += TICKS_TO_USEC(tc_usec_now() - start);
+		}
+		wdt_restart();
+	}
+
+	if (res->ok) {
+		total /= res->ok;
+		res->avg_us = total > 0xffff ? 0xffff : total;
+	}
+}
+
+static int sweep_check(struct openpcd_sweep_req *req)
+{
+	u_int32_t points = 1;
+	int a;
+
+	if (!req->iterations || req->num_axes > OPENPCD_SWEEP_AXES_MAX ||
+	    req->frame_len > OPENPCD_SWEEP_FRAME_MAX)
+		return -EINVAL;
+
+	if ((req->tests & OPENPCD_SWEEP_T_TRANSCEIVE) && !req->frame_len)
+		return -EINVAL;
+
+	for (a = 0; a < req->num_axes; a++) {
+		struct openpcd_sweep_axis *ax = &req->axis[a];
+
+		if (!ax->step || ax->first > ax->last)
+			return -EINVAL;
+		if (ax->param == OPENPCD_SWEEP_P_SPEED_RX ||
+		    ax->param == OPENPCD_SWEEP_P_SPEED_TX) {
+			if (ax->last > 3)
+				return -EINVAL;
+		} else if (ax->param > OPENPCD_REG_MAX)
+			return -EINVAL;
+
+		points *= (ax->last - ax->first) / ax->step + 1;
+		if (points > 0xffff)
+			return -ERANGE;
+	}
+
+	return 0;
+}
+
+static int sweep_run(struct openpcd_sweep_req *req)
+{
+	struct usb_stream us;
+	struct openpcd_sweep_point *pt;
+	u_int8_t cur[OPENPCD_SWEEP_AXES_MAX];
+	u_int8_t saved[OPENPCD_SWEEP_AXES_MAX];
+	u_int16_t index = 0;
+	int a, ret = OPENPCD_SWEEP_E_NONE;
+
+	usb_stream_init(&us, OPENPCD_CMD_SWEEP_RUN, OPENPCD_SWEEP_R_POINTS);
+
+	for (a = 0; a < req->num_axes; a++) {
+		cur[a] = req->axis[a].first;
+		switch (req->axis[a].param) {
+		case OPENPCD_SWEEP_P_SPEED_RX:
+			saved[a] = speed_rx;
+			break;
+		case OPENPCD_SWEEP_P_SPEED_TX:
+			saved[a] = speed_tx;
+			break;
+		default:
+			opcd_rc632_reg_read(RAH, req->axis[a].param, &saved[a]);
+			break;
+		}
+	}
+
+	while (1) {
+		pt = usb_stream_reserve(&us, sizeof(*pt));
+		if (!pt) {
+			ret = OPENPCD_SWEEP_E_NO_BUF;
+			break;
+		}
+		pt->index = index++;
+		sweep_test(req, cur, OPENPCD_SWEEP_T_REQA, &pt->reqa);
+		sweep_test(req, cur, OPENPCD_SWEEP_T_ANTICOL, &pt->anticol);
+		sweep_test(req, cur, OPENPCD_SWEEP_T_TRANSCEIVE,
+			   &pt->transceive);
+		usb_stream_commit(&us, sizeof(*pt));
+
+		if (!usb_stream_busy(&us))
+			usb_stream_flush(&us);
+
+		/* advance to the next grid point, first axis fastest */
+		for (a = 0; a < req->num_axes; a++) {
+			struct openpcd_sweep_axis *ax = &req->axis[a];
+
+			if (cur[a] + ax->step <= ax->last) {
+				cur[a] += ax->step;
+				break;
+			}
+			cur[a] = ax->first;
+		}
+		if (a == req->num_axes)
+			break;
+	}
+
+	usb_stream_finish(&us);
+
+	for (a = 0; a < req->num_axes; a++)
+		sweep_apply(req->axis[a].param, saved[a]);
+
+	return ret;
+}
+
+static int sweep_usb_rx(struct req_ctx *rctx)
+{
+	struct openpcd_hdr *poh = (struct openpcd_hdr *) rctx->data;
+	struct openpcd_sweep_req req;
+	unsigned int len = rctx->tot_len - sizeof(*poh);
+
+	rctx->tot_len = sizeof(*poh);
+
+	switch (poh->cmd) {
+	case OPENPCD_CMD_SWEEP_RUN:
+		poh->flags = 0x00;
+		poh->reg = OPENPCD_SWEEP_R_DONE;
+		poh->val = OPENPCD_SWEEP_E_NONE;
+
+		memset(&req, 0, sizeof(req));
+		if (len > sizeof(req))
+			len = sizeof(req);
+		memcpy(&req, poh->data, len);
+		if (sweep_check(&req) < 0) {
+			DEBUGPCRF("invalid sweep request");
+			return USB_ERR(USB_ERR_CMD_INVAL);
+		}
+
+		DEBUGPCRF("starting sweep");
+		led_switch(1, 1);
+		poh->val = sweep_run(&req);
+		led_switch(1, 0);
+		if (poh->val != OPENPCD_SWEEP_E_NONE)
+			poh->flags = OPENPCD_FLAG_ERROR;
+		break;
+	default:
+		return USB_ERR(USB_ERR_CMD_UNKNOWN);
+	}
+
+	return USB_RET_RESPOND;
+}
+
 void _main_func(void)
 {
 	int status;
 	struct iso14443a_atqa atqa;
-	volatile int i;
+
+	usb_out_process();
+	usb_in_process();
 
 	/* FIXME: why does this only work every second attempt without reset or
 	 * power-cycle? */
@@ -239,7 +496,7 @@ void _main_func(void)
 
 	opcd_rc632_reg_write(RAH, RC632_REG_TEST_ANA_SELECT, ana_out_sel);
 	opcd_rc632_reg_write(RAH, RC632_REG_MFOUT_SELECT, mfout_sel);
-	for (i = 0; i < 0xfffff; i++) {}
+	delay_us(REQA_INTERVAL_US);
 	//rc632_dump();
 #ifdef WITH_TC
 	tc_cdiv_print();
@@ -271,10 +528,8 @@ void _main_func(void)
 		{
 			char rx_buf[4];
 			int rx_len = sizeof(rx_buf);
-			rfid_layer2_setopt(l2h, RFID_OPT_14443A_SPEED_RX,
-					 &speed_idx, sizeof(speed_idx));
-			rfid_layer2_setopt(l2h, RFID_OPT_14443A_SPEED_TX,
-					 &speed_idx, sizeof(speed_idx));
+			set_speed_rx(speed_idx);
+			set_speed_tx(speed_idx);
 			rfid_layer2_transceive(l2h, RFID_14443A_FRAME_REGULAR, 
 					    &frame_14443a, sizeof(frame_14443a),
 					    &rx_buf, &rx_len, 1, 0);
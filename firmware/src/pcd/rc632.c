@@ -36,12 +36,17 @@
 #include <os/pcd_enumerate.h>
 #include <os/usb_handler.h>
 #include <os/req_ctx.h>
+#include <os/tc_usec.h>
 #include "rc632.h"
 
 #include <librfid/rfid_asic.h>
 
 #define NOTHING  do {} while(0)
 
+/* length of the reset pulse and upper bound for the startup phase */
+#define RC632_RESET_US		10000
+#define RC632_STARTUP_US	100000
+
 #if 0
 #define DEBUGPSPI DEBUGP
 #define DEBUGPSPIIRQ DEBUGP
@@ -405,19 +410,24 @@ void rc632_power(u_int8_t up)
 
 void rc632_reset(void)
 {
-	volatile int i;
+	u_int32_t start;
 
 	rc632_power(0);
-	for (i = 0; i < 0xffff; i++)
-		{}
+	delay_us(RC632_RESET_US);
 	rc632_power(1);
 
 	/* wait for startup phase to finish */
+	start = tc_usec_now();
 	while (1) {
 		u_int8_t val;
 		opcd_rc632_reg_read(NULL, RC632_REG_COMMAND, &val);
 		if (val == 0x00)
 			break;
+		if (tc_usec_after(tc_usec_now(),
+				  start + USEC_TO_TICKS(RC632_STARTUP_US))) {
+			DEBUGPCRF("startup phase timed out");
+			break;
+		}
 	}
 
 	/* turn off register paging */
@@ -27,6 +27,7 @@
 #include <cl_rc632.h>
 #include "rc632.h"
 #include <os/dbgu.h>
+#include <os/tc_usec.h>
 #include <librfid/rfid_layer2_iso14443a.h>
 #include <librfid/rfid_protocol_mifare_classic.h>
 
@@ -95,6 +96,7 @@ rc632_power_down(struct rfid_asic_handle *handle)
 }
 
 #define MAX_WRITE_LEN	16	/* see Sec. 18.6.1.2 of RC632 Spec Rev. 3.2. */
+#define E2_WRITE_US	20000	/* a block takes ~6ms to program */
 
 int
 rc632_write_eeprom(struct rfid_asic_handle *handle, 
@@ -102,6 +104,7 @@ rc632_write_eeprom(struct rfid_asic_handle *handle,
 {
 	u_int8_t sndbuf[MAX_WRITE_LEN + 2];
 	u_int8_t reg;
+	u_int32_t start;
 	int ret;
 
 	if (len > MAX_WRITE_LEN)
@@ -130,6 +133,7 @@ rc632_write_eeprom(struct rfid_asic_handle *handle,
 	if (reg & RC632_ERR_FLAG_ACCESS_ERR)
 		return -EPERM;
 
+	start = tc_usec_now();
 	while (1) {
 		ret = opcd_rc632_reg_read(handle, RC632_REG_SECONDARY_STATUS, &reg);
 		if (ret < 0)
@@ -140,6 +144,12 @@ rc632_write_eeprom(struct rfid_asic_handle *handle,
 			ret = opcd_rc632_reg_write(handle, RC632_REG_COMMAND, RC632_CMD_IDLE);
 			break;
 		}
+
+		if (tc_usec_after(tc_usec_now(),
+				  start + USEC_TO_TICKS(E2_WRITE_US))) {
+			opcd_rc632_reg_write(handle, RC632_REG_COMMAND, RC632_CMD_IDLE);
+			return -ETIMEDOUT;
+		}
 	}
 	
 	return ret;
@@ -0,0 +1,172 @@
+/* Table driven Miller / NRZ-L decoders for OpenPICC
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by 
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *		LSB First	LSB 	hex
+ * Sequence X	0010		0100	0x4
+ * Sequence Y	0000		0000	0x0
+ * Sequence Z	1000		0001	0x1
+ *
+ * Logic 1	Sequence X
+ * Logic 0	Sequence Y with two exceptions:
+ * 		- if there are more contiguous 0, Z used from second one
+ * 		- if the first bit after SOF is 0, sequence Z used for all contig 0's
+ * SOF		Sequence Z
+ * EOF		Logic 0 followed by Sequence Y
+ *
+ * (at two times oversampling X is 0x2, Y 0x0 and Z 0x1)
+ *
+ * The Miller decoder consumes one sample byte (two or four symbols) per
+ * table lookup.  The tables track the previous symbol, so the Miller
+ * coding rules (no Z after X, Y after a logic 0 is EOF) are checked
+ * without extra work.  Data and parity bits are collected in a shift
+ * register and checked a character at a time.
+ *
+ * NRZ-L is sampled once per etu, so no table is needed there: sixteen
+ * samples are shifted in per step and each character is checked for
+ * start and stop bit with a single compare.
+ */
+
+#include <errno.h>
+#include <sys/types.h>
+
+#include "decoder_tab.h"
+#include "decoder_tab.inc"
+
+#define MILLER_CHAR_BITS	9	/* eight data bits plus odd parity */
+
+static int miller_put_char(u_int32_t acc, u_int8_t *data)
+{
+	u_int8_t c = acc & 0xff;
+
+	if (odd_parity[c] != ((acc >> 8) & 1))
+		return -EBADMSG;
+
+	*data = c;
+	return 0;
+}
+
+int decoder_tab_miller(const u_int8_t *sample_buf, int sample_buf_size,
+		       u_int8_t oversampling, u_int8_t *data_buf,
+		       int data_buf_size, u_int8_t *bits)
+{
+	const u_int16_t (*tab)[256];
+	const u_int8_t *end = sample_buf + sample_buf_size;
+	u_int32_t acc = 0;
+	u_int8_t nacc = 0, state = 1;	/* SOF counts as logic 0 */
+	int n = 0;
+
+	if (oversampling == 4)
+		tab = miller_tab4;
+	else if (oversampling == 2)
+		tab = miller_tab2;
+	else
+		return -EINVAL;
+
+	while (sample_buf < end) {
+		u_int16_t e = tab[state][*sample_buf++];
+
+		if (e & MT_ERR)
+			return -EIO;
+
+		acc |= MT_DATA(e) << nacc;
+		nacc += MT_NBITS(e);
+		state = (e & MT_ZERO) ? 1 : 0;
+
+		if (e & MT_EOF) {
+			/* the logic 0 in front of the final Y is not data */
+			nacc--;
+			break;
+		}
+
+		/* keep one bit back, it might turn out to be part of EOF */
+		while (nacc > MILLER_CHAR_BITS) {
+			if (n >= data_buf_size)
+				return -ENOSPC;
+			if (miller_put_char(acc, &data_buf[n++]) < 0)
+				return -EBADMSG;
+			acc >>= MILLER_CHAR_BITS;
+			nacc -= MILLER_CHAR_BITS;
+		}
+	}
+
+	if (nacc == MILLER_CHAR_BITS) {
+		if (n >= data_buf_size)
+			return -ENOSPC;
+		if (miller_put_char(acc, &data_buf[n++]) < 0)
+			return -EBADMSG;
+		nacc = 0;
+	}
+
+	*bits = nacc;
+	if (nacc) {
+		if (n >= data_buf_size)
+			return -ENOSPC;
+		data_buf[n] = acc & ((1 << nacc) - 1);
+	}
+
+	return n;
+}
+
+#define NRZL_CHAR_BITS	10
+#define NRZL_CHAR_MASK	0x3ff
+#define NRZL_FRAMING	0x201	/* start and stop bit */
+
+int decoder_tab_nrzl(const u_int8_t *sample_buf, int sample_buf_size,
+		     u_int8_t *data_buf, int data_buf_size)
+{
+	u_int32_t acc = 0;
+	u_int8_t nacc = 0;
+	int i = 0, n = 0;
+
+	while (1) {
+		if (nacc < NRZL_CHAR_BITS) {
+			if (i + 1 < sample_buf_size) {
+				acc |= (sample_buf[i] | sample_buf[i+1] << 8)
+					<< nacc;
+				nacc += 16;
+				i += 2;
+			} else if (i < sample_buf_size) {
+				acc |= sample_buf[i++] << nacc;
+				nacc += 8;
+			} else
+				break;
+			continue;
+		}
+
+		/* logic 1 between characters is extra guard time */
+		if (acc & 1) {
+			acc >>= 1;
+			nacc--;
+			continue;
+		}
+
+		/* ten etu of logic 0 are the EOF */
+		if ((acc & NRZL_CHAR_MASK) == 0)
+			break;
+
+		if ((acc & NRZL_FRAMING) != 0x200)
+			return -EIO;
+
+		if (n >= data_buf_size)
+			return -ENOSPC;
+		data_buf[n++] = (acc >> 1) & 0xff;
+
+		acc >>= NRZL_CHAR_BITS;
+		nacc -= NRZL_CHAR_BITS;
+	}
+
+	return n;
+}
@@ -0,0 +1,31 @@
+#ifndef _DECODER_TAB_H
+#define _DECODER_TAB_H
+
+/* Table driven ISO14443 sample decoders, shared between the OpenPICC
+ * firmware, openpicc/application and the host side benchmark.  Do not
+ * include any board or OS specific headers here. */
+
+/* Miller table entry layout, see decoder_tab.py */
+#define MT_DATA(x)	((x) & 0xf)
+#define MT_NBITS(x)	(((x) >> 4) & 0x7)
+#define MT_ZERO		0x100
+#define MT_EOF		0x200
+#define MT_ERR		0x400
+
+/* Decode an ISO14443A modified Miller frame (SOF already stripped by the
+ * SSC start condition) at 2 or 4 times oversampling.  Returns the number
+ * of complete, parity checked bytes in data_buf; *bits is set to the
+ * number of bits of a trailing incomplete byte (e.g. 7 for REQA), which
+ * is stored in data_buf[ret].  -EIO on coding errors, -EBADMSG on parity
+ * errors, -ENOSPC if data_buf is too small. */
+extern int decoder_tab_miller(const u_int8_t *sample_buf, int sample_buf_size,
+			      u_int8_t oversampling, u_int8_t *data_buf,
+			      int data_buf_size, u_int8_t *bits);
+
+/* Decode NRZ-L characters (start bit, eight data bits, stop bit) sampled
+ * once per etu, skipping extra guard time between them and stopping at
+ * EOF.  Returns the number of bytes, -EIO on framing errors or -ENOSPC. */
+extern int decoder_tab_nrzl(const u_int8_t *sample_buf, int sample_buf_size,
+			    u_int8_t *data_buf, int data_buf_size);
+
+#endif
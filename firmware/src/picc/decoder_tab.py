@@ -0,0 +1,70 @@
+#!/usr/bin/env python
+#
+# Generates decoder_tab.inc, the lookup tables used by decoder_tab.c
+#
+# Miller tables are indexed by [state][sample byte], state 1 meaning
+# that the previous symbol was a logic 0 (or SOF).  Each entry holds
+# the data bits contained in the byte (first bit in bit 0), their
+# number, the new state and EOF/error flags, see decoder_tab.h
+
+import sys
+
+MT_ZERO = 0x100
+MT_EOF = 0x200
+MT_ERR = 0x400
+
+def miller_entry(state, byte, rate, seq_x, seq_y, seq_z):
+	data = 0
+	nbits = 0
+	flags = 0
+	mask = (1 << rate) - 1
+
+	for i in range(8 // rate):
+		seq = (byte >> (i * rate)) & mask
+		if seq == seq_x:
+			data |= 1 << nbits
+			nbits += 1
+			state = 0
+		elif seq == seq_y and state:
+			# logic 0 followed by Y: end of frame
+			flags |= MT_EOF
+			break
+		elif seq == seq_y or (seq == seq_z and state):
+			nbits += 1
+			state = 1
+		else:
+			flags |= MT_ERR
+			break
+
+	if state:
+		flags |= MT_ZERO
+
+	return flags | (nbits << 4) | data
+
+def miller_table(name, rate, seq_x, seq_y, seq_z):
+	out = "static const u_int16_t %s[2][256] = {\n" % name
+	for state in range(2):
+		e = [miller_entry(state, b, rate, seq_x, seq_y, seq_z)
+			for b in range(256)]
+		out += "\t{\n"
+		for i in range(0, 256, 8):
+			out += "\t\t" + ", ".join(["0x%03x" % x for x in e[i:i+8]]) + ",\n"
+		out += "\t},\n"
+	out += "};\n"
+	return out
+
+def parity_table(name):
+	e = [1 - (bin(b).count("1") & 1) for b in range(256)]
+	out = "static const u_int8_t %s[256] = {\n" % name
+	for i in range(0, 256, 16):
+		out += "\t" + ", ".join([str(x) for x in e[i:i+16]]) + ",\n"
+	out += "};\n"
+	return out
+
+sys.stdout.write("/* Autogenerated from decoder_tab.py */\n\n")
+sys.stdout.write("/* four times oversampling: X=0x4, Y=0x0, Z=0x1 */\n")
+sys.stdout.write(miller_table("miller_tab4", 4, 0x4, 0x0, 0x1))
+sys.stdout.write("\n/* two times oversampling: X=0x2, Y=0x0, Z=0x1 */\n")
+sys.stdout.write(miller_table("miller_tab2", 2, 0x2, 0x0, 0x1))
+sys.stdout.write("\n/* ISO14443A odd parity bit for each byte */\n")
+sys.stdout.write(parity_table("odd_parity"))
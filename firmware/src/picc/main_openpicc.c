@@ -62,7 +62,6 @@ void _init_func(void)
 	ssc_tx_init();
 
 	/* high-level protocol */
-	decoder_init();
 	opicc_usbapi_init();
 
 	AT91F_PIO_CfgInput(AT91C_BASE_PIOA, OPENPICC_PIO_BOOTLDR);
@@ -248,6 +247,9 @@ int _main_dbgu(char key)
 
 void _main_func(void)
 {
+	/* compress continuous SSC captures before they are queued */
+	ssc_rx_process();
+
 	/* first we try to get rid of pending to-be-sent stuff */
 	usb_out_process();
 
@@ -34,9 +34,11 @@
 #include <os/usb_handler.h>
 #include <os/dbgu.h>
 #include <os/led.h>
+#include <os/tc_usec.h>
 #include "../openpcd.h"
 
 #include <picc/tc_cdiv_sync.h>
+#include <picc/ssc_rle.h>
 
 //#define DEBUG_SSC_REFILL
 
@@ -59,16 +61,21 @@ enum ssc_mode {
 struct ssc_state {
 	struct req_ctx *rx_ctx[2];
 	enum ssc_mode mode;
+	u_int32_t seq;
+	u_int8_t overrun;
 };
 static struct ssc_state ssc_state;
 
+/* samples are DMA'd behind the openpcd_hdr and the capture header */
+#define SSC_RX_OFS	(MAX_HDRSIZE + sizeof(struct openpcd_ssc_capture))
+
 static const u_int16_t ssc_dmasize[] = {
 	[SSC_MODE_NONE]			= 16,
 	[SSC_MODE_14443A_SHORT]		= 16,	/* 64 bytes */
 	[SSC_MODE_14443A_STANDARD]	= 16,	/* 64 bytes */
 	[SSC_MODE_14443B]		= 16,	/* 64 bytes */
 	[SSC_MODE_EDGE_ONE_SHOT] 	= 16,	/* 64 bytes */
-	[SSC_MODE_CONTINUOUS]		= 511,	/* 2044 bytes */
+	[SSC_MODE_CONTINUOUS]		= 508,	/* 2032 bytes */
 };
 
 /* This is for four-times oversampling */
@@ -224,14 +231,13 @@ static int __ramfunc __ssc_rx_refill(int secondary)
 	init_opcdhdr(rctx);
 	DEBUGR("filling SSC RX%u dma ctx: %u (len=%u) ", secondary,
 		req_ctx_num(rctx), rctx->size);
-	rctx->tot_len = ssc_dmasize[ssc_state.mode]*4 + 
-			sizeof(struct openpcd_hdr);
+	rctx->tot_len = ssc_dmasize[ssc_state.mode]*4 + SSC_RX_OFS;
 	if (secondary) {
-		AT91F_PDC_SetNextRx(rx_pdc, rctx->data+MAX_HDRSIZE,
+		AT91F_PDC_SetNextRx(rx_pdc, rctx->data+SSC_RX_OFS,
 				    ssc_dmasize[ssc_state.mode]);
 		ssc_state.rx_ctx[1] = rctx;
 	} else {
-		AT91F_PDC_SetRx(rx_pdc, rctx->data+MAX_HDRSIZE,
+		AT91F_PDC_SetRx(rx_pdc, rctx->data+SSC_RX_OFS,
 				ssc_dmasize[ssc_state.mode]);
 		ssc_state.rx_ctx[0] = rctx;
 	}
@@ -306,10 +312,30 @@ static int8_t ssc_rx_refill(void)
 #define ISO14443A_FDT_SHORT_1	1236
 #define ISO14443A_FDT_SHORT_0	1172
 
+/* A DMA buffer has been filled: stamp it and hand it on.  Continuous
+ * captures are compressed by ssc_rx_process() in the main loop, so
+ * the IRQ handler never has to look at the samples. */
+static void __ramfunc ssc_rx_done(struct req_ctx *rctx)
+{
+	struct openpcd_ssc_capture *cap =
+		(struct openpcd_ssc_capture *) (rctx->data + MAX_HDRSIZE);
+
+	cap->timestamp = tc_usec_now();
+	cap->seq = ssc_state.seq++;
+	cap->words = (rctx->tot_len - SSC_RX_OFS) >> 2;
+	cap->flags = ssc_state.overrun ? OPENPCD_SSC_F_OVERRUN : 0;
+	cap->res = 0;
+	ssc_state.overrun = 0;
+
+	if (ssc_state.mode == SSC_MODE_CONTINUOUS)
+		req_ctx_set_state(rctx, RCTX_STATE_SSC_RX_DONE);
+	else
+		req_ctx_set_state(rctx, RCTX_STATE_UDP_EP2_PENDING);
+}
+
 static void __ramfunc ssc_irq(void)
 {
 	u_int32_t ssc_sr = ssc->SSC_SR;
-	int i, *tmp, emptyframe = 0;
 	DEBUGP("ssc_sr=0x%08x, mode=%u: ", ssc_sr, ssc_state.mode);
 
 	if (ssc_sr & AT91C_SSC_ENDRX) {
@@ -343,31 +369,9 @@ static void __ramfunc ssc_irq(void)
 			}
 		}
 #endif
-		/* Ignore empty frames */
-		if (ssc_state.mode == SSC_MODE_CONTINUOUS) {
-			tmp = (u_int32_t*)ssc_state.rx_ctx[0]->data + MAX_HDRSIZE;
-			emptyframe = 1;
-			for(i = (ssc_state.rx_ctx[0]->size-MAX_HDRSIZE) / 4 - 8/*WTF?*/; i > 0; i--) {
-				if( *tmp++ != 0xFFFFFFFF ) {
-					DEBUGPCR("NONEMPTY(%08x, %i): %08x", tmp, i, *(tmp-1));
-					emptyframe = 0;
-					break;
-				} else {
-					//DEBUGPCR("DUNNO(%08x, %i): %08x", tmp, i, tmp[i]);
-				}
-			}
-		}
 		//DEBUGP("Sending primary RCTX(%u, len=%u) ", req_ctx_num(ssc_state.rx_ctx[0]), ssc_state.rx_ctx[0]->tot_len);
 		/* Mark primary RCTX as ready to send for usb */
-		if(!emptyframe) {
-			DEBUGP("NONEMPTY");
-			req_ctx_set_state(ssc_state.rx_ctx[0], 
-					  RCTX_STATE_UDP_EP2_PENDING);
-					  //RCTX_STATE_FREE);
-		} else {
-			DEBUGP("EMPTY");
-			req_ctx_put(ssc_state.rx_ctx[0]);
-		}
+		ssc_rx_done(ssc_state.rx_ctx[0]);
 
 		/* second buffer gets propagated to primary */
 		ssc_state.rx_ctx[0] = ssc_state.rx_ctx[1];
@@ -376,9 +380,7 @@ static void __ramfunc ssc_irq(void)
 			DEBUGP("RXBUFF! ");
 			if (ssc_state.rx_ctx[0]) {
 				//DEBUGP("Sending secondary RCTX(%u, len=%u) ", req_ctx_num(ssc_state.rx_ctx[0]), ssc_state.rx_ctx[0]->tot_len);
-				req_ctx_set_state(ssc_state.rx_ctx[0],
-						  RCTX_STATE_UDP_EP2_PENDING);
-						  //RCTX_STATE_FREE);
+				ssc_rx_done(ssc_state.rx_ctx[0]);
 			}
 			if (__ssc_rx_refill(0) == -1)
 				AT91F_SSC_DisableIt(ssc, AT91C_SSC_ENDRX |
@@ -401,8 +403,10 @@ static void __ramfunc ssc_irq(void)
 #endif
 	}
 	
-	if (ssc_sr & AT91C_SSC_OVRUN)
+	if (ssc_sr & AT91C_SSC_OVRUN) {
 		DEBUGP("RX_OVERRUN ");
+		ssc_state.overrun = 1;
+	}
 
 	if (ssc_sr & AT91C_SSC_CP0)
 		DEBUGP("CP0 ");
@@ -445,6 +449,38 @@ static void __ramfunc ssc_irq(void)
 	AT91F_AIC_ClearIt(AT91C_BASE_AIC, AT91C_ID_SSC);
 }
 
+/* Run-length encode the idle stretches of a continuous capture buffer
+ * in place, see ssc_rle.c */
+static void ssc_rx_compress(struct req_ctx *rctx)
+{
+	struct openpcd_ssc_capture *cap =
+		(struct openpcd_ssc_capture *) (rctx->data + MAX_HDRSIZE);
+	int len;
+
+	len = ssc_rle_encode(rctx->data + SSC_RX_OFS, cap->words);
+	if (len == 0) {
+		/* nothing happened, the seq gap tells the host */
+		req_ctx_put(rctx);
+		return;
+	}
+	if (len > 0) {
+		cap->flags |= OPENPCD_SSC_F_RLE;
+		rctx->tot_len = SSC_RX_OFS + len;
+	}
+
+	req_ctx_set_state(rctx, RCTX_STATE_UDP_EP2_PENDING);
+}
+
+/* compress finished continuous captures and queue them for USB */
+void ssc_rx_process(void)
+{
+	struct req_ctx *rctx;
+
+	while (rctx = req_ctx_find_get(1, RCTX_STATE_SSC_RX_DONE,
+				       RCTX_STATE_MAIN_PROCESSING))
+		ssc_rx_compress(rctx);
+}
+
 void ssc_print(void)
 {
 	DEBUGP("PDC_RPR=0x%08x ", rx_pdc->PDC_RPR);
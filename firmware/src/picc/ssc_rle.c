@@ -0,0 +1,99 @@
+/* Run-length coding of idle stretches in SSC captures for OpenPICC
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * No hardware in here, host/ssc_rle_test.c builds this file as it is.
+ */
+
+#include <string.h>
+#include <sys/types.h>
+#include <openpcd.h>
+
+#include "ssc_rle.h"
+
+/* skip idle words, four at a time while possible */
+static const u_int32_t *ssc_skip_idle(const u_int32_t *p,
+				      const u_int32_t *end)
+{
+	while (end - p >= 4 && (p[0] & p[1] & p[2] & p[3]) == SSC_IDLE)
+		p += 4;
+	while (p < end && *p == SSC_IDLE)
+		p++;
+
+	return p;
+}
+
+/* find the end of an active stretch: the next run of at least two idle
+ * words, since a single one is cheaper to carry as literal */
+static const u_int32_t *ssc_skip_active(const u_int32_t *p,
+					const u_int32_t *end)
+{
+	while (p < end) {
+		if (p[0] == SSC_IDLE && (p + 1 == end || p[1] == SSC_IDLE))
+			break;
+		p++;
+	}
+
+	return p;
+}
+
+static inline void ssc_put_seg(u_int8_t *w, u_int16_t seg)
+{
+	w[0] = seg & 0xff;
+	w[1] = seg >> 8;
+}
+
+/* Each round takes an active stretch and the idle run behind it.  Both
+ * ends are found before anything is written: the first literal header
+ * puts the output two bytes ahead of the input, so moving the literal
+ * overwrites the start of the idle run that follows it.  Once that run
+ * is replaced by its two byte header (it is at least two words long
+ * unless it ends the buffer), the output is behind the input for good.
+ * A buffer without any idle run (a lone idle word is carried as
+ * literal) would only grow and is left raw. */
+int ssc_rle_encode(u_int8_t *buf, u_int16_t words)
+{
+	const u_int32_t *r = (const u_int32_t *) buf;
+	const u_int32_t *end = r + words;
+	const u_int32_t *active_end, *idle_end;
+	u_int8_t *w = buf;
+	u_int16_t n;
+
+	idle_end = ssc_skip_idle(r, end);
+	if (idle_end == end)
+		return 0;
+	if (ssc_skip_active(r, end) == end)
+		return -1;
+
+	while (r < end) {
+		active_end = ssc_skip_active(r, end);
+		idle_end = ssc_skip_idle(active_end, end);
+
+		n = active_end - r;
+		if (n) {
+			memmove(w + 2, r, n * 4);
+			ssc_put_seg(w, n);
+			w += 2 + n * 4;
+		}
+		if (idle_end != active_end) {
+			ssc_put_seg(w, OPENPCD_SSC_SEG_IDLE |
+					(idle_end - active_end));
+			w += 2;
+		}
+		r = idle_end;
+	}
+
+	return w - buf;
+}
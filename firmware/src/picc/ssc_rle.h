@@ -0,0 +1,18 @@
+#ifndef _SSC_RLE_H
+#define _SSC_RLE_H
+
+/* Run-length coding of the idle stretches of continuous SSC captures,
+ * in the segment format documented with struct openpcd_ssc_capture in
+ * openpcd.h.  Shared between the OpenPICC firmware and the host side
+ * round trip test, do not include any board specific headers here. */
+
+/* the demodulated carrier is high while there is no modulation */
+#define SSC_IDLE	0xffffffff
+
+/* Encode the words sample words at buf in place.  Returns the encoded
+ * length in bytes, 0 if there was no modulation at all (nothing to
+ * send) or -1 if encoding would not make the buffer any shorter, in
+ * which case buf is left as it was. */
+extern int ssc_rle_encode(u_int8_t *buf, u_int16_t words);
+
+#endif
@@ -32,6 +32,7 @@
 #include <lib_AT91SAM7.h>
 #include <AT91SAM7.h>
 #include <os/dbgu.h>
+#include <os/tc_usec.h>
 
 #include "../openpcd.h"
 #include <os/tc_cdiv.h>
@@ -113,7 +114,7 @@ void tc_fdt_init(void)
 		      AT91C_TC_ENETRG | AT91C_TC_CPCSTOP ;
 
 	/* Reset to start timers */
-	tcb->TCB_BCR = 1;
+	tc_usec_resync();
 
 	AT91F_AIC_ConfigureIt(AT91C_BASE_AIC, AT91C_ID_TC2,
 			      OPENPCD_IRQ_PRIO_TC_FDT,
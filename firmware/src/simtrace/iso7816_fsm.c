@@ -0,0 +1,387 @@
+/* ISO 7816-3 ATR / PTS state machine for passive sniffing
+ * (C) 2010 by Harald Welte <hwelte@hmw-consulting.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Bytes go in one at a time, events come out, the USART, the ETU
+ * timer and the USB side are left to iso7816_uart.c.  The host
+ * builds this file as it is for fuzzing and benchmarks.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "iso7816_fsm.h"
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+
+/* Table 6 from ISO 7816-3 */
+static const u_int16_t fi_table[] = {
+	372, 372, 558, 744, 1116, 1488, 1860, 0,
+	0, 512, 768, 1024, 1536, 2048, 0, 0
+};
+
+/* Table 7 from ISO 7816-3 */
+static const u_int8_t di_table[] = {
+	0, 1, 2, 4, 8, 16, 32, 64,
+	12, 20, 2, 4, 8, 16, 32, 64,
+};
+
+/* compute the F/D ratio based on Fi and Di values */
+int iso7816_3_fidi_ratio(u_int8_t fi, u_int8_t di)
+{
+	u_int16_t f, d;
+	int ret;
+
+	if (fi >= ARRAY_SIZE(fi_table) ||
+	    di >= ARRAY_SIZE(di_table))
+		return -EINVAL;
+
+	f = fi_table[fi];
+	if (f == 0)
+		return -EINVAL;
+
+	d = di_table[di];
+	if (d == 0)
+		return -EINVAL;
+
+	/* See table 7 of ISO 7816-3: From 1000 on we divide by 1/d,
+	 * which equals a multiplication by d */
+	if (di < 8)
+		ret = f / d;
+	else
+		ret = f * d;
+
+	return ret;
+}
+
+/* Update the ATR sub-state */
+static void set_atr_state(struct iso7816_3_fsm *fsm, enum atr_state new_atrs)
+{
+	if (new_atrs == ATR_S_WAIT_TS) {
+		fsm->atr_idx = 0;
+		fsm->atr_hist_len = 0;
+		fsm->atr_last_td = 0;
+		fsm->prot_t_supported = (1 << 0);
+		memset(fsm->atr, 0, sizeof(fsm->atr));
+	} else if (fsm->atr_state == new_atrs)
+		return;
+
+	fsm->atr_state = new_atrs;
+}
+
+/* Update the PTS sub-state */
+static void set_pts_state(struct iso7816_3_fsm *fsm, enum pts_state new_ptss)
+{
+	fsm->pts_state = new_ptss;
+}
+
+/* Update the ISO 7816-3 APDU receiver state */
+static void set_state(struct iso7816_3_fsm *fsm, enum iso7816_3_state new_state)
+{
+	if (new_state == ISO7816_S_WAIT_ATR) {
+		/* Reset to initial Fi / Di ratio */
+		fsm->fi = 1;
+		fsm->di = 1;
+		/* initialize todefault WI, this will be overwritten if we
+		 * receive TC2, and it will be programmed into hardware after
+		 * ATR is finished */
+		fsm->wi = ISO7816_3_DEFAULT_WI;
+		/* update waiting time to initial waiting time */
+		fsm->waiting_time = ISO7816_3_INIT_WTIME;
+		/* Set ATR sub-state to initial state */
+		set_atr_state(fsm, ATR_S_WAIT_TS);
+		set_pts_state(fsm, PTS_S_WAIT_REQ_PTSS);
+	}
+
+	fsm->state = new_state;
+}
+
+static enum iso7816_3_state atr_done_wait_apdu(struct iso7816_3_fsm *fsm,
+					       int *ev)
+{
+	set_atr_state(fsm, ATR_S_DONE);
+	/* update the waiting time */
+	fsm->waiting_time = 960 * di_table[fsm->di] * fsm->wi;
+	*ev |= ISO7816_EV_ATR_DONE;
+	return ISO7816_S_WAIT_APDU;
+}
+
+static enum iso7816_3_state
+transition_to_tck(struct iso7816_3_fsm *fsm, int *ev)
+{
+	if (fsm->prot_t_supported == 0x01) {
+		/* If only T=0 supported, there is no TCK but we
+		 * immediately transition to APDUs */
+		return atr_done_wait_apdu(fsm, ev);
+	} else {
+		set_atr_state(fsm, ATR_S_WAIT_TCK);
+		return ISO7816_S_IN_ATR;
+	}
+}
+
+/* determine the next ATR state based on received interface byte */
+static enum atr_state next_intb_state(struct iso7816_3_fsm *fsm, u_int8_t ch)
+{
+	switch (fsm->atr_state) {
+	case ATR_S_WAIT_TD:
+		fsm->prot_t_supported |= (1 << (ch & 0xf));
+	case ATR_S_WAIT_T0:
+		fsm->atr_last_td = ch;
+		goto from_td;
+	case ATR_S_WAIT_TC:
+		if ((fsm->atr_last_td & 0x0f) == 0x02) {
+			/* TC2 contains WI */
+			fsm->wi = ch;
+		}
+		goto from_tc;
+	case ATR_S_WAIT_TB:
+		goto from_tb;
+	case ATR_S_WAIT_TA:
+		goto from_ta;
+	default:
+		/* something wrong, old_state != TA */
+		return ATR_S_WAIT_TCK;
+	}
+
+from_td:
+	if (fsm->atr_last_td & 0x10)
+		return ATR_S_WAIT_TA;
+from_ta:
+	if (fsm->atr_last_td & 0x20)
+		return ATR_S_WAIT_TB;
+from_tb:
+	if (fsm->atr_last_td & 0x40)
+		return ATR_S_WAIT_TC;
+from_tc:
+	if (fsm->atr_last_td & 0x80)
+		return ATR_S_WAIT_TD;
+
+	/* Historical bytes are common, but optional! */
+	if (fsm->atr_hist_len)
+		return ATR_S_WAIT_HIST;
+	else
+		return ATR_S_WAIT_TCK;
+}
+
+/* the interface bytes are done when next_intb_state() leaves them */
+static enum iso7816_3_state
+process_intb(struct iso7816_3_fsm *fsm, u_int8_t ch, int *ev)
+{
+	enum atr_state next = next_intb_state(fsm, ch);
+
+	if (next == ATR_S_WAIT_TCK)
+		return transition_to_tck(fsm, ev);
+	set_atr_state(fsm, next);
+	return ISO7816_S_IN_ATR;
+}
+
+/* process an incomng ATR byte */
+static enum iso7816_3_state
+process_byte_atr(struct iso7816_3_fsm *fsm, u_int8_t byte, int *ev)
+{
+	/* No ATR is this long, the TDs never end on a noisy line */
+	if (fsm->atr_idx >= sizeof(fsm->atr))
+		return atr_done_wait_apdu(fsm, ev);
+
+	/* add byte to ATR buffer */
+	fsm->atr[fsm->atr_idx] = byte;
+	fsm->atr_idx++;
+
+	switch (fsm->atr_state) {
+	case ATR_S_WAIT_TS:
+		/* FIXME: if we don't have the RST line we might get this */
+		if (byte == 0) {
+			fsm->atr_idx--;
+			break;
+		}
+		/* FIXME: check inverted logic */
+		set_atr_state(fsm, ATR_S_WAIT_T0);
+		break;
+	case ATR_S_WAIT_T0:
+		/* obtain the number of historical bytes */
+		fsm->atr_hist_len = byte & 0xf;
+		/* Mask out the hist-byte-length to indiicate T=0 */
+		return process_intb(fsm, byte & 0xf0, ev);
+	case ATR_S_WAIT_TA:
+	case ATR_S_WAIT_TB:
+	case ATR_S_WAIT_TC:
+	case ATR_S_WAIT_TD:
+		return process_intb(fsm, byte, ev);
+	case ATR_S_WAIT_HIST:
+		fsm->atr_hist_len--;
+		/* after all historical bytes are recieved, go to TCK */
+		if (fsm->atr_hist_len == 0)
+			return transition_to_tck(fsm, ev);
+		break;
+	case ATR_S_WAIT_TCK:
+		/* FIXME: process and verify the TCK */
+		return atr_done_wait_apdu(fsm, ev);
+	case ATR_S_DONE:
+		break;
+	}
+
+	return ISO7816_S_IN_ATR;
+}
+
+/* Determine the next PTS state */
+static enum pts_state next_pts_state(struct iso7816_3_fsm *fsm)
+{
+	u_int8_t is_resp = fsm->pts_state & 0x10;
+	u_int8_t sstate = fsm->pts_state & 0x0f;
+	u_int8_t *pts_ptr;
+
+	if (!is_resp)
+		pts_ptr = fsm->pts_req;
+	else
+		pts_ptr = fsm->pts_resp;
+
+	switch (sstate) {
+	case PTS_S_WAIT_REQ_PTSS:
+		goto from_ptss;
+	case PTS_S_WAIT_REQ_PTS0:
+		goto from_pts0;
+	case PTS_S_WAIT_REQ_PTS1:
+		goto from_pts1;
+	case PTS_S_WAIT_REQ_PTS2:
+		goto from_pts2;
+	case PTS_S_WAIT_REQ_PTS3:
+		goto from_pts3;
+	}
+
+	if (fsm->pts_state == PTS_S_WAIT_REQ_PCK)
+		return PTS_S_WAIT_RESP_PTSS;
+
+from_ptss:
+	return PTS_S_WAIT_REQ_PTS0 | is_resp;
+from_pts0:
+	if (pts_ptr[_PTS0] & (1 << 4))
+		return PTS_S_WAIT_REQ_PTS1 | is_resp;
+from_pts1:
+	if (pts_ptr[_PTS0] & (1 << 5))
+		return PTS_S_WAIT_REQ_PTS2 | is_resp;
+from_pts2:
+	if (pts_ptr[_PTS0] & (1 << 6))
+		return PTS_S_WAIT_REQ_PTS3 | is_resp;
+from_pts3:
+	return PTS_S_WAIT_REQ_PCK | is_resp;
+}
+
+static enum iso7816_3_state
+process_byte_pts(struct iso7816_3_fsm *fsm, u_int8_t byte, int *ev)
+{
+	switch (fsm->pts_state) {
+	case PTS_S_WAIT_REQ_PTSS:
+		fsm->pts_req[_PTSS] = byte;
+		break;
+	case PTS_S_WAIT_REQ_PTS0:
+		fsm->pts_req[_PTS0] = byte;
+		break;
+	case PTS_S_WAIT_REQ_PTS1:
+		fsm->pts_req[_PTS1] = byte;
+		break;
+	case PTS_S_WAIT_REQ_PTS2:
+		fsm->pts_req[_PTS2] = byte;
+		break;
+	case PTS_S_WAIT_REQ_PTS3:
+		fsm->pts_req[_PTS3] = byte;
+		break;
+	case PTS_S_WAIT_REQ_PCK:
+		/* FIXME: check PCK */
+		fsm->pts_req[_PCK] = byte;
+		break;
+	case PTS_S_WAIT_RESP_PTSS:
+		fsm->pts_resp[_PTSS] = byte;
+		break;
+	case PTS_S_WAIT_RESP_PTS0:
+		fsm->pts_resp[_PTS0] = byte;
+		break;
+	case PTS_S_WAIT_RESP_PTS1:
+		/* This must be TA1 */
+		fsm->fi = byte >> 4;
+		fsm->di = byte & 0xf;
+		*ev |= ISO7816_EV_PTS_FIDI;
+		fsm->pts_resp[_PTS1] = byte;
+		break;
+	case PTS_S_WAIT_RESP_PTS2:
+		fsm->pts_resp[_PTS2] = byte;
+		break;
+	case PTS_S_WAIT_RESP_PTS3:
+		fsm->pts_resp[_PTS3] = byte;
+		break;
+	case PTS_S_WAIT_RESP_PCK:
+		fsm->pts_resp[_PCK] = byte;
+		/* FIXME: check PCK */
+		set_pts_state(fsm, PTS_S_WAIT_REQ_PTSS);
+		/* update baud rate generator with Fi/Di */
+		*ev |= ISO7816_EV_PTS_DONE;
+		/* Wait for the next APDU */
+		return ISO7816_S_WAIT_APDU;
+	}
+	/* calculate the next state and set it */
+	set_pts_state(fsm, next_pts_state(fsm));
+
+	return ISO7816_S_IN_PTS;
+}
+
+int iso7816_3_process_byte(struct iso7816_3_fsm *fsm, u_int8_t byte)
+{
+	int ev = 0;
+
+	switch (fsm->state) {
+	case ISO7816_S_RESET:
+		break;
+	case ISO7816_S_WAIT_ATR:
+	case ISO7816_S_IN_ATR:
+		set_state(fsm, process_byte_atr(fsm, byte, &ev));
+		break;
+	case ISO7816_S_WAIT_APDU:
+		if (byte == 0xff) {
+			/* whatever a PTS the card did not answer left */
+			set_pts_state(fsm, PTS_S_WAIT_REQ_PTSS);
+			ev |= ISO7816_EV_PTS | ISO7816_EV_PTS_START;
+			set_state(fsm, process_byte_pts(fsm, byte, &ev));
+			break;
+		}
+	case ISO7816_S_IN_APDU:
+		set_state(fsm, ISO7816_S_IN_APDU);
+		break;
+	case ISO7816_S_IN_PTS:
+		ev |= ISO7816_EV_PTS;
+		set_state(fsm, process_byte_pts(fsm, byte, &ev));
+		break;
+	}
+
+	return ev;
+}
+
+void iso7816_3_reset(struct iso7816_3_fsm *fsm)
+{
+	set_state(fsm, ISO7816_S_RESET);
+}
+
+void iso7816_3_atr_start(struct iso7816_3_fsm *fsm)
+{
+	set_state(fsm, ISO7816_S_WAIT_ATR);
+}
+
+void iso7816_3_wtime_expired(struct iso7816_3_fsm *fsm)
+{
+	if (fsm->state == ISO7816_S_IN_PTS) {
+		/* Timout during PTS: Card does not support PTS */
+	}
+	set_state(fsm, ISO7816_S_WAIT_APDU);
+}
@@ -0,0 +1,101 @@
+#ifndef _ISO7816_FSM_H
+#define _ISO7816_FSM_H
+
+/* ISO 7816-3 ATR / PTS state machine of the sniffer, without any
+ * hardware in it so that it builds for the host as well, see
+ * host/iso7816_fuzz.c and host/iso7816_bench.c */
+
+#include <sys/types.h>
+
+#define ISO7816_3_INIT_WTIME		9600
+#define ISO7816_3_DEFAULT_WI		10
+
+enum iso7816_3_state {
+	ISO7816_S_RESET,	/* in Reset */
+	ISO7816_S_WAIT_ATR,	/* waiting for ATR to start */
+	ISO7816_S_IN_ATR,	/* while we are receiving the ATR */
+	ISO7816_S_WAIT_APDU,	/* waiting for start of new APDU */
+	ISO7816_S_IN_APDU,	/* inside a single APDU */
+	ISO7816_S_IN_PTS,	/* while we are inside the PTS / PSS */
+};
+
+/* detailed sub-states of ISO7816_S_IN_ATR */
+enum atr_state {
+	ATR_S_WAIT_TS,
+	ATR_S_WAIT_T0,
+	ATR_S_WAIT_TA,
+	ATR_S_WAIT_TB,
+	ATR_S_WAIT_TC,
+	ATR_S_WAIT_TD,
+	ATR_S_WAIT_HIST,
+	ATR_S_WAIT_TCK,
+	ATR_S_DONE,
+};
+
+/* detailed sub-states of ISO7816_S_IN_PTS */
+enum pts_state {
+	PTS_S_WAIT_REQ_PTSS,
+	PTS_S_WAIT_REQ_PTS0,
+	PTS_S_WAIT_REQ_PTS1,
+	PTS_S_WAIT_REQ_PTS2,
+	PTS_S_WAIT_REQ_PTS3,
+	PTS_S_WAIT_REQ_PCK,
+	PTS_S_WAIT_RESP_PTSS = PTS_S_WAIT_REQ_PTSS | 0x10,
+	PTS_S_WAIT_RESP_PTS0 = PTS_S_WAIT_REQ_PTS0 | 0x10,
+	PTS_S_WAIT_RESP_PTS1 = PTS_S_WAIT_REQ_PTS1 | 0x10,
+	PTS_S_WAIT_RESP_PTS2 = PTS_S_WAIT_REQ_PTS2 | 0x10,
+	PTS_S_WAIT_RESP_PTS3 = PTS_S_WAIT_REQ_PTS3 | 0x10,
+	PTS_S_WAIT_RESP_PCK = PTS_S_WAIT_REQ_PCK | 0x10,
+};
+
+#define _PTSS	0
+#define _PTS0	1
+#define _PTS1	2
+#define _PTS2	3
+#define _PTS3	4
+#define _PCK	5
+
+#define ISO7816_3_MAX_ATR	64
+
+/* What iso7816_3_process_byte() found, for the caller to act on */
+#define ISO7816_EV_PTS		0x01	/* the byte is part of a PTS */
+#define ISO7816_EV_PTS_START	0x02	/* and it is the PTSS */
+#define ISO7816_EV_PTS_FIDI	0x04	/* PTS1 of the response, new fi/di */
+#define ISO7816_EV_PTS_DONE	0x08	/* PCK of the response: switch to fi/di */
+#define ISO7816_EV_ATR_DONE	0x10	/* last byte of the ATR: switch to
+					 * waiting_time */
+
+struct iso7816_3_fsm {
+	enum iso7816_3_state state;
+
+	u_int8_t fi;
+	u_int8_t di;
+	u_int8_t wi;
+	u_int32_t waiting_time;
+
+	enum atr_state atr_state;
+	u_int8_t atr_idx;
+	u_int8_t atr_hist_len;
+	u_int8_t atr_last_td;
+	u_int8_t atr[ISO7816_3_MAX_ATR];
+
+	u_int16_t prot_t_supported;
+
+	enum pts_state pts_state;
+	u_int8_t pts_req[6];
+	u_int8_t pts_resp[6];
+};
+
+/* compute the F/D ratio based on Fi and Di values, -EINVAL if reserved */
+extern int iso7816_3_fidi_ratio(u_int8_t fi, u_int8_t di);
+
+/* The reset line went active */
+extern void iso7816_3_reset(struct iso7816_3_fsm *fsm);
+/* The reset line was released, the ATR comes next */
+extern void iso7816_3_atr_start(struct iso7816_3_fsm *fsm);
+/* The waiting time expired without a byte */
+extern void iso7816_3_wtime_expired(struct iso7816_3_fsm *fsm);
+/* One byte from the I/O line, returns ISO7816_EV_* */
+extern int iso7816_3_process_byte(struct iso7816_3_fsm *fsm, u_int8_t byte);
+
+#endif
@@ -0,0 +1,291 @@
+/* PDC reception for the ISO7816-3 sniffer
+ * (C) 2010 by Harald Welte <hwelte@hmw-consulting.de>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * The PDC receives into a ring of buffers, always with a next one
+ * queued so that it never stops between two of them. A buffer is
+ * handed to the main loop when it is full or when the line has been
+ * idle for the receiver time-out, and iso7816_uart.c runs the
+ * ATR/PTS/APDU state machine over it there. Waiting time expiry and
+ * reset are queued behind the bytes received before them so that the
+ * state machine sees everything in order.
+ *
+ * That is too late for the PPS: the next command may start 16 etu
+ * after the PCK of the response, at the new rate. So from the release
+ * of reset until the first byte that is neither ATR nor PPS the PDC
+ * is given one byte at a time, and a second instance of the state
+ * machine follows the bytes in interrupt context. It switches the
+ * receiver over right after the PCK, see rx_watch_byte().
+ *
+ * The PDC registers are only accessed through iso7816_rx_pdc.h, the
+ * host builds this file against a model of them, see
+ * host/iso7816_rx_test.c.
+ */
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <lib_AT91SAM7.h>
+#include <asm/system.h>
+#include <iso7816_rx_pdc.h>
+
+#include "iso7816_fsm.h"
+#include "iso7816_rx.h"
+
+/* rx_in counts the buffers the PDC has finished, rx_out those the main
+ * loop has processed. The PDC fills the next rx_pdc (0 to 2) buffers
+ * after rx_in. */
+static struct rx_buf rx_bufs[ISO_UART_RX_BUFS];
+static volatile unsigned int rx_in, rx_out, rx_pdc;
+
+/* While rx_watch is set the PDC has no next buffer and a count of one,
+ * rx_watch_len bytes of the current buffer have gone through watch_fsm */
+static struct iso7816_3_fsm watch_fsm;
+static volatile int rx_watch;
+static u_int16_t rx_watch_len;
+
+/* Keeps the PDC supplied with a current and a next buffer as long as
+ * there are free ones. Called with interrupts off. */
+static __ramfunc void rx_arm(void)
+{
+	struct rx_buf *buf;
+
+	while (rx_pdc < (rx_watch ? 1 : 2) &&
+	       rx_in + rx_pdc - rx_out < ISO_UART_RX_BUFS) {
+		buf = &rx_bufs[(rx_in + rx_pdc) % ISO_UART_RX_BUFS];
+		if (rx_pdc == 0)
+			pdc_rx_set(buf->data,
+				   rx_watch ? 1 : ISO_UART_RX_BUF_SIZE);
+		else
+			pdc_rx_set_next(buf->data, ISO_UART_RX_BUF_SIZE);
+		rx_pdc++;
+	}
+
+	/* ENDRX is only cleared by queueing a next buffer, without one the
+	 * end of the current buffer shows as RXBUFF */
+	if (rx_pdc == 2)
+		pdc_rx_irq(PDC_RX_ENDRX);
+	else if (rx_pdc == 1)
+		pdc_rx_irq(PDC_RX_RXBUFF);
+	else
+		pdc_rx_irq(0);
+}
+
+/* Bytes in the current buffer of the PDC, unless it has moved on */
+static __ramfunc u_int16_t rx_len(void)
+{
+	return pdc_rx_ptr() - rx_bufs[rx_in % ISO_UART_RX_BUFS].data;
+}
+
+/* Whether the current buffer of the PDC is full */
+static __ramfunc int rx_full(void)
+{
+	u_int32_t status = pdc_rx_status();
+
+	if (rx_pdc == 2)
+		return status & PDC_RX_ENDRX;
+	/* while watching RXBUFF only says the byte asked for is in */
+	if (rx_pdc == 1)
+		return (status & PDC_RX_RXBUFF) &&
+			rx_len() == ISO_UART_RX_BUF_SIZE;
+	return 0;
+}
+
+/* The current buffer of the PDC is full, it has moved on to the next one
+ * if it had one. Called with interrupts off. */
+static __ramfunc void rx_end(void)
+{
+	struct rx_buf *buf = &rx_bufs[rx_in % ISO_UART_RX_BUFS];
+
+	buf->len = ISO_UART_RX_BUF_SIZE;
+	buf->events = 0;
+	rx_in++;
+	rx_pdc--;
+	rx_watch_len = 0;
+	rx_arm();
+}
+
+/* One byte of the ATR or PPS, in interrupt context */
+static void rx_watch_byte(u_int8_t byte)
+{
+	int ev, rc;
+
+	ev = iso7816_3_process_byte(&watch_fsm, byte);
+	if (ev & ISO7816_EV_PTS_DONE) {
+		/* the line is idle until the next start bit at the new rate */
+		rc = iso7816_3_fidi_ratio(watch_fsm.fi, watch_fsm.di);
+		if (rc > 0 && rc < 0x400)
+			iso_uart_set_fidi(rc);
+		rx_watch = 0;
+	} else if (watch_fsm.state == ISO7816_S_IN_APDU) {
+		/* no PPS, the rate stays */
+		rx_watch = 0;
+	}
+}
+
+/* Runs the bytes the PDC has received since the last call through
+ * watch_fsm, then asks for the next one or, once watching is over,
+ * gives the PDC the rest of the buffer and the next one again. Called
+ * with interrupts off. */
+static __ramfunc void rx_watch_poll(void)
+{
+	struct rx_buf *buf = &rx_bufs[rx_in % ISO_UART_RX_BUFS];
+	u_int16_t len;
+
+	if (!rx_watch || !rx_pdc)
+		return;
+
+	len = rx_len();
+	while (rx_watch && rx_watch_len < len)
+		rx_watch_byte(buf->data[rx_watch_len++]);
+
+	/* a full buffer is up to rx_end() */
+	if (len == ISO_UART_RX_BUF_SIZE)
+		return;
+
+	if (!rx_watch) {
+		pdc_rx_stop();
+		pdc_rx_set_count(ISO_UART_RX_BUF_SIZE - rx_len());
+		pdc_rx_start();
+		rx_arm();
+	} else if (!pdc_rx_count())
+		pdc_rx_set_count(1);
+}
+
+void iso7816_rx_watch_start(void)
+{
+	unsigned long flags;
+
+	local_irq_save(flags);
+
+	iso7816_3_reset(&watch_fsm);
+	iso7816_3_atr_start(&watch_fsm);
+	rx_watch = 1;
+	rx_watch_len = 0;
+
+	if (rx_pdc) {
+		pdc_rx_stop();
+		if (rx_pdc == 2) {
+			/* the next buffer is free again */
+			pdc_rx_set_next(0, 0);
+			rx_pdc = 1;
+		}
+		pdc_rx_set_count(1);
+		pdc_rx_start();
+		rx_arm();
+	}
+
+	local_irq_restore(flags);
+}
+
+__ramfunc void iso7816_rx_flush(u_int8_t events)
+{
+	struct rx_buf *buf;
+	unsigned long flags;
+	u_int16_t len;
+
+	local_irq_save(flags);
+
+	rx_watch_poll();
+
+	/* A buffer that has just been filled is not handed over yet */
+	if (rx_full())
+		rx_end();
+
+	if (!rx_pdc) {
+		/* All buffers are waiting for the main loop, the events
+		 * go behind the last of them */
+		if (rx_in != rx_out)
+			rx_bufs[(rx_in - 1) % ISO_UART_RX_BUFS].events |= events;
+		local_irq_restore(flags);
+		return;
+	}
+
+	pdc_rx_stop();
+	len = rx_len();
+	if (len || events) {
+		buf = &rx_bufs[rx_in % ISO_UART_RX_BUFS];
+		buf->len = len;
+		buf->events = events;
+		rx_in++;
+		rx_pdc--;
+		rx_watch_len = 0;
+		if (rx_pdc)
+			/* the next buffer becomes the current one */
+			pdc_rx_advance();
+		else
+			/* nowhere to receive until the main loop catches up */
+			pdc_rx_set_count(0);
+		rx_arm();
+	}
+	pdc_rx_start();
+
+	local_irq_restore(flags);
+}
+
+__ramfunc void iso7816_rx_irq(void)
+{
+	unsigned long flags;
+
+	local_irq_save(flags);
+	rx_watch_poll();
+	if (rx_full())
+		rx_end();
+	local_irq_restore(flags);
+}
+
+void iso7816_rx_wtime_expired(void)
+{
+	unsigned long flags;
+
+	iso7816_rx_flush(RX_EV_WTIME);
+
+	local_irq_save(flags);
+	if (rx_watch)
+		iso7816_3_wtime_expired(&watch_fsm);
+	local_irq_restore(flags);
+}
+
+void iso7816_rx_start(void)
+{
+	unsigned long flags;
+
+	local_irq_save(flags);
+	rx_arm();
+	local_irq_restore(flags);
+	pdc_rx_start();
+}
+
+struct rx_buf *iso7816_rx_get(void)
+{
+	if (rx_out == rx_in)
+		return NULL;
+	return &rx_bufs[rx_out % ISO_UART_RX_BUFS];
+}
+
+u_int8_t iso7816_rx_put(void)
+{
+	unsigned long flags;
+	u_int8_t events;
+
+	/* iso7816_rx_flush() may add events while all buffers wait */
+	local_irq_save(flags);
+	events = rx_bufs[rx_out % ISO_UART_RX_BUFS].events;
+	rx_out++;
+	rx_arm();
+	local_irq_restore(flags);
+
+	return events;
+}
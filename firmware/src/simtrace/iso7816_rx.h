@@ -0,0 +1,45 @@
+#ifndef _ISO7816_RX_H
+#define _ISO7816_RX_H
+
+/* Reception of the sniffed bytes into a ring of PDC buffers, see
+ * iso7816_rx.c.  The PDC is only touched through iso7816_rx_pdc.h,
+ * host/iso7816_rx_test.c runs this against a model of it. */
+
+#include <sys/types.h>
+
+#define ISO_UART_RX_BUFS	4
+#define ISO_UART_RX_BUF_SIZE	128
+
+/* What happened after the data of a buffer, in this order */
+#define RX_EV_WTIME		0x01	/* waiting time expired */
+#define RX_EV_RST_ACTIVE	0x02
+#define RX_EV_RST_RELEASE	0x04
+
+struct rx_buf {
+	u_int16_t len;
+	u_int8_t events;
+	u_int8_t data[ISO_UART_RX_BUF_SIZE];
+};
+
+/* Gives the PDC its first buffers */
+extern void iso7816_rx_start(void);
+/* From the USART interrupt: a byte to watch came in or a buffer is full */
+extern void iso7816_rx_irq(void);
+/* Hands over what the PDC has received so far and queues events behind
+ * it. May be called from any interrupt handler. */
+extern void iso7816_rx_flush(u_int8_t events);
+/* The ATR is coming, watch it and the PPS. Call after the buffer before
+ * the reset release has been handed over. */
+extern void iso7816_rx_watch_start(void);
+/* Waiting time expiry from the ETU timer */
+extern void iso7816_rx_wtime_expired(void);
+
+/* For the main loop: the oldest buffer handed over or NULL, and its
+ * release, which returns the events that go behind its data */
+extern struct rx_buf *iso7816_rx_get(void);
+extern u_int8_t iso7816_rx_put(void);
+
+/* Switches the receiver to a new Fi/Di ratio, in iso7816_uart.c */
+extern void iso_uart_set_fidi(int ratio);
+
+#endif
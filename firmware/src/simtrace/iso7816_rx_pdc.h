@@ -0,0 +1,79 @@
+#ifndef _ISO7816_RX_PDC_H
+#define _ISO7816_RX_PDC_H
+
+/* The receive channel of the USART0 PDC, all of the hardware that
+ * iso7816_rx.c touches.  host/fw_stub/iso7816_rx_pdc.h replaces it
+ * with a model for host/iso7816_rx_test.c */
+
+#include <sys/types.h>
+#include <AT91SAM7.h>
+
+#define PDC_RX_ENDRX	AT91C_US_ENDRX	/* RCR reached 0 since it or RNCR
+					 * was last written */
+#define PDC_RX_RXBUFF	AT91C_US_RXBUFF	/* RCR and RNCR are both 0 */
+
+#define pdc_rx_usart	AT91C_BASE_US0
+
+static inline void pdc_rx_stop(void)
+{
+	pdc_rx_usart->US_PTCR = AT91C_PDC_RXTDIS;
+}
+
+static inline void pdc_rx_start(void)
+{
+	pdc_rx_usart->US_PTCR = AT91C_PDC_RXTEN;
+}
+
+/* RPR and RCR, where the next byte goes and how many more fit */
+static inline u_int8_t *pdc_rx_ptr(void)
+{
+	return (u_int8_t *) pdc_rx_usart->US_RPR;
+}
+
+static inline u_int16_t pdc_rx_count(void)
+{
+	return pdc_rx_usart->US_RCR;
+}
+
+static inline void pdc_rx_set(u_int8_t *ptr, u_int16_t count)
+{
+	pdc_rx_usart->US_RPR = (u_int32_t) ptr;
+	pdc_rx_usart->US_RCR = count;
+}
+
+static inline void pdc_rx_set_count(u_int16_t count)
+{
+	pdc_rx_usart->US_RCR = count;
+}
+
+/* RNPR and RNCR, taken over by the PDC when RCR reaches 0 */
+static inline void pdc_rx_set_next(u_int8_t *ptr, u_int16_t count)
+{
+	pdc_rx_usart->US_RNPR = (u_int32_t) ptr;
+	pdc_rx_usart->US_RNCR = count;
+}
+
+/* Makes the next buffer the current one, with the PDC stopped */
+static inline void pdc_rx_advance(void)
+{
+	pdc_rx_usart->US_RPR = pdc_rx_usart->US_RNPR;
+	pdc_rx_usart->US_RCR = pdc_rx_usart->US_RNCR;
+	pdc_rx_usart->US_RNCR = 0;
+}
+
+/* PDC_RX_ENDRX and PDC_RX_RXBUFF out of US_CSR */
+static inline u_int32_t pdc_rx_status(void)
+{
+	return pdc_rx_usart->US_CSR & (PDC_RX_ENDRX | PDC_RX_RXBUFF);
+}
+
+/* Enables the interrupt for the PDC_RX_* bits in mask, disables the
+ * other one */
+static inline void pdc_rx_irq(u_int32_t mask)
+{
+	pdc_rx_usart->US_IDR = (PDC_RX_ENDRX | PDC_RX_RXBUFF) & ~mask;
+	if (mask)
+		pdc_rx_usart->US_IER = mask;
+}
+
+#endif
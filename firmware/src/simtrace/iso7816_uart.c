@@ -1,6 +1,10 @@
 /* Driver for AT91SAM7 USART0 in ISO7816-3 mode for passive sniffing
  * (C) 2010 by Harald Welte <hwelte@hmw-consulting.de>
  *
+ * The bytes are received by the PDC into a ring of buffers, see
+ * iso7816_rx.c, and the ATR/PTS/APDU state machine runs over them in
+ * the main loop, see iso_uart_rx_process().
+ *
  *  This program is free software; you can redistribute it and/or modify
  *  it under the terms of the GNU General Public License as published by
  *  the Free Software Foundation; either version 2 of the License, or
@@ -32,75 +36,16 @@
 
 #include "../simtrace.h"
 #include "../openpcd.h"
-
-#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+#include "iso7816_fsm.h"
+#include "iso7816_rx.h"
 
 static const AT91PS_USART usart = AT91C_BASE_US0;
 
-enum iso7816_3_state {
-	ISO7816_S_RESET,	/* in Reset */
-	ISO7816_S_WAIT_ATR,	/* waiting for ATR to start */
-	ISO7816_S_IN_ATR,	/* while we are receiving the ATR */
-	ISO7816_S_WAIT_APDU,	/* waiting for start of new APDU */
-	ISO7816_S_IN_APDU,	/* inside a single APDU */
-	ISO7816_S_IN_PTS,	/* while we are inside the PTS / PSS */
-};
-
-/* detailed sub-states of ISO7816_S_IN_ATR */
-enum atr_state {
-	ATR_S_WAIT_TS,
-	ATR_S_WAIT_T0,
-	ATR_S_WAIT_TA,
-	ATR_S_WAIT_TB,
-	ATR_S_WAIT_TC,
-	ATR_S_WAIT_TD,
-	ATR_S_WAIT_HIST,
-	ATR_S_WAIT_TCK,
-	ATR_S_DONE,
-};
-
-/* detailed sub-states of ISO7816_S_IN_PTS */
-enum pts_state {
-	PTS_S_WAIT_REQ_PTSS,
-	PTS_S_WAIT_REQ_PTS0,
-	PTS_S_WAIT_REQ_PTS1,
-	PTS_S_WAIT_REQ_PTS2,
-	PTS_S_WAIT_REQ_PTS3,
-	PTS_S_WAIT_REQ_PCK,
-	PTS_S_WAIT_RESP_PTSS = PTS_S_WAIT_REQ_PTSS | 0x10,
-	PTS_S_WAIT_RESP_PTS0 = PTS_S_WAIT_REQ_PTS0 | 0x10,
-	PTS_S_WAIT_RESP_PTS1 = PTS_S_WAIT_REQ_PTS1 | 0x10,
-	PTS_S_WAIT_RESP_PTS2 = PTS_S_WAIT_REQ_PTS2 | 0x10,
-	PTS_S_WAIT_RESP_PTS3 = PTS_S_WAIT_REQ_PTS3 | 0x10,
-	PTS_S_WAIT_RESP_PCK = PTS_S_WAIT_REQ_PCK | 0x10,
-};
-
-#define _PTSS	0
-#define _PTS0	1
-#define _PTS1	2
-#define _PTS2	3
-#define _PTS3	4
-#define _PCK	5
+/* etu without a character after which a partial buffer is handed over */
+#define ISO_UART_RX_TIMEOUT	24
 
 struct iso7816_3_handle {
-	enum iso7816_3_state state;
-
-	u_int8_t fi;
-	u_int8_t di;
-	u_int8_t wi;
-	u_int32_t waiting_time;
-
-	enum atr_state atr_state;
-	u_int8_t atr_idx;
-	u_int8_t atr_hist_len;
-	u_int8_t atr_last_td;
-	u_int8_t atr[64];
-
-	u_int16_t prot_t_supported;
-
-	enum pts_state pts_state;
-	u_int8_t pts_req[6];
-	u_int8_t pts_resp[6];
+	struct iso7816_3_fsm fsm;
 
 	struct simtrace_hdr sh;
 
@@ -113,18 +58,6 @@ struct iso7816_3_handle {
 struct iso7816_3_handle isoh;
 
 
-/* Table 6 from ISO 7816-3 */
-static const u_int16_t fi_table[] = {
-	372, 372, 558, 744, 1116, 1488, 1860, 0,
-	0, 512, 768, 1024, 1536, 2048, 0, 0
-};
-
-/* Table 7 from ISO 7816-3 */
-static const u_int8_t di_table[] = {
-	0, 1, 2, 4, 8, 16, 32, 64,
-	12, 20, 2, 4, 8, 16, 32, 64,
-};
-
 void iso_uart_stats_dump(void)
 {
 	DEBUGPCRF("no_rctx: %u, rctx_sent: %u, rst: %u, pps: %u, bytes: %u, "
@@ -139,34 +72,6 @@ struct simtrace_stats *iso_uart_stats_get(void)
 	return &isoh.stats;
 }
 
-/* compute the F/D ratio based on Fi and Di values */
-static int compute_fidi_ratio(u_int8_t fi, u_int8_t di)
-{
-	u_int16_t f, d;
-	int ret;
-
-	if (fi >= ARRAY_SIZE(fi_table) ||
-	    di >= ARRAY_SIZE(di_table))
-		return -EINVAL;
-
-	f = fi_table[fi];
-	if (f == 0)
-		return -EINVAL;
-
-	d = di_table[di];
-	if (d == 0)
-		return -EINVAL;
-
-	/* See table 7 of ISO 7816-3: From 1000 on we divide by 1/d,
-	 * which equals a multiplication by d */
-	if (di < 8) 
-		ret = f / d;
-	else
-		ret = f * d;
-
-	return ret;
-}
-
 static void refill_rctx(struct iso7816_3_handle *ih)
 {
 	struct req_ctx *rctx;
@@ -194,8 +99,8 @@ static void send_rctx(struct iso7816_3_handle *ih)
 		return;
 
 	/* Put Fi and Di into res[2] array */
-	ih->sh.res[0] = ih->fi;
-	ih->sh.res[1] = ih->di;
+	ih->sh.res[0] = ih->fsm.fi;
+	ih->sh.res[1] = ih->fsm.di;
 
 	/* copy the simtrace header */
 	memcpy(rctx->data, &ih->sh, sizeof(ih->sh));
@@ -209,323 +114,46 @@ static void send_rctx(struct iso7816_3_handle *ih)
 }
 
 
-/* Update the ATR sub-state */
-static void set_atr_state(struct iso7816_3_handle *ih, enum atr_state new_atrs)
-{
-	if (new_atrs == ATR_S_WAIT_TS) {
-		ih->atr_idx = 0;
-		ih->atr_hist_len = 0;
-		ih->atr_last_td = 0;
-		ih->prot_t_supported = (1 << 0);
-		memset(ih->atr, 0, sizeof(ih->atr));
-	} else if (ih->atr_state == new_atrs)
-		return;
-
-	//DEBUGPCR("ATR state %u -> %u", ih->atr_state, new_atrs);
-	ih->atr_state = new_atrs;
-}
-
-#define ISO7816_3_INIT_WTIME		9600
-#define ISO7816_3_DEFAULT_WI		10
-
-static void update_fidi(struct iso7816_3_handle *ih)
-{
-	int rc;
-
-	rc = compute_fidi_ratio(ih->fi, ih->di);
-	if (rc > 0 && rc < 0x400) {
-		DEBUGPCR("computed Fi(%u) Di(%u) ratio: %d", ih->fi, ih->di, rc);
-		/* make sure UART uses new F/D ratio */
-		usart->US_CR |= AT91C_US_RXDIS | AT91C_US_RSTRX;
-		usart->US_FIDI = rc & 0x3ff;
-		usart->US_CR |= AT91C_US_RXEN | AT91C_US_STTTO;
-		/* notify ETU timer about this */
-		tc_etu_set_etu(rc);
-	} else
-		DEBUGPCRF("computed FiDi ratio %d unsupported", rc);
-}
-
-/* Update the ISO 7816-3 APDU receiver state */
-static void set_state(struct iso7816_3_handle *ih, enum iso7816_3_state new_state)
-{
-	if (new_state == ISO7816_S_RESET) {
-		usart->US_CR |= AT91C_US_RXDIS | AT91C_US_RSTRX;
-	} else if (new_state == ISO7816_S_WAIT_ATR) {
-		/* Reset to initial Fi / Di ratio */
-		ih->fi = 1;
-		ih->di = 1;
-		update_fidi(ih);
-		/* initialize todefault WI, this will be overwritten if we
-		 * receive TC2, and it will be programmed into hardware after
-		 * ATR is finished */
-		ih->wi = ISO7816_3_DEFAULT_WI;
-		/* update waiting time to initial waiting time */
-		ih->waiting_time = ISO7816_3_INIT_WTIME;
-		tc_etu_set_wtime(ih->waiting_time);
-		/* Set ATR sub-state to initial state */
-		set_atr_state(ih, ATR_S_WAIT_TS);
-		/* Notice that we are just coming out of reset */
-		ih->sh.flags |= SIMTRACE_FLAG_ATR;
-	}
-
-	if (ih->state == new_state)
-		return;
-
-	//DEBUGPCR("7816 state %u -> %u", ih->state, new_state);
-	ih->state = new_state;
-}
-
-static void atr_done_wait_apdu(struct iso7816_3_handle *ih)
-{
-	set_atr_state(ih, ATR_S_DONE);
-	/* send off the USB context */
-	ih->rctx_must_be_sent = 1;
-	/* update the waiting time */
-	ih->waiting_time = 960 * di_table[ih->di] * ih->wi;
-	tc_etu_set_wtime(ih->waiting_time);
-}
-
-static enum iso7816_3_state
-transition_to_tck(struct iso7816_3_handle *ih)
-{
-	if (ih->prot_t_supported == 0x01) {
-		/* If only T=0 supported, there is no TCK but we
-		 * immediately transition to APDUs */
-		atr_done_wait_apdu(ih);
-		return ISO7816_S_WAIT_APDU;
-	} else {
-		set_atr_state(ih, ATR_S_WAIT_TCK);
-		return ISO7816_S_IN_ATR;
-	}
-}
-
-/* determine the next ATR state based on received interface byte */
-static enum atr_state next_intb_state(struct iso7816_3_handle *ih, u_int8_t ch)
+void iso_uart_set_fidi(int rc)
 {
-	switch (ih->atr_state) {
-	case ATR_S_WAIT_TD:
-		ih->prot_t_supported |= (1 << (ch & 0xf));
-	case ATR_S_WAIT_T0:
-		ih->atr_last_td = ch;
-		goto from_td;
-	case ATR_S_WAIT_TC:
-		if ((ih->atr_last_td & 0x0f) == 0x02) {
-			/* TC2 contains WI */
-			ih->wi = ch;
-		}
-		goto from_tc;
-	case ATR_S_WAIT_TB:
-		goto from_tb;
-	case ATR_S_WAIT_TA:
-		goto from_ta;
-	default:
-		DEBUGPCR("something wrong, old_state != TA");
-		return ATR_S_WAIT_TCK;
-	}
-
-from_td:
-	if (ih->atr_last_td & 0x10)
-		return ATR_S_WAIT_TA;
-from_ta:
-	if (ih->atr_last_td & 0x20)
-		return ATR_S_WAIT_TB;
-from_tb:
-	if (ih->atr_last_td & 0x40)
-		return ATR_S_WAIT_TC;
-from_tc:
-	if (ih->atr_last_td & 0x80)
-		return ATR_S_WAIT_TD;
-
-	/* Historical bytes are common, but optional! */
-	if (ih->atr_hist_len)
-		return ATR_S_WAIT_HIST;
-	else
-		return transition_to_tck(ih);
-}
-
-/* process an incomng ATR byte */
-static enum iso7816_3_state
-process_byte_atr(struct iso7816_3_handle *ih, u_int8_t byte)
-{
-	/* add byte to ATR buffer */
-	ih->atr[ih->atr_idx] = byte;
-	ih->atr_idx++;
-
-	switch (ih->atr_state) {
-	case ATR_S_WAIT_TS:
-		/* FIXME: if we don't have the RST line we might get this */
-		if (byte == 0) {
-			ih->atr_idx--;
-			break;
-		}
-		/* FIXME: check inverted logic */
-		set_atr_state(ih, ATR_S_WAIT_T0);
-		break;
-	case ATR_S_WAIT_T0:
-		/* obtain the number of historical bytes */
-		ih->atr_hist_len = byte & 0xf;
-		/* Mask out the hist-byte-length to indiicate T=0 */
-		set_atr_state(ih, next_intb_state(ih, byte & 0xf0));
-		break;
-	case ATR_S_WAIT_TA:
-	case ATR_S_WAIT_TB:
-	case ATR_S_WAIT_TC:
-	case ATR_S_WAIT_TD:
-		set_atr_state(ih, next_intb_state(ih, byte));
-		break;
-	case ATR_S_WAIT_HIST:
-		ih->atr_hist_len--;
-		/* after all historical bytes are recieved, go to TCK */
-		if (ih->atr_hist_len == 0)
-			return transition_to_tck(ih);
-		break;
-	case ATR_S_WAIT_TCK:
-		/* FIXME: process and verify the TCK */
-		atr_done_wait_apdu(ih);
-		return ISO7816_S_WAIT_APDU;
-	}
-
-	return ISO7816_S_IN_ATR;
-}
-
-/* Update the ATR sub-state */
-static void set_pts_state(struct iso7816_3_handle *ih, enum pts_state new_ptss)
-{
-	//DEBUGPCR("PTS state %u -> %u", ih->pts_state, new_ptss);
-	ih->pts_state = new_ptss;
-}
-
-/* Determine the next PTS state */
-static enum pts_state next_pts_state(struct iso7816_3_handle *ih)
-{
-	u_int8_t is_resp = ih->pts_state & 0x10;
-	u_int8_t sstate = ih->pts_state & 0x0f;
-	u_int8_t *pts_ptr;
-
-	if (!is_resp)
-		pts_ptr = ih->pts_req;
-	else
-		pts_ptr = ih->pts_resp;
-
-	switch (sstate) {
-	case PTS_S_WAIT_REQ_PTSS:
-		goto from_ptss;
-	case PTS_S_WAIT_REQ_PTS0:
-		goto from_pts0;
-	case PTS_S_WAIT_REQ_PTS1:
-		goto from_pts1;
-	case PTS_S_WAIT_REQ_PTS2:
-		goto from_pts2;
-	case PTS_S_WAIT_REQ_PTS3:
-		goto from_pts3;
-	}
-
-	if (ih->pts_state == PTS_S_WAIT_REQ_PCK)
-		return PTS_S_WAIT_RESP_PTSS;
-
-from_ptss:
-	return PTS_S_WAIT_REQ_PTS0 | is_resp;
-from_pts0:
-	if (pts_ptr[_PTS0] & (1 << 4))
-		return PTS_S_WAIT_REQ_PTS1 | is_resp;
-from_pts1:
-	if (pts_ptr[_PTS0] & (1 << 5))
-		return PTS_S_WAIT_REQ_PTS2 | is_resp;
-from_pts2:
-	if (pts_ptr[_PTS0] & (1 << 6))
-		return PTS_S_WAIT_REQ_PTS3 | is_resp;
-from_pts3:
-	return PTS_S_WAIT_REQ_PCK | is_resp;
-}
-
-static enum iso7816_3_state
-process_byte_pts(struct iso7816_3_handle *ih, u_int8_t byte)
-{
-	switch (ih->pts_state) {
-	case PTS_S_WAIT_REQ_PTSS:
-		ih->pts_req[_PTSS] = byte;
-		break;
-	case PTS_S_WAIT_REQ_PTS0:
-		ih->pts_req[_PTS0] = byte;
-		break;
-	case PTS_S_WAIT_REQ_PTS1:
-		ih->pts_req[_PTS1] = byte;
-		break;
-	case PTS_S_WAIT_REQ_PTS2:
-		ih->pts_req[_PTS2] = byte;
-		break;
-	case PTS_S_WAIT_REQ_PTS3:
-		ih->pts_req[_PTS3] = byte;
-		break;
-	case PTS_S_WAIT_REQ_PCK:
-		/* FIXME: check PCK */
-		ih->pts_req[_PCK] = byte;
-		break;
-	case PTS_S_WAIT_RESP_PTSS:
-		ih->pts_resp[_PTSS] = byte;
-		break;
-	case PTS_S_WAIT_RESP_PTS0:
-		ih->pts_resp[_PTS0] = byte;
-		break;
-	case PTS_S_WAIT_RESP_PTS1:
-		/* This must be TA1 */
-		ih->fi = byte >> 4;
-		ih->di = byte & 0xf;
-		DEBUGPCR("found Fi=%u Di=%u", ih->fi, ih->di);
-		ih->sh.flags |= SIMTRACE_FLAG_PPS_FIDI;
-		ih->pts_resp[_PTS1] = byte;
-		break;
-	case PTS_S_WAIT_RESP_PTS2:
-		ih->pts_resp[_PTS2] = byte;
-		break;
-	case PTS_S_WAIT_RESP_PTS3:
-		ih->pts_resp[_PTS3] = byte;
-		break;
-	case PTS_S_WAIT_RESP_PCK:
-		ih->pts_resp[_PCK] = byte;
-		/* FIXME: check PCK */
-		set_pts_state(ih, PTS_S_WAIT_REQ_PTSS);
-		/* update baud rate generator with Fi/Di */
-		update_fidi(ih);
-		/* Wait for the next APDU */
-		return ISO7816_S_WAIT_APDU;
-	}
-	/* calculate the next state and set it */
-	set_pts_state(ih, next_pts_state(ih));
-
-	return ISO7816_S_IN_PTS;
+	/* make sure UART uses new F/D ratio */
+	usart->US_CR |= AT91C_US_RXDIS | AT91C_US_RSTRX;
+	usart->US_FIDI = rc & 0x3ff;
+	usart->US_CR |= AT91C_US_RXEN | AT91C_US_STTTO;
+	/* notify ETU timer about this */
+	tc_etu_set_etu(rc);
 }
 
 static void process_byte(struct iso7816_3_handle *ih, u_int8_t byte)
 {
-	int new_state = -1;
 	struct req_ctx *rctx;
+	int ev;
 
 	ih->stats.bytes++;
 
 	if (!ih->rctx)
 		refill_rctx(ih);
 
-	switch (ih->state) {
-	case ISO7816_S_RESET:
-		break;
-	case ISO7816_S_WAIT_ATR:
-	case ISO7816_S_IN_ATR:
-		new_state = process_byte_atr(ih, byte);
-		break;
-	case ISO7816_S_WAIT_APDU:
-		if (byte == 0xff) {
-			new_state = process_byte_pts(ih, byte);
-			ih->stats.pps++;
-			goto out_silent;
-		}
-	case ISO7816_S_IN_APDU:
-		new_state = ISO7816_S_IN_APDU;
-		break;
-	case ISO7816_S_IN_PTS:
-		new_state = process_byte_pts(ih, byte);
-		goto out_silent;
+	ev = iso7816_3_process_byte(&ih->fsm, byte);
+	if (ev & ISO7816_EV_PTS_START)
+		ih->stats.pps++;
+	if (ev & ISO7816_EV_PTS_FIDI) {
+		DEBUGPCR("found Fi=%u Di=%u", ih->fsm.fi, ih->fsm.di);
+		ih->sh.flags |= SIMTRACE_FLAG_PPS_FIDI;
 	}
+	if (ev & ISO7816_EV_PTS_DONE) {
+		/* the receiver has been switched over by iso7816_rx.c */
+		DEBUGPCR("Fi(%u) Di(%u) ratio: %d", ih->fsm.fi, ih->fsm.di,
+			 iso7816_3_fidi_ratio(ih->fsm.fi, ih->fsm.di));
+	}
+	if (ev & ISO7816_EV_ATR_DONE) {
+		/* send off the USB context */
+		ih->rctx_must_be_sent = 1;
+		/* update the waiting time */
+		tc_etu_set_wtime(ih->fsm.waiting_time);
+	}
+	if (ev & ISO7816_EV_PTS)
+		return;
 
 	/* The USB buffer could be gone in case the timer expired or code above
 	 * this line explicitly sent it off */
@@ -547,38 +175,65 @@ static void process_byte(struct iso7816_3_handle *ih, u_int8_t byte)
 		ih->rctx_must_be_sent = 0;
 		send_rctx(ih);
 	}
-
-out_silent:
-	if (new_state != -1)
-		set_state(ih, new_state);
 }
 
 /* timeout of work waiting time during receive */
-void iso7816_wtime_expired(void)
+static void wtime_expired(struct iso7816_3_handle *ih)
 {
 	/* Always flush the URB at Rx timeout as this indicates end of APDU */
-	if (isoh.rctx) {
-		isoh.sh.flags |= SIMTRACE_FLAG_WTIME_EXP;
-		send_rctx(&isoh);
+	if (ih->rctx) {
+		ih->sh.flags |= SIMTRACE_FLAG_WTIME_EXP;
+		send_rctx(ih);
 	}
-	if (isoh.state == ISO7816_S_IN_PTS) {
-		/* Timout during PTS: Card does not support PTS */
+	iso7816_3_wtime_expired(&ih->fsm);
+}
+
+/* Runs the state machine over the received data, from the main loop */
+void iso_uart_rx_process(void)
+{
+	struct rx_buf *buf;
+	u_int8_t events;
+	int i;
+
+	while ((buf = iso7816_rx_get())) {
+		for (i = 0; i < buf->len; i++)
+			process_byte(&isoh, buf->data[i]);
+		events = iso7816_rx_put();
+
+		if (events & RX_EV_WTIME)
+			wtime_expired(&isoh);
+		if (events & RX_EV_RST_ACTIVE)
+			iso7816_3_reset(&isoh.fsm);
+		if (events & RX_EV_RST_RELEASE) {
+			/* the receiver and the ETU timer have been switched
+			 * over by reset_pin_irq() already, the ATR may be
+			 * coming in */
+			iso7816_3_atr_start(&isoh.fsm);
+			/* Notice that we are just coming out of reset */
+			isoh.sh.flags |= SIMTRACE_FLAG_ATR;
+		}
 	}
-	set_state(&isoh, ISO7816_S_WAIT_APDU);
+}
+
+/* timeout of work waiting time during receive, from the ETU timer */
+void iso7816_wtime_expired(void)
+{
+	iso7816_rx_wtime_expired();
 }
 
 static __ramfunc void usart_irq(void)
 {
 	u_int32_t csr = usart->US_CSR;
-	u_int8_t octet;
 
 	//DEBUGP("USART IRQ, CSR=0x%08x\n", csr);
 
-	if (csr & AT91C_US_RXRDY) {
-		/* at least one character received */
-		octet = usart->US_RHR & 0xff;
-		//DEBUGP("%02x ", octet);
-		process_byte(&isoh, octet);
+	/* a byte to watch came in or a buffer is full */
+	iso7816_rx_irq();
+
+	if (csr & AT91C_US_TIMEOUT) {
+		/* the line went idle, hand over what we have */
+		usart->US_CR = AT91C_US_STTTO;
+		iso7816_rx_flush(0);
 	}
 
 	if (csr & AT91C_US_TXRDY) {
@@ -606,15 +261,22 @@ static __ramfunc void usart_irq(void)
 	}
 }
 
-/* handler for the RST input pin state change */
+/* handler for the RST input pin state change. The receiver is switched
+ * over right here, the ATR may start before the main loop gets to the
+ * reset. */
 static void reset_pin_irq(u_int32_t pio)
 {
 	if (!AT91F_PIO_IsInputSet(AT91C_BASE_PIOA, pio)) {
 		DEBUGPCR("nRST");
-		set_state(&isoh, ISO7816_S_RESET);
+		usart->US_CR |= AT91C_US_RXDIS | AT91C_US_RSTRX;
+		iso7816_rx_flush(RX_EV_RST_ACTIVE);
 	} else {
 		DEBUGPCR("RST");
-		set_state(&isoh, ISO7816_S_WAIT_ATR);
+		/* initial Fi / Di ratio and waiting time */
+		iso_uart_set_fidi(iso7816_3_fidi_ratio(1, 1));
+		tc_etu_set_wtime(ISO7816_3_INIT_WTIME);
+		iso7816_rx_flush(RX_EV_RST_RELEASE);
+		iso7816_rx_watch_start();
 		isoh.stats.rst++;
 	}
 }
@@ -647,9 +309,12 @@ void iso_uart_rst(unsigned int state)
 void iso_uart_rx_mode(void)
 {
 	DEBUGPCR("USART Entering Rx Mode");
-	/* Enable receive interrupts */
-	usart->US_IER = AT91C_US_RXRDY | AT91C_US_OVRE | AT91C_US_FRAME |
+	/* Receive by PDC, interrupts for the end of a buffer (enabled by
+	 * iso7816_rx.c), for the receiver time-out and for errors */
+	iso7816_rx_start();
+	usart->US_IER = AT91C_US_TIMEOUT | AT91C_US_OVRE | AT91C_US_FRAME |
 			AT91C_US_PARE | AT91C_US_NACK | AT91C_US_ITERATION;
+	usart->US_CR = AT91C_US_STTTO;
 
 	/* call interrupt handler once to set initial state RESET / ATR */
 	reset_pin_irq(SIMTRACE_PIO_nRST);
@@ -704,8 +369,8 @@ void iso_uart_init(void)
 	usart->US_IDR = 0xff;
 	/* Clock Divider = 1, i.e. no division of SCLK */
 	usart->US_BRGR = (0x0000 << 16) | 0x0001;
-	/* Disable Receiver Time-out */
-	usart->US_RTOR = 0;
+	/* Receiver Time-out, flushes partially filled PDC buffers */
+	usart->US_RTOR = ISO_UART_RX_TIMEOUT;
 	/* Disable Transmitter Timeguard */
 	usart->US_TTGR = 0;
 
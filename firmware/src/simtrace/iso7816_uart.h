@@ -4,5 +4,6 @@ void iso_uart_stats_dump(void);
 void iso_uart_dump(void);
 void iso_uart_rst(unsigned int state);
 void iso_uart_rx_mode(void);
+void iso_uart_rx_process(void);
 void iso_uart_clk_master(unsigned int master);
 void iso_uart_init(void);
@@ -218,6 +218,9 @@ int _main_dbgu(char key)
 
 void _main_func(void)
 {
+	/* run the ISO 7816 state machine over what the UART received */
+	iso_uart_rx_process();
+
 	/* first we try to get rid of pending to-be-sent stuff */
 	usb_out_process();
 
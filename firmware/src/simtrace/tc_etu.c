@@ -20,6 +20,7 @@
 #include <lib_AT91SAM7.h>
 #include <AT91SAM7.h>
 #include <os/dbgu.h>
+#include <os/tc_usec.h>
 
 #include "../openpcd.h"
 
@@ -124,5 +125,5 @@ void tc_etu_init(void)
 	tcetu->TC_CCR = AT91C_TC_CLKEN;
 
 	/* Reset to start timers */
-	tcb->TCB_BCR = 1;
+	tc_usec_resync();
 }
@@ -0,0 +1,211 @@
+/* crc_bench - check the OpenPICC CRC_A/CRC_B tables against the
+ * ISO 14443-3 test vectors and measure their throughput
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 
+ *  as published by the Free Software Foundation
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * The CRC code and the Manchester encoder are built from
+ * openpicc/application unmodified.  Besides the Annex B vectors the
+ * encoder's CRC_APPEND output is compared with a frame carrying the
+ * CRC in its data.  Throughput is compared with the bit-serial update
+ * the diffmiller decoder used before.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/time.h>
+
+/* openpicc.h only provides the u_int*_t types, take them from libc */
+#define __OPENPICC_H__
+#include "../openpicc/application/iso14443_crc.c"
+#include "../openpicc/application/iso14443a_manchester.c"
+
+struct vector {
+	int type;
+	int len;
+	u_int8_t data[8];
+	u_int8_t crc[2];	/* as transmitted */
+};
+
+/* ISO/IEC 14443-3 Annex B, plus the SAK the pretender sends */
+static const struct vector vectors[] = {
+	{ TYPE_A, 2, { 0x00, 0x00 }, { 0xa0, 0x1e } },
+	{ TYPE_A, 2, { 0x12, 0x34 }, { 0x26, 0xcf } },
+	{ TYPE_A, 1, { 0x08 }, { 0xb6, 0xdd } },
+	{ TYPE_B, 3, { 0x00, 0x00, 0x00 }, { 0xcc, 0xc6 } },
+	{ TYPE_B, 3, { 0x0f, 0xaa, 0xff }, { 0xfc, 0xd1 } },
+	{ TYPE_B, 4, { 0x0a, 0x12, 0x34, 0x56 }, { 0x2c, 0xf6 } },
+};
+
+#define NUM_VECTORS (sizeof(vectors)/sizeof(vectors[0]))
+
+/* previous implementation from iso14443a_diffmiller.c */
+static u_int16_t ref_update(u_int16_t crc, u_int8_t byte)
+{
+	byte = (byte ^ crc) & 0xff;
+	byte = (byte ^ byte << 4) & 0xff;
+	return ((crc >> 8) ^ (byte << 8) ^ (byte << 3) ^ (byte >> 4)) & 0xffff;
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int check_vectors(void)
+{
+	iso14443_frame f;
+	unsigned int i;
+	int errors = 0;
+
+	for (i = 0; i < NUM_VECTORS; i++) {
+		const struct vector *v = &vectors[i];
+		u_int16_t crc = v->type == TYPE_A ?
+			iso14443a_crc(v->data, v->len) :
+			iso14443b_crc(v->data, v->len);
+
+		memset(&f, 0, sizeof(f));
+		f.type = v->type;
+		f.parameters.a.parity = GIVEN_PARITY;
+		f.numbytes = v->len;
+		memcpy(f.data, v->data, v->len);
+		iso14443_crc_append(&f);
+
+		if ((crc & 0xff) != v->crc[0] || (crc >> 8) != v->crc[1] ||
+		    memcmp(f.data + v->len, v->crc, 2) ||
+		    iso14443_crc_check(&f) != CRC_OK) {
+			printf("vector %u: got %02x %02x, expected %02x %02x\n",
+			       i, crc & 0xff, crc >> 8, v->crc[0], v->crc[1]);
+			errors++;
+		}
+		/* odd parity of the appended bytes */
+		if (v->type == TYPE_A && !!(f.parity[v->len/8] & (1 << (v->len%8))) ==
+		    __builtin_parity(v->crc[0])) {
+			printf("vector %u: wrong parity on the CRC\n", i);
+			errors++;
+		}
+		/* CRC_A over data and CRC leaves 0, like in the decoder */
+		if (v->type == TYPE_A &&
+		    iso14443_crc(ISO14443A_CRC_INIT, f.data, v->len + 2)) {
+			printf("vector %u: residue not 0\n", i);
+			errors++;
+		}
+	}
+
+	return errors;
+}
+
+static int check_encoder(void)
+{
+	static u_int16_t buf1[600], buf2[600];
+	iso14443_frame f, g;
+	int i, len, r1, r2, errors = 0;
+
+	srandom(1);
+	for (i = 0; i < 100; i++) {
+		len = 1 + random() % 64;
+		memset(&f, 0, sizeof(f));
+		f.type = TYPE_A;
+		f.parameters.a.format = STANDARD_FRAME;
+		f.parameters.a.parity = (i & 1) ? PARITY : NO_PARITY;
+		f.parameters.a.crc = CRC_APPEND;
+		f.numbytes = len;
+		while (len--)
+			f.data[len] = random();
+
+		g = f;
+		g.parameters.a.crc = CRC_UNCALCULATED;
+		iso14443_crc_append(&g);
+
+		r1 = manchester_encode((u_int8_t *) buf1, sizeof(buf1), &f);
+		r2 = manchester_encode((u_int8_t *) buf2, sizeof(buf2), &g);
+		if (r1 != r2 || r1 != manchester_encoded_size(&f) ||
+		    r1 < 0 || memcmp(buf1, buf2, r1)) {
+			printf("encoder: CRC_APPEND differs on frame %d\n", i);
+			errors++;
+		}
+	}
+
+	return errors;
+}
+
+static void bench(int iter)
+{
+	static u_int8_t data[256];
+	volatile u_int16_t sink;
+	u_int16_t crc;
+	double t;
+	int i, j;
+
+	for (i = 0; i < (int) sizeof(data); i++)
+		data[i] = random();
+
+	t = now();
+	for (i = 0; i < iter; i++) {
+		crc = ISO14443A_CRC_INIT;
+		for (j = 0; j < (int) sizeof(data); j++)
+			crc = ref_update(crc, data[j]);
+		sink = crc;
+	}
+	t = now() - t;
+	printf("bit serial  %8.1f MB/s\n", iter * sizeof(data) / t / 1e6);
+
+	t = now();
+	for (i = 0; i < iter; i++) {
+		crc = ISO14443A_CRC_INIT;
+		for (j = 0; j < (int) sizeof(data); j++)
+			crc = iso14443_crc_update(crc, data[j]);
+		sink = crc;
+	}
+	t = now() - t;
+	printf("table       %8.1f MB/s\n", iter * sizeof(data) / t / 1e6);
+
+	t = now();
+	for (i = 0; i < iter; i++)
+		sink = iso14443a_crc(data, sizeof(data));
+	t = now() - t;
+	printf("table bulk  %8.1f MB/s\n", iter * sizeof(data) / t / 1e6);
+	(void) sink;
+}
+
+int main(int argc, char **argv)
+{
+	int iter = 200000, c, errors;
+
+	while ((c = getopt(argc, argv, "i:h")) != -1) {
+		switch (c) {
+		case 'i':
+			iter = atoi(optarg);
+			break;
+		default:
+			printf("crc_bench [-i iterations]\n");
+			exit(c == 'h' ? 0 : 2);
+		}
+	}
+
+	errors = check_vectors() + check_encoder();
+	printf("%u test vectors, 100 encoded frames: %d error(s)\n",
+	       (unsigned int) NUM_VECTORS, errors);
+	if (errors)
+		exit(1);
+
+	bench(iter);
+	return 0;
+}
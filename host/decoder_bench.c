@@ -0,0 +1,436 @@
+/* decoder_bench - compare the table driven OpenPICC sample decoders
+ * against the implementation they replaced
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 
+ *  as published by the Free Software Foundation
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Without arguments, random frames are Miller and NRZ-L encoded and
+ * decoded.  Files given on the command line are taken as recorded raw
+ * Miller sample buffers (one frame each, SOF stripped, as the SSC
+ * delivers them).
+ *
+ * decoder_old/ holds the removed openpicc/application decoder as it
+ * was (the firmware/src/picc copy was the same code, but did not build).
+ * It does not decode these frames: a Miller character is taken from a
+ * single symbol and the NRZ-L start bit check is inverted, so the bench
+ * only counts the frames it gets right.  Its decoder_decode() gives up
+ * at the first error, so for timing, the same calls are made per
+ * character without stopping.  Whether the table decoders are right is
+ * checked against a bitwise decoder written after ISO 14443-2, on every
+ * frame.  Speeds are in sample bytes per second, the same work for all.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/time.h>
+
+#include "../firmware/src/picc/decoder_tab.h"
+#include "decoder_old/decoder.h"
+
+#define MAX_FRAME	64
+#define MAX_SAMPLES	(MAX_FRAME * 9 * 4 / 8 + 16)
+/* the removed Miller decoder reads a whole word per character */
+#define OLD_SAMPLES	(MAX_SAMPLES * 2 + 4)
+/* and makes up to one character per 9 bits */
+#define OLD_DATA	(OLD_SAMPLES * 8 / 9 + 1)
+
+struct frame {
+	u_int8_t samples[OLD_SAMPLES] __attribute__ ((aligned (4)));
+	int len;
+};
+
+static int rate = 4;
+
+/* decoder_miller.c built with two times oversampling */
+extern struct decoder_algo miller_decoder_x2;
+
+static int old_decode(int algo, const u_int8_t *buf, int len, u_int8_t *data)
+{
+	return decoder_decode(algo, (const char *) buf, len, data);
+}
+
+static int old_miller(const u_int8_t *buf, int len, u_int8_t *data)
+{
+	return old_decode(DECODER_MILLER, buf, len, data);
+}
+
+static int old_nrzl(const u_int8_t *buf, int len, u_int8_t *data)
+{
+	return old_decode(DECODER_NRZL, buf, len, data);
+}
+
+/* the loop of the removed decoder_decode(), without the early return */
+static int old_run(struct decoder_algo *algo, const u_int8_t *buf, int len,
+		   u_int8_t *data)
+{
+	struct decoder_state st;
+	u_int8_t parity_sample;
+	u_int32_t bytesample;
+	int i, err = 0;
+
+	st.buf = (const char *) buf;
+	st.buf32 = (const u_int32_t *) buf;
+	st.bit_ofs = 0;
+	st.algo = algo;
+
+	for (i = 0; i < (len * 8) / algo->bits_per_sampled_char; i++) {
+		bytesample = algo->get_next_bytesample(&st, &parity_sample);
+		if (algo->decode_sample(bytesample, &data[i]) < 0)
+			err = 1;
+	}
+
+	return err ? -EIO : i;
+}
+
+static int old_miller_run(const u_int8_t *buf, int len, u_int8_t *data)
+{
+	return old_run(rate == 4 ? &miller_decoder : &miller_decoder_x2,
+		       buf, len, data);
+}
+
+static int old_nrzl_run(const u_int8_t *buf, int len, u_int8_t *data)
+{
+	return old_run(&nrzl_decoder, buf, len, data);
+}
+
+/* reference implementation after ISO 14443-2, bit by bit */
+
+struct ref_state {
+	const u_int8_t *buf;
+	int len;
+	int bit_ofs;
+	int prev_zero;
+};
+
+static u_int32_t ref_get_bits(struct ref_state *st, int n)
+{
+	u_int32_t ret = 0;
+	int i;
+
+	for (i = 0; i < n; i++, st->bit_ofs++) {
+		int byte = st->bit_ofs / 8;
+		if (byte >= st->len)
+			break;
+		if (st->buf[byte] & (1 << (st->bit_ofs % 8)))
+			ret |= 1 << i;
+	}
+	return ret;
+}
+
+static int ref_miller_sym(struct ref_state *st, u_int32_t seq)
+{
+	u_int32_t x = rate == 4 ? 0x4 : 0x2;
+
+	switch (seq) {
+	case 0x1:	/* Z */
+		if (!st->prev_zero)
+			return -EIO;
+		return 0;
+	case 0x0:	/* Y */
+		if (st->prev_zero)
+			return 2;	/* EOF */
+		st->prev_zero = 1;
+		return 0;
+	default:
+		if (seq != x)
+			return -EIO;
+		st->prev_zero = 0;
+		return 1;
+	}
+}
+
+/* decode up to nine symbols into bits[], returns 1 at EOF */
+static int ref_miller_char(struct ref_state *st, u_int8_t *bits, int *nbits)
+{
+	int i, bit;
+
+	for (i = 0; i < 9; i++) {
+		bit = ref_miller_sym(st, ref_get_bits(st, rate));
+		if (bit < 0)
+			return bit;
+		if (bit == 2)
+			return 1;
+		bits[(*nbits)++] = bit;
+	}
+	return 0;
+}
+
+static int (*ref_decode_char)(struct ref_state *, u_int8_t *, int *) =
+	&ref_miller_char;
+
+static int ref_miller(const u_int8_t *buf, int len, u_int8_t *data)
+{
+	struct ref_state st = { buf, len, 0, 1 };
+	u_int8_t bits[MAX_SAMPLES * 8];
+	int nbits = 0, n, i, b, par, ret = 0;
+
+	while (!ret && st.bit_ofs < len * 8) {
+		ret = ref_decode_char(&st, bits, &nbits);
+		if (ret < 0)
+			return ret;
+	}
+	/* the logic 0 in front of EOF does not belong to the data */
+	if (ret)
+		nbits--;
+
+	for (n = 0, i = 0; i + 9 <= nbits; i += 9, n++) {
+		data[n] = 0;
+		par = 1;
+		for (b = 0; b < 8; b++) {
+			data[n] |= bits[i + b] << b;
+			par ^= bits[i + b];
+		}
+		if (par != bits[i + 8])
+			return -EBADMSG;
+	}
+	if (i < nbits) {
+		data[n] = 0;
+		for (b = 0; i + b < nbits; b++)
+			data[n] |= bits[i + b] << b;
+	}
+
+	return n;
+}
+
+static int ref_nrzl(const u_int8_t *buf, int len, u_int8_t *data)
+{
+	struct ref_state st = { buf, len, 0, 0 };
+	u_int32_t c;
+	int n = 0;
+
+	while (st.bit_ofs + 10 <= len * 8) {
+		if (ref_get_bits(&st, 1)) 	/* guard time */
+			continue;
+		st.bit_ofs--;
+		c = ref_get_bits(&st, 10);
+		if (c == 0)
+			break;
+		if ((c & 0x201) != 0x200)
+			return -EIO;
+		data[n++] = c >> 1;
+	}
+	return n;
+}
+
+/* encoders for the synthetic test frames */
+
+static void put_sym(struct frame *f, int *bitpos, u_int32_t seq)
+{
+	int i;
+
+	for (i = 0; i < rate; i++, (*bitpos)++) {
+		if (seq & (1 << i))
+			f->samples[*bitpos / 8] |= 1 << (*bitpos % 8);
+	}
+}
+
+static void miller_encode(struct frame *f, const u_int8_t *data, int len)
+{
+	u_int32_t x = rate == 4 ? 0x4 : 0x2;
+	int bitpos = 0, prev_zero = 1, i, b, par;
+
+	memset(f->samples, 0, sizeof(f->samples));
+	for (i = 0; i < len; i++) {
+		par = 1;
+		for (b = 0; b < 9; b++) {
+			int bit = b < 8 ? (data[i] >> b) & 1 : par;
+			par ^= bit;
+			if (bit) {
+				put_sym(f, &bitpos, x);
+				prev_zero = 0;
+			} else {
+				put_sym(f, &bitpos, prev_zero ? 0x1 : 0x0);
+				prev_zero = 1;
+			}
+		}
+	}
+	/* EOF: logic 0 followed by Y */
+	put_sym(f, &bitpos, prev_zero ? 0x1 : 0x0);
+	put_sym(f, &bitpos, 0x0);
+	f->len = (bitpos + 7) / 8;
+}
+
+static void nrzl_encode(struct frame *f, const u_int8_t *data, int len)
+{
+	int bitpos = 0, i, b;
+	u_int32_t c;
+
+	memset(f->samples, 0, sizeof(f->samples));
+	for (i = 0; i < len; i++) {
+		c = 0x200 | data[i] << 1;
+		for (b = 0; b < 10; b++, bitpos++)
+			if (c & (1 << b))
+				f->samples[bitpos / 8] |= 1 << (bitpos % 8);
+	}
+	/* EOF: ten etu of logic 0, already zero */
+	f->len = (bitpos + 10 + 7) / 8;
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+typedef int (*decode_fn)(const u_int8_t *buf, int len, u_int8_t *data);
+
+static int tab_miller(const u_int8_t *buf, int len, u_int8_t *data)
+{
+	u_int8_t bits;
+
+	return decoder_tab_miller(buf, len, rate, data, MAX_FRAME + 1, &bits);
+}
+
+static int tab_nrzl(const u_int8_t *buf, int len, u_int8_t *data)
+{
+	return decoder_tab_nrzl(buf, len, data, MAX_FRAME + 1);
+}
+
+/* sample bytes per second */
+static double bench(decode_fn fn, struct frame *frames, int num, int iter)
+{
+	u_int8_t data[OLD_DATA];
+	double start = now();
+	long bytes = 0;
+	int i, j;
+
+	for (i = 0; i < iter; i++) {
+		for (j = 0; j < num; j++) {
+			fn(frames[j].samples, frames[j].len, data);
+			bytes += frames[j].len;
+		}
+	}
+
+	return bytes / (now() - start);
+}
+
+static int compare(const char *name, decode_fn old, decode_fn old_run,
+		   decode_fn ref, decode_fn tab, struct frame *frames,
+		   int num, int iter)
+{
+	u_int8_t d1[OLD_DATA], d2[OLD_DATA];
+	double o, r, t;
+	int i, r1, r2, old_ok = 0;
+
+	for (i = 0; i < num; i++) {
+		r1 = ref(frames[i].samples, frames[i].len, d1);
+		r2 = tab(frames[i].samples, frames[i].len, d2);
+		if (r1 != r2 || (r1 > 0 && memcmp(d1, d2, r1))) {
+			fprintf(stderr, "%s: decoders disagree on frame %d "
+				"(%d vs %d)\n", name, i, r1, r2);
+			return -1;
+		}
+		r1 = old(frames[i].samples, frames[i].len, d1);
+		if (r1 == r2 && (r1 <= 0 || !memcmp(d1, d2, r1)))
+			old_ok++;
+	}
+
+	o = bench(old_run, frames, num, iter);
+	r = bench(ref, frames, num, iter);
+	t = bench(tab, frames, num, iter);
+	printf("%-10s removed %10.0f  bitwise %10.0f  table %10.0f "
+	       "sample bytes/s (%.1fx removed)\n", name, o, r, t, t / o);
+	printf("%-10s table = bitwise on all %d frames, removed decoder "
+	       "right on %d\n", name, num, old_ok);
+
+	return 0;
+}
+
+static int load_frame(const char *fname, struct frame *f)
+{
+	FILE *fp = fopen(fname, "rb");
+
+	if (!fp) {
+		perror(fname);
+		return -1;
+	}
+	memset(f->samples, 0, sizeof(f->samples));
+	f->len = fread(f->samples, 1, MAX_SAMPLES, fp);
+	fclose(fp);
+
+	return 0;
+}
+
+static void print_help(void)
+{
+	printf("decoder_bench [-2] [-n frames] [-i iterations] [file ...]\n"
+	       "\t-2\ttwo times instead of four times Miller oversampling\n");
+}
+
+int main(int argc, char **argv)
+{
+	static struct frame frames[1024];
+	u_int8_t data[MAX_FRAME];
+	int num = 256, iter = 200, c, i, j, len;
+
+	while ((c = getopt(argc, argv, "2n:i:h")) != -1) {
+		switch (c) {
+		case '2':
+			rate = 2;
+			break;
+		case 'n':
+			num = atoi(optarg);
+			if (num < 1 || num > 1024)
+				num = 1024;
+			break;
+		case 'i':
+			iter = atoi(optarg);
+			break;
+		default:
+			print_help();
+			exit(c == 'h' ? 0 : 2);
+		}
+	}
+
+	decoder_init();
+	if (rate == 2)
+		decoder_register(DECODER_MILLER, &miller_decoder_x2);
+
+	if (optind < argc) {
+		for (num = 0; optind < argc && num < 1024; optind++, num++)
+			if (load_frame(argv[optind], &frames[num]) < 0)
+				exit(1);
+		exit(compare("miller", old_miller, old_miller_run, ref_miller,
+			     tab_miller, frames, num, iter) ? 1 : 0);
+	}
+
+	srandom(1);
+	for (i = 0; i < num; i++) {
+		len = 1 + random() % MAX_FRAME;
+		for (j = 0; j < len; j++)
+			data[j] = random();
+		miller_encode(&frames[i], data, len);
+	}
+	if (compare(rate == 4 ? "miller x4" : "miller x2", old_miller,
+		    old_miller_run, ref_miller, tab_miller, frames, num,
+		    iter) < 0)
+		exit(1);
+
+	for (i = 0; i < num; i++) {
+		len = 1 + random() % MAX_FRAME;
+		for (j = 0; j < len; j++)
+			data[j] = random();
+		nrzl_encode(&frames[i], data, len);
+	}
+	if (compare("nrz-l", old_nrzl, old_nrzl_run, ref_nrzl, tab_nrzl,
+		    frames, num, iter) < 0)
+		exit(1);
+
+	exit(0);
+}
@@ -0,0 +1 @@
+/* not used by decoder_miller.c, see openpicc.h */
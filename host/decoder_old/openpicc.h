@@ -0,0 +1,5 @@
+/* Stand-in for the OpenPICC headers the removed decoder includes, only
+ * to build it into decoder_bench on the host */
+#ifndef _OPENPICC_H
+#define _OPENPICC_H
+#endif
@@ -0,0 +1,363 @@
+/* diffmiller_replay - replay edge delta traces through the OpenPICC
+ * differential Miller decoder
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 
+ *  as published by the Free Software Foundation
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * The decoder is built from openpicc/application unmodified, picc_stub/
+ * stands in for the FreeRTOS headers.  Without arguments the recorded
+ * traces from tc_sniffer.c are decoded, then random frames are Miller
+ * encoded into pause-to-pause deltas (in the units of the TC2 capture,
+ * 128 per bit) with uniform jitter added, and the decoded bits compared.
+ * Trace files contain whitespace separated deltas as printed by the
+ * sniffer with PRINT_TIMES.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+/* openpicc.h only provides the u_int*_t types, take them from libc */
+#define __OPENPICC_H__
+#include "../openpicc/application/iso14443_crc.c"
+#include "../openpicc/application/iso14443a_diffmiller.c"
+#undef printf
+
+void trace_event(u_int16_t id, u_int16_t arg)
+{
+	(void)id;
+	(void)arg;
+}
+
+void DumpStringToUSB(const char *string)
+{
+	fputs(string, stdout);
+}
+
+void DumpUIntToUSB(unsigned int data)
+{
+	printf("%u", data);
+}
+
+#define MAX_FRAME	32
+#define MAX_EDGES	(2 + 9*MAX_FRAME + 3)
+#define IDLE_DELTA	65535
+#define END_DELTA	300
+
+/* recorded by the sniffer, see tc_sniffer.c */
+static u_int32_t testdata[] = {65535, 75, 138, 75, 138, 139, 139, 300};
+static u_int32_t testdata2[] = {65535, 80, 144, 208, 208, 208, 80, 80, 208, 208, 208, 208, 80, 144, 80, 144, 144, 80, 144, 208, 81, 80, 80, 81, 80, 81, 209, 209, 209, 80, 81, 145, 81, 300};
+
+struct trace {
+	u_int8_t data[MAX_FRAME];
+	int nbits;			/* data bits, excluding parity */
+	u_int32_t delta[MAX_EDGES];
+	int count;
+};
+
+static struct diffmiller_state *decoder;
+
+/* the decoder keeps a pointer to the frame it is filling in */
+static iso14443_frame frames[8];
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static unsigned long long cycles(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+/* decode one buffer into frames[], returns the number of frames */
+static int replay(const u_int32_t *delta, unsigned int count, int max)
+{
+	unsigned int offset = 0;
+	int num = 0, ret;
+
+	while (offset < count && num < max) {
+		ret = iso14443a_decode_diffmiller(decoder, &frames[num], delta,
+						  &offset, count);
+		if (ret == 0)
+			num++;
+		else if (ret != -EBUSY)
+			break;
+	}
+	/* like the end of frame timeout in tc_recv.c */
+	if (num < max && decoder->frame == &frames[num] &&
+	    iso14443a_diffmiller_assert_frame_ended(decoder, &frames[num]) == 0)
+		num++;
+
+	/* drop whatever is left over so the next trace starts clean */
+	decoder->frame = NULL;
+	decoder->decoder_state = STATE(sym_y, OUT_OF_FRAME);
+	decoder->flags.in_frame = 0;
+
+	return num;
+}
+
+static void print_frame(const iso14443_frame *f)
+{
+	int i;
+
+	printf("%d bytes %d bits, CRC %s:", f->numbytes, f->numbits,
+	       f->parameters.a.crc == CRC_OK ? "ok" : "error");
+	for (i = 0; i < (int) f->numbytes + (f->numbits ? 1 : 0); i++)
+		printf(" %02x", f->data[i]);
+	printf("\n");
+}
+
+static void replay_print(const char *name, const u_int32_t *delta,
+			 unsigned int count)
+{
+	int i, num;
+
+	num = replay(delta, count, 8);
+	printf("%s: %d frame(s)\n", name, num);
+	for (i = 0; i < num; i++)
+		print_frame(&frames[i]);
+}
+
+/* Modified Miller: 1 is X (pause at half bit), 0 after 1 is Y (no
+ * pause), any other 0 and SOF are Z (pause at the start of the bit).
+ * EOF is a logic 0 followed by Y. */
+enum { SYM_X, SYM_Y, SYM_Z };
+
+static void encode_trace(struct trace *t, int jitter)
+{
+	u_int8_t sym[1 + 9*MAX_FRAME + 2];
+	int nsym = 0, i, bit, prev = 0, last = -1;
+	int nbits = t->nbits + t->nbits/8;	/* with parity */
+
+	sym[nsym++] = SYM_Z;
+	for (i = 0; i < nbits; i++) {
+		int byte = i / 9, pos = i % 9;
+
+		if (pos < 8)
+			bit = (t->data[byte] >> pos) & 1;
+		else
+			bit = !__builtin_parity(t->data[byte]);
+		if (bit)
+			sym[nsym++] = SYM_X;
+		else
+			sym[nsym++] = prev ? SYM_Y : SYM_Z;
+		prev = bit;
+	}
+	sym[nsym++] = prev ? SYM_Y : SYM_Z;
+	sym[nsym++] = SYM_Y;
+
+	/* the capture starts at the end of a pause: 3/4 bit for one bit */
+	t->count = 0;
+	t->delta[t->count++] = IDLE_DELTA;
+	for (i = 0; i < nsym; i++) {
+		int pos;
+
+		if (sym[i] == SYM_Y)
+			continue;
+		pos = i * BIT_LEN + (sym[i] == SYM_X ? BIT_LEN/2 : 0);
+		if (last >= 0) {
+			int d = pos - last - BIT_LEN/4 + BIT_OFFSET;
+			if (jitter)
+				d += random() % (2*jitter + 1) - jitter;
+			t->delta[t->count++] = d;
+		}
+		last = pos;
+	}
+	t->delta[t->count++] = END_DELTA;
+}
+
+static void random_trace(struct trace *t)
+{
+	int i, len = 1 + random() % MAX_FRAME;
+
+	for (i = 0; i < len; i++)
+		t->data[i] = random();
+	t->nbits = 8 * len;
+	if (random() % 4 == 0) {
+		/* short frame like REQA/WUPA */
+		t->data[0] &= 0x7f;
+		t->nbits = 7;
+	}
+}
+
+/* bit errors of one frame, data and parity bits */
+static int bit_errors(const struct trace *t, const iso14443_frame *f)
+{
+	int i, errors = 0, got = 8 * f->numbytes + f->numbits;
+
+	for (i = 0; i < t->nbits; i++) {
+		if (i >= got) {
+			errors++;
+			continue;
+		}
+		if (((t->data[i/8] ^ f->data[i/8]) >> (i%8)) & 1)
+			errors++;
+		if (i%8 == 7 && i/8 < (int) f->numbytes &&
+		    !!(f->parity[i/64] & (1 << (i/8%8))) ==
+		    !!__builtin_parity(t->data[i/8]))
+			errors++;
+	}
+	if (got > t->nbits)
+		errors += got - t->nbits;
+
+	return errors;
+}
+
+static int sweep(struct trace *traces, int num, int max_jitter, int step)
+{
+	int jitter, i, n;
+
+	printf("jitter   frames  frame errors  bits     bit errors  BER\n");
+	for (jitter = 0; jitter <= max_jitter; jitter += step) {
+		long bits = 0, errors = 0, bad = 0;
+
+		for (i = 0; i < num; i++) {
+			int e;
+
+			encode_trace(&traces[i], jitter);
+			n = replay(traces[i].delta, traces[i].count, 2);
+			e = n == 1 ? bit_errors(&traces[i], &frames[0])
+				   : traces[i].nbits + traces[i].nbits/8;
+			bits += traces[i].nbits + traces[i].nbits/8;
+			errors += e;
+			if (e)
+				bad++;
+		}
+		printf("+/-%-4d  %6d  %12ld  %7ld  %10ld  %.2e\n", jitter,
+		       num, bad, bits, errors, (double) errors / bits);
+		if (jitter == 0 && errors) {
+			fprintf(stderr, "decoding errors without jitter\n");
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static void bench(struct trace *traces, int num, int iter)
+{
+	unsigned long long c;
+	long edges = 0;
+	double start;
+	int i, j;
+
+	for (j = 0; j < num; j++)
+		encode_trace(&traces[j], 0);
+
+	start = now();
+	c = cycles();
+	for (i = 0; i < iter; i++)
+		for (j = 0; j < num; j++) {
+			replay(traces[j].delta, traces[j].count, 2);
+			edges += traces[j].count;
+		}
+	c = cycles() - c;
+
+	printf("%ld edges, %.1f ns/edge", edges,
+	       (now() - start) * 1e9 / edges);
+	if (c)
+		printf(", %.1f cycles/edge", (double) c / edges);
+	printf("\n");
+}
+
+static int load_trace(const char *fname)
+{
+	static u_int32_t delta[65536];
+	unsigned int count = 0;
+	FILE *fp = fopen(fname, "r");
+
+	if (!fp) {
+		perror(fname);
+		return -1;
+	}
+	while (count < sizeof(delta)/sizeof(delta[0]) &&
+	       fscanf(fp, "%u", &delta[count]) == 1)
+		count++;
+	fclose(fp);
+
+	replay_print(fname, delta, count);
+	return 0;
+}
+
+static void print_help(void)
+{
+	printf("diffmiller_replay [-n frames] [-i iterations] [-j jitter] "
+	       "[-s step] [file ...]\n");
+}
+
+int main(int argc, char **argv)
+{
+	static struct trace traces[1024];
+	int num = 256, iter = 2000, max_jitter = 24, step = 4, c, i;
+
+	while ((c = getopt(argc, argv, "n:i:j:s:h")) != -1) {
+		switch (c) {
+		case 'n':
+			num = atoi(optarg);
+			if (num < 1 || num > 1024)
+				num = 1024;
+			break;
+		case 'i':
+			iter = atoi(optarg);
+			break;
+		case 'j':
+			max_jitter = atoi(optarg);
+			break;
+		case 's':
+			step = atoi(optarg);
+			if (step < 1)
+				step = 1;
+			break;
+		default:
+			print_help();
+			exit(c == 'h' ? 0 : 2);
+		}
+	}
+
+	decoder = iso14443a_init_diffmiller(0);
+
+	if (optind < argc) {
+		for (; optind < argc; optind++)
+			if (load_trace(argv[optind]) < 0)
+				exit(1);
+		exit(0);
+	}
+
+	replay_print("testdata", testdata, sizeof(testdata)/sizeof(testdata[0]));
+	replay_print("testdata2", testdata2, sizeof(testdata2)/sizeof(testdata2[0]));
+
+	srandom(1);
+	for (i = 0; i < num; i++)
+		random_trace(&traces[i]);
+
+	if (sweep(traces, num, max_jitter, step) < 0)
+		exit(1);
+	bench(traces, num, iter);
+
+	return 0;
+}
@@ -0,0 +1,50 @@
+/* Minimal AT91SAM7.h for building firmware timers on the host: the
+ * peripherals are plain variables the test drives, see timer_test.c */
+#ifndef AT91SAM7_H
+#define AT91SAM7_H
+
+#include <sys/types.h>
+
+typedef struct _AT91S_TC {
+	u_int32_t TC_CCR;
+	u_int32_t TC_CMR;
+	u_int32_t TC_CV;
+	u_int32_t TC_RC;
+	u_int32_t TC_SR;
+	u_int32_t TC_IER;
+	u_int32_t TC_IDR;
+} AT91S_TC, *AT91PS_TC;
+
+typedef struct _AT91S_TCB {
+	u_int32_t TCB_BCR;
+} AT91S_TCB, *AT91PS_TCB;
+
+extern AT91S_TC host_tc1;
+extern u_int32_t host_pivr;
+/* the firmware only writes SYNC to the TC block, so every access is
+ * taken as one: host_tcb() restarts TC1 from 0 */
+extern AT91PS_TCB host_tcb(void);
+
+#define AT91C_BASE_TC1		(&host_tc1)
+#define AT91C_BASE_TCB		(host_tcb())
+#define AT91C_PITC_PIVR		(&host_pivr)
+#define AT91C_BASE_PITC		((void *) 0)
+#define AT91C_BASE_AIC		((void *) 0)
+#define AT91C_BASE_PMC		((void *) 0)
+
+#define AT91C_ID_TC1		13
+
+#define AT91C_TC_CLKEN		(0x1 << 0)
+#define AT91C_TC_CLKDIS		(0x1 << 1)
+#define AT91C_TC_SWTRG		(0x1 << 2)
+#define AT91C_TC_CLKS_TIMER_DIV3_CLOCK	0x2
+#define AT91C_TC_WAVESEL_UP	(0x0 << 13)
+#define AT91C_TC_WAVE		(0x1 << 15)
+#define AT91C_TC_CPCS		(0x1 << 4)
+#define AT91C_TCB_SYNC		(0x1 << 0)
+
+#define AT91C_AIC_PRIOR_LOWEST	0
+#define AT91C_AIC_PRIOR_HIGHEST	7
+#define AT91C_AIC_SRCTYPE_INT_HIGH_LEVEL	(0x1 << 5)
+
+#endif
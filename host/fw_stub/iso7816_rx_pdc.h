@@ -0,0 +1,89 @@
+/* Model of the USART0 PDC receive channel in place of
+ * firmware/src/simtrace/iso7816_rx_pdc.h, driven by iso7816_rx_test.c.
+ * Follows the PDC chapter of the AT91SAM7S datasheet: ENDRX is set when
+ * RCR reaches 0 and cleared by writing a non zero RCR or RNCR, RXBUFF
+ * is RCR and RNCR both 0, and a byte waiting in the receive holding
+ * register is taken as soon as the channel is enabled with a count. */
+#ifndef _ISO7816_RX_PDC_H
+#define _ISO7816_RX_PDC_H
+
+#include <sys/types.h>
+
+#define PDC_RX_ENDRX	(0x1 << 3)
+#define PDC_RX_RXBUFF	(0x1 << 12)
+
+struct host_pdc {
+	u_int8_t *rpr, *rnpr;
+	u_int16_t rcr, rncr;
+	int enabled;
+	int endrx;
+	u_int32_t imr;
+};
+
+extern struct host_pdc host_pdc;
+/* moves a waiting byte if the channel can take it */
+extern void host_pdc_service(void);
+
+static inline void pdc_rx_stop(void)
+{
+	host_pdc.enabled = 0;
+}
+
+static inline void pdc_rx_start(void)
+{
+	host_pdc.enabled = 1;
+	host_pdc_service();
+}
+
+static inline u_int8_t *pdc_rx_ptr(void)
+{
+	return host_pdc.rpr;
+}
+
+static inline u_int16_t pdc_rx_count(void)
+{
+	return host_pdc.rcr;
+}
+
+static inline void pdc_rx_set_count(u_int16_t count)
+{
+	host_pdc.rcr = count;
+	if (count)
+		host_pdc.endrx = 0;
+	host_pdc_service();
+}
+
+static inline void pdc_rx_set(u_int8_t *ptr, u_int16_t count)
+{
+	host_pdc.rpr = ptr;
+	pdc_rx_set_count(count);
+}
+
+static inline void pdc_rx_set_next(u_int8_t *ptr, u_int16_t count)
+{
+	host_pdc.rnpr = ptr;
+	host_pdc.rncr = count;
+	if (count)
+		host_pdc.endrx = 0;
+}
+
+static inline void pdc_rx_advance(void)
+{
+	u_int16_t count = host_pdc.rncr;
+
+	host_pdc.rncr = 0;
+	pdc_rx_set(host_pdc.rnpr, count);
+}
+
+static inline u_int32_t pdc_rx_status(void)
+{
+	return (host_pdc.endrx ? PDC_RX_ENDRX : 0) |
+		(!host_pdc.rcr && !host_pdc.rncr ? PDC_RX_RXBUFF : 0);
+}
+
+static inline void pdc_rx_irq(u_int32_t mask)
+{
+	host_pdc.imr = mask;
+}
+
+#endif
@@ -0,0 +1,27 @@
+/* Minimal lib_AT91SAM7.h for building firmware timers on the host */
+#ifndef lib_AT91SAM7_H
+#define lib_AT91SAM7_H
+
+#include <stddef.h>
+#include "AT91SAM7.h"
+
+#define __ramfunc
+
+/* the test fires the TC1 IRQ through this */
+extern void (*host_tc1_irq)(void);
+
+static inline void AT91F_AIC_ConfigureIt(void *aic, unsigned int id,
+					 unsigned int prio, unsigned int type,
+					 void (*handler)(void))
+{
+	host_tc1_irq = handler;
+}
+
+#define AT91F_AIC_EnableIt(aic, id)		do { } while (0)
+#define AT91F_PMC_EnablePeriphClock(pmc, mask)	do { } while (0)
+#define AT91F_PITC_CfgPMC()			do { } while (0)
+#define AT91F_PITInit(pitc, period, mhz)	do { } while (0)
+#define AT91F_PITEnableInt(pitc)		do { } while (0)
+#define AT91F_PITGetPIIR(pitc)			0
+
+#endif
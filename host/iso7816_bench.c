@@ -0,0 +1,227 @@
+/* iso7816_bench - throughput of the SIMtrace ISO 7816-3 state machine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Files given on the command line are taken as usbmon captures of the
+ * SIMtrace (as tcpdump or simtrace_replay -w write them).  Their
+ * transfers are loaded into memory and run through
+ * firmware/src/simtrace/iso7816_fsm.c the way iso7816_uart.c does: a
+ * reset and the start of the ATR for a transfer flagged as ATR, the
+ * bytes, then the waiting time if it expired.  The firmware does not
+ * pass the PPS on, so without files a session with PPS exchanges is
+ * generated instead.
+ *
+ *	iso7816_bench [-n passes] [capture...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include <simtrace_usb.h>
+
+#include "simtrace_apdu.h"
+#include "../firmware/src/simtrace/iso7816_fsm.h"
+
+/* bytes at 372 clocks per ETU, 12 ETU per byte, 3.5712 MHz */
+#define LINE_BYTES_PER_S	(3571200.0 / 372 / 12)
+
+struct xfer {
+	u_int8_t flags;
+	u_int16_t len;
+	u_int32_t off;
+};
+
+static struct xfer *xfers;
+static unsigned long xfer_count, xfer_size;
+static u_int8_t *data;
+static unsigned long data_len, data_size;
+
+static unsigned long atrs, ptss, fidis;
+
+static void add_xfer(u_int8_t flags, const u_int8_t *buf, unsigned int len)
+{
+	if (xfer_count == xfer_size) {
+		xfer_size = xfer_size ? xfer_size * 2 : 4096;
+		xfers = realloc(xfers, xfer_size * sizeof(*xfers));
+	}
+	while (data_len + len > data_size) {
+		data_size = data_size ? data_size * 2 : 1 << 20;
+		data = realloc(data, data_size);
+	}
+	if (!xfers || !data) {
+		perror("realloc");
+		exit(1);
+	}
+	xfers[xfer_count].flags = flags;
+	xfers[xfer_count].len = len;
+	xfers[xfer_count].off = data_len;
+	xfer_count++;
+	memcpy(data + data_len, buf, len);
+	data_len += len;
+}
+
+static void transfer_cb(const u_int8_t *buf, unsigned int len,
+			u_int64_t ts_ns, void *priv)
+{
+	struct simtrace_hdr hdr;
+
+	if (len < sizeof(hdr))
+		return;
+	memcpy(&hdr, buf, sizeof(hdr));
+	if (hdr.cmd != SIMTRACE_MSGT_DATA)
+		return;
+	add_xfer(hdr.flags, buf + sizeof(hdr), len - sizeof(hdr));
+}
+
+static void load(const char *name)
+{
+	FILE *f = fopen(name, "rb");
+
+	if (!f) {
+		perror(name);
+		exit(1);
+	}
+	setvbuf(f, NULL, _IOFBF, 1 << 20);
+	if (st_usbmon_read(f, 0, transfer_cb, NULL) < 0) {
+		perror(name);
+		exit(1);
+	}
+	fclose(f);
+}
+
+/* An APDU worth of random bytes, not starting like a PPS */
+static void gen_apdu(u_int8_t flags)
+{
+	u_int8_t buf[261];
+	unsigned int len = 5 + lrand48() % 257, i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = lrand48();
+	buf[0] = 0xa0;
+	add_xfer(flags, buf, len);
+}
+
+static void generate(unsigned long bytes)
+{
+	/* T=0 and T=1, then a PPS to T=1 at Fi 1 Di 3 */
+	static const u_int8_t atr[] = { 0x3b, 0x95, 0x11, 0x80, 0x01,
+					'S', 'I', 'M', 't', 'r', 0x10 };
+	static const u_int8_t pps[] = { 0xff, 0x11, 0x13, 0xfd,
+					0xff, 0x11, 0x13, 0xfd };
+	unsigned int i;
+
+	srand48(1);
+	while (data_len < bytes) {
+		add_xfer(SIMTRACE_FLAG_ATR, atr, sizeof(atr));
+		add_xfer(0, pps, sizeof(pps));
+		for (i = 0; i < 1000; i++)
+			gen_apdu(SIMTRACE_FLAG_WTIME_EXP);
+	}
+}
+
+static void run(struct iso7816_3_fsm *fsm)
+{
+	const struct xfer *x;
+	const u_int8_t *p, *end;
+	int ev;
+
+	for (x = xfers; x < xfers + xfer_count; x++) {
+		if (x->flags & SIMTRACE_FLAG_ATR) {
+			iso7816_3_reset(fsm);
+			iso7816_3_atr_start(fsm);
+		}
+		p = data + x->off;
+		end = p + x->len;
+		while (p < end) {
+			ev = iso7816_3_process_byte(fsm, *p++);
+			if (!ev)
+				continue;
+			if (ev & ISO7816_EV_ATR_DONE)
+				atrs++;
+			if (ev & ISO7816_EV_PTS_START)
+				ptss++;
+			if (ev & ISO7816_EV_PTS_DONE)
+				fidis++;
+		}
+		if (x->flags & SIMTRACE_FLAG_WTIME_EXP)
+			iso7816_3_wtime_expired(fsm);
+	}
+}
+
+static double now_s(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void help(void)
+{
+	printf("iso7816_bench [-n passes] [capture...]\n"
+	       "  -n  passes over the transfers (default 20)\n");
+}
+
+int main(int argc, char **argv)
+{
+	static struct iso7816_3_fsm fsm;
+	unsigned long passes = 20, flagged = 0, i;
+	double t;
+	int c;
+
+	while ((c = getopt(argc, argv, "n:h")) != -1) {
+		switch (c) {
+		case 'n':
+			passes = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			help();
+			exit(c == 'h' ? 0 : 2);
+		}
+	}
+	if (!passes)
+		passes = 1;
+
+	if (optind < argc) {
+		while (optind < argc)
+			load(argv[optind++]);
+	} else
+		generate(16 << 20);
+
+	for (i = 0; i < xfer_count; i++)
+		if (xfers[i].flags & SIMTRACE_FLAG_ATR)
+			flagged++;
+	printf("%lu bytes in %lu transfers, %lu flagged as ATR, "
+	       "%.1f h of line time at Fi/Di 1/1\n", data_len, xfer_count,
+	       flagged, data_len / LINE_BYTES_PER_S / 3600);
+
+	/* once to see what the state machine finds */
+	run(&fsm);
+	printf("%lu ATRs, %lu PTS started, %lu completed\n", atrs, ptss, fidis);
+
+	t = now_s();
+	for (i = 0; i < passes; i++)
+		run(&fsm);
+	t = now_s() - t;
+
+	printf("%lu passes in %.3f s: %.1f MB/s, %.2f ns per byte, "
+	       "%.0f times the line rate\n", passes, t,
+	       data_len * passes / t / 1e6, t * 1e9 / (data_len * passes),
+	       data_len * passes / t / LINE_BYTES_PER_S);
+	return 0;
+}
@@ -0,0 +1,460 @@
+/* iso7816_fuzz - drive the SIMtrace ISO 7816-3 state machine on the host
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Builds firmware/src/simtrace/iso7816_fsm.c as it is and feeds it two
+ * kinds of sessions, each from its own seed:
+ *
+ *  - well formed ones: a random ATR (any mix of interface bytes,
+ *    historical bytes, TCK when a TD names a protocol other than T=0),
+ *    sometimes a PPS the card does not answer, a PPS exchange, APDUs
+ *    separated by the waiting time and resets in between, now and then
+ *    noise that looks like an endless ATR.  The events must come
+ *    exactly at the last byte of the ATR and of the PPS response, and
+ *    Fi/Di must be the ones the card answered with.
+ *
+ *  - random bytes with random resets and waiting time expiries.  Any
+ *    state must stay in range, the ATR buffer must not overflow and
+ *    the ATR and PPS must end after a bounded number of bytes.
+ *
+ * A failing session is printed with the seed that reproduces it.  For
+ * memory errors add -fsanitize=address,undefined to CFLAGS.
+ *
+ *	iso7816_fuzz [-n sessions] [-s seed] [-v]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include "../firmware/src/simtrace/iso7816_fsm.h"
+
+#define TRACE_LEN	4096
+#define CHAOS_BYTES	2000
+
+static struct iso7816_3_fsm fsm;
+static char trace[TRACE_LEN];
+static unsigned int trace_len;
+static const char *failure;
+static int verbose;
+
+static unsigned long sessions, bytes, atrs, ptss, apdus;
+
+/* what went into the state machine, printed when a session fails */
+static void trace_add(const char *fmt, unsigned int v)
+{
+	if (trace_len + 8 >= TRACE_LEN)
+		return;
+	trace_len += snprintf(trace + trace_len, TRACE_LEN - trace_len, fmt, v);
+}
+
+static void fail(const char *why)
+{
+	if (!failure)
+		failure = why;
+}
+
+static int put(u_int8_t b)
+{
+	trace_add(" %02x", b);
+	bytes++;
+	return iso7816_3_process_byte(&fsm, b);
+}
+
+static void reset(void)
+{
+	trace_add(" RST", 0);
+	iso7816_3_reset(&fsm);
+}
+
+static void atr_start(void)
+{
+	trace_add(" |", 0);
+	iso7816_3_atr_start(&fsm);
+}
+
+static void wtime(void)
+{
+	trace_add(" WT", 0);
+	iso7816_3_wtime_expired(&fsm);
+}
+
+static void check_ranges(void)
+{
+	if (fsm.state > ISO7816_S_IN_PTS)
+		fail("state out of range");
+	if (fsm.atr_state > ATR_S_DONE)
+		fail("ATR state out of range");
+	if ((fsm.pts_state & 0x0f) > PTS_S_WAIT_REQ_PCK ||
+	    (fsm.pts_state & ~0x1f))
+		fail("PTS state out of range");
+	if (fsm.atr_idx > ISO7816_3_MAX_ATR)
+		fail("ATR index past the buffer");
+	if (fsm.fi > 15 || fsm.di > 15)
+		fail("Fi/Di out of range");
+}
+
+/* A random but well formed ATR, returns its length */
+static unsigned int gen_atr(u_int8_t *atr)
+{
+	unsigned int len = 0, hist = lrand48() % 16, groups, i;
+	int tck = 0;
+	u_int8_t y;
+
+	atr[len++] = lrand48() % 2 ? 0x3b : 0x3f;
+	groups = lrand48() % 6;
+	y = lrand48() & 0x70;
+	if (groups)
+		y |= 0x80;
+	atr[len++] = y | hist;
+
+	for (;;) {
+		if (y & 0x10)
+			atr[len++] = lrand48();
+		if (y & 0x20)
+			atr[len++] = lrand48();
+		if (y & 0x40)
+			atr[len++] = lrand48();
+		if (!(y & 0x80))
+			break;
+		/* mostly T=0 and T=1, now and then anything */
+		y = lrand48() % 4 ? lrand48() % 2 : lrand48() % 16;
+		if (y)
+			tck = 1;
+		y |= lrand48() & 0x70;
+		if (--groups)
+			y |= 0x80;
+		atr[len++] = y;
+	}
+	for (i = 0; i < hist; i++)
+		atr[len++] = lrand48();
+	if (tck) {
+		atr[len] = 0;
+		for (i = 1; i < len; i++)
+			atr[len] ^= atr[i];
+		len++;
+	}
+	return len;
+}
+
+static void session_atr(void)
+{
+	u_int8_t atr[ISO7816_3_MAX_ATR];
+	unsigned int len = gen_atr(atr), zeros = lrand48() % 3, i;
+	int ev;
+
+	atr_start();
+	/* no RST line, the I/O line may be low before TS */
+	for (i = 0; i < zeros; i++)
+		if (put(0))
+			fail("event on a NUL before TS");
+
+	for (i = 0; i < len; i++) {
+		ev = put(atr[i]);
+		if (i < len - 1 && ev)
+			fail("event inside the ATR");
+		if (i == len - 1 && ev != ISO7816_EV_ATR_DONE)
+			fail("no ATR_DONE at the last ATR byte");
+	}
+	if (fsm.state != ISO7816_S_WAIT_APDU)
+		fail("not waiting for an APDU after the ATR");
+	if (fsm.atr_idx != len || memcmp(fsm.atr, atr, len))
+		fail("ATR not recorded as sent");
+	if (fsm.fi != 1 || fsm.di != 1)
+		fail("Fi/Di changed by the ATR");
+	if (fsm.waiting_time != 960 * fsm.wi)
+		fail("waiting time not set from WI");
+	atrs++;
+}
+
+/* Noise after a reset: every byte announces another TD */
+static void session_atr_endless(void)
+{
+	unsigned int i;
+	int ev;
+
+	atr_start();
+	put(0x3b);
+	for (i = 1; i <= ISO7816_3_MAX_ATR; i++) {
+		ev = put(0x80 | (lrand48() & 0x0f));
+		if (i < ISO7816_3_MAX_ATR && ev)
+			fail("event inside the ATR");
+		if (i == ISO7816_3_MAX_ATR && ev != ISO7816_EV_ATR_DONE)
+			fail("no ATR_DONE once the ATR buffer is full");
+	}
+	if (fsm.state != ISO7816_S_WAIT_APDU ||
+	    fsm.atr_idx != ISO7816_3_MAX_ATR)
+		fail("overlong ATR not cut off");
+}
+
+/* PTSS, PTS0, the PTS1..3 PTS0 announces and PCK */
+static unsigned int gen_pts(u_int8_t *pts, u_int8_t pts0)
+{
+	unsigned int len = 0, i;
+
+	pts[len++] = 0xff;
+	pts[len++] = pts0;
+	if (pts0 & 0x10)
+		pts[len++] = (lrand48() % 2 ? 0x90 : 0x10) | (1 + lrand48() % 3);
+	if (pts0 & 0x20)
+		pts[len++] = lrand48();
+	if (pts0 & 0x40)
+		pts[len++] = lrand48();
+	pts[len] = 0;
+	for (i = 0; i < len; i++)
+		pts[len] ^= pts[i];
+	return len + 1;
+}
+
+static void pts_bytes(const u_int8_t *pts, unsigned int len, int resp)
+{
+	unsigned int i;
+	int ev, want;
+
+	for (i = 0; i < len; i++) {
+		ev = put(pts[i]);
+		want = ISO7816_EV_PTS;
+		if (!resp && i == 0)
+			want |= ISO7816_EV_PTS_START;
+		if (resp && i == 2 && (pts[1] & 0x10))
+			want |= ISO7816_EV_PTS_FIDI;
+		if (resp && i == len - 1)
+			want |= ISO7816_EV_PTS_DONE;
+		if (ev != want)
+			fail("wrong PTS event");
+	}
+}
+
+static void session_pts(void)
+{
+	u_int8_t req[6], resp[6], pts0;
+	unsigned int req_len, resp_len;
+
+	pts0 = (lrand48() & 0x70) | lrand48() % 2;
+	req_len = gen_pts(req, pts0);
+
+	/* the card ignores the first one */
+	if (lrand48() % 4 == 0) {
+		pts_bytes(req, lrand48() % req_len + 1, 0);
+		wtime();
+		if (fsm.state != ISO7816_S_WAIT_APDU)
+			fail("not waiting for an APDU after an unanswered PTS");
+	}
+
+	pts_bytes(req, req_len, 0);
+	/* accepted as requested, or without the PTS1 */
+	if (lrand48() % 2) {
+		memcpy(resp, req, req_len);
+		resp_len = req_len;
+	} else
+		resp_len = gen_pts(resp, pts0 & 0x6f);
+	pts_bytes(resp, resp_len, 1);
+
+	if (fsm.state != ISO7816_S_WAIT_APDU)
+		fail("not waiting for an APDU after the PTS");
+	if (resp[1] & 0x10) {
+		if (fsm.fi != resp[2] >> 4 || fsm.di != (resp[2] & 0xf))
+			fail("Fi/Di not taken from PTS1");
+		if (iso7816_3_fidi_ratio(fsm.fi, fsm.di) <= 0)
+			fail("no F/D ratio for the negotiated Fi/Di");
+	} else if (fsm.fi != 1 || fsm.di != 1)
+		fail("Fi/Di changed without PTS1");
+	ptss++;
+}
+
+static void session_apdus(void)
+{
+	unsigned int n = lrand48() % 8, len, i;
+	u_int8_t b;
+
+	while (n--) {
+		len = 1 + lrand48() % 300;
+		for (i = 0; i < len; i++) {
+			b = lrand48();
+			/* a CLA of FF is a PTS, which is what the card thinks */
+			if (i == 0 && b == 0xff)
+				b = 0xa0;
+			if (put(b))
+				fail("event inside an APDU");
+			if (fsm.state != ISO7816_S_IN_APDU)
+				fail("not inside the APDU");
+		}
+		wtime();
+		if (fsm.state != ISO7816_S_WAIT_APDU)
+			fail("not waiting for an APDU after the waiting time");
+		apdus++;
+	}
+}
+
+static void session_wellformed(void)
+{
+	unsigned int resets = 1 + lrand48() % 3;
+
+	while (resets--) {
+		if (lrand48() % 2) {
+			reset();
+			if (put(lrand48()))
+				fail("event in reset");
+		}
+		if (lrand48() % 8 == 0)
+			session_atr_endless();
+		session_atr();
+		if (lrand48() % 2)
+			session_pts();
+		session_apdus();
+	}
+}
+
+static void session_chaos(void)
+{
+	unsigned int i, atr_bytes = 0, pts_bytes = 0;
+	int ev, was;
+
+	atr_start();
+	for (i = 0; i < CHAOS_BYTES && !failure; i++) {
+		switch (lrand48() % 64) {
+		case 0:
+			reset();
+			break;
+		case 1:
+			atr_start();
+			break;
+		case 2:
+		case 3:
+			wtime();
+			break;
+		}
+
+		was = fsm.state;
+		if (was != ISO7816_S_IN_ATR)
+			atr_bytes = 0;
+		if (was != ISO7816_S_IN_PTS)
+			pts_bytes = 0;
+		/* zeros before TS and PTS are likely on a bad line */
+		ev = put(lrand48() % 4 ? lrand48() : (lrand48() % 2) * 0xff);
+		check_ranges();
+
+		if ((ev & (ISO7816_EV_PTS_START | ISO7816_EV_PTS_FIDI |
+			   ISO7816_EV_PTS_DONE)) && !(ev & ISO7816_EV_PTS))
+			fail("PTS event without EV_PTS");
+		if ((ev & ISO7816_EV_ATR_DONE) && (ev & ISO7816_EV_PTS))
+			fail("ATR and PTS at once");
+		if ((ev & ISO7816_EV_ATR_DONE) && was != ISO7816_S_WAIT_ATR &&
+		    was != ISO7816_S_IN_ATR)
+			fail("ATR_DONE outside the ATR");
+		if ((ev & (ISO7816_EV_ATR_DONE | ISO7816_EV_PTS_DONE)) &&
+		    fsm.state != ISO7816_S_WAIT_APDU)
+			fail("not waiting for an APDU after ATR/PTS");
+
+		/* NULs before TS do not count */
+		if (fsm.state == ISO7816_S_IN_ATR && fsm.atr_idx &&
+		    ++atr_bytes > ISO7816_3_MAX_ATR)
+			fail("ATR does not end");
+		if (fsm.state == ISO7816_S_IN_PTS && ++pts_bytes > 11)
+			fail("PTS does not end");
+	}
+}
+
+static void check_fidi_ratio(void)
+{
+	static const int f[16] = { 372, 372, 558, 744, 1116, 1488, 1860, 0,
+				   0, 512, 768, 1024, 1536, 2048, 0, 0 };
+	static const int d[16] = { 0, 1, 2, 4, 8, 16, 32, 64,
+				   12, 20, 2, 4, 8, 16, 32, 64 };
+	int fi, di, want;
+
+	for (fi = 0; fi < 18; fi++) {
+		for (di = 0; di < 18; di++) {
+			if (fi > 15 || di > 15 || !f[fi] || !d[di])
+				want = -EINVAL;
+			else if (di < 8)
+				want = f[fi] / d[di];
+			else
+				want = f[fi] * d[di];
+			if (iso7816_3_fidi_ratio(fi, di) != want) {
+				printf("F/D ratio of Fi %d Di %d: %d, not %d\n",
+				       fi, di, iso7816_3_fidi_ratio(fi, di), want);
+				exit(1);
+			}
+		}
+	}
+}
+
+static void help(void)
+{
+	printf("iso7816_fuzz [-n sessions] [-s seed] [-v]\n"
+	       "  -n  sessions to run (default 10000)\n"
+	       "  -s  seed of the first session\n"
+	       "  -v  print every session\n");
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long n = 10000, seed = time(NULL), i;
+	int c;
+
+	while ((c = getopt(argc, argv, "n:s:vh")) != -1) {
+		switch (c) {
+		case 'n':
+			n = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			help();
+			exit(c == 'h' ? 0 : 2);
+		}
+	}
+
+	check_fidi_ratio();
+
+	for (i = 0; i < n; i++) {
+		srand48(seed + i);
+		memset(&fsm, 0, sizeof(fsm));
+		trace_len = 0;
+		trace[0] = '\0';
+		failure = NULL;
+
+		if ((seed + i) % 2)
+			session_chaos();
+		else
+			session_wellformed();
+		sessions++;
+
+		if (failure || verbose)
+			printf("%s session, seed %lu:%s\n",
+			       (seed + i) % 2 ? "random" : "well formed",
+			       seed + i, trace);
+		if (failure) {
+			printf("FAILED: %s (state %d, ATR state %d, PTS state "
+			       "0x%02x)\nrun with -s %lu -n 1 to repeat\n",
+			       failure, fsm.state, fsm.atr_state,
+			       fsm.pts_state, seed + i);
+			return 1;
+		}
+	}
+
+	printf("%lu sessions from seed %lu: %lu bytes, %lu ATRs, %lu PTS, "
+	       "%lu APDUs, no failures\n", sessions, seed, bytes, atrs, ptss,
+	       apdus);
+	return 0;
+}
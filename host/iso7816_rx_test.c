@@ -0,0 +1,473 @@
+/* iso7816_rx_test - run the SIMtrace PDC reception on the host
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Builds firmware/src/simtrace/iso7816_rx.c and iso7816_fsm.c as they
+ * are, with fw_stub/iso7816_rx_pdc.h putting a model of the PDC receive
+ * channel and the USART holding register in place of the registers.
+ * The test plays the card, the reader and iso7816_uart.c: it sends
+ * bytes, raises the PDC interrupt, the receiver time-out, the waiting
+ * time and the reset line, and runs the main loop now and then.
+ *
+ * Sessions start with a reset and an ATR, sometimes with TA1, followed
+ * by a PPS the card answers, one it does not answer or none, then
+ * APDUs with idle gaps, and now and then a reset in the middle.  Some
+ * sessions are random bytes and events.  The main loop keeps up in
+ * some sessions and stalls for a while in others.
+ *
+ *  - The main loop must get every byte the PDC wrote, in order, with
+ *    the events where they happened (events without bytes in between
+ *    may be merged).
+ *  - Bytes may only be lost while every buffer waits for the main loop.
+ *  - The PDC interrupt must be off again after the handler ran.
+ *  - A PPS the card answered must switch the receiver right after the
+ *    PCK of the response, to its Fi/Di, before the next byte.  Nothing
+ *    else may switch it.
+ *
+ *	iso7816_rx_test [-n sessions] [-s seed] [-v]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include <iso7816_rx_pdc.h>
+#include "../firmware/src/simtrace/iso7816_fsm.h"
+#include "../firmware/src/simtrace/iso7816_rx.h"
+
+#define LOG_LEN		(64 * 1024)
+#define LOG_EVENT	0x100	/* | RX_EV_*, otherwise a byte */
+
+struct host_pdc host_pdc;
+static int rhr_full;
+static u_int8_t rhr;
+
+/* what the PDC wrote and the events in between, and what the main loop
+ * got */
+static unsigned int pdc_log[LOG_LEN], main_log[LOG_LEN];
+static unsigned int pdc_log_len, main_log_len;
+
+static const char *failure;
+static int verbose, stalled;
+static unsigned long line_bytes, fidi_calls, fidi_at;
+/* lost + held at the reset, the watch has seen every byte since if they
+ * did not change */
+static unsigned long lost_at_reset, resets;
+static int fidi_ratio;
+
+static unsigned long sessions, bytes, buffers, lost, held, ppss, pps_checked;
+
+static void fail(const char *why)
+{
+	if (!failure)
+		failure = why;
+}
+
+static void log_add(unsigned int *log, unsigned int *len, unsigned int v)
+{
+	/* runs of events count as one, OR'ed */
+	if ((v & LOG_EVENT) && *len && (log[*len - 1] & LOG_EVENT)) {
+		log[*len - 1] |= v;
+		return;
+	}
+	if (*len == LOG_LEN) {
+		fail("log overflow");
+		return;
+	}
+	log[(*len)++] = v;
+}
+
+void host_pdc_service(void)
+{
+	if (!rhr_full || !host_pdc.enabled || !host_pdc.rcr)
+		return;
+
+	*host_pdc.rpr++ = rhr;
+	rhr_full = 0;
+	log_add(pdc_log, &pdc_log_len, rhr);
+	if (--host_pdc.rcr)
+		return;
+
+	host_pdc.endrx = 1;
+	if (host_pdc.rncr) {
+		host_pdc.rpr = host_pdc.rnpr;
+		host_pdc.rcr = host_pdc.rncr;
+		host_pdc.rncr = 0;
+	}
+}
+
+/* The receiver is reset, as iso7816_uart.c does on reset and PPS */
+static void rx_reset(void)
+{
+	if (rhr_full)
+		lost++;
+	rhr_full = 0;
+}
+
+void iso_uart_set_fidi(int ratio)
+{
+	rx_reset();
+	fidi_calls++;
+	fidi_ratio = ratio;
+	fidi_at = line_bytes;
+}
+
+/* The PDC interrupt is level triggered */
+static void irq(void)
+{
+	int i;
+
+	for (i = 0; host_pdc.imr & pdc_rx_status(); i++) {
+		if (i == 2) {
+			fail("PDC interrupt stays raised");
+			return;
+		}
+		iso7816_rx_irq();
+	}
+}
+
+static void main_loop(void)
+{
+	struct rx_buf *buf;
+	u_int8_t events;
+	int i;
+
+	irq();
+	while ((buf = iso7816_rx_get())) {
+		if (buf->len > ISO_UART_RX_BUF_SIZE)
+			fail("buffer longer than its size");
+		for (i = 0; i < buf->len; i++)
+			log_add(main_log, &main_log_len, buf->data[i]);
+		events = iso7816_rx_put();
+		if (events & ~(RX_EV_WTIME | RX_EV_RST_ACTIVE |
+			       RX_EV_RST_RELEASE))
+			fail("unknown event");
+		if (events)
+			log_add(main_log, &main_log_len, LOG_EVENT | events);
+		buffers++;
+		irq();
+	}
+}
+
+/* Between two things happening on the line */
+static void maybe_main_loop(void)
+{
+	if (!stalled || !(lrand48() % 64))
+		main_loop();
+}
+
+static void put(u_int8_t b)
+{
+	/* the PDC interrupt is taken within a character, but the time-out,
+	 * the ETU timer or the reset line may come first */
+	irq();
+
+	if (rhr_full) {
+		/* overrun, the byte before is gone */
+		if (!stalled)
+			fail("byte lost while the main loop keeps up");
+		lost++;
+	}
+	rhr = b;
+	rhr_full = 1;
+	line_bytes++;
+	bytes++;
+	host_pdc_service();
+	if (rhr_full) {
+		if (!stalled)
+			fail("byte held while the main loop keeps up");
+		held++;
+	}
+	if (lrand48() % 8)
+		irq();
+	maybe_main_loop();
+}
+
+static void flush(u_int8_t events)
+{
+	if (events)
+		log_add(pdc_log, &pdc_log_len, LOG_EVENT | events);
+	iso7816_rx_flush(events);
+	irq();
+	maybe_main_loop();
+}
+
+/* The receiver time-out after a gap */
+static void idle(void)
+{
+	flush(0);
+}
+
+static void wtime(void)
+{
+	log_add(pdc_log, &pdc_log_len, LOG_EVENT | RX_EV_WTIME);
+	iso7816_rx_wtime_expired();
+	irq();
+	maybe_main_loop();
+}
+
+/* What reset_pin_irq() does */
+static void reset(void)
+{
+	rx_reset();
+	flush(RX_EV_RST_ACTIVE);
+	/* back to Fi/Di 1, which resets the receiver once more */
+	rx_reset();
+	flush(RX_EV_RST_RELEASE);
+	iso7816_rx_watch_start();
+	irq();
+	lost_at_reset = lost + held;
+	resets++;
+}
+
+static void maybe_idle(void)
+{
+	if (lrand48() % 2)
+		idle();
+}
+
+static void atr(void)
+{
+	u_int8_t t0 = lrand48() % 16;
+	int i;
+
+	put(lrand48() % 2 ? 0x3b : 0x3f);
+	if (lrand48() % 2)
+		t0 |= 0x10;
+	if (lrand48() % 4 == 0)
+		t0 |= 0x60;
+	put(t0);
+	/* TA1 to TC1 */
+	for (i = 4; i < 7; i++)
+		if (t0 & (1 << i))
+			put(lrand48());
+	for (i = 0; i < (t0 & 0x0f); i++)
+		put(lrand48());
+}
+
+/* A PPS for T=0 with PPS1, answered unless noanswer */
+static void pps(int noanswer)
+{
+	static const u_int8_t pps1s[] = {
+		0x11, 0x13, 0x18, 0x94, 0x95, 0x96, 0x97, 0xf0,
+	};
+	u_int8_t req[4];
+	unsigned long calls = fidi_calls;
+	int i, ratio;
+
+	req[0] = 0xff;
+	req[1] = 0x10;
+	req[2] = pps1s[lrand48() % sizeof(pps1s)];
+	req[3] = req[0] ^ req[1] ^ req[2];
+	ratio = iso7816_3_fidi_ratio(req[2] >> 4, req[2] & 0x0f);
+
+	for (i = 0; i < 4; i++)
+		put(req[i]);
+	maybe_idle();
+	if (noanswer) {
+		wtime();
+		return;
+	}
+	for (i = 0; i < 4; i++)
+		put(req[i]);
+	/* before the next byte, the IRQ after the PCK may still be due */
+	irq();
+	ppss++;
+
+	/* with bytes held back the watch runs late */
+	if (lost + held != lost_at_reset)
+		return;
+	pps_checked++;
+	if (ratio <= 0 || ratio >= 0x400) {
+		if (fidi_calls != calls)
+			fail("switched to a reserved Fi/Di");
+		return;
+	}
+	if (fidi_calls != calls + 1)
+		fail("the PPS response did not switch the receiver");
+	else if (fidi_at != line_bytes)
+		fail("switched at the wrong byte");
+	else if (fidi_ratio != ratio)
+		fail("switched to the wrong Fi/Di");
+}
+
+static void apdu(void)
+{
+	unsigned int len = lrand48() % 300, gaps = 32, i;
+
+	/* now and then a long one without a gap, over several buffers */
+	if (!(lrand48() % 4)) {
+		len = lrand48() % (4 * ISO_UART_RX_BUF_SIZE);
+		gaps = 0;
+	}
+
+	/* CLA, never 0xff */
+	put(lrand48() % 2 ? 0xa0 : 0x00);
+	for (i = 1; i < 5 + len; i++) {
+		put(lrand48());
+		if (gaps && !(lrand48() % gaps))
+			idle();
+		if (!(lrand48() % 512)) {
+			reset();
+			return;
+		}
+	}
+	if (lrand48() % 2)
+		wtime();
+	else
+		idle();
+}
+
+static void session_wellformed(void)
+{
+	unsigned int n = lrand48() % 8, i;
+	unsigned long calls, resets_before;
+
+	reset();
+	atr();
+	maybe_idle();
+
+	switch (lrand48() % 3) {
+	case 0:
+		pps(0);
+		break;
+	case 1:
+		pps(1);
+		break;
+	}
+	maybe_idle();
+
+	calls = fidi_calls;
+	resets_before = resets;
+	for (i = 0; i < n && resets == resets_before; i++)
+		apdu();
+	/* after a reset in an APDU its bytes are taken for an ATR */
+	if (fidi_calls != calls && resets == resets_before &&
+	    lost + held == lost_at_reset)
+		fail("the receiver was switched by an APDU");
+}
+
+static void session_chaos(void)
+{
+	unsigned int n = lrand48() % 2000, i;
+
+	reset();
+	for (i = 0; i < n; i++) {
+		switch (lrand48() % 64) {
+		case 0:
+			reset();
+			break;
+		case 1:
+		case 2:
+			wtime();
+			break;
+		case 3:
+		case 4:
+		case 5:
+			idle();
+			break;
+		default:
+			put(lrand48() % 4 ? lrand48() : 0xff);
+			break;
+		}
+	}
+}
+
+/* Hands over the rest and compares what the main loop got */
+static void session_check(void)
+{
+	unsigned int i;
+
+	main_loop();
+	iso7816_rx_flush(0);
+	irq();
+	main_loop();
+
+	if (rhr_full)
+		fail("a byte is still waiting after the main loop caught up");
+	for (i = 0; i < pdc_log_len && i < main_log_len; i++)
+		if (pdc_log[i] != main_log[i])
+			break;
+	if (i < pdc_log_len || i < main_log_len) {
+		printf("differ at %u of %u/%u: PDC %03x, main loop %03x\n",
+		       i, pdc_log_len, main_log_len,
+		       i < pdc_log_len ? pdc_log[i] : 0,
+		       i < main_log_len ? main_log[i] : 0);
+		fail("the main loop did not get what the PDC received");
+	}
+}
+
+static void help(void)
+{
+	printf("iso7816_rx_test [-n sessions] [-s seed] [-v]\n"
+	       "  -n  sessions to run (default 10000)\n"
+	       "  -v  print every session\n");
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long n = 10000, seed = 1, i;
+	int c, chaos;
+
+	while ((c = getopt(argc, argv, "n:s:vh")) != -1) {
+		switch (c) {
+		case 'n':
+			n = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			help();
+			exit(c == 'h' ? 0 : 2);
+		}
+	}
+
+	srand48(seed);
+	iso7816_rx_start();
+
+	for (i = 0; i < n; i++) {
+		pdc_log_len = main_log_len = 0;
+		stalled = !(lrand48() % 4);
+		chaos = !(lrand48() % 4);
+
+		if (chaos)
+			session_chaos();
+		else
+			session_wellformed();
+		session_check();
+		sessions++;
+
+		if (failure || verbose)
+			printf("session %lu: %s, %s main loop, %u bytes and "
+			       "events\n", i, chaos ? "random" : "well formed",
+			       stalled ? "stalling" : "eager", pdc_log_len);
+		if (failure) {
+			printf("FAILED: %s\nrun with -s %lu -n %lu to repeat\n",
+			       failure, seed, i + 1);
+			return 1;
+		}
+	}
+
+	printf("%lu sessions from seed %lu: %lu bytes in %lu buffers, "
+	       "%lu PPS (%lu checked), %lu bytes held and %lu lost while "
+	       "stalled, no failures\n", sessions, seed, bytes, buffers,
+	       ppss, pps_checked, held, lost);
+	return 0;
+}
@@ -0,0 +1,247 @@
+/* manchester_bench - time the OpenPICC Manchester encoder against the
+ * ISO14443A frame delay time budget
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 
+ *  as published by the Free Software Foundation
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * The encoder is built from openpicc/application unmodified.  Its output
+ * is checked against the previous bit-by-bit encoder for standard frames
+ * and decoded back for short and anticollision frames.  Timings are
+ * host timings; scale them by the clock/IPC ratio to the 48MHz ARM7.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/time.h>
+
+/* openpicc.h only provides the u_int*_t types, take them from libc */
+#define __OPENPICC_H__
+#include "../openpicc/application/iso14443_crc.c"
+#include "../openpicc/application/iso14443a_manchester.c"
+
+/* minimum frame delay time PICC->PCD after a PCD frame ending in 0 */
+#define FDT_MIN_FC	1172
+#define FC_HZ		13560000.0
+
+/* previous implementation, bit by bit */
+static void ref_enc_byte(u_int16_t **s16, u_int8_t data, int parity)
+{
+	int i, sum_1 = 0;
+
+	for (i = 0; i < 8; i++) {
+		if (data & (1 << i)) {
+			*(*s16)++ = MANCHESTER_SEQ_D;
+			sum_1++;
+		} else
+			*(*s16)++ = MANCHESTER_SEQ_E;
+	}
+	if (parity == -1)
+		parity = (sum_1 & 1) ? 0 : 1;
+	if (parity <= 1)
+		*(*s16)++ = parity ? MANCHESTER_SEQ_D : MANCHESTER_SEQ_E;
+}
+
+static int ref_encode(u_int8_t *buf, const iso14443_frame *frame)
+{
+	u_int16_t *s16 = (u_int16_t *) buf;
+	unsigned int i;
+	int enc_size;
+
+	enc_size = (1 + frame->numbytes *
+		    ((frame->parameters.a.parity != NO_PARITY) ? 9 : 8) + 1) * 2;
+	memset(buf, 0, enc_size);
+	*s16++ = MANCHESTER_SEQ_D;
+	for (i = 0; i < frame->numbytes; i++) {
+		int p = -1;
+		if (frame->parameters.a.parity == NO_PARITY)
+			p = 2;
+		else if (frame->parameters.a.parity == GIVEN_PARITY)
+			p = (frame->parity[i/8] & (1 << (i%8))) ? 1 : 0;
+		ref_enc_byte(&s16, frame->data[i], p);
+	}
+	*s16++ = MANCHESTER_SEQ_F;
+
+	return enc_size;
+}
+
+/* sample buffer back to bits, 1 for D, 0 for E; returns bit count or -1 */
+static int samples_to_bits(const u_int8_t *buf, int len, u_int8_t *bits)
+{
+	const u_int16_t *s16 = (const u_int16_t *) buf;
+	int i, n = len / 2;
+
+	if (s16[0] != MANCHESTER_SEQ_D || s16[n-1] != MANCHESTER_SEQ_F)
+		return -1;
+	for (i = 1; i < n - 1; i++) {
+		if (s16[i] == MANCHESTER_SEQ_D)
+			bits[i-1] = 1;
+		else if (s16[i] == MANCHESTER_SEQ_E)
+			bits[i-1] = 0;
+		else
+			return -1;
+	}
+	return n - 2;
+}
+
+static int odd_parity(u_int8_t c)
+{
+	int i, p = 1;
+
+	for (i = 0; i < 8; i++)
+		p ^= (c >> i) & 1;
+	return p;
+}
+
+static void init_frame(iso14443_frame *f, int format, int parity, int len)
+{
+	int i;
+
+	memset(f, 0, sizeof(*f));
+	f->type = TYPE_A;
+	f->parameters.a.format = format;
+	f->parameters.a.parity = parity;
+	f->numbytes = len;
+	for (i = 0; i < len + 1; i++)
+		f->data[i] = random();
+	for (i = 0; i < (int) sizeof(f->parity); i++)
+		f->parity[i] = random();
+}
+
+/* two bytes per bit: SOF, nine bits per byte, EOF */
+#define TX_BUF_SIZE	((1 + MAXIMUM_FRAME_SIZE * 9 + 1) * 2 + 4)
+
+static u_int32_t buf1[TX_BUF_SIZE / 4];
+static u_int32_t buf2[TX_BUF_SIZE / 4];
+
+static int check(void)
+{
+	static const int parities[] = { PARITY, GIVEN_PARITY, NO_PARITY };
+	iso14443_frame f;
+	u_int8_t bits[MAXIMUM_FRAME_SIZE * 9 + 16];
+	int len, p, ofs, r1, r2, n, i, b;
+
+	/* standard frames must match the old encoder, at both alignments */
+	for (len = 0; len <= MAXIMUM_FRAME_SIZE; len++) {
+		for (p = 0; p < 3; p++) {
+			for (ofs = 0; ofs <= 2; ofs += 2) {
+				u_int8_t *out = (u_int8_t *) buf2 + ofs;
+				init_frame(&f, STANDARD_FRAME, parities[p], len);
+				r1 = ref_encode((u_int8_t *) buf1, &f);
+				r2 = manchester_encode(out,
+					sizeof(buf2) - ofs, &f);
+				if (r1 != r2 || memcmp(buf1, out, r1)) {
+					printf("mismatch: len %d parity %d "
+					       "ofs %d\n", len, p, ofs);
+					return -1;
+				}
+			}
+		}
+	}
+
+	/* short frame: seven bits, no parity */
+	init_frame(&f, SHORT_FRAME, PARITY, 0);
+	f.data[0] = 0x26;
+	r2 = manchester_encode((u_int8_t *) buf2, sizeof(buf2), &f);
+	n = samples_to_bits((u_int8_t *) buf2, r2, bits);
+	for (i = 0, b = 0; i < n; i++)
+		b |= bits[i] << i;
+	if (n != 7 || b != 0x26) {
+		printf("short frame broken\n");
+		return -1;
+	}
+
+	/* anticollision frame: split first byte with parity, partial tail */
+	for (ofs = 1; ofs < 8; ofs++) {
+		init_frame(&f, AC_FRAME, PARITY, 4);
+		f.bit_offset = ofs;
+		f.numbits = 8 - ofs;
+		r2 = manchester_encode((u_int8_t *) buf2, sizeof(buf2), &f);
+		n = samples_to_bits((u_int8_t *) buf2, r2, bits);
+		if (n != (8 - ofs) + 1 + 3 * 9 + (8 - ofs))
+			goto ac_broken;
+		for (i = 0; i < 8 - ofs; i++)
+			if (bits[i] != ((f.data[0] >> (i + ofs)) & 1))
+				goto ac_broken;
+		if (bits[i++] != odd_parity(f.data[0]))
+			goto ac_broken;
+		for (len = 1; len < 4; len++) {
+			for (b = 0; b < 8; b++)
+				if (bits[i++] != ((f.data[len] >> b) & 1))
+					goto ac_broken;
+			if (bits[i++] != odd_parity(f.data[len]))
+				goto ac_broken;
+		}
+		for (b = 0; b < 8 - ofs; b++)
+			if (bits[i++] != ((f.data[4] >> b) & 1))
+				goto ac_broken;
+	}
+
+	return 0;
+
+ac_broken:
+	printf("anticollision frame broken (bit_offset %d)\n", ofs);
+	return -1;
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+int main(int argc, char **argv)
+{
+	static const int sizes[] = { 2, 4, 5, 7, 9, 16, 18, 32, 64, 256 };
+	iso14443_frame f;
+	double t0, t_ref, t_tab, fdt;
+	int iter = argc > 1 ? atoi(argv[1]) : 200000;
+	unsigned int s;
+	int i;
+
+	srandom(1);
+	if (check() < 0)
+		exit(1);
+	printf("output identical to the bitwise encoder, short and "
+	       "anticollision frames ok\n\n");
+
+	fdt = FDT_MIN_FC / FC_HZ * 1e9;
+	printf("bytes   bitwise ns   table ns  speedup   FDT budget %.0f ns\n",
+	       fdt);
+
+	for (s = 0; s < sizeof(sizes)/sizeof(sizes[0]); s++) {
+		init_frame(&f, STANDARD_FRAME, PARITY, sizes[s]);
+		/* warm up caches */
+		ref_encode((u_int8_t *) buf1, &f);
+		manchester_encode((u_int8_t *) buf2, sizeof(buf2), &f);
+
+		t0 = now();
+		for (i = 0; i < iter; i++)
+			ref_encode((u_int8_t *) buf1, &f);
+		t_ref = (now() - t0) * 1e9 / iter;
+
+		t0 = now();
+		for (i = 0; i < iter; i++)
+			manchester_encode((u_int8_t *) buf2, sizeof(buf2), &f);
+		t_tab = (now() - t0) * 1e9 / iter;
+
+		printf("%5d %12.1f %10.1f %7.1fx %9.2f%% of FDT\n", sizes[s],
+		       t_ref, t_tab, t_ref / t_tab, t_tab * 100 / fdt);
+	}
+
+	exit(0);
+}
@@ -0,0 +1,326 @@
+/* metrics_poll - watch the OpenPICC metrics
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * On the CDC tty this sends the 'm' command at a fixed rate and prints
+ * what has changed since the last dump (see openpicc/application/metrics.h):
+ * counters with their increase and rate, gauges with their level and
+ * histograms with the increase per bucket. A counter marked as an error
+ * that went up is flagged with '!', and the exit status is 1 if that
+ * happened at all.
+ *
+ *	metrics_poll -i 1000 /dev/ttyACM0
+ *
+ * A file, e.g. from picc_sim -m, is read to its end instead, the dumps
+ * in it are compared one after the other.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include "../openpicc/application/metrics.h"
+
+#define MAX_METRICS	128
+#define MAX_BUCKETS	255
+
+struct value {
+	char name[256];
+	u_int8_t type, flags, buckets;
+	u_int32_t v[MAX_BUCKETS];
+};
+
+struct snapshot {
+	u_int32_t time, clock_hz;
+	unsigned int count;
+	struct value m[MAX_METRICS];
+};
+
+static struct snapshot snaps[2];
+static int cur, have_prev, show_all, errors_seen;
+static unsigned long dumps;
+
+static u_int32_t get32(const u_int8_t *p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (u_int32_t)p[3] << 24;
+}
+
+static const struct value *find(const struct snapshot *s, const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < s->count; i++)
+		if (!strcmp(s->m[i].name, name))
+			return &s->m[i];
+	return NULL;
+}
+
+static void print_diff(const struct snapshot *s, const struct snapshot *prev)
+{
+	double dt = 0;
+	unsigned int i, j;
+
+	if (prev)
+		dt = (double)(u_int32_t)(s->time - prev->time) / s->clock_hz;
+	printf("--- dump %lu", dumps);
+	if (prev)
+		printf(", %.3f s after the last one", dt);
+	printf("\n");
+
+	for (i = 0; i < s->count; i++) {
+		const struct value *m = &s->m[i];
+		const struct value *p = prev ? find(prev, m->name) : NULL;
+		int changed = !p, error = 0;
+		u_int32_t d;
+
+		if (p && (p->type != m->type || p->buckets != m->buckets))
+			p = NULL;
+		for (j = 0; p && j < m->buckets; j++)
+			if (m->v[j] != p->v[j])
+				changed = 1;
+		if (!changed && !show_all)
+			continue;
+
+		if (m->type != METRIC_GAUGE && p && (m->flags & METRIC_F_ERROR))
+			for (j = 0; j < m->buckets; j++)
+				if (m->v[j] > p->v[j])
+					error = 1;
+		errors_seen |= error;
+
+		printf("%c %-32s", error ? '!' : ' ', m->name);
+		switch (m->type) {
+		case METRIC_COUNTER:
+			printf(" %10u", m->v[0]);
+			if (p) {
+				/* Smaller means it was reset */
+				d = m->v[0] >= p->v[0] ? m->v[0] - p->v[0] : m->v[0];
+				printf(" %+10d", (int)d);
+				if (dt > 0)
+					printf(" %10.1f/s", d / dt);
+			}
+			break;
+		case METRIC_GAUGE:
+			printf(" %10u", m->v[0]);
+			break;
+		case METRIC_HISTOGRAM:
+			for (j = 0; j < m->buckets; j++)
+				printf(" %u", p && m->v[j] >= p->v[j] ?
+				       m->v[j] - p->v[j] : m->v[j]);
+			if (!p)
+				printf(" (new)");
+			break;
+		}
+		printf("\n");
+	}
+	fflush(stdout);
+}
+
+/* Parses a dump into snaps[cur], returns 0 or -1 if it is not valid */
+static int parse_dump(const u_int8_t *buf, unsigned int len)
+{
+	struct snapshot *s = &snaps[cur];
+	const struct metrics_dump_header *hdr = (const void *)buf;
+	unsigned int pos = sizeof(*hdr), i, j;
+	u_int32_t sum = 0;
+
+	for (i = pos; i < len; i++)
+		sum += buf[i];
+	if (sum != hdr->sum || hdr->clock_hz == 0)
+		return -1;
+
+	s->time = hdr->time;
+	s->clock_hz = hdr->clock_hz;
+	s->count = 0;
+	for (i = 0; i < hdr->count; i++) {
+		struct value *m = &s->m[s->count];
+		u_int8_t name_len;
+
+		if (pos + 4 > len)
+			return -1;
+		m->type = buf[pos++];
+		m->flags = buf[pos++];
+		m->buckets = buf[pos++];
+		name_len = buf[pos++];
+		if (pos + name_len + 4*m->buckets > len)
+			return -1;
+		memcpy(m->name, buf + pos, name_len);
+		m->name[name_len] = 0;
+		pos += name_len;
+		for (j = 0; j < m->buckets; j++, pos += 4)
+			m->v[j] = get32(buf + pos);
+		if (s->count < MAX_METRICS)
+			s->count++;
+	}
+	return 0;
+}
+
+/* Looks for dumps in the data, returns the number of bytes used up */
+static size_t parse(const u_int8_t *buf, size_t len)
+{
+	struct metrics_dump_header hdr;
+	size_t pos = 0, dlen;
+
+	while (len - pos >= sizeof(hdr)) {
+		memcpy(&hdr, buf + pos, sizeof(hdr));
+		if (hdr.magic != METRICS_DUMP_MAGIC ||
+		    hdr.length > METRICS_DUMP_SIZE - sizeof(hdr)) {
+			pos++;
+			continue;
+		}
+		dlen = sizeof(hdr) + hdr.length;
+		if (len - pos < dlen)
+			break;
+		if (parse_dump(buf + pos, dlen) < 0) {
+			pos++;
+			continue;
+		}
+
+		dumps++;
+		print_diff(&snaps[cur], have_prev ? &snaps[cur ^ 1] : NULL);
+		have_prev = 1;
+		cur ^= 1;
+		pos += dlen;
+	}
+	return pos;
+}
+
+static u_int8_t buf[64 * 1024];
+static size_t buf_len;
+
+/* Returns the number of dumps found, -1 at the end of the input */
+static int feed(int fd)
+{
+	unsigned long before = dumps;
+	size_t used;
+	ssize_t ret;
+
+	ret = read(fd, buf + buf_len, sizeof(buf) - buf_len);
+	if (ret <= 0)
+		return ret < 0 && errno == EINTR ? 0 : -1;
+	buf_len += ret;
+	used = parse(buf, buf_len);
+	/* Text in between that will never be part of a dump */
+	if (!used && buf_len == sizeof(buf))
+		used = buf_len - sizeof(struct metrics_dump_header);
+	memmove(buf, buf + used, buf_len - used);
+	buf_len -= used;
+	return dumps - before;
+}
+
+static unsigned long long now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+static int poll_tty(int fd, unsigned int interval_ms, unsigned long count)
+{
+	struct termios tio;
+	unsigned long long next;
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	int ret;
+
+	if (tcgetattr(fd, &tio) < 0) {
+		perror("tcgetattr");
+		return -1;
+	}
+	cfmakeraw(&tio);
+	if (tcsetattr(fd, TCSANOW, &tio) < 0) {
+		perror("tcsetattr");
+		return -1;
+	}
+
+	next = now_ms();
+	while (!count || dumps < count) {
+		if (write(fd, "m\r", 2) != 2) {
+			perror("write");
+			return -1;
+		}
+		next += interval_ms;
+		/* Take everything until the next request is due */
+		while (now_ms() < next) {
+			ret = poll(&pfd, 1, next - now_ms());
+			if (ret < 0 && errno != EINTR) {
+				perror("poll");
+				return -1;
+			}
+			if (ret > 0 && feed(fd) < 0) {
+				fprintf(stderr, "device gone\n");
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+static void help(void)
+{
+	printf("metrics_poll [-i ms] [-n count] [-a] tty|file\n"
+	       "  -i  poll interval on a tty (default 1000)\n"
+	       "  -n  stop after count dumps\n"
+	       "  -a  show metrics that have not changed too\n");
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int interval_ms = 1000;
+	unsigned long count = 0;
+	int c, fd, ret = 0;
+
+	while ((c = getopt(argc, argv, "i:n:ah")) != -1) {
+		switch (c) {
+		case 'i':
+			interval_ms = atoi(optarg);
+			break;
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		case 'a':
+			show_all = 1;
+			break;
+		default:
+			help();
+			exit(c == 'h' ? 0 : 2);
+		}
+	}
+	if (optind != argc - 1 || interval_ms == 0) {
+		help();
+		exit(2);
+	}
+
+	fd = open(argv[optind], O_RDWR | O_NOCTTY);
+	if (fd < 0)
+		fd = open(argv[optind], O_RDONLY);
+	if (fd < 0) {
+		perror(argv[optind]);
+		exit(2);
+	}
+
+	if (isatty(fd))
+		ret = poll_tty(fd, interval_ms, count);
+	else
+		while (feed(fd) >= 0 && (!count || dumps < count))
+			;
+
+	close(fd);
+	return ret < 0 ? 2 : errors_seen;
+}
@@ -0,0 +1,220 @@
+/* opcd_sweep - run an RF parameter sweep on the OpenPCD
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 
+ *  as published by the Free Software Foundation
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Needs the main_reqa firmware.  Every -x option adds one axis to the
+ * grid; the result table is printed as CSV, one line per grid point.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <errno.h>
+
+#include <sys/types.h>
+
+#include <usb.h>
+
+#include <openpcd.h>
+#include "opcd_usb.h"
+
+static const struct {
+	const char *name;
+	u_int8_t param;
+} param_names[] = {
+	{ "cw",		0x12 },	/* CwConductance */
+	{ "mod",	0x13 },	/* ModConductance */
+	{ "phase",	0x1b },	/* BitPhase */
+	{ "thresh",	0x1c },	/* RxThreshold */
+	{ "rxspeed",	OPENPCD_SWEEP_P_SPEED_RX },
+	{ "txspeed",	OPENPCD_SWEEP_P_SPEED_TX },
+};
+
+static void print_help(void)
+{
+	printf( "\t-x\t--axis\t\tparam:first:last[:step]\n"
+		"\t\t\t\tparam is cw, mod, phase, thresh, rxspeed,\n"
+		"\t\t\t\ttxspeed or an RC632 register number\n"
+		"\t-n\t--iterations\tattempts per test and point\n"
+		"\t-t\t--tests\t\tany of r(eqa), a(nticol), x(transceive)\n"
+		"\t-f\t--frame\t\thex bytes for transceive (default 3000)\n");
+}
+
+static struct option opts[] = {
+	{ "axis", 1, 0, 'x' },
+	{ "iterations", 1, 0, 'n' },
+	{ "tests", 1, 0, 't' },
+	{ "frame", 1, 0, 'f' },
+	{ "help", 0, 0, 'h' },
+	{ 0, 0, 0, 0 }
+};
+
+static int parse_axis(const char *arg, struct openpcd_sweep_axis *ax)
+{
+	char name[16];
+	unsigned int first, last, step = 1;
+	unsigned int i;
+	int n;
+
+	n = sscanf(arg, "%15[^:]:%i:%i:%i", name, &first, &last, &step);
+	if (n < 3 || first > 0xff || last > 0xff || !step || step > 0xff)
+		return -EINVAL;
+
+	ax->param = 0xff;
+	for (i = 0; i < sizeof(param_names)/sizeof(param_names[0]); i++) {
+		if (!strcmp(name, param_names[i].name))
+			ax->param = param_names[i].param;
+	}
+	if (ax->param == 0xff) {
+		char *end;
+		unsigned long reg = strtoul(name, &end, 0);
+		if (*end || reg > OPENPCD_REG_MAX)
+			return -EINVAL;
+		ax->param = reg;
+	}
+
+	ax->first = first;
+	ax->last = last;
+	ax->step = step;
+
+	return 0;
+}
+
+static int parse_frame(const char *arg, struct openpcd_sweep_req *req)
+{
+	unsigned int byte;
+	int len = strlen(arg);
+
+	if (len % 2 || len / 2 > OPENPCD_SWEEP_FRAME_MAX)
+		return -EINVAL;
+
+	for (req->frame_len = 0; *arg; arg += 2) {
+		if (sscanf(arg, "%2x", &byte) != 1)
+			return -EINVAL;
+		req->frame[req->frame_len++] = byte;
+	}
+	return 0;
+}
+
+static void print_point(struct openpcd_sweep_req *req,
+			struct openpcd_sweep_point *pt)
+{
+	unsigned int idx = pt->index;
+	int a;
+
+	/* reconstruct parameter values, first axis varies fastest */
+	for (a = 0; a < req->num_axes; a++) {
+		struct openpcd_sweep_axis *ax = &req->axis[a];
+		unsigned int n = (ax->last - ax->first) / ax->step + 1;
+
+		printf("%u,", ax->first + (idx % n) * ax->step);
+		idx /= n;
+	}
+	printf("%u,%u,%u,%u,%u,%u\n",
+		pt->reqa.ok, pt->reqa.avg_us,
+		pt->anticol.ok, pt->anticol.avg_us,
+		pt->transceive.ok, pt->transceive.avg_us);
+}
+
+int main(int argc, char **argv)
+{
+	struct opcd_handle *od;
+	struct openpcd_sweep_req req;
+	static char buf[4096];
+	struct openpcd_hdr *hdr = (struct openpcd_hdr *) buf;
+	struct openpcd_sweep_point *pt;
+	unsigned int i;
+	int c, ret, a;
+
+	memset(&req, 0, sizeof(req));
+	req.iterations = 10;
+	req.tests = OPENPCD_SWEEP_T_REQA | OPENPCD_SWEEP_T_ANTICOL;
+	req.frame[0] = 0x30;	/* mifare READ block 0 */
+	req.frame[1] = 0x00;
+	req.frame_len = 2;
+
+	while ((c = getopt_long(argc, argv, "x:n:t:f:h", opts, NULL)) != -1) {
+		switch (c) {
+		case 'x':
+			if (req.num_axes >= OPENPCD_SWEEP_AXES_MAX ||
+			    parse_axis(optarg, &req.axis[req.num_axes]) < 0) {
+				fprintf(stderr, "invalid axis `%s'\n", optarg);
+				exit(2);
+			}
+			req.num_axes++;
+			break;
+		case 'n':
+			req.iterations = atoi(optarg);
+			break;
+		case 't':
+			req.tests = 0;
+			if (strchr(optarg, 'r'))
+				req.tests |= OPENPCD_SWEEP_T_REQA;
+			if (strchr(optarg, 'a'))
+				req.tests |= OPENPCD_SWEEP_T_ANTICOL;
+			if (strchr(optarg, 'x'))
+				req.tests |= OPENPCD_SWEEP_T_TRANSCEIVE;
+			break;
+		case 'f':
+			if (parse_frame(optarg, &req) < 0) {
+				fprintf(stderr, "invalid frame `%s'\n", optarg);
+				exit(2);
+			}
+			break;
+		case 'h':
+		default:
+			print_help();
+			exit(c == 'h' ? 0 : 2);
+		}
+	}
+
+	od = opcd_init(0);
+
+	opcd_send_command(od, OPENPCD_CMD_SWEEP_RUN, 0, 0, sizeof(req),
+			  (unsigned char *) &req);
+
+	for (a = 0; a < req.num_axes; a++)
+		printf("p%02x,", req.axis[a].param);
+	printf("reqa_ok,reqa_us,anticol_ok,anticol_us,xcv_ok,xcv_us\n");
+
+	while (1) {
+		ret = opcd_recv_reply(od, buf, sizeof(buf));
+		if (ret < (int) sizeof(*hdr))
+			exit(1);
+		if (hdr->cmd != OPENPCD_CMD_SWEEP_RUN)
+			continue;
+		if (hdr->reg == OPENPCD_SWEEP_R_DONE ||
+		    hdr->flags & OPENPCD_FLAG_ERROR)
+			break;
+
+		pt = (struct openpcd_sweep_point *) hdr->data;
+		for (i = 0; i < hdr->val; i++, pt++) {
+			if ((char *)(pt + 1) > buf + ret)
+				break;
+			print_point(&req, pt);
+		}
+		fflush(stdout);
+	}
+
+	if (hdr->flags & OPENPCD_FLAG_ERROR) {
+		fprintf(stderr, "sweep failed: error %u\n", hdr->val);
+		exit(1);
+	}
+
+	opcd_fini(od);
+	exit(0);
+}
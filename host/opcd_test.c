@@ -32,6 +32,7 @@
 
 #include <openpcd.h>
 #include "opcd_usb.h"
+#include "ssc_capture.h"
 
 static int get_number(const char *optarg, unsigned int min,
 		      unsigned int max, unsigned int *num)
@@ -50,6 +51,127 @@ static int get_number(const char *optarg, unsigned int min,
 	return 0;
 }
 
+static int get_hex(const char *str, unsigned char *out, unsigned int len)
+{
+	unsigned int i, byte;
+
+	if (strlen(str) != len * 2)
+		return -EINVAL;
+
+	for (i = 0; i < len; i++) {
+		if (sscanf(str + i*2, "%2x", &byte) != 1)
+			return -EINVAL;
+		out[i] = byte;
+	}
+	return 0;
+}
+
+static const char *mfcl_status_name(u_int8_t status)
+{
+	switch (status) {
+	case OPENPCD_MFCL_S_OK:
+		return "OK";
+	case OPENPCD_MFCL_S_AUTH:
+		return "AUTH";
+	case OPENPCD_MFCL_S_TIMEOUT:
+		return "TIMEOUT";
+	case OPENPCD_MFCL_S_READ:
+		return "READ";
+	}
+	return "?";
+}
+
+/* dump a range of mifare classic sectors in one USB round trip */
+static int mfcl_dump(struct opcd_handle *od, struct openpcd_mfcl_read_req *req)
+{
+	static char buf[4096];
+	struct openpcd_hdr *hdr = (struct openpcd_hdr *) buf;
+	struct openpcd_mfcl_read_rsp *rsp;
+	struct openpcd_mfcl_block *mb;
+	int ret, i;
+
+	opcd_send_command(od, OPENPCD_CMD_LRFID_MFCL_READ, 0, 0,
+			  sizeof(*req), (unsigned char *) req);
+
+	while (1) {
+		ret = opcd_recv_reply(od, buf, sizeof(buf));
+		if (ret < (int) sizeof(*hdr))
+			return -EIO;
+		if (hdr->cmd != OPENPCD_CMD_LRFID_MFCL_READ)
+			continue;
+
+		if (hdr->reg == OPENPCD_MFCL_R_DONE)
+			break;
+
+		mb = (struct openpcd_mfcl_block *) hdr->data;
+		for (i = 0; i < hdr->val; i++, mb++) {
+			if ((char *)(mb + 1) > buf + ret)
+				break;
+			printf("block %3u: %-7s %s\n", mb->block,
+				mfcl_status_name(mb->status),
+				mb->status == OPENPCD_MFCL_S_OK ?
+				opcd_hexdump(mb->data, sizeof(mb->data)) : "");
+		}
+	}
+
+	rsp = (struct openpcd_mfcl_read_rsp *) hdr->data;
+	if (ret < (int) (sizeof(*hdr) + sizeof(*rsp)))
+		return -EIO;
+	if (hdr->flags & OPENPCD_FLAG_ERROR)
+		fprintf(stderr, "MFCL_READ failed: error %u\n", rsp->error);
+	printf("UID %s: %u blocks, %u errors\n",
+		opcd_hexdump(rsp->uid, rsp->uid_len), rsp->num_blocks,
+		rsp->num_errors);
+
+	return rsp->error ? -EIO : 0;
+}
+
+/* print an SSC capture reply and append its samples to outfd (if >= 0).
+ * Buffers without modulation are not sent, they are written as idle
+ * words so the file stays a continuous sample stream. */
+static int ssc_dump(const char *buf, int len, int outfd)
+{
+	static u_int32_t samples[SSC_CAPTURE_WORDS_MAX];
+	static u_int32_t idle[SSC_CAPTURE_WORDS_MAX];
+	static u_int32_t next_seq;
+	static int have_seq;
+	struct openpcd_ssc_capture cap;
+	u_int32_t skipped;
+	int words;
+
+	words = ssc_capture_decode(buf, len, &cap, samples,
+				   SSC_CAPTURE_WORDS_MAX);
+	if (words < 0) {
+		fprintf(stderr, "malformed SSC capture %s\n",
+			opcd_hexdump(buf, len));
+		return -EINVAL;
+	}
+
+	skipped = have_seq ? cap.seq - next_seq : 0;
+	next_seq = cap.seq + 1;
+	have_seq = 1;
+
+	printf("SSC seq %u ts %u: %u words%s%s", cap.seq, cap.timestamp,
+	       words, cap.flags & OPENPCD_SSC_F_RLE ? ", rle" : "",
+	       cap.flags & OPENPCD_SSC_F_OVERRUN ? ", OVERRUN" : "");
+	if (skipped)
+		printf(", %u idle buffers before", skipped);
+	printf("\n%s\n", opcd_hexdump(samples, words * 4));
+
+	if (outfd < 0)
+		return 0;
+	/* seq starts over when the reader is reset */
+	if (skipped > 0x10000)
+		skipped = 0;
+	memset(idle, 0xff, sizeof(idle));
+	while (skipped--)
+		write(outfd, idle, words * 4);
+	write(outfd, samples, words * 4);
+	fsync(outfd);
+
+	return 0;
+}
+
 static void print_welcome(void)
 {
 	printf("opcd_test - OpenPCD Test and Debug Program\n"
@@ -68,6 +190,11 @@ static void print_help(void)
 		"\t-c\t--clear-bits\treg\tmask\n"
 
 		"\t-u\t--usb-perf\txfer_size\n"
+
+		"\t-S\t--ssc-read\n"
+		"\t-L\t--loop\t\tSSC samples to /tmp/opcd_samples\n"
+
+		"\t-m\t--mifare-dump\tfirst_sector last_sector [keyA] [uid]\n"
 		);
 }
 
@@ -86,6 +213,7 @@ static struct option opts[] = {
 	{ "ssc-read", 0, 0, 'S' },
 	{ "loop", 0, 0, 'L' },
 	{ "serial-number", 0, 0, 'n' },
+	{ "mifare-dump", 1, 0, 'm' },
 	{ "help", 0, 0, 'h'},
 };	
 
@@ -107,7 +235,7 @@ int main(int argc, char **argv)
 	while (1) {
 		int option_index = 0;
 
-		c = getopt_long(argc, argv, "l:r:w:R:W:s:c:h?u:aASLn", opts,
+		c = getopt_long(argc, argv, "l:r:w:R:W:s:c:h?u:aASLnm:", opts,
 				&option_index);
 
 		if (c == -1)
@@ -184,8 +312,9 @@ int main(int argc, char **argv)
 			break;
 		case 'S':
 			opcd_send_command(od, OPENPCD_CMD_SSC_READ, 0, 1, 0, NULL);
-			opcd_recv_reply(od, buf, buf_len);
-			/* FIXME: interpret and print SSC result */
+			retlen = opcd_recv_reply(od, buf, buf_len);
+			if (retlen > 0)
+				ssc_dump(buf, retlen, -1);
 			break;
 		case 'L':
 			outfd = open("/tmp/opcd_samples",
@@ -197,11 +326,12 @@ int main(int argc, char **argv)
 				retlen = opcd_recv_reply(od, buf, buf_len);
 				if (retlen < 0)
 					break;
-				printf("DATA: %s\n", opcd_hexdump(data, retlen-4));
-#if 1
-				write(outfd, data, retlen-4);
-				fsync(outfd);
-#endif
+				if (((struct openpcd_hdr *) buf)->cmd ==
+				    OPENPCD_CMD_SSC_READ)
+					ssc_dump(buf, retlen, outfd);
+				else
+					printf("DATA: %s\n",
+					       opcd_hexdump(data, retlen-4));
 			}
 			close(outfd);
 			break;
@@ -221,6 +351,37 @@ int main(int argc, char **argv)
 			} else
 				printf("ERROR: %d, %s\n", retlen, usb_strerror());
 			break;
+		case 'm': {
+			struct openpcd_mfcl_read_req req;
+
+			memset(&req, 0, sizeof(req));
+			memset(req.key, 0xff, sizeof(req.key));
+			req.key_type = OPENPCD_MFCL_KEY_A;
+			if (get_number(optarg, 0, 39, &i) < 0)
+				exit(2);
+			req.sector_first = i;
+			if (optind >= argc ||
+			    get_number(argv[optind++], i, 39, &j) < 0)
+				exit(2);
+			req.sector_last = j;
+			if (optind < argc && argv[optind][0] != '-' &&
+			    get_hex(argv[optind++], req.key, 6) < 0) {
+				fprintf(stderr, "key must be 12 hex digits\n");
+				exit(2);
+			}
+			if (optind < argc && argv[optind][0] != '-') {
+				req.uid_len = strlen(argv[optind]) / 2;
+				if (req.uid_len > sizeof(req.uid) ||
+				    get_hex(argv[optind++], req.uid,
+					    req.uid_len) < 0) {
+					fprintf(stderr, "invalid UID\n");
+					exit(2);
+				}
+			}
+			if (mfcl_dump(od, &req) < 0)
+				exit(1);
+			}
+			break;
 		default:
 			fprintf(stderr, "unknown key `%c'\n", c);
 			print_help();
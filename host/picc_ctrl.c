@@ -0,0 +1,458 @@
+/* picc_ctrl - read and change the OpenPICC settings over the binary
+ * control channel
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * All operations given on the command line go to the firmware as one
+ * request (see openpicc/application/ctrl_proto.h) and are answered in
+ * one response, e.g.
+ *
+ *	picc_ctrl /dev/ttyACM0 set uid 01020304 add fdt_offset -4 get pll_locked
+ *	picc_ctrl /dev/ttyACM0 list
+ *
+ * The names and types of the parameters are asked from the firmware
+ * first. An answer that does not fit into one response is picked up with
+ * another request. With -b the operations are sent that many times and
+ * the round trips per second are shown.
+ *
+ * The exit status is 1 if an operation failed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include "../openpicc/application/ctrl_proto.h"
+
+#define TIMEOUT_MS	1000
+#define MAX_OPS		64
+#define MAX_VALUE	32
+
+struct op {
+	u_int8_t op, param, len;
+	u_int8_t value[MAX_VALUE];
+	/* from the response */
+	int done;
+	u_int8_t status, result_len;
+	u_int8_t result[MAX_VALUE];
+};
+
+struct param {
+	char name[MAX_VALUE];
+	u_int8_t type, size, flags;
+};
+
+static struct param params[_MAX_CTRL_PARAM];
+static unsigned int num_params;
+static int fd;
+static u_int8_t seq;
+
+static unsigned long long now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+static u_int16_t checksum(const u_int8_t *data, unsigned int len)
+{
+	u_int16_t sum = 0;
+
+	while (len--)
+		sum += *data++;
+	return sum;
+}
+
+static u_int8_t rx[4096];
+static size_t rx_len;
+
+/* Waits for the response to seq, skipping the console output around it.
+ * Returns the payload length or -1. */
+static int recv_response(struct ctrl_header *hdr, u_int8_t *payload)
+{
+	unsigned long long end = now_ms() + TIMEOUT_MS;
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	size_t pos;
+	ssize_t ret;
+
+	for (;;) {
+		for (pos = 0; pos + sizeof(*hdr) <= rx_len; pos++) {
+			if (rx[pos] != CTRL_SYNC_RESPONSE)
+				continue;
+			memcpy(hdr, rx + pos, sizeof(*hdr));
+			if (hdr->seq != seq || hdr->length > CTRL_MAX_PAYLOAD)
+				continue;
+			if (rx_len - pos < sizeof(*hdr) + hdr->length)
+				break;
+			if (checksum(rx + pos + sizeof(*hdr), hdr->length) != hdr->sum)
+				continue;
+			memcpy(payload, rx + pos + sizeof(*hdr), hdr->length);
+			pos += sizeof(*hdr) + hdr->length;
+			memmove(rx, rx + pos, rx_len - pos);
+			rx_len -= pos;
+			return hdr->length;
+		}
+		/* Keep what might still become a response */
+		if (pos) {
+			memmove(rx, rx + pos, rx_len - pos);
+			rx_len -= pos;
+		}
+		if (rx_len == sizeof(rx))
+			rx_len = 0;
+
+		if (now_ms() >= end)
+			return -1;
+		ret = poll(&pfd, 1, end - now_ms());
+		if (ret < 0 && errno != EINTR) {
+			perror("poll");
+			return -1;
+		}
+		if (ret <= 0)
+			continue;
+		ret = read(fd, rx + rx_len, sizeof(rx) - rx_len);
+		if (ret <= 0) {
+			fprintf(stderr, "device gone\n");
+			return -1;
+		}
+		rx_len += ret;
+	}
+}
+
+/* Sends as many of the operations from first on as fit into one request
+ * and fills in their results. Returns the number of operations answered,
+ * which is less than were sent if the response ran out of space, or -1. */
+static int transact(struct op *ops, unsigned int first, unsigned int count)
+{
+	struct {
+		struct ctrl_header hdr;
+		u_int8_t payload[CTRL_MAX_PAYLOAD];
+	} __attribute__ ((packed)) req;
+	struct ctrl_header hdr;
+	u_int8_t payload[CTRL_MAX_PAYLOAD];
+	struct ctrl_result res;
+	struct op *o;
+	unsigned int len = 0, n, i;
+	int ret;
+
+	for (n = 0; first + n < count; n++) {
+		o = &ops[first + n];
+		if (len + sizeof(struct ctrl_op) + o->len > CTRL_MAX_PAYLOAD ||
+		    n == 255)
+			break;
+		req.payload[len++] = o->op;
+		req.payload[len++] = o->param;
+		req.payload[len++] = o->len;
+		memcpy(req.payload + len, o->value, o->len);
+		len += o->len;
+	}
+
+	seq++;
+	req.hdr.sync = CTRL_SYNC_REQUEST;
+	req.hdr.seq = seq;
+	req.hdr.length = len;
+	req.hdr.sum = checksum(req.payload, len);
+	req.hdr.status = 0;
+	req.hdr.count = n;
+	if (write(fd, &req, sizeof(req.hdr) + len) != (ssize_t)(sizeof(req.hdr) + len)) {
+		perror("write");
+		return -1;
+	}
+
+	if ((ret = recv_response(&hdr, payload)) < 0) {
+		fprintf(stderr, "no response\n");
+		return -1;
+	}
+	if (hdr.status) {
+		fprintf(stderr, "request refused: %s\n", strerror(hdr.status));
+		return -1;
+	}
+
+	len = 0;
+	for (i = 0; i < hdr.count && i < n; i++) {
+		if (len + sizeof(res) > (unsigned int)ret)
+			break;
+		memcpy(&res, payload + len, sizeof(res));
+		len += sizeof(res);
+		if (len + res.len > (unsigned int)ret || res.len > MAX_VALUE)
+			break;
+		o = &ops[first + i];
+		/* Not executed, has to go again */
+		if (res.status == ENOSPC)
+			break;
+		o->done = 1;
+		o->status = res.status;
+		o->result_len = res.len;
+		memcpy(o->result, payload + len, res.len);
+		len += res.len;
+	}
+	if (i == 0) {
+		fprintf(stderr, "empty response\n");
+		return -1;
+	}
+	return i;
+}
+
+static int run(struct op *ops, unsigned int count)
+{
+	unsigned int done = 0;
+	int ret;
+
+	while (done < count) {
+		if ((ret = transact(ops, done, count)) < 0)
+			return -1;
+		done += ret;
+	}
+	return 0;
+}
+
+/* Asks for the names and types of all parameters */
+static int get_params(void)
+{
+	struct op ops[_MAX_CTRL_PARAM];
+	struct ctrl_info info;
+	unsigned int i, len;
+
+	memset(ops, 0, sizeof(ops));
+	for (i = 0; i < _MAX_CTRL_PARAM; i++) {
+		ops[i].op = CTRL_OP_INFO;
+		ops[i].param = i;
+	}
+	if (run(ops, _MAX_CTRL_PARAM) < 0)
+		return -1;
+
+	for (i = 0; i < _MAX_CTRL_PARAM; i++) {
+		/* Older firmware with fewer parameters */
+		if (ops[i].status || ops[i].result_len < sizeof(info))
+			break;
+		memcpy(&info, ops[i].result, sizeof(info));
+		params[i].type = info.type;
+		params[i].size = info.size;
+		params[i].flags = info.flags;
+		len = ops[i].result_len - sizeof(info);
+		memcpy(params[i].name, ops[i].result + sizeof(info), len);
+		params[i].name[len < MAX_VALUE ? len : MAX_VALUE - 1] = 0;
+	}
+	num_params = i;
+	return 0;
+}
+
+static int find_param(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < num_params; i++)
+		if (!strcmp(params[i].name, name))
+			return i;
+	fprintf(stderr, "unknown parameter %s, see list\n", name);
+	return -1;
+}
+
+static int parse_value(const struct param *p, const char *s, u_int8_t *value)
+{
+	unsigned int i;
+	unsigned long u;
+	long l;
+	char *end;
+
+	switch (p->type) {
+	case CTRL_T_BYTES:
+		if (strlen(s) != 2 * p->size)
+			break;
+		for (i = 0; i < p->size; i++) {
+			if (sscanf(s + 2 * i, "%2lx", &u) != 1)
+				return -1;
+			value[i] = u;
+		}
+		return p->size;
+	case CTRL_T_S32:
+		l = strtol(s, &end, 0);
+		if (*end)
+			break;
+		u = l;
+		goto little_endian;
+	default:
+		u = strtoul(s, &end, 0);
+		if (*end || (p->size < 4 && u >> (8 * p->size)))
+			break;
+	little_endian:
+		for (i = 0; i < p->size; i++)
+			value[i] = u >> (8 * i);
+		return p->size;
+	}
+	fprintf(stderr, "bad value %s for %s\n", s, p->name);
+	return -1;
+}
+
+static void print_value(const struct param *p, const u_int8_t *value, unsigned int len)
+{
+	u_int32_t u = 0;
+	unsigned int i;
+
+	if (p->type == CTRL_T_BYTES || len > 4) {
+		for (i = 0; i < len; i++)
+			printf("%02x", value[i]);
+		return;
+	}
+	for (i = 0; i < len; i++)
+		u |= (u_int32_t)value[i] << (8 * i);
+	if (p->type == CTRL_T_S32)
+		printf("%d", (int)u);
+	else
+		printf("%u", u);
+}
+
+static const char *type_names[] = { "u8", "u16", "u32", "s32", "bytes" };
+static const char *op_names[] = { "", "get", "set", "add", "info" };
+
+static void list(void)
+{
+	unsigned int i;
+
+	printf("%-16s %-6s %4s %s\n", "parameter", "type", "size", "access");
+	for (i = 0; i < num_params; i++)
+		printf("%-16s %-6s %4u %s%s\n", params[i].name,
+		       params[i].type < 5 ? type_names[params[i].type] : "?",
+		       params[i].size,
+		       params[i].flags & CTRL_F_READ ? "r" : "-",
+		       params[i].flags & CTRL_F_WRITE ? "w" : "-");
+}
+
+static void help(void)
+{
+	printf("picc_ctrl [-b rounds] tty operation...\n"
+	       "  list                   show the parameters\n"
+	       "  get name\n"
+	       "  set name value         bytes in hex, numbers as in C\n"
+	       "  add name delta\n"
+	       "  -b  send the operations rounds times and time it\n");
+}
+
+static struct op ops[MAX_OPS];
+
+int main(int argc, char **argv)
+{
+	struct termios tio;
+	unsigned long rounds = 0, r;
+	unsigned long long start;
+	unsigned int count = 0, i;
+	int c, p, do_list = 0, failed = 0;
+	long delta;
+	struct op *o;
+
+	while ((c = getopt(argc, argv, "+b:h")) != -1) {
+		switch (c) {
+		case 'b':
+			rounds = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			help();
+			exit(c == 'h' ? 0 : 2);
+		}
+	}
+	if (optind >= argc) {
+		help();
+		exit(2);
+	}
+
+	fd = open(argv[optind], O_RDWR | O_NOCTTY);
+	if (fd < 0) {
+		perror(argv[optind]);
+		exit(2);
+	}
+	if (tcgetattr(fd, &tio) == 0) {
+		cfmakeraw(&tio);
+		tcsetattr(fd, TCSANOW, &tio);
+	}
+	if (get_params() < 0)
+		exit(2);
+
+	for (i = optind + 1; i < (unsigned int)argc; ) {
+		if (!strcmp(argv[i], "list")) {
+			do_list = 1;
+			i++;
+			continue;
+		}
+		if (count == MAX_OPS) {
+			fprintf(stderr, "too many operations\n");
+			exit(2);
+		}
+		o = &ops[count];
+		if (!strcmp(argv[i], "get"))
+			o->op = CTRL_OP_GET;
+		else if (!strcmp(argv[i], "set"))
+			o->op = CTRL_OP_SET;
+		else if (!strcmp(argv[i], "add"))
+			o->op = CTRL_OP_ADD;
+		else {
+			help();
+			exit(2);
+		}
+		if (i + 1 >= (unsigned int)argc || (o->op != CTRL_OP_GET && i + 2 >= (unsigned int)argc)) {
+			help();
+			exit(2);
+		}
+		if ((p = find_param(argv[i + 1])) < 0)
+			exit(2);
+		o->param = p;
+		if (o->op == CTRL_OP_SET) {
+			if ((c = parse_value(&params[p], argv[i + 2], o->value)) < 0)
+				exit(2);
+			o->len = c;
+		} else if (o->op == CTRL_OP_ADD) {
+			delta = strtol(argv[i + 2], NULL, 0);
+			for (c = 0; c < 4; c++)
+				o->value[c] = (u_int32_t)delta >> (8 * c);
+			o->len = 4;
+		}
+		i += o->op == CTRL_OP_GET ? 2 : 3;
+		count++;
+	}
+
+	if (do_list)
+		list();
+	if (!count)
+		return 0;
+
+	if (run(ops, count) < 0)
+		exit(2);
+	for (i = 0; i < count; i++) {
+		o = &ops[i];
+		printf("%s %-16s ", op_names[o->op], params[o->param].name);
+		if (o->status) {
+			printf("failed: %s\n", strerror(o->status));
+			failed = 1;
+			continue;
+		}
+		print_value(&params[o->param], o->result, o->result_len);
+		printf("\n");
+	}
+
+	if (rounds) {
+		start = now_ms();
+		for (r = 0; r < rounds; r++)
+			if (run(ops, count) < 0)
+				exit(2);
+		start = now_ms() - start;
+		printf("%lu rounds of %u operations in %llu ms, %.1f round trips/s\n",
+		       rounds, count, start, start ? 1e3 * rounds / start : 0);
+	}
+	return failed;
+}
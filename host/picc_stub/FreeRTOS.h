@@ -0,0 +1,15 @@
+/* Minimal FreeRTOS.h for building OpenPICC decoders on the host */
+#ifndef INC_FREERTOS_H
+#define INC_FREERTOS_H
+
+#define __ramfunc
+
+#define portCHAR char
+#define portLONG long
+typedef long portBASE_TYPE;
+typedef unsigned long portTickType;
+
+#define portSET_INTERRUPT_MASK_FROM_ISR()	0
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR(x)	((void)(x))
+
+#endif
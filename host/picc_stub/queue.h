@@ -0,0 +1,7 @@
+/* Minimal queue.h for building OpenPICC decoders on the host */
+#ifndef QUEUE_H
+#define QUEUE_H
+
+typedef void *xQueueHandle;
+
+#endif
@@ -0,0 +1,149 @@
+/* simtrace2pcap - decode SIMtrace captures into GSMTAP pcap/pcapng
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Reads a usbmon capture of the SIMtrace bulk IN endpoint, puts the
+ * ATRs and APDUs back together (see simtrace_apdu.c) and writes them
+ * as GSMTAP SIM packets, which Wireshark decodes.  Recorded captures
+ * are read as fast as the disk goes, live ones come through a pipe:
+ *
+ *	tcpdump -i usbmon1 -U -w - | simtrace2pcap -U | wireshark -k -i -
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+
+#include "simtrace_apdu.h"
+
+static struct st_pcap pcap;
+static int verbose, unbuffered;
+
+static void print_msg(const struct st_msg *msg)
+{
+	static const char * const type_names[] = {
+		[ST_MSG_ATR] = "ATR ", [ST_MSG_APDU] = "APDU", [ST_MSG_GARBAGE] = "??? ",
+	};
+	unsigned int i;
+
+	fprintf(stderr, "%llu.%06llu %s",
+		(unsigned long long) (msg->ts_ns / 1000000000ULL),
+		(unsigned long long) (msg->ts_ns % 1000000000ULL / 1000),
+		type_names[msg->type]);
+	for (i = 0; i < msg->len; i++)
+		fprintf(stderr, " %02x", msg->data[i]);
+	if (msg->flags & ST_F_TRUNCATED)
+		fprintf(stderr, "  (truncated)");
+	if (msg->flags & ST_F_MERGED)
+		fprintf(stderr, "  (GET RESPONSE)");
+	if (msg->flags & ST_F_EDC_ERROR)
+		fprintf(stderr, "  (LRC error)");
+	if (msg->flags & ST_F_PPS)
+		fprintf(stderr, "  (PPS Fi %u Di %u)", msg->fi, msg->di);
+	fprintf(stderr, "\n");
+}
+
+static void msg_cb(const struct st_msg *msg, void *priv)
+{
+	st_pcap_write(&pcap, msg);
+	if (unbuffered)
+		fflush(pcap.f);
+	if (verbose)
+		print_msg(msg);
+}
+
+static void help(void)
+{
+	printf("simtrace2pcap [-i input] [-w output] [-n] [-d devnum] [-t 0|1] [-U] [-v]\n"
+	       "  -i  usbmon pcap capture (default stdin)\n"
+	       "  -w  file to write (default stdout)\n"
+	       "  -n  write pcapng instead of pcap\n"
+	       "  -d  only this USB device number\n"
+	       "  -t  assume this protocol instead of the one in the ATR\n"
+	       "  -U  write every packet out at once, for live captures\n"
+	       "  -v  print the ATRs and APDUs to stderr\n");
+}
+
+int main(int argc, char **argv)
+{
+	static struct st_reasm r;
+	FILE *in = stdin, *out = stdout;
+	int c, pcapng = 0, devnum = 0, ret;
+
+	st_reasm_init(&r, msg_cb, NULL);
+
+	while ((c = getopt(argc, argv, "i:w:nd:t:Uvh")) != -1) {
+		switch (c) {
+		case 'i':
+			in = fopen(optarg, "rb");
+			if (!in) {
+				perror(optarg);
+				exit(1);
+			}
+			break;
+		case 'w':
+			out = fopen(optarg, "wb");
+			if (!out) {
+				perror(optarg);
+				exit(1);
+			}
+			break;
+		case 'n':
+			pcapng = 1;
+			break;
+		case 'd':
+			devnum = atoi(optarg);
+			break;
+		case 't':
+			r.force_protocol = atoi(optarg);
+			if (r.force_protocol != 0 && r.force_protocol != 1) {
+				help();
+				exit(2);
+			}
+			break;
+		case 'U':
+			unbuffered = 1;
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			help();
+			exit(c == 'h' ? 0 : 2);
+		}
+	}
+
+	/* large buffers, a recorded capture is read in big chunks */
+	setvbuf(in, NULL, _IOFBF, 1 << 20);
+	if (!unbuffered)
+		setvbuf(out, NULL, _IOFBF, 1 << 20);
+
+	st_pcap_open(&pcap, out, pcapng);
+	ret = st_usbmon_read(in, devnum, st_reasm_transfer_cb, &r);
+	if (ret < 0)
+		perror("reading the capture");
+	st_reasm_flush(&r);
+	fclose(out);
+
+	fprintf(stderr, "%lu transfers, %lu bytes: %lu ATRs, %lu APDUs "
+		"(%lu with GET RESPONSE, %lu truncated, %lu LRC errors), "
+		"%lu bytes not decoded\n",
+		r.stats.transfers, r.stats.bytes, r.stats.atrs, r.stats.apdus,
+		r.stats.merged, r.stats.truncated, r.stats.edc_errors,
+		r.stats.garbage);
+	return ret < 0;
+}
@@ -0,0 +1,815 @@
+/* simtrace_apdu - turn the SIMtrace data stream back into ISO 7816-3
+ * ATRs and APDUs, read it from usbmon captures and write GSMTAP
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * The firmware sends every byte it sees on the I/O line in
+ * SIMTRACE_MSGT_DATA transfers, both directions mixed, PPS bytes
+ * left out.  A transfer ends early at the end of the ATR (with
+ * SIMTRACE_FLAG_ATR) and when the waiting time expired (with
+ * SIMTRACE_FLAG_WTIME_EXP), otherwise transfer boundaries mean
+ * nothing.  The protocol is the first one offered in the ATR: the
+ * PPS is not passed on, only the Fi/Di it set.
+ *
+ * T=0 TPDUs are followed through the procedure bytes, NULLs and
+ * procedure bytes are dropped.  A command answered with 61xx or 9Fxx
+ * is held back until the GET RESPONSE, whose data and status words
+ * are appended to it.  T=1 blocks alternate between the reader and
+ * the card starting after the ATR, the I-blocks of a chain are put
+ * together and the command and response are written in the layout
+ * of a T=0 TPDU, so that both end up as
+ *
+ *	CLA INS P1 P2 P3 [command data] [response data] SW1 SW2
+ *
+ * which is what the Wireshark GSM SIM dissector takes.  When a
+ * byte does not fit, the TPDU is passed on as truncated and the
+ * reassembler looks for the next header; waiting time expiry and
+ * the next ATR resynchronise as well.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+
+#include <simtrace_usb.h>
+
+#include "simtrace_apdu.h"
+
+#define INS_GET_RESPONSE	0xc0
+
+/* usbmon, see Documentation/usb/usbmon.txt */
+#define LINKTYPE_USB_LINUX		189
+#define LINKTYPE_USB_LINUX_MMAPPED	220
+#define USBMON_HDR_LEN			48
+#define USBMON_HDR_LEN_MMAPPED		64
+#define USBMON_COMPLETE			'C'
+#define USBMON_BULK			3
+#define SIMTRACE_IN_EP			0x82
+
+struct usbmon_hdr {
+	u_int64_t id;
+	u_int8_t type;
+	u_int8_t xfer_type;
+	u_int8_t epnum;
+	u_int8_t devnum;
+	u_int16_t busnum;
+	int8_t flag_setup;
+	int8_t flag_data;		/* 0 if there is data */
+	int64_t ts_sec;
+	int32_t ts_usec;
+	int32_t status;
+	u_int32_t length;
+	u_int32_t len_cap;
+} __attribute__ ((packed));
+
+#define PCAP_MAGIC_US		0xa1b2c3d4
+#define PCAP_MAGIC_NS		0xa1b23c4d
+#define LINKTYPE_IPV4		228
+
+#define PCAPNG_SHB		0x0a0d0d0a
+#define PCAPNG_IDB		0x00000001
+#define PCAPNG_EPB		0x00000006
+#define PCAPNG_OPT_END		0
+#define PCAPNG_OPT_COMMENT	1
+#define PCAPNG_IF_TSRESOL	9
+
+#define GSMTAP_VERSION		2
+#define GSMTAP_TYPE_SIM		4
+#define GSMTAP_SIM_APDU		0
+#define GSMTAP_SIM_ATR		1
+#define GSMTAP_UDP_PORT		4729
+#define GSMTAP_HDR_LEN		16
+#define IP_UDP_HDR_LEN		28
+
+/* Instructions whose data comes from the card (GSM 11.11, TS 102 221),
+ * P3 = 0 asks for 256 bytes */
+static int ins_outgoing(u_int8_t ins)
+{
+	switch (ins) {
+	case 0xb0:	/* READ BINARY */
+	case 0xb2:	/* READ RECORD */
+	case 0xc0:	/* GET RESPONSE */
+	case 0xf2:	/* STATUS */
+	case 0x84:	/* GET CHALLENGE */
+	case 0xca:	/* GET DATA */
+	case 0x12:	/* FETCH */
+		return 1;
+	}
+	return 0;
+}
+
+static int is_sw1(u_int8_t b)
+{
+	return (b & 0xf0) == 0x90 || ((b & 0xf0) == 0x60 && b != 0x60);
+}
+
+/* Length of the ATR at the start of atr if all of it is there, 0 if more
+ * bytes are needed, -1 if it is not an ATR */
+static int atr_parse(const u_int8_t *atr, unsigned int len, int *protocol,
+		     int *t1_crc)
+{
+	unsigned int pos = 2, y, group = 1, hist, t1_group = 0;
+	int tck = 0;
+
+	if (len < 1)
+		return 0;
+	if (atr[0] != 0x3b && atr[0] != 0x3f)
+		return -1;
+	if (len < 2)
+		return 0;
+
+	*protocol = 0;
+	*t1_crc = 0;
+	y = atr[1] >> 4;
+	hist = atr[1] & 0x0f;
+	while (y) {
+		if (y & 0x1)		/* TA */
+			pos++;
+		if (y & 0x2)		/* TB */
+			pos++;
+		if (y & 0x4) {		/* TC */
+			if (pos >= len)
+				return 0;
+			if (group == t1_group)
+				*t1_crc = atr[pos] & 1;
+			pos++;
+		}
+		if (!(y & 0x8))
+			break;
+		if (pos >= len)		/* TD */
+			return 0;
+		y = atr[pos] >> 4;
+		if ((atr[pos] & 0x0f) != 0)
+			tck = 1;
+		if (group == 1)
+			*protocol = atr[pos] & 0x0f;
+		else if ((atr[pos] & 0x0f) == 1 && !t1_group)
+			t1_group = group + 1;
+		group++;
+		pos++;
+		if (pos > ST_MAX_ATR)
+			return -1;
+	}
+
+	pos += hist + tck;
+	if (pos > ST_MAX_ATR)
+		return -1;
+	return pos <= len ? (int) pos : 0;
+}
+
+static void emit(struct st_reasm *r, enum st_msg_type type, const u_int8_t *data,
+		 unsigned int len, unsigned int flags, u_int64_t ts_ns)
+{
+	struct st_msg msg;
+
+	msg.type = type;
+	msg.flags = flags | r->flags;
+	msg.ts_ns = ts_ns;
+	msg.fi = r->fi;
+	msg.di = r->di;
+	msg.data = data;
+	msg.len = len;
+	r->flags = 0;
+
+	switch (type) {
+	case ST_MSG_ATR:
+		r->stats.atrs++;
+		break;
+	case ST_MSG_APDU:
+		r->stats.apdus++;
+		if (msg.flags & ST_F_MERGED)
+			r->stats.merged++;
+		if (msg.flags & ST_F_TRUNCATED)
+			r->stats.truncated++;
+		if (msg.flags & ST_F_EDC_ERROR)
+			r->stats.edc_errors++;
+		break;
+	case ST_MSG_GARBAGE:
+		r->stats.garbage += len;
+		break;
+	}
+	r->cb(&msg, r->priv);
+}
+
+static void flush_pending(struct st_reasm *r)
+{
+	if (!r->pending_len)
+		return;
+	emit(r, ST_MSG_APDU, r->pending, r->pending_len, r->pending_flags,
+	     r->pending_ts_ns);
+	r->pending_len = 0;
+}
+
+static void t1_start(struct st_reasm *r)
+{
+	r->state = ST_S_T1_PROLOGUE;
+	r->block_len = 0;
+	r->t1_card = 0;
+	r->t1_cmd_done = 0;
+	r->cmd_len = 0;
+	r->rsp_len = 0;
+}
+
+static void protocol_start(struct st_reasm *r)
+{
+	if (r->protocol == 1) {
+		t1_start(r);
+	} else {
+		r->state = ST_S_T0_HDR;
+		r->apdu_len = 0;
+	}
+}
+
+/* Passes on the command and response of T=1 in the layout of a T=0 TPDU */
+static void t1_apdu(struct st_reasm *r, unsigned int flags)
+{
+	unsigned int lc = 0, len;
+
+	if (!r->cmd_len && !r->rsp_len)
+		return;
+
+	if (r->cmd_len < 4 || (r->cmd_len > 5 && 5U + r->cmd[4] > r->cmd_len) ||
+	    (r->cmd_len > 5 && r->cmd[4] == 0)) {
+		/* not a short APDU, pass it on as it is */
+		memcpy(r->apdu, r->cmd, r->cmd_len);
+		len = r->cmd_len;
+	} else {
+		memcpy(r->apdu, r->cmd, 4);
+		if (r->cmd_len == 4) {
+			r->apdu[4] = 0;
+		} else if (r->cmd_len == 5) {
+			r->apdu[4] = r->cmd[4];		/* Le */
+		} else {
+			lc = r->cmd[4];
+			r->apdu[4] = lc;
+			memcpy(r->apdu + 5, r->cmd + 5, lc);
+		}
+		len = 5 + lc;
+	}
+	if (len + r->rsp_len > ST_MAX_APDU) {
+		r->rsp_len = ST_MAX_APDU - len;
+		flags |= ST_F_TRUNCATED;
+	}
+	memcpy(r->apdu + len, r->rsp, r->rsp_len);
+	len += r->rsp_len;
+
+	emit(r, ST_MSG_APDU, r->apdu, len, flags | ST_F_T1, r->ts_ns);
+	r->cmd_len = 0;
+	r->rsp_len = 0;
+	r->t1_cmd_done = 0;
+}
+
+static void t1_append(u_int8_t *buf, unsigned int *len, const u_int8_t *data,
+		      unsigned int n, unsigned int *flags)
+{
+	if (*len + n > ST_MAX_APDU) {
+		n = ST_MAX_APDU - *len;
+		*flags |= ST_F_TRUNCATED;
+	}
+	memcpy(buf + *len, data, n);
+	*len += n;
+}
+
+static void t1_block(struct st_reasm *r)
+{
+	const u_int8_t *b = r->block;
+	u_int8_t pcb = b[1], lrc = 0;
+	unsigned int i;
+	int card = r->t1_card;
+
+	/* the CRC is left unchecked */
+	if (!r->t1_crc) {
+		for (i = 0; i < r->block_len; i++)
+			lrc ^= b[i];
+		if (lrc)
+			r->flags |= ST_F_EDC_ERROR;
+	}
+
+	r->t1_card = !card;
+	r->block_len = 0;
+
+	/* R- and S-blocks carry nothing of the APDU */
+	if (pcb & 0x80)
+		return;
+
+	if (!card) {
+		if (r->t1_cmd_done) {
+			/* a new command without a response to the last */
+			t1_apdu(r, ST_F_TRUNCATED);
+		}
+		t1_append(r->cmd, &r->cmd_len, b + 3, b[2], &r->flags);
+		r->t1_cmd_done = !(pcb & 0x20);
+	} else {
+		t1_append(r->rsp, &r->rsp_len, b + 3, b[2], &r->flags);
+		if (!(pcb & 0x20))
+			t1_apdu(r, 0);
+	}
+}
+
+static void t0_hdr_done(struct st_reasm *r)
+{
+	u_int8_t ins = r->apdu[1];
+
+	if (is_sw1(ins)) {
+		/* Not a header, we lost track. Slide over the bytes. */
+		emit(r, ST_MSG_GARBAGE, r->apdu, 1, 0, r->ts_ns);
+		memmove(r->apdu, r->apdu + 1, --r->apdu_len);
+		return;
+	}
+	if (ins != INS_GET_RESPONSE)
+		flush_pending(r);
+
+	r->t0_outgoing = ins_outgoing(ins);
+	r->t0_left = r->apdu[4];
+	if (!r->t0_left && r->t0_outgoing)
+		r->t0_left = 256;
+	r->state = ST_S_T0_PROC;
+}
+
+static void t0_done(struct st_reasm *r)
+{
+	u_int8_t sw1 = r->apdu[r->apdu_len - 2];
+	unsigned int data = r->apdu_len - 7;
+	int more = sw1 == 0x61 || sw1 == 0x9f;
+
+	r->state = ST_S_T0_HDR;
+
+	if (r->pending_len && r->apdu[1] == INS_GET_RESPONSE &&
+	    r->pending_len + data <= ST_MAX_APDU) {
+		/* replace the status words of the command with the data
+		 * and status words of the GET RESPONSE */
+		r->pending_len -= 2;
+		memcpy(r->pending + r->pending_len, r->apdu + 5, data + 2);
+		r->pending_len += data + 2;
+		r->pending_flags |= ST_F_MERGED | r->flags;
+		r->pending_ts_ns = r->ts_ns;
+		r->flags = 0;
+		r->apdu_len = 0;
+		if (!more)
+			flush_pending(r);
+		return;
+	}
+	flush_pending(r);
+
+	if (more && r->apdu[1] != INS_GET_RESPONSE) {
+		memcpy(r->pending, r->apdu, r->apdu_len);
+		r->pending_len = r->apdu_len;
+		r->pending_flags = r->flags;
+		r->pending_ts_ns = r->ts_ns;
+		r->flags = 0;
+	} else {
+		emit(r, ST_MSG_APDU, r->apdu, r->apdu_len, 0, r->ts_ns);
+	}
+	r->apdu_len = 0;
+}
+
+/* Passes on whatever is half done, as truncated */
+static void abort_msg(struct st_reasm *r)
+{
+	switch (r->state) {
+	case ST_S_WAIT_ATR:
+		break;
+	case ST_S_ATR:
+		emit(r, ST_MSG_GARBAGE, r->atr, r->atr_len, 0, r->ts_ns);
+		r->state = ST_S_WAIT_ATR;
+		break;
+	case ST_S_T0_HDR:
+		if (r->apdu_len)
+			emit(r, ST_MSG_GARBAGE, r->apdu, r->apdu_len, 0, r->ts_ns);
+		r->apdu_len = 0;
+		flush_pending(r);
+		break;
+	case ST_S_T0_PROC:
+	case ST_S_T0_DATA:
+	case ST_S_T0_DATA1:
+	case ST_S_T0_SW2:
+		flush_pending(r);
+		emit(r, ST_MSG_APDU, r->apdu, r->apdu_len, ST_F_TRUNCATED,
+		     r->ts_ns);
+		r->apdu_len = 0;
+		r->state = ST_S_T0_HDR;
+		break;
+	case ST_S_T1_PROLOGUE:
+	case ST_S_T1_INF:
+		if (r->block_len) {
+			/* the reader speaks first after the time out */
+			emit(r, ST_MSG_GARBAGE, r->block, r->block_len, 0,
+			     r->ts_ns);
+			t1_apdu(r, ST_F_TRUNCATED);
+			t1_start(r);
+		} else if (!r->t1_cmd_done) {
+			/* only a card working on a command stays silent that
+			 * long, otherwise the reader is next */
+			r->t1_card = 0;
+		}
+		break;
+	}
+}
+
+/* Passes on everything held back, at a reset or the end */
+static void abort_all(struct st_reasm *r)
+{
+	abort_msg(r);
+	flush_pending(r);
+	if (r->state == ST_S_T1_PROLOGUE)
+		t1_apdu(r, ST_F_TRUNCATED);
+}
+
+static void process_byte(struct st_reasm *r, u_int8_t b)
+{
+	int len;
+
+	switch (r->state) {
+	case ST_S_WAIT_ATR:
+		if (b != 0x3b && b != 0x3f) {
+			emit(r, ST_MSG_GARBAGE, &b, 1, 0, r->ts_ns);
+			break;
+		}
+		r->atr[0] = b;
+		r->atr_len = 1;
+		r->state = ST_S_ATR;
+		break;
+	case ST_S_ATR:
+		r->atr[r->atr_len++] = b;
+		len = atr_parse(r->atr, r->atr_len, &r->protocol, &r->t1_crc);
+		if (len < 0) {
+			emit(r, ST_MSG_GARBAGE, r->atr, r->atr_len, 0, r->ts_ns);
+			r->state = ST_S_WAIT_ATR;
+		} else if (len > 0) {
+			emit(r, ST_MSG_ATR, r->atr, r->atr_len, 0, r->ts_ns);
+			if (r->force_protocol >= 0)
+				r->protocol = r->force_protocol;
+			protocol_start(r);
+		}
+		break;
+	case ST_S_T0_HDR:
+		r->apdu[r->apdu_len++] = b;
+		if (r->apdu_len == 5)
+			t0_hdr_done(r);
+		break;
+	case ST_S_T0_PROC:
+		if (b == 0x60)
+			break;			/* NULL */
+		if (is_sw1(b)) {
+			r->apdu[r->apdu_len++] = b;
+			r->state = ST_S_T0_SW2;
+		} else if (b == r->apdu[1] && r->t0_left) {
+			r->state = ST_S_T0_DATA;
+		} else if (b == (r->apdu[1] ^ 0xff) && r->t0_left) {
+			r->state = ST_S_T0_DATA1;
+		} else {
+			/* lost track, maybe this starts the next header */
+			abort_msg(r);
+			process_byte(r, b);
+		}
+		break;
+	case ST_S_T0_DATA:
+	case ST_S_T0_DATA1:
+		r->apdu[r->apdu_len++] = b;
+		if (--r->t0_left == 0 || r->state == ST_S_T0_DATA1)
+			r->state = ST_S_T0_PROC;
+		break;
+	case ST_S_T0_SW2:
+		r->apdu[r->apdu_len++] = b;
+		t0_done(r);
+		break;
+	case ST_S_T1_PROLOGUE:
+		r->block[r->block_len++] = b;
+		if (r->block_len == 3) {
+			if (b == 0xff) {
+				/* LEN 0xff is reserved, we lost track */
+				emit(r, ST_MSG_GARBAGE, r->block, 3, 0, r->ts_ns);
+				t1_start(r);
+				break;
+			}
+			r->block_need = 3 + b + (r->t1_crc ? 2 : 1);
+			r->state = ST_S_T1_INF;
+		}
+		break;
+	case ST_S_T1_INF:
+		r->block[r->block_len++] = b;
+		if (r->block_len == r->block_need) {
+			r->state = ST_S_T1_PROLOGUE;
+			t1_block(r);
+		}
+		break;
+	}
+}
+
+void st_reasm_init(struct st_reasm *r, st_msg_cb *cb, void *priv)
+{
+	memset(r, 0, sizeof(*r));
+	r->cb = cb;
+	r->priv = priv;
+	r->force_protocol = -1;
+	r->state = ST_S_WAIT_ATR;
+	r->fi = 1;
+	r->di = 1;
+}
+
+/* Where the ATR in a transfer with SIMTRACE_FLAG_ATR starts: it ends with
+ * the transfer, anything before it is left from before the reset */
+static unsigned int atr_start(const u_int8_t *data, unsigned int len)
+{
+	unsigned int i;
+	int protocol, t1_crc;
+
+	for (i = 0; i < len; i++)
+		if (atr_parse(data + i, len - i, &protocol, &t1_crc) ==
+		    (int) (len - i))
+			return i;
+	return 0;
+}
+
+void st_reasm_transfer(struct st_reasm *r, const u_int8_t *buf,
+		       unsigned int len, u_int64_t ts_ns)
+{
+	struct simtrace_hdr hdr;
+	const u_int8_t *data = buf + sizeof(hdr);
+	unsigned int i, start = 0;
+
+	if (len < sizeof(hdr))
+		return;
+	memcpy(&hdr, buf, sizeof(hdr));
+	if (hdr.cmd != SIMTRACE_MSGT_DATA)
+		return;
+	len -= sizeof(hdr);
+
+	r->stats.transfers++;
+	r->stats.bytes += len;
+	r->ts_ns = ts_ns;
+
+	if (hdr.flags & SIMTRACE_FLAG_ATR) {
+		start = atr_start(data, len);
+		for (i = 0; i < start; i++)
+			process_byte(r, data[i]);
+		abort_all(r);
+		r->state = ST_S_WAIT_ATR;
+		r->fi = 1;
+		r->di = 1;
+	}
+	if (hdr.flags & SIMTRACE_FLAG_PPS_FIDI) {
+		r->fi = hdr.res[0];
+		r->di = hdr.res[1];
+		r->flags |= ST_F_PPS;
+	}
+
+	for (i = start; i < len; i++)
+		process_byte(r, data[i]);
+
+	if (hdr.flags & SIMTRACE_FLAG_WTIME_EXP)
+		abort_msg(r);
+}
+
+void st_reasm_flush(struct st_reasm *r)
+{
+	abort_all(r);
+}
+
+void st_reasm_transfer_cb(const u_int8_t *buf, unsigned int len,
+			  u_int64_t ts_ns, void *priv)
+{
+	st_reasm_transfer(priv, buf, len, ts_ns);
+}
+
+int st_usbmon_read(FILE *f, int devnum, st_transfer_cb *cb, void *priv)
+{
+	static u_int8_t buf[USBMON_HDR_LEN_MMAPPED + 65536];
+	u_int32_t ghdr[6], rec[4];
+	struct usbmon_hdr uh;
+	unsigned int hdr_len, len;
+	u_int64_t ts_ns;
+	int nsec;
+
+	if (fread(ghdr, sizeof(ghdr), 1, f) != 1)
+		return ferror(f) ? -1 : 0;
+	if (ghdr[0] != PCAP_MAGIC_US && ghdr[0] != PCAP_MAGIC_NS) {
+		errno = EPROTO;
+		return -1;
+	}
+	nsec = ghdr[0] == PCAP_MAGIC_NS;
+	switch (ghdr[5]) {
+	case LINKTYPE_USB_LINUX:
+		hdr_len = USBMON_HDR_LEN;
+		break;
+	case LINKTYPE_USB_LINUX_MMAPPED:
+		hdr_len = USBMON_HDR_LEN_MMAPPED;
+		break;
+	default:
+		errno = EPROTONOSUPPORT;
+		return -1;
+	}
+
+	while (fread(rec, sizeof(rec), 1, f) == 1) {
+		len = rec[2];
+		if (len > sizeof(buf)) {
+			if (fseek(f, len, SEEK_CUR) < 0)
+				return -1;
+			continue;
+		}
+		if (fread(buf, 1, len, f) != len)
+			break;
+		if (len < hdr_len)
+			continue;
+
+		memcpy(&uh, buf, sizeof(uh));
+		if (uh.type != USBMON_COMPLETE || uh.xfer_type != USBMON_BULK ||
+		    uh.epnum != SIMTRACE_IN_EP || uh.status || uh.flag_data ||
+		    (devnum && uh.devnum != devnum))
+			continue;
+		if (uh.len_cap > len - hdr_len)
+			uh.len_cap = len - hdr_len;
+
+		ts_ns = rec[0] * 1000000000ULL +
+			(nsec ? rec[1] : rec[1] * 1000ULL);
+		cb(buf + hdr_len, uh.len_cap, ts_ns, priv);
+	}
+	return ferror(f) ? -1 : 0;
+}
+
+static void put32(u_int8_t *p, u_int32_t v)
+{
+	memcpy(p, &v, 4);
+}
+
+static void put16(u_int8_t *p, u_int16_t v)
+{
+	memcpy(p, &v, 2);
+}
+
+static void put16_be(u_int8_t *p, u_int16_t v)
+{
+	p[0] = v >> 8;
+	p[1] = v & 0xff;
+}
+
+/* an option with its value, padded to 32 bits */
+static int put_option(u_int8_t *p, u_int16_t code, const void *val,
+		      u_int16_t len)
+{
+	int padded = (len + 3) & ~3;
+
+	put16(p, code);
+	put16(p + 2, len);
+	memset(p + 4, 0, padded);
+	memcpy(p + 4, val, len);
+	return 4 + padded;
+}
+
+static void write_block(FILE *f, u_int32_t type, u_int8_t *block, int len)
+{
+	/* block has room for the type and length in front and the
+	 * length after the body */
+	put32(block, type);
+	put32(block + 4, len + 12);
+	put32(block + 8 + len, len + 12);
+	fwrite(block, 1, len + 12, f);
+}
+
+void st_pcap_open(struct st_pcap *p, FILE *f, int pcapng)
+{
+	u_int8_t block[64];
+	u_int8_t tsresol = 9;	/* nanoseconds */
+	int len;
+
+	p->f = f;
+	p->pcapng = pcapng;
+	p->packets = 0;
+
+	if (!pcapng) {
+		put32(block, PCAP_MAGIC_NS);
+		put16(block + 4, 2);
+		put16(block + 6, 4);
+		put32(block + 8, 0);
+		put32(block + 12, 0);
+		put32(block + 16, 65535);
+		put32(block + 20, LINKTYPE_IPV4);
+		fwrite(block, 1, 24, f);
+		return;
+	}
+
+	/* section header: byte order magic, version 1.0, unknown length */
+	put32(block + 8, 0x1a2b3c4d);
+	put16(block + 12, 1);
+	put16(block + 14, 0);
+	memset(block + 16, 0xff, 8);
+	write_block(f, PCAPNG_SHB, block, 16);
+
+	/* interface description */
+	put16(block + 8, LINKTYPE_IPV4);
+	put16(block + 10, 0);
+	put32(block + 12, 0);	/* no snaplen */
+	len = 8;
+	len += put_option(block + 8 + len, PCAPNG_IF_TSRESOL, &tsresol, 1);
+	len += put_option(block + 8 + len, PCAPNG_OPT_END, NULL, 0);
+	write_block(f, PCAPNG_IDB, block, len);
+}
+
+unsigned int st_gsmtap_build(u_int8_t *buf, const struct st_msg *msg)
+{
+	buf[0] = GSMTAP_VERSION;
+	buf[1] = GSMTAP_HDR_LEN / 4;
+	buf[2] = GSMTAP_TYPE_SIM;
+	memset(buf + 3, 0, GSMTAP_HDR_LEN - 3);
+	buf[12] = msg->type == ST_MSG_ATR ? GSMTAP_SIM_ATR : GSMTAP_SIM_APDU;
+	memcpy(buf + GSMTAP_HDR_LEN, msg->data, msg->len);
+	return GSMTAP_HDR_LEN + msg->len;
+}
+
+/* IPv4 and UDP from and to localhost port 4729 in front of len bytes */
+static void put_ip_udp(u_int8_t *p, unsigned int len)
+{
+	u_int32_t sum = 0;
+	int i;
+
+	memset(p, 0, IP_UDP_HDR_LEN);
+	p[0] = 0x45;
+	put16_be(p + 2, IP_UDP_HDR_LEN + len);
+	p[6] = 0x40;		/* don't fragment */
+	p[8] = 64;		/* TTL */
+	p[9] = 17;		/* UDP */
+	p[12] = p[16] = 127;
+	p[15] = p[19] = 1;
+	for (i = 0; i < 20; i += 2)
+		sum += p[i] << 8 | p[i + 1];
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+	put16_be(p + 10, ~sum);
+
+	put16_be(p + 20, GSMTAP_UDP_PORT);
+	put16_be(p + 22, GSMTAP_UDP_PORT);
+	put16_be(p + 24, 8 + len);
+	/* no UDP checksum */
+}
+
+static int comment(char *s, const struct st_msg *msg)
+{
+	int len = 0;
+
+	if (msg->flags & ST_F_TRUNCATED)
+		len += sprintf(s + len, "truncated; ");
+	if (msg->flags & ST_F_MERGED)
+		len += sprintf(s + len, "GET RESPONSE appended; ");
+	if (msg->flags & ST_F_EDC_ERROR)
+		len += sprintf(s + len, "LRC error; ");
+	if (msg->flags & ST_F_T1)
+		len += sprintf(s + len, "T=1; ");
+	if (msg->flags & ST_F_PPS)
+		len += sprintf(s + len, "PPS Fi %u Di %u; ", msg->fi, msg->di);
+	if (len)
+		s[len -= 2] = 0;
+	return len;
+}
+
+void st_pcap_write(struct st_pcap *p, const struct st_msg *msg)
+{
+	static u_int8_t block[8 + 20 + IP_UDP_HDR_LEN + GSMTAP_HDR_LEN +
+			      ST_MAX_APDU + 3 + 4 + 128 + 4 + 4];
+	char text[128];
+	unsigned int hdr, plen, len;
+	int clen;
+
+	if (msg->type == ST_MSG_GARBAGE)
+		return;
+
+	hdr = p->pcapng ? 8 + 20 : 16;
+	plen = st_gsmtap_build(block + hdr + IP_UDP_HDR_LEN, msg);
+	put_ip_udp(block + hdr, plen);
+	plen += IP_UDP_HDR_LEN;
+	p->packets++;
+
+	if (!p->pcapng) {
+		put32(block, msg->ts_ns / 1000000000ULL);
+		put32(block + 4, msg->ts_ns % 1000000000ULL);
+		put32(block + 8, plen);
+		put32(block + 12, plen);
+		fwrite(block, 1, 16 + plen, p->f);
+		return;
+	}
+
+	put32(block + 8, 0);		/* interface */
+	put32(block + 12, msg->ts_ns >> 32);
+	put32(block + 16, msg->ts_ns & 0xffffffff);
+	put32(block + 20, plen);
+	put32(block + 24, plen);
+	len = 20 + ((plen + 3) & ~3);
+	memset(block + 8 + 20 + plen, 0, len - 20 - plen);
+	clen = comment(text, msg);
+	if (clen)
+		len += put_option(block + 8 + len, PCAPNG_OPT_COMMENT, text, clen);
+	len += put_option(block + 8 + len, PCAPNG_OPT_END, NULL, 0);
+	write_block(p->f, PCAPNG_EPB, block, len);
+}
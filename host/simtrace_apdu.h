@@ -0,0 +1,142 @@
+#ifndef SIMTRACE_APDU_H
+#define SIMTRACE_APDU_H
+
+/* simtrace_apdu - turn the SIMtrace data stream back into ISO 7816-3
+ * ATRs and APDUs, read it from usbmon captures and write GSMTAP
+ *
+ * See simtrace_apdu.c.
+ */
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#define ST_MAX_ATR		33
+#define ST_MAX_APDU		4096
+
+enum st_msg_type {
+	ST_MSG_ATR,
+	ST_MSG_APDU,		/* CLA INS P1 P2 P3, command data, response
+				 * data, SW1 SW2 */
+	ST_MSG_GARBAGE,		/* bytes that did not fit the protocol */
+};
+
+/* flags of a message */
+#define ST_F_TRUNCATED		0x01	/* waiting time expired, reset or
+					 * protocol error before the end */
+#define ST_F_MERGED		0x02	/* GET RESPONSE data appended */
+#define ST_F_EDC_ERROR		0x04	/* T=1 block with a bad LRC */
+#define ST_F_PPS		0x08	/* Fi/Di changed by PPS before */
+#define ST_F_T1			0x10	/* reassembled from T=1 blocks */
+
+struct st_msg {
+	enum st_msg_type type;
+	unsigned int flags;
+	u_int64_t ts_ns;		/* of the transfer with the last byte */
+	u_int8_t fi, di;		/* as reported by the firmware */
+	const u_int8_t *data;
+	unsigned int len;
+};
+
+typedef void st_msg_cb(const struct st_msg *msg, void *priv);
+
+struct st_reasm_stats {
+	unsigned long transfers;
+	unsigned long bytes;
+	unsigned long atrs;
+	unsigned long apdus;
+	unsigned long merged;
+	unsigned long truncated;
+	unsigned long edc_errors;
+	unsigned long garbage;		/* bytes */
+};
+
+enum st_state {
+	ST_S_WAIT_ATR,
+	ST_S_ATR,
+	ST_S_T0_HDR,
+	ST_S_T0_PROC,
+	ST_S_T0_DATA,		/* all remaining data bytes */
+	ST_S_T0_DATA1,		/* one data byte, then a procedure byte */
+	ST_S_T0_SW2,
+	ST_S_T1_PROLOGUE,
+	ST_S_T1_INF,		/* and the EDC */
+};
+
+struct st_reasm {
+	st_msg_cb *cb;
+	void *priv;
+	int force_protocol;		/* -1 or the protocol to assume */
+
+	enum st_state state;
+	int protocol;			/* from the ATR */
+	int t1_crc;			/* T=1 EDC is a CRC, not an LRC */
+	unsigned int flags;		/* of the message being built */
+	u_int8_t fi, di;
+	u_int64_t ts_ns;
+
+	u_int8_t atr[ST_MAX_ATR];
+	unsigned int atr_len;
+
+	/* T=0: the TPDU being received, the data bytes still expected and
+	 * whether they come from the card */
+	u_int8_t apdu[ST_MAX_APDU];
+	unsigned int apdu_len;
+	unsigned int t0_left;
+	int t0_outgoing;
+
+	/* T=0: a command answered with 61xx/9Fxx waiting for the GET
+	 * RESPONSE */
+	u_int8_t pending[ST_MAX_APDU];
+	unsigned int pending_len;
+	unsigned int pending_flags;
+	u_int64_t pending_ts_ns;
+
+	/* T=1: the block being received and the command and response
+	 * being chained together */
+	u_int8_t block[3 + 254 + 2];
+	unsigned int block_len;
+	unsigned int block_need;
+	int t1_card;			/* the card sends the next block */
+	int t1_cmd_done;
+	u_int8_t cmd[ST_MAX_APDU];
+	unsigned int cmd_len;
+	u_int8_t rsp[ST_MAX_APDU];
+	unsigned int rsp_len;
+
+	struct st_reasm_stats stats;
+};
+
+extern void st_reasm_init(struct st_reasm *r, st_msg_cb *cb, void *priv);
+/* One USB transfer: struct simtrace_hdr and the data bytes */
+extern void st_reasm_transfer(struct st_reasm *r, const u_int8_t *buf,
+			      unsigned int len, u_int64_t ts_ns);
+/* Passes on what is still held back, at the end of a capture */
+extern void st_reasm_flush(struct st_reasm *r);
+
+typedef void st_transfer_cb(const u_int8_t *buf, unsigned int len,
+			    u_int64_t ts_ns, void *priv);
+
+/* Reads a pcap file of usbmon captures (LINKTYPE_USB_LINUX or
+ * LINKTYPE_USB_LINUX_MMAPPED) and passes the bulk IN transfers of the
+ * SIMtrace (endpoint 0x82, of device devnum unless that is 0) to cb.
+ * Returns 0 or -1 with errno set. */
+extern int st_usbmon_read(FILE *f, int devnum, st_transfer_cb *cb, void *priv);
+/* An st_transfer_cb for the struct st_reasm in priv */
+extern void st_reasm_transfer_cb(const u_int8_t *buf, unsigned int len,
+				 u_int64_t ts_ns, void *priv);
+
+struct st_pcap {
+	FILE *f;
+	int pcapng;
+	unsigned long packets;
+};
+
+/* Writes the file header, the packets are GSMTAP over UDP over IPv4 */
+extern void st_pcap_open(struct st_pcap *p, FILE *f, int pcapng);
+extern void st_pcap_write(struct st_pcap *p, const struct st_msg *msg);
+
+/* Builds the GSMTAP (type SIM) header and payload of msg into buf,
+ * returns its length */
+extern unsigned int st_gsmtap_build(u_int8_t *buf, const struct st_msg *msg);
+
+#endif /* SIMTRACE_APDU_H */
@@ -0,0 +1,555 @@
+/* simtrace_replay - benchmark simtrace_apdu.c on a long generated capture
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Generates hours of SIM card traffic the way the SIMtrace firmware
+ * passes it on: the bytes of the I/O line at the line rate, in
+ * transfers of up to 124 bytes that end early at the end of the ATR
+ * and when the waiting time expires.  The card is reset every half
+ * hour, alternately answering with a T=0 ATR (GSM commands with
+ * procedure bytes, NULLs and GET RESPONSE) and a T=1 ATR followed by
+ * a PPS (chained I-blocks with an IFSC of 32, WTX requests).  After
+ * a third of the exchanges the line stays idle past the waiting time,
+ * otherwise the next command follows at once.
+ *
+ * The transfers are written as a usbmon capture, the way tcpdump
+ * records them, which is then read back through st_usbmon_read() into
+ * GSMTAP pcap.  Shown is how much faster than real time that goes,
+ * and whether every ATR and APDU came out as generated.  With -e
+ * bytes are dropped, as the firmware does when it runs out of request
+ * contexts, to see how the decoder gets back on track.
+ *
+ *	simtrace_replay [-H hours] [-e loss] [-w capture] [-o pcap]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include <simtrace_usb.h>
+
+#include "simtrace_apdu.h"
+
+#define SIM_CLOCK_HZ		3571200
+#define XFER_DATA		(128 - sizeof(struct simtrace_hdr))	/* RCTX_SIZE_SMALL */
+#define SESSION_NS		(30 * 60 * 1000000000ULL)
+#define IFSC			32
+#define LOOKAHEAD		1024
+
+static const int di_table[16] = { 0, 1, 2, 4, 8, 16, 32, 64, 12, 20 };
+
+static FILE *cap;
+static u_int8_t xfer[sizeof(struct simtrace_hdr) + XFER_DATA];
+static unsigned int xfer_len;
+static u_int8_t xfer_flags, fi = 1, di = 1;
+static u_int64_t now_ns, etu_ns, transfers, line_bytes, usbmon_id;
+static double loss;
+
+/* Every ATR and APDU as it should come out, as a hash of type, flags and
+ * bytes, and the one being put together */
+static u_int64_t *expected;
+static unsigned long exp_count, exp_size;
+static u_int8_t exp_buf[ST_MAX_APDU];
+static unsigned int exp_len, exp_flags;
+
+static unsigned long matched, wrong, decoded;
+static unsigned long next_expected;
+static struct st_pcap pcap;
+
+static u_int64_t fnv(u_int64_t h, const u_int8_t *p, unsigned int len)
+{
+	while (len--) {
+		h ^= *p++;
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+static u_int64_t msg_hash(int type, unsigned int flags, const u_int8_t *p,
+			  unsigned int len)
+{
+	u_int8_t tf[2] = { type, flags };
+
+	return fnv(fnv(0xcbf29ce484222325ULL, tf, 2), p, len);
+}
+
+static void exp_add(const u_int8_t *p, unsigned int len)
+{
+	memcpy(exp_buf + exp_len, p, len);
+	exp_len += len;
+}
+
+static void exp_end(int type, unsigned int flags)
+{
+	if (exp_count == exp_size) {
+		exp_size = exp_size ? exp_size * 2 : 65536;
+		expected = realloc(expected, exp_size * sizeof(*expected));
+		if (!expected) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	expected[exp_count++] = msg_hash(type, flags | exp_flags, exp_buf, exp_len);
+	exp_flags = 0;
+	exp_len = 0;
+}
+
+static void put32(u_int8_t *p, u_int32_t v)
+{
+	memcpy(p, &v, 4);
+}
+
+/* One usbmon record, 64 byte header as with LINKTYPE_USB_LINUX_MMAPPED */
+static void usbmon_record(char type, const u_int8_t *data, unsigned int len)
+{
+	u_int8_t rec[16 + 64];
+	u_int64_t id = usbmon_id;
+
+	put32(rec, now_ns / 1000000000ULL);
+	put32(rec + 4, now_ns % 1000000000ULL / 1000);
+	put32(rec + 8, 64 + len);
+	put32(rec + 12, 64 + len);
+	memset(rec + 16, 0, 64);
+	memcpy(rec + 16, &id, 8);
+	rec[16 + 8] = type;
+	rec[16 + 9] = 3;		/* bulk */
+	rec[16 + 10] = 0x82;
+	rec[16 + 11] = 5;		/* device */
+	rec[16 + 12] = 1;		/* bus */
+	rec[16 + 14] = '-';		/* no setup */
+	rec[16 + 15] = data ? 0 : '<';
+	put32(rec + 16 + 32, type == 'C' ? len : 2048);
+	put32(rec + 16 + 36, len);
+	fwrite(rec, 1, sizeof(rec), cap);
+	if (data)
+		fwrite(data, 1, len, cap);
+}
+
+/* The firmware sends off the request context */
+static void send_xfer(u_int8_t flags)
+{
+	struct simtrace_hdr *hdr = (struct simtrace_hdr *) xfer;
+
+	/* without a request context the waiting time goes unnoticed */
+	if (!xfer_len) {
+		xfer_flags |= flags & ~SIMTRACE_FLAG_WTIME_EXP;
+		return;
+	}
+	xfer_flags |= flags;
+	hdr->cmd = SIMTRACE_MSGT_DATA;
+	hdr->flags = xfer_flags;
+	hdr->res[0] = fi;
+	hdr->res[1] = di;
+
+	/* the host has an URB waiting all the time */
+	usbmon_record('S', NULL, 0);
+	now_ns += 1000000;
+	usbmon_record('C', xfer, sizeof(*hdr) + xfer_len);
+	now_ns -= 1000000;
+	usbmon_id++;
+	transfers++;
+	xfer_len = 0;
+	xfer_flags = 0;
+}
+
+static void put_byte(u_int8_t b)
+{
+	now_ns += 12 * etu_ns;
+	line_bytes++;
+	if (loss > 0 && drand48() < loss)
+		return;
+	xfer[sizeof(struct simtrace_hdr) + xfer_len++] = b;
+	if (xfer_len == XFER_DATA)
+		send_xfer(0);
+}
+
+static void put_bytes(const u_int8_t *p, unsigned int len)
+{
+	while (len--)
+		put_byte(*p++);
+}
+
+static void turnaround(void)
+{
+	now_ns += 16 * etu_ns;
+}
+
+/* The line stays idle past the waiting time */
+static void idle(void)
+{
+	now_ns += 960 * 10 * di_table[di] * etu_ns + lrand48() % 100000000;
+	send_xfer(SIMTRACE_FLAG_WTIME_EXP);
+}
+
+static void random_bytes(u_int8_t *p, unsigned int len)
+{
+	while (len--)
+		*p++ = lrand48();
+}
+
+static void set_rate(u_int8_t new_fi, u_int8_t new_di)
+{
+	static const int fi_table[16] = { 372, 372, 558, 744, 1116, 1488, 1860,
+					  0, 0, 512, 768, 1024, 1536, 2048 };
+
+	fi = new_fi;
+	di = new_di;
+	etu_ns = fi_table[fi] * 1000000000ULL / di_table[di] / SIM_CLOCK_HZ;
+}
+
+static void atr(const u_int8_t *atr, unsigned int len)
+{
+	u_int8_t tck = 0;
+	unsigned int i;
+
+	set_rate(1, 1);
+	put_bytes(atr, len - 1);
+	for (i = 1; i < len - 1; i++)
+		tck ^= atr[i];
+	put_byte(tck);
+	send_xfer(SIMTRACE_FLAG_ATR);
+
+	exp_add(atr, len - 1);
+	exp_add(&tck, 1);
+	exp_end(ST_MSG_ATR, 0);
+}
+
+/* A TPDU: header, procedure bytes, data in either direction, SW */
+static void t0_tpdu(const u_int8_t *hdr, const u_int8_t *data, unsigned int len,
+		    u_int8_t sw1, u_int8_t sw2)
+{
+	int slow = lrand48() % 8 == 0, nulls = lrand48() % 4;
+	unsigned int i;
+
+	put_bytes(hdr, 5);
+	turnaround();
+	if (len) {
+		if (slow) {
+			for (i = 0; i < len; i++) {
+				put_byte(hdr[1] ^ 0xff);
+				put_byte(data[i]);
+			}
+		} else {
+			put_byte(hdr[1]);
+			put_bytes(data, len);
+		}
+	}
+	while (nulls--)
+		put_byte(0x60);
+	put_byte(sw1);
+	put_byte(sw2);
+	turnaround();
+}
+
+static void t0_exchange(void)
+{
+	u_int8_t hdr[5] = { 0xa0 }, gr[5] = { 0xa0, 0xc0, 0, 0 };
+	u_int8_t data[256], rsp[256], ok[2] = { 0x90, 0x00 };
+	unsigned int len, rlen;
+
+	switch (lrand48() % 6) {
+	case 0:
+	case 1:
+		/* SELECT, the response is fetched by GET RESPONSE */
+		hdr[1] = 0xa4;
+		hdr[4] = 2;
+		random_bytes(data, 2);
+		rlen = 15 + lrand48() % 26;
+		random_bytes(rsp, rlen);
+		gr[4] = rlen;
+		t0_tpdu(hdr, data, 2, 0x9f, rlen);
+		t0_tpdu(gr, rsp, rlen, 0x90, 0x00);
+		exp_add(hdr, 5);
+		exp_add(data, 2);
+		exp_add(rsp, rlen);
+		exp_add(ok, 2);
+		exp_end(ST_MSG_APDU, ST_F_MERGED);
+		break;
+	case 2:
+		/* READ BINARY, P3 = 0 asks for 256 */
+		hdr[1] = 0xb0;
+		hdr[4] = lrand48();
+		len = hdr[4] ? hdr[4] : 256;
+		random_bytes(data, len);
+		t0_tpdu(hdr, data, len, 0x90, 0x00);
+		exp_add(hdr, 5);
+		exp_add(data, len);
+		exp_add(ok, 2);
+		exp_end(ST_MSG_APDU, 0);
+		break;
+	case 3:
+		/* RUN GSM ALGORITHM */
+		hdr[1] = 0x88;
+		hdr[4] = 16;
+		random_bytes(data, 16);
+		random_bytes(rsp, 12);
+		gr[4] = 12;
+		t0_tpdu(hdr, data, 16, 0x9f, 12);
+		t0_tpdu(gr, rsp, 12, 0x90, 0x00);
+		exp_add(hdr, 5);
+		exp_add(data, 16);
+		exp_add(rsp, 12);
+		exp_add(ok, 2);
+		exp_end(ST_MSG_APDU, ST_F_MERGED);
+		break;
+	case 4:
+		/* UPDATE RECORD */
+		hdr[1] = 0xdc;
+		hdr[2] = 1;
+		hdr[3] = 4;
+		hdr[4] = 1 + lrand48() % 255;
+		random_bytes(data, hdr[4]);
+		t0_tpdu(hdr, data, hdr[4], 0x90, 0x00);
+		exp_add(hdr, 5);
+		exp_add(data, hdr[4]);
+		exp_add(ok, 2);
+		exp_end(ST_MSG_APDU, 0);
+		break;
+	case 5:
+		/* SELECT of a file that is not there */
+		hdr[1] = 0xa4;
+		hdr[4] = 2;
+		random_bytes(data, 2);
+		t0_tpdu(hdr, data, 2, 0x94, 0x04);
+		exp_add(hdr, 5);
+		exp_add(data, 2);
+		exp_add((const u_int8_t *) "\x94\x04", 2);
+		exp_end(ST_MSG_APDU, 0);
+		break;
+	}
+}
+
+static void t1_block(u_int8_t pcb, const u_int8_t *inf, unsigned int len)
+{
+	u_int8_t prologue[3] = { 0, pcb, len }, lrc = pcb ^ len;
+	unsigned int i;
+
+	for (i = 0; i < len; i++)
+		lrc ^= inf[i];
+	put_bytes(prologue, 3);
+	put_bytes(inf, len);
+	put_byte(lrc);
+	turnaround();
+}
+
+/* I-blocks of at most IFSC bytes, each but the last acknowledged by the
+ * other side with an R-block */
+static void t1_chain(const u_int8_t *p, unsigned int len, int *ns)
+{
+	unsigned int n;
+	int more;
+
+	do {
+		n = len > IFSC ? IFSC : len;
+		more = len > n;
+		t1_block(*ns << 6 | (more ? 0x20 : 0), p, n);
+		*ns ^= 1;
+		if (more)
+			t1_block(0x80 | *ns << 4, NULL, 0);
+		p += n;
+		len -= n;
+	} while (len);
+}
+
+static void t1_exchange(void)
+{
+	static int ns_reader, ns_card;
+	u_int8_t cmd[4 + 1 + 255 + 1], rsp[258], wtx = 1, p3;
+	unsigned int len = 4, lc = 0, rlen;
+	int c = lrand48() % 4;
+
+	cmd[0] = 0x00;
+	random_bytes(cmd + 1, 3);
+	if (c >= 2) {
+		/* case 3 and 4: command data */
+		lc = 1 + lrand48() % 200;
+		cmd[len++] = lc;
+		random_bytes(cmd + len, lc);
+		len += lc;
+	}
+	if (c == 1 || c == 3)
+		cmd[len++] = lrand48();			/* Le */
+	rlen = c == 1 || c == 3 ? lrand48() % 257 : 0;
+	random_bytes(rsp, rlen);
+	rsp[rlen++] = 0x90;
+	rsp[rlen++] = 0x00;
+
+	t1_chain(cmd, len, &ns_reader);
+	if (lrand48() % 4 == 0) {
+		/* the card asks for more time */
+		t1_block(0xc3, &wtx, 1);
+		t1_block(0xe3, &wtx, 1);
+	}
+	t1_chain(rsp, rlen, &ns_card);
+
+	p3 = c == 0 ? 0 : c == 1 ? cmd[4] : lc;
+	exp_add(cmd, 4);
+	exp_add(&p3, 1);
+	exp_add(cmd + 5, lc);
+	exp_add(rsp, rlen);
+	exp_end(ST_MSG_APDU, ST_F_T1);
+}
+
+static void generate(double hours)
+{
+	/* T=0 offered first, T=1 as well */
+	static const u_int8_t atr_t0[] = { 0x3b, 0x95, 0x11, 0x80, 0x01,
+					   'S', 'I', 'M', 't', 'r', 0 };
+	/* T=1 only, IFSC 32, LRC */
+	static const u_int8_t atr_t1[] = { 0x3b, 0x80, 0x81, 0x31, IFSC, 0x45, 0 };
+	u_int64_t end_ns = hours * 3600 * 1e9, session_end;
+	int t1 = 0;
+
+	now_ns = 1000000000ULL;
+	while (now_ns < end_ns) {
+		session_end = now_ns + SESSION_NS;
+		if (t1) {
+			atr(atr_t1, sizeof(atr_t1));
+			/* PPS to Di 4, the firmware only passes on the
+			 * result */
+			set_rate(1, 3);
+			xfer_flags |= SIMTRACE_FLAG_PPS_FIDI;
+			exp_flags |= ST_F_PPS;
+		} else {
+			atr(atr_t0, sizeof(atr_t0));
+		}
+		while (now_ns < session_end && now_ns < end_ns) {
+			if (t1)
+				t1_exchange();
+			else
+				t0_exchange();
+			if (lrand48() % 3 == 0)
+				idle();
+		}
+		idle();
+		t1 = !t1;
+	}
+}
+
+static void msg_cb(const struct st_msg *msg, void *priv)
+{
+	u_int64_t h = msg_hash(msg->type, msg->flags, msg->data, msg->len);
+	unsigned long i;
+
+	st_pcap_write(&pcap, msg);
+	if (msg->type == ST_MSG_GARBAGE)
+		return;
+	decoded++;
+
+	/* after lost bytes some of the expected may not come */
+	for (i = next_expected; i < exp_count && i < next_expected + LOOKAHEAD; i++) {
+		if (expected[i] == h) {
+			matched++;
+			next_expected = i + 1;
+			return;
+		}
+	}
+	wrong++;
+}
+
+static double now_s(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void help(void)
+{
+	printf("simtrace_replay [-H hours] [-e loss] [-s seed] [-w capture] [-o pcap]\n"
+	       "  -H  hours of line time to generate (default 4)\n"
+	       "  -e  probability of a byte being lost\n"
+	       "  -w  keep the generated usbmon capture in this file\n"
+	       "  -o  write the decoded GSMTAP pcap to this file\n");
+}
+
+int main(int argc, char **argv)
+{
+	static struct st_reasm r;
+	const char *capture = NULL, *output = "/dev/null";
+	u_int32_t ghdr[6] = { 0xa1b2c3d4, 0x00040002, 0, 0, 65535, 220 };
+	double hours = 4, t;
+	long size;
+	FILE *out;
+	int c;
+
+	while ((c = getopt(argc, argv, "H:e:s:w:o:h")) != -1) {
+		switch (c) {
+		case 'H':
+			hours = atof(optarg);
+			break;
+		case 'e':
+			loss = atof(optarg);
+			break;
+		case 's':
+			srand48(strtoul(optarg, NULL, 0));
+			break;
+		case 'w':
+			capture = optarg;
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		default:
+			help();
+			exit(c == 'h' ? 0 : 2);
+		}
+	}
+
+	cap = capture ? fopen(capture, "w+b") : tmpfile();
+	out = fopen(output, "wb");
+	if (!cap || !out) {
+		perror("fopen");
+		exit(1);
+	}
+	setvbuf(cap, NULL, _IOFBF, 1 << 20);
+	setvbuf(out, NULL, _IOFBF, 1 << 20);
+
+	fwrite(ghdr, sizeof(ghdr), 1, cap);
+	generate(hours);
+	fflush(cap);
+	size = ftell(cap);
+	rewind(cap);
+
+	printf("%.1f h of line time: %llu bytes in %llu transfers, "
+	       "%lu ATRs and APDUs, %.1f MB capture\n", hours,
+	       (unsigned long long) line_bytes, (unsigned long long) transfers,
+	       exp_count, size / 1e6);
+
+	st_reasm_init(&r, msg_cb, NULL);
+	st_pcap_open(&pcap, out, 0);
+	t = now_s();
+	if (st_usbmon_read(cap, 0, st_reasm_transfer_cb, &r) < 0) {
+		perror("st_usbmon_read");
+		exit(1);
+	}
+	st_reasm_flush(&r);
+	fflush(out);
+	t = now_s() - t;
+
+	printf("decoded in %.3f s: %.0f times real time, %.1f MB/s, "
+	       "%.2f us per APDU\n", t, hours * 3600 / t, size / 1e6 / t,
+	       t * 1e6 / (r.stats.apdus + r.stats.atrs));
+	printf("%lu of %lu as generated, %lu decoded wrong, %lu truncated, "
+	       "%lu bytes not decoded\n", matched, exp_count, wrong,
+	       r.stats.truncated, r.stats.garbage);
+
+	fclose(out);
+	fclose(cap);
+	return loss == 0 && (matched != exp_count || wrong) ? 1 : 0;
+}
@@ -0,0 +1,279 @@
+/* sniff2pcapng - convert the binary record stream of the OpenPICC T/C
+ * sniffer into pcapng
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Reads the records (see openpicc/application/sniffer_proto.h) from the
+ * CDC tty or a file and writes one ISO 14443 packet (LINKTYPE_ISO_14443)
+ * per frame.  The carrier cycle timestamps are turned into nanoseconds
+ * from the time the first record arrived.  CRC, parity and decoder
+ * problems end up in the packet comments.  Whatever else shares the
+ * CDC endpoint (text from usb_print) is skipped.
+ *
+ *	sniff2pcapng -i /dev/ttyACM0 | wireshark -k -i -
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/time.h>
+
+#include "../openpicc/application/sniffer_proto.h"
+
+#define MAX_BITS		(256*8)	/* MAXIMUM_FRAME_SIZE in iso14443.h */
+
+#define LINKTYPE_ISO_14443	264
+#define ISO14443_EVT_DATA_PCD	0xff
+#define ISO14443_EVT_DATA_PICC	0xfe
+
+#define PCAPNG_SHB		0x0a0d0d0a
+#define PCAPNG_IDB		0x00000001
+#define PCAPNG_EPB		0x00000006
+#define PCAPNG_OPT_END		0
+#define PCAPNG_OPT_COMMENT	1
+#define PCAPNG_IF_TSRESOL	9
+
+static FILE *out;
+static int verbose;
+
+static u_int64_t base_ns;		/* wall clock of the first record */
+static u_int64_t first_cycles, last_cycles;
+static int have_first;
+
+static unsigned long records, skipped;
+
+static void put32(u_int8_t *p, u_int32_t v)
+{
+	memcpy(p, &v, 4);
+}
+
+static void put16(u_int8_t *p, u_int16_t v)
+{
+	memcpy(p, &v, 2);
+}
+
+/* an option with its value, padded to 32 bits */
+static int put_option(u_int8_t *p, u_int16_t code, const void *val,
+		      u_int16_t len)
+{
+	int padded = (len + 3) & ~3;
+
+	put16(p, code);
+	put16(p + 2, len);
+	memset(p + 4, 0, padded);
+	memcpy(p + 4, val, len);
+	return 4 + padded;
+}
+
+static void write_block(u_int32_t type, const u_int8_t *body, int len)
+{
+	u_int8_t hdr[8], trailer[4];
+
+	put32(hdr, type);
+	put32(hdr + 4, len + 12);
+	put32(trailer, len + 12);
+	fwrite(hdr, 1, sizeof(hdr), out);
+	fwrite(body, 1, len, out);
+	fwrite(trailer, 1, sizeof(trailer), out);
+}
+
+static void write_header(void)
+{
+	u_int8_t body[64];
+	u_int8_t tsresol = 9;	/* nanoseconds */
+	int len;
+
+	/* section header: byte order magic, version 1.0, unknown length */
+	put32(body, 0x1a2b3c4d);
+	put16(body + 4, 1);
+	put16(body + 6, 0);
+	memset(body + 8, 0xff, 8);
+	write_block(PCAPNG_SHB, body, 16);
+
+	/* interface description */
+	put16(body, LINKTYPE_ISO_14443);
+	put16(body + 2, 0);
+	put32(body + 4, 0);	/* no snaplen */
+	len = 8;
+	len += put_option(body + len, PCAPNG_IF_TSRESOL, &tsresol, 1);
+	len += put_option(body + len, PCAPNG_OPT_END, NULL, 0);
+	write_block(PCAPNG_IDB, body, len);
+}
+
+static int parity_ok(const u_int8_t *data, const u_int8_t *parity, int bytes)
+{
+	int i;
+
+	for (i = 0; i < bytes; i++) {
+		int p = (parity[i / 8] >> (i % 8)) & 1;
+		if (p == __builtin_parity(data[i]))
+			return 0;
+	}
+	return 1;
+}
+
+static void write_frame(const struct sniffer_record *rec, const u_int8_t *data,
+			const u_int8_t *parity)
+{
+	u_int8_t body[32 + 4 + MAX_BITS / 8 + 4 + 128];
+	char comment[128];
+	int dlen = SNIFFER_DATA_LEN(rec->bits), len, clen = 0;
+	u_int64_t cycles, ts;
+	struct timeval tv;
+
+	/* extend the 32 bit carrier cycle counter */
+	if (!have_first) {
+		gettimeofday(&tv, NULL);
+		base_ns = tv.tv_sec * 1000000000ULL + tv.tv_usec * 1000ULL;
+		first_cycles = last_cycles = rec->timestamp;
+		have_first = 1;
+	}
+	cycles = (last_cycles & ~0xffffffffULL) | rec->timestamp;
+	if (cycles < last_cycles)
+		cycles += 1ULL << 32;
+	last_cycles = cycles;
+	ts = base_ns + (cycles - first_cycles) * 1000000000ULL / SNIFFER_CLOCK_HZ;
+
+	comment[0] = 0;
+	if (rec->flags & SNIFFER_F_CRC_ERROR)
+		clen += sprintf(comment + clen, "CRC error; ");
+	if (!parity_ok(data, parity, rec->bits / 8))
+		clen += sprintf(comment + clen, "parity error; ");
+	if (rec->flags & SNIFFER_F_DECODE_ERROR)
+		clen += sprintf(comment + clen, "decoder error; ");
+	if (rec->flags & SNIFFER_F_TRUNCATED)
+		clen += sprintf(comment + clen, "truncated; ");
+	if (rec->flags & SNIFFER_F_OVERRUN)
+		clen += sprintf(comment + clen, "captures lost before; ");
+	if (rec->flags & SNIFFER_F_GAP)
+		clen += sprintf(comment + clen, "idle gap not timed; ");
+	if (clen)
+		comment[clen -= 2] = 0;
+	if (rec->bits % 8)
+		clen += sprintf(comment + clen, "%s%d bits", clen ? "; " : "",
+				rec->bits);
+
+	put32(body, 0);		/* interface */
+	put32(body + 4, ts >> 32);
+	put32(body + 8, ts & 0xffffffff);
+	put32(body + 12, 4 + dlen);
+	put32(body + 16, 4 + dlen);
+	body[20] = 0;		/* pseudo header version */
+	body[21] = rec->flags & SNIFFER_F_PICC ?
+			ISO14443_EVT_DATA_PICC : ISO14443_EVT_DATA_PCD;
+	body[22] = dlen >> 8;	/* big endian */
+	body[23] = dlen & 0xff;
+	memcpy(body + 24, data, dlen);
+	len = 24 + ((dlen + 3) & ~3);
+	memset(body + 24 + dlen, 0, len - 24 - dlen);
+	if (clen)
+		len += put_option(body + len, PCAPNG_OPT_COMMENT, comment, clen);
+	len += put_option(body + len, PCAPNG_OPT_END, NULL, 0);
+	write_block(PCAPNG_EPB, body, len);
+	fflush(out);
+
+	if (verbose) {
+		int i;
+
+		fprintf(stderr, "%10llu %s", (unsigned long long) cycles,
+			rec->flags & SNIFFER_F_PICC ? "PICC" : "PCD ");
+		for (i = 0; i < dlen; i++)
+			fprintf(stderr, " %02x", data[i]);
+		fprintf(stderr, "%s%s\n", clen ? "  " : "", comment);
+	}
+}
+
+/* Take the records out of buf, returns the number of bytes used up */
+static int parse(const u_int8_t *buf, int len)
+{
+	struct sniffer_record rec;
+	int pos = 0, rlen;
+
+	while (len - pos >= (int) sizeof(rec)) {
+		memcpy(&rec, buf + pos, sizeof(rec));
+		if (rec.type != SNIFFER_REC_FRAME || rec.bits == 0 ||
+		    rec.bits > MAX_BITS) {
+			skipped++;
+			pos++;
+			continue;
+		}
+		rlen = SNIFFER_RECORD_LEN(rec.bits);
+		if (len - pos < rlen)
+			break;
+		write_frame(&rec, buf + pos + sizeof(rec),
+			    buf + pos + sizeof(rec) + SNIFFER_DATA_LEN(rec.bits));
+		records++;
+		pos += rlen;
+	}
+	return pos;
+}
+
+static void help(void)
+{
+	printf("sniff2pcapng [-i input] [-w output] [-v]\n"
+	       "  -i  tty or file with the sniffer records (default stdin)\n"
+	       "  -w  pcapng file to write (default stdout)\n"
+	       "  -v  print the frames to stderr\n");
+}
+
+int main(int argc, char **argv)
+{
+	static u_int8_t buf[4096];
+	int fd = 0, c, len = 0, ret, used;
+
+	out = stdout;
+	while ((c = getopt(argc, argv, "i:w:vh")) != -1) {
+		switch (c) {
+		case 'i':
+			fd = open(optarg, O_RDONLY | O_NOCTTY);
+			if (fd < 0) {
+				perror(optarg);
+				exit(1);
+			}
+			break;
+		case 'w':
+			out = fopen(optarg, "wb");
+			if (!out) {
+				perror(optarg);
+				exit(1);
+			}
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			help();
+			exit(c == 'h' ? 0 : 2);
+		}
+	}
+
+	write_header();
+
+	while ((ret = read(fd, buf + len, sizeof(buf) - len)) > 0) {
+		len += ret;
+		used = parse(buf, len);
+		memmove(buf, buf + used, len - used);
+		len -= used;
+	}
+	if (ret < 0)
+		perror("read");
+
+	fclose(out);
+	fprintf(stderr, "%lu frames, %lu bytes skipped\n", records, skipped);
+	return ret < 0;
+}
@@ -0,0 +1,84 @@
+/* ssc_capture - turn OPENPCD_CMD_SSC_READ replies of the OpenPICC back
+ * into sample words
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * The counterpart of firmware/src/picc/ssc_rle.c, used by opcd_test and
+ * checked against the encoder by ssc_rle_test.
+ */
+
+#include <string.h>
+#include <sys/types.h>
+
+#include <openpcd.h>
+
+#include "ssc_capture.h"
+#include "../firmware/src/picc/ssc_rle.h"
+
+int ssc_capture_expand(const u_int8_t *in, unsigned int len,
+		       u_int32_t *out, unsigned int words)
+{
+	unsigned int i = 0, o = 0, n;
+	u_int16_t seg;
+
+	while (i < len) {
+		if (len - i < 2)
+			return -1;
+		seg = in[i] | (in[i + 1] << 8);
+		i += 2;
+		n = seg & ~OPENPCD_SSC_SEG_IDLE;
+		if (!n || o + n > words)
+			return -1;
+		if (seg & OPENPCD_SSC_SEG_IDLE) {
+			while (n--)
+				out[o++] = SSC_IDLE;
+		} else {
+			if (len - i < n * 4)
+				return -1;
+			memcpy(out + o, in + i, n * 4);
+			i += n * 4;
+			o += n;
+		}
+	}
+
+	return o;
+}
+
+int ssc_capture_decode(const void *buf, unsigned int len,
+		       struct openpcd_ssc_capture *cap,
+		       u_int32_t *out, unsigned int words)
+{
+	const struct openpcd_hdr *hdr = buf;
+	const u_int8_t *data;
+
+	if (len < sizeof(*hdr) + sizeof(*cap) ||
+	    hdr->cmd != OPENPCD_CMD_SSC_READ)
+		return -1;
+	memcpy(cap, hdr->data, sizeof(*cap));
+	data = hdr->data + sizeof(*cap);
+	len -= sizeof(*hdr) + sizeof(*cap);
+
+	if (cap->words > words)
+		return -1;
+	if (cap->flags & OPENPCD_SSC_F_RLE) {
+		if (ssc_capture_expand(data, len, out, cap->words) != cap->words)
+			return -1;
+	} else {
+		if (len != cap->words * 4)
+			return -1;
+		memcpy(out, data, len);
+	}
+
+	return cap->words;
+}
@@ -0,0 +1,30 @@
+#ifndef SSC_CAPTURE_H
+#define SSC_CAPTURE_H
+
+/* ssc_capture - turn OPENPCD_CMD_SSC_READ replies of the OpenPICC back
+ * into sample words
+ *
+ * See ssc_capture.c, the format is documented with struct
+ * openpcd_ssc_capture in openpcd.h.
+ */
+
+#include <sys/types.h>
+#include <openpcd.h>
+
+/* longest buffer the firmware sends (SSC_MODE_CONTINUOUS) */
+#define SSC_CAPTURE_WORDS_MAX	508
+
+/* Expand the len bytes of segments at in into at most words sample
+ * words.  Returns the number of words or -1 if the segments are
+ * malformed or do not fit. */
+extern int ssc_capture_expand(const u_int8_t *in, unsigned int len,
+			      u_int32_t *out, unsigned int words);
+
+/* Take apart a complete reply of len bytes: the capture header is copied
+ * to cap, the samples, raw or run-length coded, end up in out.  Returns
+ * cap->words, or -1 if the reply is no SSC capture or is malformed. */
+extern int ssc_capture_decode(const void *buf, unsigned int len,
+			      struct openpcd_ssc_capture *cap,
+			      u_int32_t *out, unsigned int words);
+
+#endif
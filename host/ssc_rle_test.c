@@ -0,0 +1,240 @@
+/* ssc_rle_test - round trip of the OpenPICC SSC capture run-length coding
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Builds firmware/src/picc/ssc_rle.c as it is, encodes capture buffers
+ * in place the way ssc_picc.c does and expands them again with
+ * ssc_capture.c, the host side used by opcd_test (format in openpcd.h),
+ * both alone and as a complete reply.  Every buffer must come back word
+ * for word, never grow, and be dropped only if it is all idle.  A few
+ * fixed buffers cover the edges (modulation in the first word, single
+ * idle words, a run at the very end), then random ones follow.
+ *
+ *	ssc_rle_test [-n buffers] [-s seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include <openpcd.h>
+
+#include "ssc_capture.h"
+#include "../firmware/src/picc/ssc_rle.h"
+
+#define WORDS		SSC_CAPTURE_WORDS_MAX
+
+static unsigned long tested, raw, dropped, in_bytes, out_bytes;
+
+/* the reply as the firmware sends it, taken apart as opcd_test does */
+static int check_reply(const u_int8_t *enc, int len, unsigned int words,
+		       u_int32_t *out)
+{
+	static u_int8_t reply[sizeof(struct openpcd_hdr) +
+			      sizeof(struct openpcd_ssc_capture) + WORDS * 4];
+	struct openpcd_hdr *hdr = (struct openpcd_hdr *) reply;
+	struct openpcd_ssc_capture cap = {
+		.seq = tested, .words = words,
+		.flags = len < 0 ? 0 : OPENPCD_SSC_F_RLE,
+	}, got;
+
+	if (len < 0)
+		len = words * 4;
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->cmd = OPENPCD_CMD_SSC_READ;
+	memcpy(hdr->data, &cap, sizeof(cap));
+	memcpy(hdr->data + sizeof(cap), enc, len);
+
+	if (ssc_capture_decode(reply, sizeof(*hdr) + sizeof(cap) + len, &got,
+			       out, WORDS) != words)
+		return -1;
+	return memcmp(&got, &cap, sizeof(cap)) ? -1 : 0;
+}
+
+static int check(const u_int32_t *samples, unsigned int words,
+		 const char *what)
+{
+	u_int32_t buf[WORDS], out[WORDS];
+	unsigned int i;
+	int len;
+
+	memcpy(buf, samples, words * 4);
+	len = ssc_rle_encode((u_int8_t *) buf, words);
+	tested++;
+	in_bytes += words * 4;
+
+	if (len == 0) {
+		for (i = 0; i < words; i++)
+			if (samples[i] != SSC_IDLE) {
+				printf("%s: dropped although word %u is 0x%08x\n",
+				       what, i, samples[i]);
+				return -1;
+			}
+		dropped++;
+		return 0;
+	}
+	if (len < 0) {
+		if (memcmp(buf, samples, words * 4)) {
+			printf("%s: left raw but changed\n", what);
+			return -1;
+		}
+		raw++;
+		out_bytes += words * 4;
+	} else if (len > words * 4) {
+		printf("%s: grew from %u to %d bytes\n", what, words * 4, len);
+		return -1;
+	} else {
+		if (ssc_capture_expand((u_int8_t *) buf, len, out,
+				       words) != words) {
+			printf("%s: does not expand to %u words\n", what,
+			       words);
+			return -1;
+		}
+		out_bytes += len;
+	}
+
+	if (check_reply((u_int8_t *) buf, len, words, out) < 0) {
+		printf("%s: reply does not decode\n", what);
+		return -1;
+	}
+	for (i = 0; i < words; i++)
+		if (out[i] != samples[i]) {
+			printf("%s: word %u is 0x%08x, not 0x%08x\n", what, i,
+			       out[i], samples[i]);
+			return -1;
+		}
+
+	return 0;
+}
+
+static void fill(u_int32_t *p, unsigned int from, unsigned int to,
+		 u_int32_t v)
+{
+	while (from < to)
+		p[from++] = v;
+}
+
+static int fixed(void)
+{
+	u_int32_t s[WORDS];
+	int ret = 0, i;
+
+	/* modulation first, then an idle run */
+	fill(s, 0, WORDS, SSC_IDLE);
+	s[0] = s[1] = 0x12345678;
+	fill(s, 16, 40, 0xdeadbeef);
+	ret |= check(s, WORDS, "modulation in words 0-1, idle 2-15");
+
+	fill(s, 0, WORDS, SSC_IDLE);
+	s[0] = 0;
+	ret |= check(s, WORDS, "modulation in word 0 only");
+
+	/* a lone idle word is carried as literal */
+	fill(s, 0, WORDS, 0x0f0f0f0f);
+	s[3] = SSC_IDLE;
+	s[WORDS - 1] = SSC_IDLE;
+	ret |= check(s, WORDS, "single idle words");
+
+	fill(s, 0, WORDS, 0x0f0f0f0f);
+	s[WORDS - 2] = s[WORDS - 1] = SSC_IDLE;
+	ret |= check(s, WORDS, "idle run at the end");
+
+	fill(s, 0, WORDS, SSC_IDLE);
+	s[WORDS - 1] = 0x1;
+	ret |= check(s, WORDS, "modulation in the last word");
+
+	fill(s, 0, WORDS, 0x55555555);
+	ret |= check(s, WORDS, "no idle word at all");
+
+	fill(s, 0, WORDS, SSC_IDLE);
+	ret |= check(s, WORDS, "all idle");
+
+	/* alternating, the worst case that still compresses */
+	fill(s, 0, WORDS, SSC_IDLE);
+	for (i = 0; i < WORDS; i += 3)
+		s[i] = 0x7fffffff;
+	ret |= check(s, WORDS, "one active word in three");
+
+	return ret;
+}
+
+/* idle runs and bursts of modulation of random length */
+static void random_buf(u_int32_t *s, unsigned int words)
+{
+	unsigned int i = 0, n;
+	int active = lrand48() % 2;
+
+	while (i < words) {
+		n = 1 + lrand48() % (lrand48() % 4 ? 8 : 200);
+		if (n > words - i)
+			n = words - i;
+		while (n--) {
+			if (!active)
+				s[i] = SSC_IDLE;
+			else if (lrand48() % 8)
+				s[i] = mrand48();
+			else
+				s[i] = SSC_IDLE;
+			i++;
+		}
+		active = !active;
+	}
+}
+
+static void help(void)
+{
+	printf("ssc_rle_test [-n buffers] [-s seed]\n"
+	       "  -n  random buffers (default 100000)\n");
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long n = 100000, seed = 1, i;
+	u_int32_t s[WORDS];
+	char what[64];
+	int c;
+
+	while ((c = getopt(argc, argv, "n:s:h")) != -1) {
+		switch (c) {
+		case 'n':
+			n = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			help();
+			exit(c == 'h' ? 0 : 2);
+		}
+	}
+
+	if (fixed())
+		return 1;
+
+	srand48(seed);
+	for (i = 0; i < n; i++) {
+		random_buf(s, WORDS);
+		snprintf(what, sizeof(what), "random buffer %lu (seed %lu)",
+			 i, seed);
+		if (check(s, 1 + lrand48() % WORDS, what))
+			return 1;
+	}
+
+	printf("%lu buffers: %lu dropped as idle, %lu sent raw, "
+	       "%lu of %lu bytes left, no errors\n", tested, dropped, raw,
+	       out_bytes, in_bytes);
+	return 0;
+}
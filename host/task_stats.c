@@ -0,0 +1,275 @@
+/* task_stats - show where the OpenPICC spends its CPU time
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * On the CDC tty this sends the 's' command at a fixed rate and prints,
+ * for every task, its share of the CPU and its context switches since the
+ * last dump together with its stack use (see
+ * openpicc/application/taskstats.h). The first dump is shown as it is,
+ * i.e. since the scheduler started. The time the run time accounting
+ * itself took is the number of switches times the cost per switch the
+ * firmware measured at start up.
+ *
+ *	task_stats -i 1000 /dev/ttyACM0
+ *
+ * A file, e.g. from picc_sim -s, is read to its end instead.
+ *
+ * The exit status is 1 if a task got within 16 words of the end of its
+ * stack.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include "../openpicc/application/taskstats.h"
+
+#define STACK_WARN	16
+
+struct snapshot {
+	struct taskstats_dump_header hdr;
+	struct taskstats_record rec[TASKSTATS_MAX_TASKS];
+};
+
+static struct snapshot snaps[2];
+static int cur, have_prev, stack_low;
+static unsigned long dumps;
+
+static const struct taskstats_record *find(const struct snapshot *s, u_int8_t number)
+{
+	unsigned int i;
+
+	for (i = 0; i < s->hdr.count; i++)
+		if (s->rec[i].number == number)
+			return &s->rec[i];
+	return NULL;
+}
+
+static void print_dump(const struct snapshot *s, const struct snapshot *prev)
+{
+	const struct taskstats_record *r, *p;
+	u_int32_t run[TASKSTATS_MAX_TASKS], sw[TASKSTATS_MAX_TASKS];
+	u_int32_t total = 0, switches = 0;
+	double dt;
+	unsigned int i;
+
+	for (i = 0; i < s->hdr.count; i++) {
+		r = &s->rec[i];
+		p = prev ? find(prev, r->number) : NULL;
+		/* Counters wrap, differences of u_int32_t are right anyway */
+		run[i] = p ? r->run_time - p->run_time : r->run_time;
+		sw[i] = p ? r->switches - p->switches : r->switches;
+		total += run[i];
+		switches += sw[i];
+	}
+	dt = (double)total / s->hdr.clock_hz;
+
+	printf("--- dump %lu, %.3f s %s\n", dumps, dt,
+	       prev ? "since the last one" : "since start up");
+	printf("%-16s %3s %3s %2s %7s %10s %10s %10s %11s\n", "task", "#",
+	       "pri", "st", "cpu%", "run ms", "switches", "switches/s",
+	       "stack used");
+	for (i = 0; i < s->hdr.count; i++) {
+		r = &s->rec[i];
+		printf("%-16.16s %3u %3u %2c %7.2f %10.1f %10u %10.1f %5u/%-5u%s\n",
+		       r->name, r->number, r->priority, r->state,
+		       total ? 100.0 * run[i] / total : 0,
+		       1e3 * run[i] / s->hdr.clock_hz, sw[i],
+		       dt > 0 ? sw[i] / dt : 0,
+		       r->stack_depth - r->stack_free, r->stack_depth,
+		       r->stack_free < STACK_WARN ? " !" : "");
+		if (r->stack_free < STACK_WARN)
+			stack_low = 1;
+	}
+	printf("accounting: %u ticks per switch, %.3f%% of the CPU\n",
+	       s->hdr.overhead,
+	       total ? 100.0 * switches * s->hdr.overhead / total : 0);
+	fflush(stdout);
+}
+
+/* Returns 0 or -1 if the dump at buf is not valid */
+static int parse_dump(const u_int8_t *buf, const struct taskstats_dump_header *hdr)
+{
+	struct snapshot *s = &snaps[cur];
+	unsigned int i;
+	u_int32_t sum = 0;
+
+	for (i = 0; i < hdr->count * sizeof(s->rec[0]); i++)
+		sum += buf[sizeof(*hdr) + i];
+	if (sum != hdr->sum || hdr->clock_hz == 0)
+		return -1;
+
+	s->hdr = *hdr;
+	memcpy(s->rec, buf + sizeof(*hdr), hdr->count * sizeof(s->rec[0]));
+	for (i = 0; i < hdr->count; i++)
+		s->rec[i].name[sizeof(s->rec[i].name) - 1] = 0;
+	return 0;
+}
+
+/* Looks for dumps in the data, returns the number of bytes used up */
+static size_t parse(const u_int8_t *buf, size_t len)
+{
+	struct taskstats_dump_header hdr;
+	size_t pos = 0, dlen;
+
+	while (len - pos >= sizeof(hdr)) {
+		memcpy(&hdr, buf + pos, sizeof(hdr));
+		if (hdr.magic != TASKSTATS_DUMP_MAGIC ||
+		    hdr.count > TASKSTATS_MAX_TASKS ||
+		    hdr.record_size != sizeof(struct taskstats_record)) {
+			pos++;
+			continue;
+		}
+		dlen = sizeof(hdr) + hdr.count * hdr.record_size;
+		if (len - pos < dlen)
+			break;
+		if (parse_dump(buf + pos, &hdr) < 0) {
+			pos++;
+			continue;
+		}
+
+		dumps++;
+		print_dump(&snaps[cur], have_prev ? &snaps[cur ^ 1] : NULL);
+		have_prev = 1;
+		cur ^= 1;
+		pos += dlen;
+	}
+	return pos;
+}
+
+static u_int8_t buf[16 * 1024];
+static size_t buf_len;
+
+/* Returns the number of dumps found, -1 at the end of the input */
+static int feed(int fd)
+{
+	unsigned long before = dumps;
+	size_t used;
+	ssize_t ret;
+
+	ret = read(fd, buf + buf_len, sizeof(buf) - buf_len);
+	if (ret <= 0)
+		return ret < 0 && errno == EINTR ? 0 : -1;
+	buf_len += ret;
+	used = parse(buf, buf_len);
+	/* Text in between that will never be part of a dump */
+	if (!used && buf_len == sizeof(buf))
+		used = buf_len - sizeof(struct taskstats_dump_header);
+	memmove(buf, buf + used, buf_len - used);
+	buf_len -= used;
+	return dumps - before;
+}
+
+static unsigned long long now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+static int poll_tty(int fd, unsigned int interval_ms, unsigned long count)
+{
+	struct termios tio;
+	unsigned long long next;
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	int ret;
+
+	if (tcgetattr(fd, &tio) < 0) {
+		perror("tcgetattr");
+		return -1;
+	}
+	cfmakeraw(&tio);
+	if (tcsetattr(fd, TCSANOW, &tio) < 0) {
+		perror("tcsetattr");
+		return -1;
+	}
+
+	next = now_ms();
+	while (!count || dumps < count) {
+		if (write(fd, "s\r", 2) != 2) {
+			perror("write");
+			return -1;
+		}
+		next += interval_ms;
+		/* Take everything until the next request is due */
+		while (now_ms() < next) {
+			ret = poll(&pfd, 1, next - now_ms());
+			if (ret < 0 && errno != EINTR) {
+				perror("poll");
+				return -1;
+			}
+			if (ret > 0 && feed(fd) < 0) {
+				fprintf(stderr, "device gone\n");
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+static void help(void)
+{
+	printf("task_stats [-i ms] [-n count] tty|file\n"
+	       "  -i  poll interval on a tty (default 1000)\n"
+	       "  -n  stop after count dumps\n");
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int interval_ms = 1000;
+	unsigned long count = 0;
+	int c, fd, ret = 0;
+
+	while ((c = getopt(argc, argv, "i:n:h")) != -1) {
+		switch (c) {
+		case 'i':
+			interval_ms = atoi(optarg);
+			break;
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			help();
+			exit(c == 'h' ? 0 : 2);
+		}
+	}
+	if (optind != argc - 1 || interval_ms == 0) {
+		help();
+		exit(2);
+	}
+
+	fd = open(argv[optind], O_RDWR | O_NOCTTY);
+	if (fd < 0)
+		fd = open(argv[optind], O_RDONLY);
+	if (fd < 0) {
+		perror(argv[optind]);
+		exit(2);
+	}
+
+	if (isatty(fd))
+		ret = poll_tty(fd, interval_ms, count);
+	else
+		while (feed(fd) >= 0 && (!count || dumps < count))
+			;
+
+	close(fd);
+	return ret < 0 ? 2 : stack_low;
+}
@@ -0,0 +1,453 @@
+/* timer_test - run the firmware timer wheel and usec timer heap on the host
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Builds firmware/src/os/pit.c and tc_usec.c unmodified against the
+ * fw_stub/ headers, which turn the PIT and TC1 registers into plain
+ * variables.  The test then plays the hardware: it advances jiffies
+ * and the 16 bit TC1 counter and raises the IRQs, while adding,
+ * moving and deleting timers at random, also from the callbacks.
+ *
+ * Every timer must fire exactly once per add, never before its expiry
+ * and no later than the IRQ that passes it (TC1: the 16 tick minimum
+ * sleep), in expiry order, and deleted timers must never fire.  Both
+ * counters are started shortly before they wrap, and expiries reach
+ * several wheel turns and 16 bit TC1 wraps ahead.  TC1 is also reset
+ * by tc_usec_resync() now and then, as the board inits do with their
+ * SYNC of the TC block, which must not disturb the time.
+ *
+ *	timer_test [-n ops] [-s seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+
+#include <AT91SAM7.h>
+#include <os/pit.h>
+#include <os/tc_usec.h>
+#include <os/system_irq.h>
+
+/* private to the firmware, needed to judge lateness */
+#define TC_USEC_MIN_SLEEP	16
+#define USEC_TIMERS_MAX		8
+
+#define PIT_TIMERS		64
+#define USEC_TIMERS		(USEC_TIMERS_MAX + 2)
+
+AT91S_TC host_tc1;
+u_int32_t host_pivr;
+void (*host_tc1_irq)(void);
+static AT91S_TCB tcb;
+static unsigned long syncs;
+
+static sysirq_hdlr *pit_hdlr;
+static const char *failure;
+static unsigned long fired, added, deleted, readded;
+
+void sysirq_register(enum sysirqs irq, sysirq_hdlr *hdlr)
+{
+	if (irq == AT91SAM7_SYSIRQ_PIT)
+		pit_hdlr = hdlr;
+}
+
+AT91PS_TCB host_tcb(void)
+{
+	host_tc1.TC_CV = 0;
+	syncs++;
+	return &tcb;
+}
+
+/* delay_us() keeps the USB going */
+void usb_out_process(void)
+{
+}
+
+static void fail(const char *why)
+{
+	if (!failure)
+		failure = why;
+}
+
+/* PIT timer wheel */
+
+enum cb_kind {
+	CB_PLAIN,
+	CB_READD,	/* re-adds itself */
+	CB_KILL,	/* deletes another pending timer */
+	CB_KIND_MAX,
+};
+
+struct ptimer {
+	struct timer_list tl;
+	enum cb_kind kind;
+	int pending;
+	unsigned long due;	/* bucket it has to fire from */
+};
+
+static struct ptimer pt[PIT_TIMERS];
+static unsigned long last_due, bucket;
+static int in_irq;
+
+static void pt_add(struct ptimer *p, unsigned long expires)
+{
+	p->tl.expires = expires;
+	/* added from a callback at or before the bucket being run, it
+	 * waits for the next one */
+	p->due = expires;
+	if (in_irq && !time_after(expires, bucket))
+		p->due = bucket + 1;
+	timer_add(&p->tl);
+	if (p->pending)
+		readded++;
+	p->pending = 1;
+	added++;
+}
+
+static void pt_del(struct ptimer *p)
+{
+	if (timer_del(&p->tl) != p->pending)
+		fail("timer_del() does not know whether the timer was pending");
+	if (p->pending)
+		deleted++;
+	p->pending = 0;
+}
+
+static void pt_cb(void *data)
+{
+	struct ptimer *p = data, *victim;
+
+	if (!in_irq)
+		fail("timer run outside the PIT IRQ");
+	if (!p->pending)
+		fail("timer fired that was not pending (deleted or fired twice)");
+	if (time_after(p->tl.expires, jiffies))
+		fail("timer fired early");
+	if (time_before(p->due, last_due))
+		fail("timers fired out of order");
+	if (p->tl.pprev)
+		fail("timer still linked in its callback");
+	last_due = bucket = p->due;
+	p->pending = 0;
+	fired++;
+
+	switch (p->kind) {
+	case CB_READD:
+		/* 0 is due at once, 70 is more than two wheel turns */
+		pt_add(p, jiffies + lrand48() % 71);
+		break;
+	case CB_KILL:
+		victim = &pt[lrand48() % PIT_TIMERS];
+		if (victim != p)
+			pt_del(victim);
+		break;
+	default:
+		break;
+	}
+}
+
+static void pit_tick(unsigned int n)
+{
+	int i;
+
+	host_pivr = n << 20;
+	in_irq = 1;
+	pit_hdlr(1);
+	in_irq = 0;
+
+	for (i = 0; i < PIT_TIMERS; i++)
+		if (pt[i].pending && !time_after(pt[i].due, jiffies))
+			fail("timer not fired by the IRQ that passed it");
+}
+
+static int test_pit(unsigned long ops)
+{
+	struct ptimer *p;
+	unsigned long i, wrapped = 0, start;
+	int j;
+
+	/* the wheel wraps a few hundred ticks in */
+	start = jiffies = -500UL;
+	pit_init();
+	last_due = jiffies;
+
+	for (j = 0; j < PIT_TIMERS; j++) {
+		pt[j].tl.function = pt_cb;
+		pt[j].tl.data = &pt[j];
+		pt[j].kind = j % CB_KIND_MAX;
+	}
+
+	for (i = 0; i < ops && !failure; i++) {
+		p = &pt[lrand48() % PIT_TIMERS];
+		switch (lrand48() % 4) {
+		case 0:
+			/* up to six wheel turns ahead */
+			pt_add(p, jiffies + 1 + lrand48() % 200);
+			break;
+		case 1:
+			pt_del(p);
+			break;
+		default:
+			/* the PIT IRQ may be late by a couple of ticks */
+			pit_tick(1 + (lrand48() % 8 ? 0 : lrand48() % 3));
+			if (jiffies < start)
+				wrapped = 1;
+			break;
+		}
+	}
+
+	/* whatever is left has to come out within the longest expiry */
+	for (j = 0; j < PIT_TIMERS; j++)
+		if (pt[j].kind == CB_READD)
+			pt_del(&pt[j]);
+	for (i = 0; i < 256 && !failure; i++)
+		pit_tick(1);
+	for (j = 0; j < PIT_TIMERS; j++)
+		if (pt[j].pending)
+			fail("timer never fired");
+	if (!wrapped)
+		fail("jiffies did not wrap");
+
+	printf("PIT wheel: %lu adds (%lu moved), %lu deleted, %lu fired, "
+	       "jiffies now %lu: %s\n", added, readded, deleted, fired,
+	       jiffies, failure ? failure : "ok");
+
+	return failure ? -1 : 0;
+}
+
+/* TC1 usec timers */
+
+struct utimer {
+	struct usec_timer ut;
+	enum cb_kind kind;
+	int pending;
+};
+
+static struct utimer ut[USEC_TIMERS];
+static unsigned int ut_pending;
+static u_int32_t sim_ticks, irq_seq, last_seq, last_ut_expires;
+static int in_tc_irq;
+
+static int ut_add(struct utimer *u, u_int32_t expires)
+{
+	int ret;
+
+	if (!u->pending && ut_pending == USEC_TIMERS_MAX) {
+		u->ut.expires = expires;
+		if (usec_timer_add(&u->ut) != -ENOSPC)
+			fail("more usec timers than the heap holds");
+		return -ENOSPC;
+	}
+	if (!u->pending)
+		ut_pending++;
+	else
+		readded++;
+	u->pending = 1;
+	added++;
+	u->ut.expires = expires;
+	/* a timer that is due runs right away, in order of its own */
+	if (!in_tc_irq)
+		irq_seq++;
+	ret = usec_timer_add(&u->ut);
+	if (ret)
+		fail("usec_timer_add() failed with room in the heap");
+	return ret;
+}
+
+static void ut_del(struct utimer *u)
+{
+	if (usec_timer_del(&u->ut) != u->pending)
+		fail("usec_timer_del() does not know whether the timer was pending");
+	if (u->pending) {
+		ut_pending--;
+		deleted++;
+	}
+	u->pending = 0;
+}
+
+static void ut_cb(void *data)
+{
+	struct utimer *u = data, *victim;
+	u_int32_t now = tc_usec_now();
+
+	if (!u->pending)
+		fail("usec timer fired that was not pending");
+	if (tc_usec_after(u->ut.expires, now))
+		fail("usec timer fired early");
+	if (u->ut.slot)
+		fail("usec timer still in the heap in its callback");
+	if (irq_seq == last_seq && tc_usec_before(u->ut.expires, last_ut_expires))
+		fail("usec timers fired out of order");
+	last_seq = irq_seq;
+	last_ut_expires = u->ut.expires;
+	u->pending = 0;
+	ut_pending--;
+	fired++;
+
+	switch (u->kind) {
+	case CB_READD:
+		ut_add(u, now + lrand48() % 3000);
+		break;
+	case CB_KILL:
+		victim = &ut[lrand48() % USEC_TIMERS];
+		if (victim != u)
+			ut_del(victim);
+		break;
+	default:
+		break;
+	}
+}
+
+/* let TC1 count on by step ticks, with a compare IRQ if RC is passed */
+static void tc_step(u_int16_t step)
+{
+	u_int16_t old = host_tc1.TC_CV;
+
+	host_tc1.TC_CV = (u_int16_t) (old + step);
+	sim_ticks += step;
+	if ((u_int16_t) (host_tc1.TC_RC - old - 1) < step) {
+		host_tc1.TC_SR = AT91C_TC_CPCS;
+		irq_seq++;
+		in_tc_irq = 1;
+		host_tc1_irq();
+		in_tc_irq = 0;
+		host_tc1.TC_SR = 0;
+	}
+}
+
+static void ut_check(void)
+{
+	u_int32_t now = tc_usec_now();
+	int i;
+
+	if (now != sim_ticks)
+		fail("tc_usec_now() lost track of the counter");
+	for (i = 0; i < USEC_TIMERS; i++)
+		if (ut[i].pending &&
+		    tc_usec_after(now, ut[i].ut.expires + TC_USEC_MIN_SLEEP))
+			fail("usec timer not fired by the compare IRQ");
+}
+
+static int test_usec(unsigned long ops)
+{
+	struct utimer *u;
+	unsigned long i;
+	u_int32_t before;
+	int j, wrapped = 0;
+
+	added = readded = deleted = fired = 0;
+	host_tc1.TC_CV = lrand48() & 0xffff;
+	tc_usec_init();
+	sim_ticks = 0;
+
+	/* no timers: the IRQ still has to come often enough to extend the
+	 * 16 bit counter, run up to just before the 32 bit wrap */
+	while (sim_ticks < 0u - 20000 && !failure) {
+		tc_step(0x7000 + lrand48() % 0x1000);
+		if ((sim_ticks & 0xfffff) < 0x8000)
+			ut_check();
+	}
+	ut_check();
+
+	for (j = 0; j < USEC_TIMERS; j++) {
+		ut[j].ut.function = ut_cb;
+		ut[j].ut.data = &ut[j];
+		ut[j].kind = j % CB_KIND_MAX;
+	}
+
+	for (i = 0; i < ops && !failure; i++) {
+		u = &ut[lrand48() % USEC_TIMERS];
+		switch (lrand48() % 4) {
+		case 0:
+			/* past, close, or several 16 bit wraps ahead */
+			if (lrand48() % 8 == 0)
+				ut_add(u, sim_ticks - lrand48() % 100);
+			else if (lrand48() % 2)
+				ut_add(u, sim_ticks + lrand48() % 64);
+			else
+				ut_add(u, sim_ticks + lrand48() % 300000);
+			break;
+		case 1:
+			if (lrand48() % 64 == 0) {
+				tc_usec_resync();
+				if (tcb.TCB_BCR != AT91C_TCB_SYNC)
+					fail("tc_usec_resync() did not SYNC");
+				ut_check();
+			} else
+				ut_del(u);
+			break;
+		default:
+			before = sim_ticks;
+			tc_step(1 + lrand48() % 300);
+			if (sim_ticks < before)
+				wrapped = 1;
+			ut_check();
+			break;
+		}
+	}
+
+	for (j = 0; j < USEC_TIMERS; j++)
+		if (ut[j].kind == CB_READD)
+			ut_del(&ut[j]);
+	for (i = 0; i < 400000 / 300 && !failure; i++) {
+		tc_step(300);
+		ut_check();
+	}
+	for (j = 0; j < USEC_TIMERS; j++)
+		if (ut[j].pending)
+			fail("usec timer never fired");
+	if (!wrapped)
+		fail("the 32 bit tick count did not wrap");
+
+	printf("TC1 usec: %lu adds (%lu moved), %lu deleted, %lu fired, "
+	       "%u compare IRQs, %lu SYNCs: %s\n", added, readded, deleted,
+	       fired, irq_seq, syncs, failure ? failure : "ok");
+
+	return failure ? -1 : 0;
+}
+
+static void help(void)
+{
+	printf("timer_test [-n ops] [-s seed]\n"
+	       "  -n  random operations per timer service (default 1000000)\n");
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long ops = 1000000, seed = 1;
+	int c;
+
+	while ((c = getopt(argc, argv, "n:s:h")) != -1) {
+		switch (c) {
+		case 'n':
+			ops = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			help();
+			exit(c == 'h' ? 0 : 2);
+		}
+	}
+
+	srand48(seed);
+	if (test_pit(ops) || test_usec(ops))
+		return 1;
+
+	return 0;
+}
@@ -0,0 +1,353 @@
+/* trace_analyse - latency histograms from the OpenPICC event trace
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2
+ *  as published by the Free Software Foundation
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Reads trace dumps (see openpicc/application/trace.h, command 'e' or
+ * picc_sim -t) from files or stdin, skipping whatever text is in
+ * between, and follows every received frame through the stages
+ *
+ *	edge	last pause of the frame, from TC2 at TRACE_RX_DECODED
+ *	decoded	TRACE_RX_DECODED
+ *	queued	TRACE_RX_QUEUED
+ *	armed	TRACE_TX_ARMED
+ *	started	TRACE_TX_STARTED
+ *
+ * A response from the cache is armed by the receive IRQ before the
+ * frame is queued, so armed is measured from decoded.
+ *
+ * For each step the distribution of the time it took is printed, and
+ * with -H a histogram. The latency from a pause to the receiver IRQ
+ * comes from the TC2 value of every TRACE_RX_IRQ. "edge -> armed" is
+ * the time the software needs to have a response ready, it has to stay
+ * below the frame delay time. picc_sim has no SSC TXSYN, its traces
+ * end at armed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "../openpicc/application/trace.h"
+
+#define CARRIER_HZ	13560000
+/* TC2 restarts this many carrier cycles after the start of a pause, see
+ * TC2_RESTART in tc_sniffer.c */
+#define TC2_RESTART	(128/4 + 4 + 20)
+
+enum { ST_EDGE, ST_DECODED, ST_QUEUED, ST_ARMED, ST_STARTED, NUM_STAGES };
+enum { STEP_IRQ, STEP_DECODE, STEP_QUEUE, STEP_LAYER2, STEP_TX_WAIT, STEP_ARMED,
+	STEP_TOTAL, NUM_STEPS };
+
+static const char * const step_names[NUM_STEPS] = {
+	"edge -> IRQ", "edge -> decoded", "decoded -> queued", "decoded -> armed",
+	"armed -> started", "edge -> armed", "edge -> started",
+};
+
+static const char * const id_names[_MAX_TRACE_ID] = {
+	"none", "mark", "rx irq", "decode", "rx decoded", "rx queued",
+	"tx armed", "tx started", "tx ended", "fiq overrun",
+};
+
+struct samples {
+	double *us;
+	unsigned int n, size;
+};
+
+static struct samples steps[NUM_STEPS];
+static int verbose, histograms;
+static double bucket_us = 10;
+static unsigned long dumps, records, lost, frames;
+
+static void add_sample(int step, double us)
+{
+	struct samples *s = &steps[step];
+
+	if (s->n == s->size) {
+		s->size = s->size ? 2 * s->size : 256;
+		s->us = realloc(s->us, s->size * sizeof(s->us[0]));
+		if (!s->us) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	s->us[s->n++] = us;
+}
+
+/* A frame on its way through the stages, times in clock ticks */
+struct frame {
+	int open;
+	u_int64_t t[NUM_STAGES];
+	int have[NUM_STAGES];
+};
+
+static double ticks_to_us(int64_t ticks, u_int32_t clock_hz)
+{
+	return ticks * 1e6 / clock_hz;
+}
+
+static void close_frame(struct frame *f, u_int32_t clock_hz)
+{
+	static const int from[NUM_STEPS] = {
+		[STEP_DECODE] = ST_EDGE, [STEP_QUEUE] = ST_DECODED,
+		[STEP_LAYER2] = ST_DECODED, [STEP_TX_WAIT] = ST_ARMED,
+		[STEP_ARMED] = ST_EDGE, [STEP_TOTAL] = ST_EDGE,
+	};
+	static const int to[NUM_STEPS] = {
+		[STEP_DECODE] = ST_DECODED, [STEP_QUEUE] = ST_QUEUED,
+		[STEP_LAYER2] = ST_ARMED, [STEP_TX_WAIT] = ST_STARTED,
+		[STEP_ARMED] = ST_ARMED, [STEP_TOTAL] = ST_STARTED,
+	};
+	int i;
+
+	if (!f->open)
+		return;
+	for (i = STEP_DECODE; i < NUM_STEPS; i++)
+		if (f->have[from[i]] && f->have[to[i]])
+			add_sample(i, ticks_to_us(f->t[to[i]] - f->t[from[i]], clock_hz));
+	frames++;
+	memset(f, 0, sizeof(*f));
+}
+
+static void analyse(const struct trace_dump_header *hdr, const struct trace_record *rec)
+{
+	const double ticks_per_cycle = (double) hdr->clock_hz / CARRIER_HZ;
+	struct frame f;
+	u_int64_t t = 0, prev = 0;
+	u_int64_t last_mark = 0;
+	unsigned int i;
+
+	memset(&f, 0, sizeof(f));
+	for (i = 0; i < hdr->count; i++) {
+		/* Extend to 64 bit. A record written while the TC1 overflow
+		 * was pending is 0x10000 short, see trace.h. */
+		t = (prev & ~0xffffffffULL) | rec[i].time;
+		if (i && t < prev) {
+			if (t + 0x10000 >= prev)
+				t += 0x10000;
+			else
+				t += 1ULL << 32;
+		}
+		prev = t;
+
+		if (verbose) {
+			printf("%12.3f us  %-12s %u\n", ticks_to_us(t, hdr->clock_hz),
+			       rec[i].id < _MAX_TRACE_ID ? id_names[rec[i].id] : "?",
+			       rec[i].arg);
+			if (rec[i].id == TRACE_MARK && last_mark)
+				printf("%12.3f us since the last mark\n",
+				       ticks_to_us(t - last_mark, hdr->clock_hz));
+		}
+
+		switch (rec[i].id) {
+		case TRACE_MARK:
+			last_mark = t;
+			break;
+		case TRACE_RX_IRQ:
+			add_sample(STEP_IRQ, (rec[i].arg + TC2_RESTART) * 1e6 / CARRIER_HZ);
+			break;
+		case TRACE_RX_DECODED:
+			close_frame(&f, hdr->clock_hz);
+			f.open = 1;
+			f.t[ST_DECODED] = t;
+			f.have[ST_DECODED] = 1;
+			f.t[ST_EDGE] = t - (u_int64_t) ((rec[i].arg + TC2_RESTART) * ticks_per_cycle);
+			f.have[ST_EDGE] = 1;
+			break;
+		case TRACE_RX_QUEUED:
+			if (f.open && !f.have[ST_QUEUED]) {
+				f.t[ST_QUEUED] = t;
+				f.have[ST_QUEUED] = 1;
+			}
+			break;
+		case TRACE_TX_ARMED:
+			if (f.open && !f.have[ST_ARMED]) {
+				f.t[ST_ARMED] = t;
+				f.have[ST_ARMED] = 1;
+			}
+			break;
+		case TRACE_TX_STARTED:
+			if (f.open && !f.have[ST_STARTED]) {
+				f.t[ST_STARTED] = t;
+				f.have[ST_STARTED] = 1;
+			}
+			close_frame(&f, hdr->clock_hz);
+			break;
+		}
+	}
+	close_frame(&f, hdr->clock_hz);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+	return x < y ? -1 : x > y;
+}
+
+static void print_histogram(const struct samples *s)
+{
+	unsigned int counts[64], i, n, max = 0;
+	double lo = s->us[0];
+	int b;
+
+	lo = bucket_us * (int) (lo / bucket_us);
+	memset(counts, 0, sizeof(counts));
+	for (i = 0; i < s->n; i++) {
+		b = (s->us[i] - lo) / bucket_us;
+		if (b > 63)
+			b = 63;
+		if (++counts[b] > max)
+			max = counts[b];
+	}
+	for (b = 63; b > 0 && !counts[b]; b--)
+		;
+	for (i = 0; i <= (unsigned int) b; i++) {
+		printf("  %8.1f%s %7u ", lo + i * bucket_us, i == 63 ? "+" : " ",
+		       counts[i]);
+		for (n = 0; n < counts[i] * 50 / max; n++)
+			putchar('#');
+		putchar('\n');
+	}
+}
+
+static void report(void)
+{
+	int i;
+
+	printf("%lu dumps, %lu records, %lu lost, %lu frames\n",
+	       dumps, records, lost, frames);
+	printf("%-18s %7s %9s %9s %9s %9s %9s  (us)\n", "", "n", "min", "avg",
+	       "p50", "p99", "max");
+	for (i = 0; i < NUM_STEPS; i++) {
+		struct samples *s = &steps[i];
+		double sum = 0;
+		unsigned int j;
+
+		if (!s->n) {
+			printf("%-18s %7u\n", step_names[i], 0);
+			continue;
+		}
+		qsort(s->us, s->n, sizeof(s->us[0]), cmp_double);
+		for (j = 0; j < s->n; j++)
+			sum += s->us[j];
+		printf("%-18s %7u %9.1f %9.1f %9.1f %9.1f %9.1f\n", step_names[i],
+		       s->n, s->us[0], sum / s->n, s->us[s->n / 2],
+		       s->us[(s->n * 99) / 100], s->us[s->n - 1]);
+	}
+
+	if (!histograms)
+		return;
+	for (i = 0; i < NUM_STEPS; i++) {
+		if (!steps[i].n)
+			continue;
+		printf("\n%s\n", step_names[i]);
+		print_histogram(&steps[i]);
+	}
+}
+
+/* Look for dumps in the data, returns the number of bytes used up */
+static size_t parse(const u_int8_t *buf, size_t len)
+{
+	struct trace_dump_header hdr;
+	size_t pos = 0, rlen;
+
+	while (len - pos >= sizeof(hdr)) {
+		memcpy(&hdr, buf + pos, sizeof(hdr));
+		if (hdr.magic != TRACE_DUMP_MAGIC || hdr.count > TRACE_RECORDS ||
+		    hdr.clock_hz == 0) {
+			pos++;
+			continue;
+		}
+		rlen = sizeof(hdr) + hdr.count * sizeof(struct trace_record);
+		if (len - pos < rlen)
+			break;
+
+		dumps++;
+		records += hdr.count;
+		lost += hdr.lost;
+		if (verbose)
+			printf("dump of %u records at %u Hz, %u lost\n", hdr.count,
+			       hdr.clock_hz, hdr.lost);
+		analyse(&hdr, (const struct trace_record *) (buf + pos + sizeof(hdr)));
+		pos += rlen;
+	}
+	return pos;
+}
+
+static int read_file(FILE *in)
+{
+	static u_int8_t buf[64 * 1024];
+	size_t len = 0, ret, used;
+
+	while ((ret = fread(buf + len, 1, sizeof(buf) - len, in)) > 0) {
+		len += ret;
+		used = parse(buf, len);
+		memmove(buf, buf + used, len - used);
+		len -= used;
+	}
+	return ferror(in) ? -1 : 0;
+}
+
+static void help(void)
+{
+	printf("trace_analyse [-v] [-H] [-b us] [file ...]\n"
+	       "  -v  print every record\n"
+	       "  -H  print histograms\n"
+	       "  -b  histogram bucket width in us (default %.0f)\n", bucket_us);
+}
+
+int main(int argc, char **argv)
+{
+	FILE *in;
+	int c, i, ret = 0;
+
+	while ((c = getopt(argc, argv, "vHb:h")) != -1) {
+		switch (c) {
+		case 'v':
+			verbose = 1;
+			break;
+		case 'H':
+			histograms = 1;
+			break;
+		case 'b':
+			bucket_us = atof(optarg);
+			if (bucket_us <= 0) {
+				help();
+				exit(2);
+			}
+			break;
+		default:
+			help();
+			exit(c == 'h' ? 0 : 2);
+		}
+	}
+
+	if (optind == argc) {
+		ret = read_file(stdin);
+	} else {
+		for (i = optind; i < argc; i++) {
+			in = fopen(argv[i], "rb");
+			if (!in || read_file(in) < 0) {
+				perror(argv[i]);
+				ret = -1;
+			}
+			if (in)
+				fclose(in);
+		}
+	}
+
+	report();
+	return ret < 0;
+}
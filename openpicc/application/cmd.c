@@ -24,6 +24,10 @@
 #include "load_modulation.h"
 #include "tc_sniffer.h"
 #include "iso14443a_pretender.h"
+#include "trace.h"
+#include "metrics.h"
+#include "taskstats.h"
+#include "ctrl.h"
 
 xQueueHandle xCmdQueue;
 xTaskHandle xCmdTask;
@@ -48,7 +52,7 @@ static const portBASE_TYPE USE_COLON_FOR_LONG_COMMANDS = 0;
 /* When not USE_COLON_FOR_LONG_COMMANDS then short commands will be recognized by including
  * their character in the string SHORT_COMMANDS
  * */
-static const char *SHORT_COMMANDS = "!prc+-l?hq9fjka#i";
+static const char *SHORT_COMMANDS = "!prc+-l?hq9fjka#iw";
 /* Note that the long/short command distinction only applies to the USB serial console
  * */
 
@@ -64,8 +68,7 @@ void DumpUIntToUSB(unsigned int data)
         i++;
     } while(data);
 
-    while(i--)
-        usb_print_char(*p++);
+    usb_print_buffer((char*)p, 0, i);
 }
 /**********************************************************************/
 
@@ -82,11 +85,17 @@ static inline unsigned char HexChar(unsigned char nibble)
 
 void DumpBufferToUSB(char* buffer, int len)
 {
-    int i;
+    char hex[32];
+    int i, n = 0;
 
+    /* Hand the digits over in pieces, not one character at a time */
     for(i=0; i<len; i++) {
-	usb_print_char(HexChar( *buffer  >>   4));
-	usb_print_char(HexChar( *buffer++ & 0xf));
+	hex[n++] = HexChar( *buffer  >>   4);
+	hex[n++] = HexChar( *buffer++ & 0xf);
+	if(n == sizeof(hex) || i == len-1) {
+	    usb_print_buffer(hex, 0, n);
+	    n = 0;
+	}
     }
 }
 /**********************************************************************/
@@ -292,18 +301,8 @@ void prvExecCommand(u_int32_t cmd, portCHAR *args) {
 		    DumpStringToUSB(" * load_mod_level: ");
 		    DumpUIntToUSB(load_mod_level_set);
 		    DumpStringToUSB("\n\r");
-		    DumpStringToUSB(" * SSC performance metrics:\n\r");
-		    for(i=0; i<_MAX_METRICS; i++) {
-		    	char *name; 
-		    	int value;
-		    	if(ssc_get_metric(i, &name, &value)) {
-		    		DumpStringToUSB(" * \t");
-		    		DumpStringToUSB(name);
-		    		DumpStringToUSB(": ");
-		    		DumpUIntToUSB(value);
-		    		DumpStringToUSB("\n\r");
-		    	}
-		    }
+		    DumpStringToUSB(" * Metrics:\n\r");
+		    metrics_print();
 		    DumpStringToUSB(" * SSC status: ");
 		    DumpUIntToUSB(AT91C_BASE_SSC->SSC_SR);
 		    DumpStringToUSB("\n\r");
@@ -420,6 +419,14 @@ void prvExecCommand(u_int32_t cmd, portCHAR *args) {
 		    else { DumpStringToUSB("+"); DumpUIntToUSB(fdt_offset); }
 		    DumpStringToUSB("\n\r");
 		    break;
+		case 'W':
+		    env.fdt_offset = fdt_offset;
+		    env.comparator = da_get_value();
+		    if(env_store() < 0)
+			DumpStringToUSB("Storing the settings failed\n\r");
+		    else
+			DumpStringToUSB("Settings stored\n\r");
+		    break;
 		case 'F':
 		    startstop_field_meter();
 		    break;
@@ -434,6 +441,18 @@ void prvExecCommand(u_int32_t cmd, portCHAR *args) {
 		    DumpStringToUSB((char*)pcWriteBuffer);
 		    break;
 #endif
+		case 'E':
+		    if(trace_dump() < 0)
+			DumpStringToUSB(" * Trace dump failed, busy or USB down\n\r");
+		    break;
+		case 'M':
+		    if(metrics_dump() < 0)
+			DumpStringToUSB(" * Metrics dump failed\n\r");
+		    break;
+		case 'S':
+		    if(taskstats_dump() < 0)
+			DumpStringToUSB(" * Task stats dump failed\n\r");
+		    break;
 		case 'Q':
 		    //BROKEN new ssc code
 			//ssc_rx_start();
@@ -467,6 +486,10 @@ void prvExecCommand(u_int32_t cmd, portCHAR *args) {
 			" * t    - print task list and stack usage\n\r"
 #endif
 			" * c    - print configuration\n\r"
+			" * e    - dump the event trace (host/trace_analyse)\n\r"
+			" * m    - dump the metrics (host/metrics_poll)\n\r"
+			" * s    - dump the task run times (host/task_stats)\n\r"
+			" * 0xc5 - starts a binary control request (host/picc_ctrl)\n\r"
 			" * +,-  - decrease/increase comparator threshold\n\r"
 		    " * #    - switch clock\n\r"
 			" * l    - cycle LEDs\n\r"
@@ -480,6 +503,7 @@ void prvExecCommand(u_int32_t cmd, portCHAR *args) {
 			" * d div- set tc_cdiv divider value 16, 32, 64, ...\n\r"
 			" * j,k  - increase, decrease fdt_offset\n\r"
 			" * a    - change load modulation level\n\r"
+			" * w    - store fdt_offset and comparator threshold in flash\n\r"
 			" * g 0/1- disable or enable SSC_DATA through gate\n\r"
 			" * 9    - reset CPU\n\r"
 			" * ?,h  - display this help screen\n\r"
@@ -539,6 +563,10 @@ void vCmdRecvUsbCode(void *pvParameters) {
     
 	for( ;; ) {
 		if(vUSBRecvByte(&next_command.command[len], 1, 100)) {
+			if(len == 0 && (u_int8_t)next_command.command[0] == CTRL_SYNC_REQUEST) {
+				ctrl_receive();
+				continue;
+			}
 			if(USE_COLON_FOR_LONG_COMMANDS) {
 				if(len == 0 && next_command.command[len] == ':')
 					short_command = 0;
@@ -16,5 +16,6 @@ extern void DumpStringToUSB(const char *string);
 extern void DumpBufferToUSB(char* buffer, int len);
 extern void DumpTimeToUSB(long ticks);
 extern xQueueHandle xCmdQueue;
+extern volatile int load_mod_level_set;
 
 #endif /*CMD_H_*/
@@ -0,0 +1,504 @@
+/***************************************************************
+ *
+ * OpenPICC - binary control channel
+ *
+ * The text console is fine for a human but slow and awkward to
+ * drive from a script: every change is a round trip, most
+ * settings can only be stepped by one and the answers have to
+ * be scraped from the echo. This channel takes length prefixed
+ * requests on the same CDC endpoints (see ctrl_proto.h) with any
+ * number of typed get, set and add operations on the parameters
+ * below and answers all of them in one response, so a host tool
+ * can read or change the whole state of the PICC in a single
+ * round trip.
+ *
+ * The requests are recognised by the USB command task from their
+ * first byte, which is never typed on the console, and executed
+ * right there; they do not go through xCmdQueue.
+ *
+ ***************************************************************
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; version 2.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <USB-CDC.h>
+#include <board.h>
+#include <errno.h>
+#include <string.h>
+
+#include "openpicc.h"
+#include "ctrl.h"
+#include "cmd.h"
+#include "led.h"
+#include "da.h"
+#include "adc.h"
+#include "pll.h"
+#include "tc_cdiv.h"
+#include "tc_cdiv_sync.h"
+#include "pio_irq.h"
+#include "ssc.h"
+#include "clock_switch.h"
+#include "load_modulation.h"
+#include "iso14443_layer3a.h"
+#include "iso14443a_pretender.h"
+#include "metrics.h"
+
+/* For the rest of a request once the sync byte is in */
+#define CTRL_RECV_TIMEOUT	(100/portTICK_RATE_MS)
+
+DEFINE_METRIC_COUNTER(ctrl_requests, "ctrl.requests", 0);
+DEFINE_METRIC_COUNTER(ctrl_bad_requests, "ctrl.bad_requests", METRIC_F_ERROR);
+
+/* Values are passed to the accessors in the native type of the parameter:
+ * u_int8_t, u_int16_t, u_int32_t, s_int32_t or u_int8_t[size]. They
+ * return 0 or a negative errno value. */
+struct ctrl_param_desc {
+	const char *name;
+	u_int8_t type;
+	u_int8_t size;
+	int (*get)(void *value);
+	int (*set)(const void *value);
+};
+
+static int get_uid(void *value)
+{
+	return get_UID(value, 4) < 0 ? -EIO : 0;
+}
+
+static int set_uid(const void *value)
+{
+	u_int8_t uid[4];
+	int ret;
+	memcpy(uid, value, sizeof(uid));
+	taskENTER_CRITICAL();
+	ret = set_UID(uid, sizeof(uid));
+	taskEXIT_CRITICAL();
+	return ret < 0 ? ret : 0;
+}
+
+static int get_nonce_param(void *value)
+{
+	return get_nonce(value, 4) < 0 ? -EIO : 0;
+}
+
+static int set_nonce_param(const void *value)
+{
+	u_int8_t nonce[4];
+	int ret;
+	memcpy(nonce, value, sizeof(nonce));
+	taskENTER_CRITICAL();
+	ret = set_nonce(nonce, sizeof(nonce));
+	taskEXIT_CRITICAL();
+	return ret < 0 ? ret : 0;
+}
+
+static int get_fdt_offset(void *value)
+{
+	*(s_int32_t*)value = fdt_offset;
+	return 0;
+}
+
+static int set_fdt_offset(const void *value)
+{
+	fdt_offset = *(const s_int32_t*)value;
+	return 0;
+}
+
+static int get_load_mod_level(void *value)
+{
+	*(u_int8_t*)value = load_mod_level_set;
+	return 0;
+}
+
+static int set_load_mod_level(const void *value)
+{
+	u_int8_t level = *(const u_int8_t*)value;
+	if(level > 3)
+		return -EINVAL;
+	load_mod_level_set = level;
+	load_mod_level(level);
+	return 0;
+}
+
+static int get_comparator(void *value)
+{
+	*(u_int8_t*)value = da_get_value();
+	return 0;
+}
+
+static int set_comparator(const void *value)
+{
+	da_comp_carr(*(const u_int8_t*)value);
+	return 0;
+}
+
+static int set_cdiv_divider(const void *value)
+{
+	u_int16_t div = *(const u_int16_t*)value;
+	if(div == 0)
+		return -EINVAL;
+	tc_cdiv_set_divider(div);
+	return 0;
+}
+
+static int set_cdiv_sync(const void *value)
+{
+	if(*(const u_int8_t*)value)
+		tc_cdiv_sync_enable();
+	else
+		tc_cdiv_sync_disable();
+	return 0;
+}
+
+static int set_ssc_gate(const void *value)
+{
+	if(!OPENPICC->features.data_gating)
+		return -ENODEV;
+	ssc_set_gate(*(const u_int8_t*)value);
+	return 0;
+}
+
+static int get_pll_inhibit(void *value)
+{
+	*(u_int8_t*)value = pll_is_inhibited() ? 1 : 0;
+	return 0;
+}
+
+static int set_pll_inhibit(const void *value)
+{
+	pll_inhibit(*(const u_int8_t*)value);
+	return 0;
+}
+
+static int set_clock(const void *value)
+{
+	u_int8_t clock = *(const u_int8_t*)value;
+	if(!OPENPICC->features.clock_switching)
+		return -ENODEV;
+	if(clock != CLOCK_SELECT_PLL && clock != CLOCK_SELECT_CARRIER)
+		return -EINVAL;
+	clock_switch(clock);
+	return 0;
+}
+
+static int set_leds(const void *value)
+{
+	u_int8_t leds = *(const u_int8_t*)value;
+	vLedSetRed(leds & 0x01);
+	vLedSetGreen((leds & 0x02) != 0);
+	return 0;
+}
+
+static int get_field_strength(void *value)
+{
+	*(u_int16_t*)value = adc_get_field_strength();
+	return 0;
+}
+
+static int get_pll_locked(void *value)
+{
+	*(u_int8_t*)value = pll_is_locked() ? 1 : 0;
+	return 0;
+}
+
+static int get_pio_irqs(void *value)
+{
+	*(u_int32_t*)value = pio_irq_get_count();
+	return 0;
+}
+
+static int get_uptime(void *value)
+{
+	*(u_int32_t*)value = xTaskGetTickCount() * portTICK_RATE_MS;
+	return 0;
+}
+
+static const struct ctrl_param_desc params[_MAX_CTRL_PARAM] = {
+	[CTRL_P_UID] = { "uid", CTRL_T_BYTES, 4, get_uid, set_uid },
+	[CTRL_P_NONCE] = { "nonce", CTRL_T_BYTES, 4, get_nonce_param, set_nonce_param },
+	[CTRL_P_FDT_OFFSET] = { "fdt_offset", CTRL_T_S32, 4, get_fdt_offset, set_fdt_offset },
+	[CTRL_P_LOAD_MOD_LEVEL] = { "load_mod_level", CTRL_T_U8, 1, get_load_mod_level, set_load_mod_level },
+	[CTRL_P_COMPARATOR] = { "comparator", CTRL_T_U8, 1, get_comparator, set_comparator },
+	[CTRL_P_CDIV_DIVIDER] = { "cdiv_divider", CTRL_T_U16, 2, NULL, set_cdiv_divider },
+	[CTRL_P_CDIV_SYNC] = { "cdiv_sync", CTRL_T_U8, 1, NULL, set_cdiv_sync },
+	[CTRL_P_SSC_GATE] = { "ssc_gate", CTRL_T_U8, 1, NULL, set_ssc_gate },
+	[CTRL_P_PLL_INHIBIT] = { "pll_inhibit", CTRL_T_U8, 1, get_pll_inhibit, set_pll_inhibit },
+	[CTRL_P_CLOCK] = { "clock", CTRL_T_U8, 1, NULL, set_clock },
+	[CTRL_P_LEDS] = { "leds", CTRL_T_U8, 1, NULL, set_leds },
+	[CTRL_P_FIELD_STRENGTH] = { "field_strength", CTRL_T_U16, 2, get_field_strength, NULL },
+	[CTRL_P_PLL_LOCKED] = { "pll_locked", CTRL_T_U8, 1, get_pll_locked, NULL },
+	[CTRL_P_PIO_IRQS] = { "pio_irqs", CTRL_T_U32, 4, get_pio_irqs, NULL },
+	[CTRL_P_UPTIME] = { "uptime", CTRL_T_U32, 4, get_uptime, NULL },
+};
+
+/* Large enough for any value and for struct ctrl_info with the name */
+#define CTRL_MAX_VALUE	32
+
+union ctrl_value {
+	u_int8_t u8;
+	u_int16_t u16;
+	u_int32_t u32;
+	s_int32_t s32;
+	u_int8_t bytes[CTRL_MAX_VALUE];
+};
+
+static unsigned int param_flags(const struct ctrl_param_desc *p)
+{
+	return (p->get ? CTRL_F_READ : 0) | (p->set ? CTRL_F_WRITE : 0);
+}
+
+/* Adds delta to the value, refusing results that do not fit the type.
+ * A 4 byte array is taken as one little endian word, so that e.g. the UID
+ * can be stepped through. */
+static int add_value(const struct ctrl_param_desc *p, union ctrl_value *v, s_int32_t delta)
+{
+	s_int32_t n;
+	switch(p->type) {
+	case CTRL_T_U8:
+		n = v->u8 + delta;
+		if(n < 0 || n > 0xff)
+			return -ERANGE;
+		v->u8 = n;
+		return 0;
+	case CTRL_T_U16:
+		n = v->u16 + delta;
+		if(n < 0 || n > 0xffff)
+			return -ERANGE;
+		v->u16 = n;
+		return 0;
+	case CTRL_T_U32:
+	case CTRL_T_S32:
+		v->u32 += delta;
+		return 0;
+	case CTRL_T_BYTES:
+		if(p->size != 4)
+			return -EINVAL;
+		v->u32 += delta;
+		return 0;
+	}
+	return -EINVAL;
+}
+
+/* Executes one operation, the value in v is replaced by the answer and
+ * *len set to its length. Returns 0 or a negative errno value. */
+static int execute_op(const struct ctrl_op *op, union ctrl_value *v, unsigned int *len)
+{
+	const struct ctrl_param_desc *p;
+	struct ctrl_info *info;
+	s_int32_t delta;
+	int ret;
+
+	*len = 0;
+	if(op->param >= _MAX_CTRL_PARAM)
+		return -ENOENT;
+	p = &params[op->param];
+
+	switch(op->op) {
+	case CTRL_OP_INFO:
+		if(op->len != 0)
+			return -EINVAL;
+		info = (struct ctrl_info*)v->bytes;
+		info->type = p->type;
+		info->size = p->size;
+		info->flags = param_flags(p);
+		*len = strlen(p->name);
+		if(*len > CTRL_MAX_VALUE - sizeof(*info))
+			*len = CTRL_MAX_VALUE - sizeof(*info);
+		memcpy(info->name, p->name, *len);
+		*len += sizeof(*info);
+		return 0;
+	case CTRL_OP_GET:
+		if(op->len != 0)
+			return -EINVAL;
+		if(!p->get)
+			return -EPERM;
+		break;
+	case CTRL_OP_SET:
+		if(op->len != p->size)
+			return -EINVAL;
+		if(!p->set)
+			return -EPERM;
+		if((ret = p->set(v)) < 0)
+			return ret;
+		/* Write only: the value as it was set */
+		if(!p->get) {
+			*len = p->size;
+			return 0;
+		}
+		break;
+	case CTRL_OP_ADD:
+		if(op->len != sizeof(delta))
+			return -EINVAL;
+		if(!p->get || !p->set)
+			return -EPERM;
+		delta = v->s32;
+		if((ret = p->get(v)) < 0)
+			return ret;
+		if((ret = add_value(p, v, delta)) < 0)
+			return ret;
+		if((ret = p->set(v)) < 0)
+			return ret;
+		break;
+	default:
+		return -ENOSYS;
+	}
+
+	if((ret = p->get(v)) < 0)
+		return ret;
+	*len = p->size;
+	return 0;
+}
+
+/* The biggest answer an operation can have */
+static unsigned int result_space(const struct ctrl_op *op)
+{
+	if(op->param >= _MAX_CTRL_PARAM)
+		return 0;
+	if(op->op == CTRL_OP_INFO)
+		return CTRL_MAX_VALUE;
+	return params[op->param].size;
+}
+
+static struct {
+	struct ctrl_header hdr;
+	u_int8_t payload[CTRL_MAX_PAYLOAD];
+} __attribute__ ((packed)) request, response;
+
+static xUSB_TX_DESCRIPTOR response_desc;
+static volatile int response_busy;
+
+/* Called by the USB task once the response is in the FIFO */
+static void response_done(xUSB_TX_DESCRIPTOR *desc)
+{
+	(void)desc;
+	response_busy = 0;
+}
+
+static u_int16_t checksum(const u_int8_t *data, unsigned int len)
+{
+	u_int16_t sum = 0;
+	while(len--)
+		sum += *data++;
+	return sum;
+}
+
+/* Checks that the operations exactly fill the payload, so that nothing is
+ * executed from a request that is cut short or garbled */
+static int check_request(void)
+{
+	const struct ctrl_op *op;
+	unsigned int pos = 0, i;
+
+	if(checksum(request.payload, request.hdr.length) != request.hdr.sum)
+		return -EBADMSG;
+	for(i = 0; i < request.hdr.count; i++) {
+		if(pos + sizeof(*op) > request.hdr.length)
+			return -EINVAL;
+		op = (const struct ctrl_op*)(request.payload + pos);
+		if(op->len > CTRL_MAX_VALUE)
+			return -EINVAL;
+		pos += sizeof(*op) + op->len;
+	}
+	return pos == request.hdr.length ? 0 : -EINVAL;
+}
+
+/* Executes the operations of the request into the response. An operation
+ * whose answer might not fit any more is answered with ENOSPC and ends
+ * the request. */
+static void execute_request(void)
+{
+	struct ctrl_op op;
+	struct ctrl_result res;
+	union ctrl_value v;
+	unsigned int pos = 0, out = 0, len, i;
+	int ret;
+
+	for(i = 0; i < request.hdr.count; i++) {
+		memcpy(&op, request.payload + pos, sizeof(op));
+		memcpy(v.bytes, request.payload + pos + sizeof(op), op.len);
+		pos += sizeof(op) + op.len;
+
+		if(out + sizeof(res) > sizeof(response.payload))
+			break;
+		if(out + sizeof(res) + result_space(&op) > sizeof(response.payload)) {
+			ret = -ENOSPC;
+			len = 0;
+		} else
+			ret = execute_op(&op, &v, &len);
+
+		res.op = op.op;
+		res.param = op.param;
+		res.status = -ret;
+		res.len = ret < 0 ? 0 : len;
+		memcpy(response.payload + out, &res, sizeof(res));
+		memcpy(response.payload + out + sizeof(res), v.bytes, res.len);
+		out += sizeof(res) + res.len;
+		if(ret == -ENOSPC) {
+			i++;
+			break;
+		}
+	}
+	response.hdr.count = i;
+	response.hdr.length = out;
+}
+
+void ctrl_receive(void)
+{
+	u_int8_t *hdr = (u_int8_t*)&request.hdr;
+	unsigned int rest = sizeof(request.hdr) - 1;
+	int ret;
+
+	/* The sync byte has been read by the caller */
+	if(vUSBRecvByte((portCHAR*)hdr + 1, rest, CTRL_RECV_TIMEOUT) != (portLONG)rest)
+		goto bad;
+	if(request.hdr.length > sizeof(request.payload))
+		goto bad;
+	if(vUSBRecvByte((portCHAR*)request.payload, request.hdr.length, CTRL_RECV_TIMEOUT)
+			!= (portLONG)request.hdr.length)
+		goto bad;
+	metric_inc(ctrl_requests);
+
+	/* Only one response can be in flight, wait for the last one */
+	while(response_busy)
+		vTaskDelay(1);
+	response_busy = 1;
+
+	response.hdr.sync = CTRL_SYNC_RESPONSE;
+	response.hdr.seq = request.hdr.seq;
+	if((ret = check_request()) < 0) {
+		metric_inc(ctrl_bad_requests);
+		response.hdr.status = -ret;
+		response.hdr.count = 0;
+		response.hdr.length = 0;
+	} else {
+		response.hdr.status = 0;
+		execute_request();
+	}
+	response.hdr.sum = checksum(response.payload, response.hdr.length);
+
+	response_desc.pucData = (const unsigned portCHAR *)&response;
+	response_desc.usLength = sizeof(response.hdr) + response.hdr.length;
+	response_desc.vRelease = response_done;
+	if(xUSBSendDescriptor(&response_desc, portMAX_DELAY) != pdPASS)
+		response_busy = 0;
+	return;
+
+bad:
+	/* Without a complete header there is nobody to answer to; the host
+	 * times out and the bytes that follow are taken as text */
+	metric_inc(ctrl_bad_requests);
+}
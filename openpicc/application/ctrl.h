@@ -0,0 +1,13 @@
+#ifndef CTRL_H_
+#define CTRL_H_
+
+#include "ctrl_proto.h"
+
+/* Binary control channel, see ctrl.c and ctrl_proto.h */
+
+/* Called by the USB command task once it has read CTRL_SYNC_REQUEST as
+ * the first byte of a command. Reads the rest of the request, executes it
+ * and sends the answer. */
+extern void ctrl_receive(void);
+
+#endif /*CTRL_H_*/
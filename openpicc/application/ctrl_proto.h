@@ -0,0 +1,94 @@
+#ifndef CTRL_PROTO_H_
+#define CTRL_PROTO_H_
+
+/* Binary control channel of the OpenPICC, see ctrl.c. Shares the CDC
+ * endpoints with the text console and is driven by host/picc_ctrl.c.
+ *
+ * A request is a struct ctrl_header with sync CTRL_SYNC_REQUEST followed
+ * by length bytes of operations, each a struct ctrl_op and len value
+ * bytes. The sync byte is not ASCII, so it never starts a typed command.
+ * The answer is a struct ctrl_header with sync CTRL_SYNC_RESPONSE and the
+ * seq of the request, followed by one struct ctrl_result and its value
+ * per operation, in the order of the request. Operations are executed
+ * one after the other; one that fails does not stop the others. If the
+ * request itself is bad the answer carries no results and status in the
+ * header says why.
+ *
+ * sum is the 16 bit sum of the bytes after the header. Multi-byte fields
+ * and values are little endian, like the ARM7. */
+
+#define CTRL_SYNC_REQUEST	0xc5
+#define CTRL_SYNC_RESPONSE	0xc6
+
+#define CTRL_MAX_PAYLOAD	256
+
+struct ctrl_header {
+	u_int8_t sync;
+	u_int8_t seq;		/* chosen by the host, echoed */
+	u_int16_t length;	/* of what follows */
+	u_int16_t sum;
+	u_int8_t status;	/* response: 0 or an errno value for the
+				 * request as a whole, request: 0 */
+	u_int8_t count;		/* operations or results that follow */
+} __attribute__ ((packed));
+
+enum ctrl_opcode {
+	CTRL_OP_GET = 1,	/* no value, returns the value */
+	CTRL_OP_SET,		/* value of the parameter's size, returns the
+				 * value read back */
+	CTRL_OP_ADD,		/* s32 to add, integer and 4 byte parameters,
+				 * returns the new value */
+	CTRL_OP_INFO,		/* no value, returns struct ctrl_info */
+};
+
+struct ctrl_op {
+	u_int8_t op;
+	u_int8_t param;		/* enum ctrl_param */
+	u_int8_t len;		/* of the value that follows */
+} __attribute__ ((packed));
+
+struct ctrl_result {
+	u_int8_t op;
+	u_int8_t param;
+	u_int8_t status;	/* 0 or an errno value */
+	u_int8_t len;		/* of the value that follows */
+} __attribute__ ((packed));
+
+enum ctrl_type {
+	CTRL_T_U8,
+	CTRL_T_U16,
+	CTRL_T_U32,
+	CTRL_T_S32,
+	CTRL_T_BYTES,
+};
+
+#define CTRL_F_READ	0x01
+#define CTRL_F_WRITE	0x02
+
+struct ctrl_info {
+	u_int8_t type;		/* enum ctrl_type */
+	u_int8_t size;		/* of the value */
+	u_int8_t flags;		/* CTRL_F_* */
+	char name[0];		/* up to the end of the value */
+} __attribute__ ((packed));
+
+enum ctrl_param {
+	CTRL_P_UID,		/* bytes[4], as sent in the anticollision */
+	CTRL_P_NONCE,		/* bytes[4] */
+	CTRL_P_FDT_OFFSET,	/* s32, carrier cycles */
+	CTRL_P_LOAD_MOD_LEVEL,	/* u8, 0 to 3 */
+	CTRL_P_COMPARATOR,	/* u8, threshold of the carrier comparator */
+	CTRL_P_CDIV_DIVIDER,	/* u16, write only */
+	CTRL_P_CDIV_SYNC,	/* u8, enable tc_cdiv_sync, write only */
+	CTRL_P_SSC_GATE,	/* u8, pass SSC_DATA, write only */
+	CTRL_P_PLL_INHIBIT,	/* u8 */
+	CTRL_P_CLOCK,		/* u8, enum clock_source, write only */
+	CTRL_P_LEDS,		/* u8, bit 0 red, bit 1 green, write only */
+	CTRL_P_FIELD_STRENGTH,	/* u16, ADC reading, read only */
+	CTRL_P_PLL_LOCKED,	/* u8, read only */
+	CTRL_P_PIO_IRQS,	/* u32, read only */
+	CTRL_P_UPTIME,		/* u32, ms, read only */
+	_MAX_CTRL_PARAM
+};
+
+#endif /*CTRL_PROTO_H_*/
@@ -0,0 +1,3 @@
+/* The table driven decoders are shared with the OpenPCD firmware tree,
+ * see firmware/src/picc/decoder_tab.c and decoder_tab.py there */
+#include "../../firmware/src/picc/decoder_tab.c"
@@ -0,0 +1 @@
+#include "../../firmware/src/picc/decoder_tab.h"
@@ -2,6 +2,11 @@
  *
  * OpenBeacon.org - flash routines for persistent environment
  *
+ * The environment is kept in the log of env_log.c in the
+ * ENVIRONMENT_SIZE bytes at the end of the flash, this file
+ * drives the flash controller for it and maps the fields of
+ * TEnvironment onto keys of the log.
+ *
  * Copyright 2007 Milosch Meriac <meriac@openbeacon.de>
  *
  ***************************************************************
@@ -24,8 +29,11 @@
 #include <AT91SAM7.h>
 #include <lib_AT91SAM7.h>
 #include <string.h>
+#include <stddef.h>
+#include <errno.h>
 #include <board.h>
 #include <task.h>
+#include "openpicc.h"
 #include "env.h"
 
 #define EFCS_CMD_WRITE_PAGE		0x1
@@ -40,9 +48,53 @@
 #define PAGES_PER_LOCKREGION	(AT91C_IFLASH_LOCK_REGION_SIZE>>AT91C_IFLASH_PAGE_SHIFT)
 #define IS_FIRST_PAGE_OF_LOCKREGION(x)	((x % PAGES_PER_LOCKREGION) == 0)
 #define LOCKREGION_FROM_PAGE(x)	(x / PAGES_PER_LOCKREGION)
-#define ENV_FLASH ((unsigned int *)AT91C_IFLASH + AT91C_IFLASH_SIZE - ENVIRONMENT_SIZE)
+#define ENV_FLASH ((const u_int8_t *)AT91C_IFLASH + AT91C_IFLASH_SIZE - ENVIRONMENT_SIZE)
+#define ENV_PAGES (ENVIRONMENT_SIZE/AT91C_IFLASH_PAGE_SIZE)
+
+/* Where the single page environment used to be written. The offset got
+ * scaled by the size of an int, the mirroring of the flash folded it back
+ * to 4k below the end. Only read to take over its settings. */
+#define ENV_LEGACY_FLASH ((unsigned int *)AT91C_IFLASH + AT91C_IFLASH_SIZE - ENVIRONMENT_SIZE)
+#define ENV_LEGACY_MAGIC 0x0CCC2007
 
-TEnvironmentBlock env;
+typedef struct
+{
+    unsigned int magic,size,crc16;
+    unsigned int mode,speed;
+    unsigned int reader_id;
+} TLegacyEnvironment;
+
+typedef union {
+    TLegacyEnvironment e;
+    unsigned int data[AT91C_IFLASH_PAGE_SIZE/sizeof(unsigned int)];
+} TLegacyEnvironmentBlock;
+
+typedef char env_page_size_check[(AT91C_IFLASH_PAGE_SIZE == ENV_LOG_PAGE_SIZE) ? 1 : -1];
+
+/* Keys of the log, never reuse a number */
+enum env_key {
+	ENV_KEY_MODE = 1,
+	ENV_KEY_SPEED,
+	ENV_KEY_READER_ID,
+	ENV_KEY_FDT_OFFSET,
+	ENV_KEY_COMPARATOR,
+};
+
+#define ENV_FIELD(_key, field) \
+	{ _key, offsetof(TEnvironment, field), sizeof(((TEnvironment *)0)->field) }
+
+static const struct {
+	u_int8_t key, offset, size;
+} env_fields[] = {
+	ENV_FIELD(ENV_KEY_MODE, mode),
+	ENV_FIELD(ENV_KEY_SPEED, speed),
+	ENV_FIELD(ENV_KEY_READER_ID, reader_id),
+	ENV_FIELD(ENV_KEY_FDT_OFFSET, fdt_offset),
+	ENV_FIELD(ENV_KEY_COMPARATOR, comparator),
+};
+
+TEnvironment env;
+static struct env_log env_log;
 
 static inline unsigned short RAMFUNC page_from_ramaddr(const void *addr)
 {
@@ -83,62 +135,94 @@ static inline void RAMFUNC flash_page(const void *addr)
 	flash_cmd_wait();
 }
 
-unsigned short RAMFUNC env_crc16 (const unsigned char *buffer, int size)
+/* Without erase the controller is told not to erase the page first, the
+ * words of data that are all ones then leave the flash as it is */
+static int RAMFUNC env_program(unsigned int page, const u_int32_t *data, int erase)
 {
-    unsigned short crc = 0xFFFF;
-
-    if(buffer && size)
-        while (size--)
-        {
-            crc = (crc >> 8) | (crc << 8);
-            crc ^= *buffer++;
-            crc ^= ((unsigned char) crc) >> 4;
-            crc ^= crc << 12;
-            crc ^= (crc & 0xFF) << 5;
-        }
-
-    return crc;
-}
+	volatile unsigned int *dst = (volatile unsigned int *)(ENV_FLASH + page*AT91C_IFLASH_PAGE_SIZE);
+	unsigned int i, status;
 
-void RAMFUNC env_store(void)
-{
-	unsigned int i,*src,*dst;
-	
 	/* During flashing only RAMFUNC code may be executed. 
 	 * For now, this means that no other code whatsoever may
 	 * be run until this function returns. */
 	vTaskSuspendAll();
 	portENTER_CRITICAL();
-	
-	env.e.magic=TENVIRONMENT_MAGIC;	
-	env.e.crc16=0;
-	env.e.size=sizeof(env);
-	env.e.crc16=env_crc16((unsigned char*)&env,sizeof(env));
-	
-	src=env.data;
-	dst=ENV_FLASH;
-        for (i = 0; i < (sizeof(env.data)/sizeof(env.data[0])); i++)
-	    *dst++ = *src++;
 
-	flash_page(ENV_FLASH);
-	
+	if(erase)
+		AT91C_BASE_MC->MC_FMR &= ~AT91C_MC_NEBP;
+	else
+		AT91C_BASE_MC->MC_FMR |= AT91C_MC_NEBP;
+
+	for (i = 0; i < AT91C_IFLASH_PAGE_SIZE/sizeof(unsigned int); i++)
+	    dst[i] = data[i];
+	flash_page((const void *)dst);
+	status = AT91C_BASE_MC->MC_FSR;
+
+	AT91C_BASE_MC->MC_FMR &= ~AT91C_MC_NEBP;
+
 	portEXIT_CRITICAL();
 	xTaskResumeAll();
+
+	return (status & (AT91C_MC_LOCKE|AT91C_MC_PROGE)) ? -EIO : 0;
 }
 
-int env_load(void)
+static const struct env_log_flash env_flash = {
+	.base = ENV_FLASH,
+	.pages = ENV_PAGES,
+	.program = env_program,
+};
+
+int env_store(void)
+{
+	unsigned int i;
+	int ret, err = 0;
+
+	/* Only the fields that changed are appended */
+	for(i = 0; i < sizeof(env_fields)/sizeof(env_fields[0]); i++) {
+		ret = env_log_set(&env_log, env_fields[i].key,
+			(const u_int8_t *)&env + env_fields[i].offset, env_fields[i].size);
+		if(ret < 0)
+			err = ret;
+	}
+	return err;
+}
+
+/* Takes over the settings of the old single page format */
+static int env_load_legacy(void)
 {
+	static TLegacyEnvironmentBlock block;
 	unsigned int crc;
-    
-	memcpy(&env,ENV_FLASH,sizeof(env));
-	
-	if(env.e.magic!=TENVIRONMENT_MAGIC || env.e.size!=sizeof(env) )
+
+	memcpy(&block, ENV_LEGACY_FLASH, sizeof(block));
+	if(block.e.magic!=ENV_LEGACY_MAGIC || block.e.size!=sizeof(block))
 	    return 0;
-    
-	crc=env.e.crc16;
-	env.e.crc16=0;
-    
-	return env_crc16((unsigned char*)&env,sizeof(env))==crc;
+
+	crc=block.e.crc16;
+	block.e.crc16=0;
+	if(env_crc16((unsigned char*)&block,sizeof(block))!=crc)
+	    return 0;
+
+	env.mode=block.e.mode;
+	env.speed=block.e.speed;
+	env.reader_id=block.e.reader_id;
+	return env_store() == 0;
+}
+
+int env_load(void)
+{
+	unsigned int i;
+	int found = 0;
+
+	if(env_log_init(&env_log, &env_flash) == 0)
+	    return env_load_legacy();
+
+	/* Fields that are not in the log keep their defaults */
+	for(i = 0; i < sizeof(env_fields)/sizeof(env_fields[0]); i++)
+		if(env_log_get(&env_log, env_fields[i].key,
+			(u_int8_t *)&env + env_fields[i].offset,
+			env_fields[i].size) == env_fields[i].size)
+			found++;
+	return found > 0;
 }
 
 void env_init(void)
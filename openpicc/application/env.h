@@ -23,24 +23,24 @@
 #ifndef __ENV_H__
 #define __ENV_H__
 
-#define TENVIRONMENT_MAGIC 0x0CCC2007
+#include "env_log.h"
 
+/* The settings kept in flash, see env.c */
 typedef struct
 {
-    unsigned int magic,size,crc16;
     unsigned int mode,speed;
     unsigned int reader_id;
+    int fdt_offset;
+    unsigned char comparator;
 } TEnvironment;
 
-typedef union {
-    TEnvironment e;
-    unsigned int data[AT91C_IFLASH_PAGE_SIZE/sizeof(unsigned int)];
-} TEnvironmentBlock;
-
-extern void env_store(void) RAMFUNC;
+/* Appends the fields that changed since they were last stored or loaded,
+ * returns 0 or a negative errno value */
+extern int env_store(void);
+/* Returns 1 if settings were found, fields that were not keep what they
+ * have */
 extern int env_load(void);
 extern void env_init(void);
-extern TEnvironmentBlock env;
-extern unsigned short env_crc16 (const unsigned char *buffer, int size) RAMFUNC;
+extern TEnvironment env;
 
 #endif/*__ENV_H__*/
@@ -0,0 +1,295 @@
+/***************************************************************
+ *
+ * OpenPICC - log structured storage for the environment
+ *
+ * The settings live as a log of small key/value records in a
+ * few flash pages. Saving a value appends one record to the
+ * active page, programmed without erasing the page first so
+ * that only the new bytes change, and the latest record of a
+ * key wins. When the active page is full the latest value of
+ * every key is written to the next page in one go and that
+ * page becomes the active one, so the erases go round all the
+ * pages.
+ *
+ * Every page starts with a header carrying a sequence number,
+ * records carry a CRC. A record torn by a power loss fails its
+ * CRC and the page is not appended to any more, the value
+ * before it stays valid. A torn compaction leaves the pages it
+ * was made from alone, the next compaction picks up the
+ * records from all of them. The log is indexed once at boot,
+ * reading a value is a lookup in RAM afterwards.
+ *
+ ***************************************************************
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; version 2.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#include <openpicc.h>
+#include <FreeRTOS.h>
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "env_log.h"
+
+#define RECORD_SIZE(len)	((sizeof(struct env_log_record) + (len) + 3) & ~3)
+
+/* The page being built, programmed in one go */
+static u_int32_t page_buffer[ENV_LOG_PAGE_SIZE/sizeof(u_int32_t)];
+
+unsigned short env_crc16(const unsigned char *buffer, int size)
+{
+	unsigned short crc = 0xFFFF;
+
+	if(buffer && size)
+		while(size--) {
+			crc = (crc >> 8) | (crc << 8);
+			crc ^= *buffer++;
+			crc ^= ((unsigned char) crc) >> 4;
+			crc ^= crc << 12;
+			crc ^= (crc & 0xFF) << 5;
+		}
+
+	return crc;
+}
+
+static inline const u_int8_t *page_address(const struct env_log *log, unsigned int page)
+{
+	return log->flash->base + page*ENV_LOG_PAGE_SIZE;
+}
+
+static u_int16_t header_crc(const struct env_log_page_header *hdr)
+{
+	return env_crc16((const unsigned char *)hdr, offsetof(struct env_log_page_header, crc16));
+}
+
+/* len must be checked against ENV_LOG_MAX_VALUE */
+static u_int16_t record_crc(u_int8_t key, u_int8_t len, const u_int8_t *value)
+{
+	u_int8_t buf[2 + ENV_LOG_MAX_VALUE];
+
+	buf[0] = key;
+	buf[1] = len;
+	memcpy(buf + 2, value, len);
+	return env_crc16(buf, 2 + len);
+}
+
+static int valid_page(const struct env_log *log, unsigned int page, u_int32_t *sequence)
+{
+	struct env_log_page_header hdr;
+
+	memcpy(&hdr, page_address(log, page), sizeof(hdr));
+	if(hdr.magic != ENV_LOG_PAGE_MAGIC || hdr.crc16 != header_crc(&hdr))
+		return 0;
+	*sequence = hdr.sequence;
+	return 1;
+}
+
+/* Indexes the records of a page. Returns the offset of its free space or
+ * ENV_LOG_PAGE_SIZE if nothing may be appended to it. */
+static unsigned int scan_page(struct env_log *log, unsigned int page)
+{
+	const u_int8_t *p = page_address(log, page);
+	struct env_log_record rec;
+	unsigned int pos = sizeof(struct env_log_page_header), i;
+
+	while(pos + sizeof(rec) <= ENV_LOG_PAGE_SIZE) {
+		memcpy(&rec, p + pos, sizeof(rec));
+		if(rec.key == ENV_LOG_KEY_FREE) {
+			/* A torn record may have left bits in what looks free */
+			for(i = pos; i < ENV_LOG_PAGE_SIZE; i++)
+				if(p[i] != 0xff)
+					return ENV_LOG_PAGE_SIZE;
+			return pos;
+		}
+		/* A torn record, nothing after it can be trusted */
+		if(rec.len > ENV_LOG_MAX_VALUE ||
+		   pos + RECORD_SIZE(rec.len) > ENV_LOG_PAGE_SIZE ||
+		   rec.crc16 != record_crc(rec.key, rec.len, p + pos + sizeof(rec)))
+			return ENV_LOG_PAGE_SIZE;
+		if(rec.key < ENV_LOG_MAX_KEYS)
+			log->index[rec.key] = page*ENV_LOG_PAGE_SIZE + pos;
+		pos += RECORD_SIZE(rec.len);
+	}
+	return ENV_LOG_PAGE_SIZE;
+}
+
+int env_log_init(struct env_log *log, const struct env_log_flash *flash)
+{
+	u_int32_t sequence, next_sequence = 0;
+	unsigned int page;
+	int next, keys = 0;
+
+	memset(log, 0, sizeof(*log));
+	log->flash = flash;
+	log->active = -1;
+
+	/* Oldest page first, so that later records replace earlier ones */
+	do {
+		next = -1;
+		for(page = 0; page < flash->pages; page++) {
+			if(!valid_page(log, page, &sequence))
+				continue;
+			if(log->active >= 0 && sequence <= log->sequence)
+				continue;
+			if(next < 0 || sequence < next_sequence) {
+				next = page;
+				next_sequence = sequence;
+			}
+		}
+		if(next >= 0) {
+			log->active = next;
+			log->sequence = next_sequence;
+			log->free = scan_page(log, next);
+		}
+	} while(next >= 0);
+
+	for(page = 0; page < ENV_LOG_MAX_KEYS; page++)
+		if(log->index[page])
+			keys++;
+	return keys;
+}
+
+int env_log_get(const struct env_log *log, u_int8_t key, void *value, unsigned int len)
+{
+	struct env_log_record rec;
+	const u_int8_t *p;
+
+	if(key >= ENV_LOG_MAX_KEYS || !log->index[key])
+		return -ENOENT;
+	p = log->flash->base + log->index[key];
+	memcpy(&rec, p, sizeof(rec));
+	memcpy(value, p + sizeof(rec), len < rec.len ? len : rec.len);
+	return rec.len;
+}
+
+static unsigned int put_record(unsigned int pos, u_int8_t key, const void *value, unsigned int len)
+{
+	u_int8_t *buf = (u_int8_t *)page_buffer;
+	struct env_log_record rec;
+
+	rec.key = key;
+	rec.len = len;
+	rec.crc16 = record_crc(key, len, value);
+	memcpy(buf + pos, &rec, sizeof(rec));
+	memcpy(buf + pos + sizeof(rec), value, len);
+	return pos + RECORD_SIZE(len);
+}
+
+/* The page after the active one that holds no live record. Only after
+ * torn compactions can the next page still be needed. */
+static unsigned int compaction_target(const struct env_log *log)
+{
+	unsigned int pages = log->flash->pages, page, i, k;
+
+	if(log->active < 0)
+		return 0;
+	for(i = 1; i < pages; i++) {
+		page = (log->active + i) % pages;
+		for(k = 0; k < ENV_LOG_MAX_KEYS; k++)
+			if(log->index[k] && log->index[k] / ENV_LOG_PAGE_SIZE == page)
+				break;
+		if(k == ENV_LOG_MAX_KEYS)
+			return page;
+	}
+	return (log->active + 1) % pages;
+}
+
+/* Writes the latest value of every key, with value for key, to a fresh
+ * page and makes that the active one */
+static int compact(struct env_log *log, u_int8_t key, const void *value, unsigned int len)
+{
+	u_int8_t *buf = (u_int8_t *)page_buffer;
+	u_int16_t index[ENV_LOG_MAX_KEYS];
+	struct env_log_page_header hdr;
+	struct env_log_record rec;
+	const u_int8_t *p;
+	unsigned int target, pos, k;
+	int ret;
+
+	target = compaction_target(log);
+	memset(page_buffer, 0xff, sizeof(page_buffer));
+	hdr.magic = ENV_LOG_PAGE_MAGIC;
+	hdr.sequence = log->active < 0 ? 0 : log->sequence + 1;
+	hdr.reserved = 0xffff;
+	hdr.crc16 = header_crc(&hdr);
+	memcpy(buf, &hdr, sizeof(hdr));
+
+	memset(index, 0, sizeof(index));
+	pos = sizeof(hdr);
+	for(k = 0; k < ENV_LOG_MAX_KEYS; k++) {
+		if(k != key && !log->index[k])
+			continue;
+		if(k == key) {
+			p = value;
+			rec.len = len;
+		} else {
+			p = log->flash->base + log->index[k];
+			memcpy(&rec, p, sizeof(rec));
+			p += sizeof(rec);
+		}
+		if(pos + RECORD_SIZE(rec.len) > ENV_LOG_PAGE_SIZE)
+			return -ENOSPC;
+		index[k] = target*ENV_LOG_PAGE_SIZE + pos;
+		pos = put_record(pos, k, p, rec.len);
+	}
+
+	if((ret = log->flash->program(target, page_buffer, 1)) < 0)
+		return ret;
+	if(memcmp(page_address(log, target), buf, ENV_LOG_PAGE_SIZE))
+		return -EIO;
+
+	memcpy(log->index, index, sizeof(index));
+	log->active = target;
+	log->sequence = hdr.sequence;
+	log->free = pos;
+	return 0;
+}
+
+int env_log_set(struct env_log *log, u_int8_t key, const void *value, unsigned int len)
+{
+	const u_int8_t *buf = (const u_int8_t *)page_buffer;
+	const u_int8_t *p;
+	unsigned int size = RECORD_SIZE(len);
+	int ret;
+
+	if(key >= ENV_LOG_MAX_KEYS || len > ENV_LOG_MAX_VALUE)
+		return -EINVAL;
+	if(log->index[key]) {
+		p = log->flash->base + log->index[key];
+		if(((const struct env_log_record *)p)->len == len &&
+		   !memcmp(p + sizeof(struct env_log_record), value, len))
+			return 0;
+	}
+
+	if(log->active < 0 || log->free + size > ENV_LOG_PAGE_SIZE)
+		return compact(log, key, value, len);
+
+	/* Erased bytes program nothing, only the record changes the page */
+	memset(page_buffer, 0xff, sizeof(page_buffer));
+	put_record(log->free, key, value, len);
+	if((ret = log->flash->program(log->active, page_buffer, 0)) < 0)
+		return ret;
+	if(memcmp(page_address(log, log->active) + log->free, buf + log->free, size)) {
+		/* The space was not clean after all, leave the page */
+		log->free = ENV_LOG_PAGE_SIZE;
+		return compact(log, key, value, len);
+	}
+
+	log->index[key] = log->active*ENV_LOG_PAGE_SIZE + log->free;
+	log->free += size;
+	return 0;
+}
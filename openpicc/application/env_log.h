@@ -0,0 +1,64 @@
+#ifndef ENV_LOG_H_
+#define ENV_LOG_H_
+
+#include <openpicc.h>
+
+/* Append only key/value log in a few flash pages, see env_log.c. Knows
+ * nothing about the AT91SAM7 flash controller, env.c supplies that, so
+ * that it can be run against the flash emulator in sim/env_bench.c. */
+
+#define ENV_LOG_PAGE_SIZE	256	/* AT91SAM7S256 */
+#define ENV_LOG_MAX_KEYS	32
+#define ENV_LOG_MAX_VALUE	32
+
+#define ENV_LOG_PAGE_MAGIC	0x31474c45	/* "ELG1" */
+#define ENV_LOG_KEY_FREE	0xff		/* erased flash */
+
+/* At the start of every page in use */
+struct env_log_page_header {
+	u_int32_t magic;
+	u_int32_t sequence;	/* one more than the page compacted from */
+	u_int16_t crc16;	/* of magic and sequence */
+	u_int16_t reserved;
+} __attribute__ ((packed));
+
+/* Followed by len value bytes, padded to a word. The crc covers key, len
+ * and the value. */
+struct env_log_record {
+	u_int8_t key;
+	u_int8_t len;
+	u_int16_t crc16;
+} __attribute__ ((packed));
+
+struct env_log_flash {
+	const u_int8_t *base;	/* memory mapped, pages back to back */
+	unsigned int pages;	/* at least 3 */
+	/* Programs one page from a word aligned buffer. With erase the page
+	 * is erased first, without bits can only go from 1 to 0. Returns 0
+	 * or a negative errno value. */
+	int (*program)(unsigned int page, const u_int32_t *data, int erase);
+};
+
+struct env_log {
+	const struct env_log_flash *flash;
+	int active;			/* page appended to, -1 if none */
+	u_int32_t sequence;		/* of the active page */
+	unsigned int free;		/* offset of the free space in it */
+	u_int16_t index[ENV_LOG_MAX_KEYS];	/* offset of the latest record
+						 * from base, 0 if none */
+};
+
+/* Scans the pages and indexes the latest record of every key. Returns
+ * the number of keys found. */
+extern int env_log_init(struct env_log *log, const struct env_log_flash *flash);
+/* Copies up to len bytes of the value of key. Returns the length of the
+ * stored value or -ENOENT. */
+extern int env_log_get(const struct env_log *log, u_int8_t key, void *value, unsigned int len);
+/* Appends a record unless the value is the stored one already. Compacts
+ * the log into the next page when the active one is full. Returns 0 or a
+ * negative errno value. */
+extern int env_log_set(struct env_log *log, u_int8_t key, const void *value, unsigned int len);
+
+extern unsigned short env_crc16(const unsigned char *buffer, int size);
+
+#endif /*ENV_LOG_H_*/
@@ -95,7 +95,9 @@ typedef struct {
   		       NO_PARITY, /* Don't send any parity */
   		} parity;
   		enum { ISO14443A_LAST_BIT_0 = 0, ISO14443A_LAST_BIT_1 = 1, ISO14443A_LAST_BIT_NONE } last_bit;
-  		enum { CRC_UNCALCULATED = 2, CRC_OK = 1, CRC_ERROR = 0} crc;
+  		enum { CRC_UNCALCULATED = 2, CRC_OK = 1, CRC_ERROR = 0,
+  		       CRC_APPEND = 3, /* Tx only: the encoder appends the CRC to the data */
+  		} crc;
   	} a;
   } parameters;
   u_int32_t numbytes;
@@ -0,0 +1,111 @@
+/* ISO14443 CRC_A/CRC_B for OpenPICC
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by 
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <openpicc.h>
+#include <errno.h>
+
+#include "iso14443.h"
+#include "iso14443_crc.h"
+
+const u_int16_t iso14443_crc_tab[256] = {
+#include "iso14443_crc.inc"
+};
+
+u_int16_t iso14443_crc(u_int16_t crc, const u_int8_t *data, unsigned int len)
+{
+	/* unrolled, the loop overhead is about the same as the table lookup */
+	for (; len >= 4; len -= 4, data += 4) {
+		crc = (crc >> 8) ^ iso14443_crc_tab[(crc ^ data[0]) & 0xff];
+		crc = (crc >> 8) ^ iso14443_crc_tab[(crc ^ data[1]) & 0xff];
+		crc = (crc >> 8) ^ iso14443_crc_tab[(crc ^ data[2]) & 0xff];
+		crc = (crc >> 8) ^ iso14443_crc_tab[(crc ^ data[3]) & 0xff];
+	}
+	while (len--)
+		crc = (crc >> 8) ^ iso14443_crc_tab[(crc ^ *data++) & 0xff];
+
+	return crc;
+}
+
+u_int16_t iso14443a_crc(const u_int8_t *data, unsigned int len)
+{
+	return iso14443_crc(ISO14443A_CRC_INIT, data, len);
+}
+
+u_int16_t iso14443b_crc(const u_int8_t *data, unsigned int len)
+{
+	return ~iso14443_crc(ISO14443B_CRC_INIT, data, len);
+}
+
+static inline u_int16_t frame_crc(const iso14443_frame *frame, unsigned int len)
+{
+	if (frame->type == TYPE_B)
+		return iso14443b_crc(frame->data, len);
+	return iso14443a_crc(frame->data, len);
+}
+
+static void set_parity(iso14443_frame *frame, unsigned int i)
+{
+	u_int8_t b = frame->data[i];
+
+	b ^= b >> 4;
+	b ^= b >> 2;
+	b ^= b >> 1;
+	/* odd parity */
+	if (b & 1)
+		frame->parity[i/8] &= ~(1 << (i%8));
+	else
+		frame->parity[i/8] |= 1 << (i%8);
+}
+
+int iso14443_crc_append(iso14443_frame *frame)
+{
+	unsigned int n = frame->numbytes;
+	u_int16_t crc;
+
+	if (n + 2 > MAXIMUM_FRAME_SIZE)
+		return -ENOSPC;
+
+	crc = frame_crc(frame, n);
+	frame->data[n] = crc & 0xff;
+	frame->data[n+1] = crc >> 8;
+	frame->numbytes = n + 2;
+
+	if (frame->type == TYPE_A) {
+		if (frame->parameters.a.parity == GIVEN_PARITY) {
+			set_parity(frame, n);
+			set_parity(frame, n+1);
+		}
+		frame->parameters.a.crc = CRC_OK;
+	}
+
+	return 0;
+}
+
+int iso14443_crc_check(const iso14443_frame *frame)
+{
+	unsigned int n = frame->numbytes;
+	u_int16_t crc;
+
+	if (n < 2 || frame->numbits)
+		return CRC_ERROR;
+
+	crc = frame_crc(frame, n - 2);
+	if (frame->data[n-2] == (crc & 0xff) && frame->data[n-1] == (crc >> 8))
+		return CRC_OK;
+	return CRC_ERROR;
+}
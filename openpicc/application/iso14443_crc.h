@@ -0,0 +1,35 @@
+#ifndef ISO14443_CRC_H_
+#define ISO14443_CRC_H_
+
+#include "iso14443.h"
+
+/* CRC_A and CRC_B from ISO 14443-3 Annex B, table driven.  Both are
+ * transmitted LSB first after the data, CRC_B is sent inverted. */
+
+#define ISO14443A_CRC_INIT	0x6363
+#define ISO14443B_CRC_INIT	0xFFFF
+
+extern const u_int16_t iso14443_crc_tab[256];
+
+/* Incremental: feed one byte into the CRC register, for streaming decoders.
+ * CRC_A over data and received CRC is 0 if they match. */
+static inline u_int16_t iso14443_crc_update(u_int16_t crc, u_int8_t byte)
+{
+	return (crc >> 8) ^ iso14443_crc_tab[(crc ^ byte) & 0xff];
+}
+
+/* Bulk: run len bytes through the CRC register */
+extern u_int16_t iso14443_crc(u_int16_t crc, const u_int8_t *data, unsigned int len);
+
+/* CRC as transmitted (i.e. inverted for type B) */
+extern u_int16_t iso14443a_crc(const u_int8_t *data, unsigned int len);
+extern u_int16_t iso14443b_crc(const u_int8_t *data, unsigned int len);
+
+/* Append the CRC matching frame->type to the frame data (and parity bits
+ * for GIVEN_PARITY), sets CRC_OK.  Returns -ENOSPC if the frame is full. */
+extern int iso14443_crc_append(iso14443_frame *frame);
+
+/* Check the last two bytes of a received frame, returns CRC_OK or CRC_ERROR */
+extern int iso14443_crc_check(const iso14443_frame *frame);
+
+#endif /*ISO14443_CRC_H_*/
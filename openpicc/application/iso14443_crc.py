@@ -0,0 +1,25 @@
+#!/usr/bin/env python
+#
+# Generates iso14443_crc.inc for iso14443_crc.c
+#
+# CRC_A and CRC_B (ISO 14443-3 Annex B) are both the CCITT polynomial
+# x^16 + x^12 + x^5 + 1, processed LSB first, so the reflected polynomial
+# 0x8408 is used.  Entry i is the CRC register change for a low byte i.
+
+import sys
+
+POLY = 0x8408
+
+def entry(b):
+	crc = b
+	for i in range(8):
+		if crc & 1:
+			crc = (crc >> 1) ^ POLY
+		else:
+			crc >>= 1
+	return crc
+
+sys.stdout.write("/* Autogenerated from iso14443_crc.py */\n")
+for i in range(0, 256, 8):
+	sys.stdout.write("\t" + ", ".join(["0x%04x" % entry(b)
+		for b in range(i, i + 8)]) + ",\n")
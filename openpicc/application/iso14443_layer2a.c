@@ -95,11 +95,7 @@ int iso14443_receive(iso14443_receive_callback_t _callback, iso14443_frame **fra
 		}
 		
 		if(frame != NULL) *frame = _frame;
-		else {
-			portENTER_CRITICAL();
-			_frame->state = FRAME_FREE;
-			portEXIT_CRITICAL();
-		}
+		else tc_recv_release(_frame);
 		
 		rx_pending=0;
 		callback=NULL;
@@ -121,6 +117,11 @@ int iso14443_receive(iso14443_receive_callback_t _callback, iso14443_frame **fra
 	return -ETIMEDOUT;
 }
 
+void iso14443_release(iso14443_frame *frame)
+{
+	tc_recv_release(frame);
+}
+
 int iso14443_transmit(ssc_dma_tx_buffer_t *buffer, unsigned int fdt, u_int8_t async, unsigned int timeout)
 {
 	if(tx_pending) 
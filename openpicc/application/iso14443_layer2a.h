@@ -24,8 +24,8 @@ typedef void (*iso14443_receive_callback_t)(ssc_dma_rx_buffer_t *buffer, iso1444
  * This call will block until a frame is received or an exception happens. Obviously it must not be run
  * from IRQ context.
  * 
- * Warning: When you get a frame from the function then its state is set to SSC_PROCESSING and you must 
- * SSC_FREE it yourself. However, you MUST NOT free a buffer or a frame from the callback.
+ * Warning: When you get a frame from the function then its state is set to FRAME_PROCESSING and you must 
+ * hand it back with iso14443_release() yourself. However, you MUST NOT free a buffer or a frame from the callback.
  * 
  * Return values:
  * = 0         Frame received
@@ -36,6 +36,9 @@ typedef void (*iso14443_receive_callback_t)(ssc_dma_rx_buffer_t *buffer, iso1444
  */
 extern int iso14443_receive(iso14443_receive_callback_t callback, iso14443_frame **frame, unsigned int timeout);
 
+/* Return a frame from iso14443_receive() to the receive buffer pool */
+extern void iso14443_release(iso14443_frame *frame);
+
 /*
  * Transmit a frame. Starts transmitting fdt carrier cycles after the end of the received frame.
  * Parameters buffer and fdt specify the SSC Tx buffer to be sent and the frame delay time in carrier cycles.
@@ -78,9 +78,7 @@ void iso14443_sniffer (void *pvParameters)
 			DumpBufferToUSB((char*)rx_frame->data, rx_frame->numbytes + (rx_frame->numbits+7)/8 );
 			usb_print_string("\n\r");
 			
-			portENTER_CRITICAL();
-			rx_frame->state = FRAME_FREE;
-			portEXIT_CRITICAL();
+			iso14443_release(rx_frame);
 		} else {
 			if(res != -ETIMEDOUT) {
 				usb_print_string("Receive error: ");
@@ -29,9 +29,11 @@
 
 #include "iso14443.h"
 #include "iso14443a_diffmiller.h"
+#include "iso14443_crc.h"
 #include "usb_print.h"
 
-#include "performance.h"
+#include "trace.h"
+#include "metrics.h"
 
 #define DEBUGP (void)
 #define printf usb_print_string
@@ -60,6 +62,12 @@
  * All other combinations are invalid and likely en- or decoding errors. (Note that old_state
  * Y is exactly the same as old_state none.)
  * 
+ * Both phases are table driven: the delta is quantised into a bucket by delta_bucket[], and
+ * diffmiller_tab[decoder state][bucket] directly yields up to three bits, SOF/EOF/error and the new
+ * decoder state.  The decoder state combines the old_state from above with the position in the
+ * frame (outside, inside, inside with a 0 pending that might turn out to be EOF).  Both tables are
+ * built from the symbol table and the rules below at init time.
+ * 
  * The mapping from symbol sequences to SOF/EOF/bit is as follows:
  *         X: 1
  * 0, then Y: EOF
@@ -91,20 +99,66 @@
 #define ALMOST_GREATER_THAN_OR_EQUAL(a,b) (a >= (b-BIT_LEN_ERROR_MAX))
 
 enum symbol {NO_SYM=0, sym_x, sym_y, sym_z};
-enum bit { BIT_ERROR, BIT_SOF, BIT_0, BIT_1, BIT_EOF };
 
-#define PERFORMANCE_COUNTS 10
+/* Delta buckets: B_7_9 is >= 7 but not yet >= 9 */
+enum bucket { B_INVALID=0, B_3, B_5, B_7, B_7_9, B_9, NUM_BUCKETS };
+
+#define SYMBOLS(sym1, sym2, next) ((sym1) | ((sym2)<<2) | ((next)<<4))
+
+/* The old_state/delta table from above */
+static const u_int8_t symbol_tab[4][NUM_BUCKETS] = {
+	[NO_SYM] = {
+		[B_3]   = SYMBOLS(sym_z, sym_z, sym_z),
+		[B_5]   = SYMBOLS(sym_z, sym_x, sym_x),
+	},
+	[sym_x] = {
+		[B_3]   = SYMBOLS(sym_x, NO_SYM, sym_x),
+		[B_5]   = SYMBOLS(sym_y, sym_z, sym_z),
+		[B_7]   = SYMBOLS(sym_y, sym_x, sym_x),
+		[B_9]   = SYMBOLS(sym_y, sym_y, sym_y),
+	},
+	[sym_y] = {
+		[B_3]   = SYMBOLS(sym_z, sym_z, sym_z),
+		[B_5]   = SYMBOLS(sym_z, sym_x, sym_x),
+	},
+	[sym_z] = {
+		[B_3]   = SYMBOLS(sym_z, NO_SYM, sym_z),
+		[B_5]   = SYMBOLS(sym_x, NO_SYM, sym_x),
+		[B_7]   = SYMBOLS(sym_y, NO_SYM, sym_y),
+		[B_7_9] = SYMBOLS(sym_y, NO_SYM, sym_y),
+		[B_9]   = SYMBOLS(sym_y, NO_SYM, sym_y),
+	},
+};
+
+/* Position in the frame */
+enum frame_pos { OUT_OF_FRAME=0, IN_FRAME, IN_FRAME_0 };
+
+/* Decoder state: old_state and frame position */
+#define STATE(sym, pos) (((sym)<<2) | (pos))
+#define STATE_SYM(s) ((s)>>2)
+#define STATE_POS(s) ((s)&3)
+#define NUM_STATES 16
+
+/* Transition table entries */
+#define T_NEXT(t)   ((t) & 0xf)
+#define T_NBITS(t)  (((t)>>4) & 3)
+#define T_BITS(t)   ((t)>>6 & 7)
+#define T_EOF       (1<<9)
+#define T_SOF       (1<<10)
+#define T_ERROR     (1<<11)
+
+/* Everything above BIT_LEN_9-BIT_LEN_ERROR_MAX is B_9 */
+#define DELTA_BUCKETS 256
+static u_int8_t delta_bucket[DELTA_BUCKETS];
+static u_int16_t diffmiller_tab[NUM_STATES][NUM_BUCKETS];
+
 struct diffmiller_state {
 	int initialized, pauses_count;
-	enum symbol old_state;
-	enum bit last_bit;
+	u_int8_t decoder_state;
 	iso14443_frame *frame;
 	u_int32_t counter;
 	u_int16_t byte,crc;
-	u_int8_t parity;
 	u_int8_t last_data_bit;
-	u_int32_t performance[PERFORMANCE_COUNTS][2];
-	size_t perf_index;
 	struct {
 		u_int8_t in_frame:1;
 		u_int8_t frame_finished:1;
@@ -115,19 +169,92 @@ struct diffmiller_state {
 
 struct diffmiller_state _state;
 
-inline void start_frame(struct diffmiller_state * const state)
+static void init_delta_buckets(void)
+{
+	int delta;
+	for(delta=0; delta<DELTA_BUCKETS; delta++) {
+		if( ALMOST_EQUAL(delta, BIT_LEN_3) )
+			delta_bucket[delta] = B_3;
+		else if( ALMOST_EQUAL(delta, BIT_LEN_5) )
+			delta_bucket[delta] = B_5;
+		else if( ALMOST_EQUAL(delta, BIT_LEN_7) )
+			delta_bucket[delta] = B_7;
+		else if( ALMOST_GREATER_THAN_OR_EQUAL(delta, BIT_LEN_9) )
+			delta_bucket[delta] = B_9;
+		else if( ALMOST_GREATER_THAN_OR_EQUAL(delta, BIT_LEN_7) )
+			delta_bucket[delta] = B_7_9;
+		else
+			delta_bucket[delta] = B_INVALID;
+	}
+}
+
+/* Run the symbols of one table entry through the SOF/EOF/bit rules. On EOF the
+ * rest is dropped, the decoder restarts in old_state Y after each frame.
+ */
+static u_int16_t make_transition(int sym_state, enum frame_pos pos, int bucket)
+{
+	u_int8_t s = symbol_tab[sym_state][bucket];
+	u_int16_t t = 0;
+	int nbits = 0, i;
+
+	if(s == 0) /* invalid, nothing changes */
+		return STATE(sym_state, pos);
+
+	for(i=0; i<2; i++) {
+		switch( (s>>(2*i)) & 3 ) {
+		case sym_x:
+			if(pos == OUT_OF_FRAME) {
+				t |= T_ERROR;
+			} else {
+				if(pos == IN_FRAME_0) nbits++;          /* 0 */
+				t |= 1<<(6+nbits++);                     /* 1 */
+				pos = IN_FRAME;
+			}
+			break;
+		case sym_y:
+			if(pos == OUT_OF_FRAME) {
+				t |= T_ERROR;
+			} else if(pos == IN_FRAME_0) {
+				return t | T_EOF | (nbits<<4) | STATE(sym_y, OUT_OF_FRAME);
+			} else {
+				pos = IN_FRAME_0;
+			}
+			break;
+		case sym_z:
+			if(pos == OUT_OF_FRAME) {
+				t |= T_SOF;
+				pos = IN_FRAME;
+			} else {
+				if(pos == IN_FRAME_0) nbits++;          /* 0 */
+				pos = IN_FRAME_0;
+			}
+			break;
+		}
+	}
+
+	return t | (nbits<<4) | STATE(s>>4, pos);
+}
+
+static void init_diffmiller_tab(void)
+{
+	int sym_state, pos, bucket;
+	for(sym_state=NO_SYM; sym_state<=sym_z; sym_state++)
+		for(pos=OUT_OF_FRAME; pos<=IN_FRAME_0; pos++)
+			for(bucket=0; bucket<NUM_BUCKETS; bucket++)
+				diffmiller_tab[STATE(sym_state, pos)][bucket] = 
+					make_transition(sym_state, pos, bucket);
+}
+
+static inline void start_frame(struct diffmiller_state * const state)
 {
 	state->byte=0;
-	state->parity=0;
-	state->crc=0x6363;
+	state->crc=ISO14443A_CRC_INIT;
 	
-	performance_set_checkpoint("start_frame before memset");
 	memset(&state->flags, 0, sizeof(state->flags));
 	state->flags.in_frame = 1;
 	
 	//memset(state->frame, 0, sizeof(*state->frame));
-	memset(state->frame, 0, (u_int32_t)&(((iso14443_frame*)0)->data) );
-	performance_set_checkpoint("start_frame after memset");
+	memset(state->frame, 0, (size_t)&(((iso14443_frame*)0)->data) );
 	state->frame->state = FRAME_PENDING;
 }
 
@@ -146,22 +273,32 @@ static inline void append_to_frame(struct diffmiller_state *const state,
 	}
 
 	f->data[f->numbytes] = byte & 0xff;
-	f->parity[f->numbytes/8] |= ((parity&1)<<(f->numbytes%8));
+	/* The frame buffers are reused, clear stale parity bits as well */
+	if(parity&1)
+		f->parity[f->numbytes/8] |= (1<<(f->numbytes%8));
+	else
+		f->parity[f->numbytes/8] &= ~(1<<(f->numbytes%8));
 
 	if(valid_bits == 8) {
 		f->numbytes++;
-		byte=(byte ^ state->crc)&0xFF;
-		byte=(byte ^ byte<<4)&0xFF;
-		state->crc=((state->crc>>8)^(byte<<8)^(byte<<3)^(byte>>4))&0xFFFF;
+		state->crc=iso14443_crc_update(state->crc, byte);
 	} else {
 		f->numbits += valid_bits;
 	}
 }
 
 
+DEFINE_METRIC_COUNTER(decode_errors, "diffmiller.decode_errors", METRIC_F_ERROR);
+DEFINE_METRIC_COUNTER(overflows, "diffmiller.overflows", METRIC_F_ERROR);
+
 static inline void end_frame(struct diffmiller_state * const state, const u_int32_t counter, const int last_data_bit)
 {
 	if(state->frame != NULL) {
+		if(state->flags.error)
+			metric_inc(decode_errors);
+		if(state->flags.overflow)
+			metric_inc(overflows);
+
 		if(counter > 0) {
 			append_to_frame(state, state->byte, 0, counter);
 		}
@@ -181,80 +318,6 @@ static inline void end_frame(struct diffmiller_state * const state, const u_int3
 	}
 }
 
-#define PRINT_BIT(a) if(0){(void)a;}
-//#define PRINT_BIT(a) usb_print_string_f(a,0)
-
-#define DO_BIT_0 { \
-	last_data_bit = 0; \
-	if(++counter==9) { \
-	    	append_to_frame(state, state->byte, 0, 8); \
-	    	counter=state->byte=state->parity=0; \
-	    } \
-	PRINT_BIT(" 0"); \
-}
-
-#define DO_BIT_1 { \
-	last_data_bit = 1; \
-	if(counter<8)  { \
-    	state->byte |= (1<<counter); \
-    	state->parity ^= 1; \
-    } \
-	if(++counter==9) { \
-	    	append_to_frame(state, state->byte, 1, 8); \
-	    	counter=state->byte=state->parity=0; \
-	} \
-	PRINT_BIT(" 1"); \
-}
-
-#define DO_SYMBOL_X \
-	PRINT_BIT("(X)"); \
-	if(!in_frame) { \
-		if(last_bit == BIT_0) DO_BIT_0; \
-		error = 1; \
-		PRINT_BIT(" ERROR\n"); \
-		last_bit = BIT_ERROR; \
-		in_frame = 0; \
-	} else { \
-		if(last_bit == BIT_0) DO_BIT_0; \
-		DO_BIT_1; \
-		last_bit = BIT_1; \
-	}
-
-#define DO_SYMBOL_Y \
-	PRINT_BIT("(Y)"); \
-	if(!in_frame) { \
-		if(last_bit == BIT_0) DO_BIT_0; \
-		error = 1; \
-		PRINT_BIT(" ERROR\n"); \
-		last_bit = BIT_ERROR; \
-		in_frame = 0; \
-	} else { \
-		if(last_bit == BIT_0) { \
-			end_frame(state, counter, last_data_bit); \
-			PRINT_BIT(" EOF\n"); \
-			last_bit = BIT_EOF; \
-			in_frame = 0; \
-		} else { \
-			last_bit = BIT_0; \
-		} \
-	}
-
-#define DO_SYMBOL_Z \
-	PRINT_BIT("(Z)"); \
-	if(!in_frame) { \
-		if(last_bit == BIT_0) DO_BIT_0; \
-		counter = 0; \
-		start_frame(state); \
-		PRINT_BIT("SOF"); \
-		in_frame = 1; \
-		last_bit = BIT_ERROR; \
-		last_bit = BIT_SOF; \
-	} else { \
-		if(last_bit == BIT_0) DO_BIT_0; \
-		last_bit = BIT_0; \
-	}
-
-
 int __ramfunc iso14443a_decode_diffmiller(struct diffmiller_state * const state, iso14443_frame * const frame, 
 	const u_int32_t buffer[], unsigned int * const offset, const unsigned int buflen)
 {
@@ -262,89 +325,66 @@ int __ramfunc iso14443a_decode_diffmiller(struct diffmiller_state * const state,
 	if(state->frame != NULL && state->frame != frame) return -EINVAL;
 	state->frame = frame;
 	
-	enum symbol old_state = state->old_state;
-	enum bit last_bit = state->last_bit;
-	int in_frame = state->flags.in_frame;
-	int error = state->flags.error;
+	int decoder_state = state->decoder_state;
 	int counter = state->counter;
 	int last_data_bit = state->last_data_bit;
+	u_int32_t byte = state->byte;
+	const int pause_len = state->pauses_count ? PAUSE_LEN : 0;
 	
-	if(state->perf_index < PERFORMANCE_COUNTS) {
-		state->performance[state->perf_index][0] = *offset;
-		state->performance[state->perf_index++][1] = buflen;
-	}
+	trace_event(TRACE_DECODE, buflen - *offset);
 	
 	for(; *offset < buflen; ) {
-		int delta;
-		if(state->pauses_count)
-			delta = buffer[(*offset)++] - PAUSE_LEN;
+		int delta = buffer[(*offset)++] - pause_len;
+		int bucket;
+		
+		if((unsigned int)delta < DELTA_BUCKETS)
+			bucket = delta_bucket[delta];
+		else if(delta < 0)
+			bucket = B_INVALID;
 		else
-			delta = buffer[(*offset)++];
-
-		switch(old_state) {
-		case sym_x:
-			if( ALMOST_EQUAL(delta, BIT_LEN_3) ) {
-				DO_SYMBOL_X;
-				old_state = sym_x;
-			} else if( ALMOST_EQUAL(delta, BIT_LEN_5) ) {
-				DO_SYMBOL_Y;
-				DO_SYMBOL_Z;
-				old_state = sym_z;
-			} else if( ALMOST_EQUAL(delta, BIT_LEN_7) ) {
-				DO_SYMBOL_Y;
-				DO_SYMBOL_X;
-				old_state = sym_x;
-			} else if( ALMOST_GREATER_THAN_OR_EQUAL(delta, BIT_LEN_9)) {
-				DO_SYMBOL_Y;
-				DO_SYMBOL_Y;
-				old_state = sym_y;
+			bucket = B_9;
+		
+		const u_int16_t t = diffmiller_tab[decoder_state][bucket];
+		decoder_state = T_NEXT(t);
+		
+		if(t & (T_EOF | T_SOF | T_ERROR)) {
+			if(t & T_EOF) {
+				state->byte = byte;
+				end_frame(state, counter, last_data_bit);
+				state->flags.frame_finished = 0;
+				state->flags.in_frame = 0;
+				state->decoder_state = STATE(sym_y, OUT_OF_FRAME);
+				state->counter = counter;
+				state->last_data_bit = last_data_bit;
+				state->frame = NULL;
+				return 0;
 			}
-			break;
-		case NO_SYM: /* Fall-Through */
-		case sym_y:
-			if( ALMOST_EQUAL(delta, BIT_LEN_3) ) {
-				DO_SYMBOL_Z;
-				DO_SYMBOL_Z;
-				old_state = sym_z;
-			} else if( ALMOST_EQUAL(delta, BIT_LEN_5) ) {
-				DO_SYMBOL_Z;
-				DO_SYMBOL_X;
-				old_state = sym_x;
-			} 
-			break;
-		case sym_z:
-			if( ALMOST_EQUAL(delta, BIT_LEN_3) ) {
-				DO_SYMBOL_Z;
-				old_state = sym_z;
-			} else if( ALMOST_EQUAL(delta, BIT_LEN_5) ) {
-				DO_SYMBOL_X;
-				old_state = sym_x;
-			} else if( ALMOST_GREATER_THAN_OR_EQUAL(delta, BIT_LEN_7)) {
-				DO_SYMBOL_Y;
-				old_state = sym_y;
+			if(t & T_ERROR)
+				state->flags.error = 1;
+			if(t & T_SOF) {
+				counter = 0;
+				start_frame(state);
+				byte = 0;
 			}
-			break;
 		}
 		
-		if(state->flags.frame_finished)  {
-			state->flags.frame_finished = 0;
-			state->old_state = sym_y;
-			state->last_bit = last_bit;
-			state->counter = counter;
-			state->flags.in_frame = in_frame;
-			state->flags.error = error;
-			state->frame = NULL;
-			performance_set_checkpoint("frame finished");
-			return 0;
+		int nbits = T_NBITS(t), bits = T_BITS(t);
+		for(; nbits; nbits--, bits >>= 1) {
+			last_data_bit = bits & 1;
+			if(counter < 8)
+				byte |= last_data_bit << counter;
+			if(++counter == 9) {
+				append_to_frame(state, byte, last_data_bit, 8);
+				counter = byte = 0;
+			}
 		}
 	}
 	
-	state->old_state = old_state;
-	state->last_bit = last_bit;
+	state->decoder_state = decoder_state;
 	state->counter = counter;
 	state->last_data_bit = last_data_bit;
-	state->flags.in_frame = in_frame;
-	state->flags.error = error;
+	state->byte = byte;
+	state->flags.in_frame = STATE_POS(decoder_state) != OUT_OF_FRAME;
 	
 	return -EBUSY;
 }
@@ -358,44 +398,37 @@ int iso14443a_diffmiller_assert_frame_ended(struct diffmiller_state * const stat
 	state->frame = frame;
 
 	end_frame(state, state->counter, state->last_data_bit);
-	PRINT_BIT(" EOF2\n");
 	state->flags.in_frame = 0;
 	
 	if(state->flags.frame_finished)  {
 		state->flags.frame_finished = 0;
-		state->old_state = sym_y;
-		state->last_bit = BIT_EOF;
+		state->decoder_state = STATE(sym_y, OUT_OF_FRAME);
 		state->counter = 0;
 		state->frame = NULL;
-		performance_set_checkpoint("frame finished2");
 		return 0;
 	}
 	
 	return -EBUSY;
 }
 
+int iso14443a_diffmiller_frame_errors(const struct diffmiller_state * const state)
+{
+	return (state->flags.error ? DIFFMILLER_ERROR : 0) |
+		(state->flags.overflow ? DIFFMILLER_OVERFLOW : 0);
+}
+
 struct diffmiller_state *iso14443a_init_diffmiller(int pauses_count)
 {
 	if(_state.initialized) return NULL;
 	struct diffmiller_state *state = &_state;
+	init_delta_buckets();
+	init_diffmiller_tab();
 	state->initialized = 1;
 	state->pauses_count = pauses_count;
 	state->frame = NULL;
-	state->old_state = sym_y;
+	state->decoder_state = STATE(sym_y, OUT_OF_FRAME);
 	state->flags.frame_finished = 0;
 	
 	return state;
 }
 
-
-#include "cmd.h"
-void iso14443a_diffmiller_print_performance(struct diffmiller_state * const state)
-{
-	DumpStringToUSB("`");
-	unsigned int i; for(i=0; i<state->perf_index; i++) {
-		if(i>0)DumpStringToUSB(";");
-		DumpUIntToUSB(state->performance[i][0]); DumpStringToUSB(":"); DumpUIntToUSB(state->performance[i][1]);
-	}
-	DumpStringToUSB("'");
-	state->perf_index=0;
-}
@@ -11,6 +11,10 @@ extern int iso14443a_diffmiller_assert_frame_ended(struct diffmiller_state * con
 		iso14443_frame * const frame);
 extern struct diffmiller_state *iso14443a_init_diffmiller(int pauses_count);
 
-extern void iso14443a_diffmiller_print_performance(struct diffmiller_state * const state);
+/* Errors seen in the frame that was finished last */
+#define DIFFMILLER_ERROR	0x01	/* a pause spacing that fit no symbol */
+#define DIFFMILLER_OVERFLOW	0x02	/* more than MAXIMUM_FRAME_SIZE bytes */
+extern int iso14443a_diffmiller_frame_errors(const struct diffmiller_state * const state);
+
 
 #endif /*ISO14443A_DIFFMILLER_H_*/
@@ -51,87 +51,209 @@
 #include <string.h>
 #include "openpicc.h"
 #include "iso14443_layer3a.h"
+#include "iso14443_crc.h"
 #include "iso14443a_manchester.h"
 
-enum parity {
-	PARITY_NONE, /* Don't add a parity bit */
-	ODD_PARITY, EVEN_PARITY, /* Calculate parity */
-	PARITY_0, PARITY_1 /* Set fixed parity */
+#include "manchester_tab.inc"
+
+/* Sample output in 16bit units (one bit period each) with 32bit stores.
+ * An odd halfword is kept in pend until its successor arrives. */
+struct manchester_out {
+	u_int32_t *w;
+	u_int32_t pend;
+	u_int8_t half;
 };
 
-static inline void manchester_enc_byte(u_int16_t **s16, const u_int8_t data, const enum parity parity)
+static inline void manchester_put_half(struct manchester_out *o, u_int32_t h)
+{
+	if (o->half) {
+		*o->w++ = o->pend | (h << 16);
+		o->half = 0;
+	} else {
+		o->pend = h;
+		o->half = 1;
+	}
+}
+
+/* two bit periods, the earlier one in the low halfword */
+static inline void manchester_put_word(struct manchester_out *o, u_int32_t x)
+{
+	if (o->half) {
+		*o->w++ = o->pend | (x << 16);
+		o->pend = x >> 16;
+	} else
+		*o->w++ = x;
+}
+
+/* eight data bits and optionally a parity bit (-1: odd parity) */
+static inline void manchester_put_byte(struct manchester_out *o, u_int8_t data,
+				       int parity)
+{
+	const u_int32_t *t = manchester_tab[data];
+
+	manchester_put_word(o, t[0]);
+	manchester_put_word(o, t[1]);
+	manchester_put_word(o, t[2]);
+	manchester_put_word(o, t[3]);
+
+	if (parity < 0)
+		manchester_put_half(o, t[4]);
+	else if (parity == 0)
+		manchester_put_half(o, MANCHESTER_SEQ_E);
+	else if (parity == 1)
+		manchester_put_half(o, MANCHESTER_SEQ_D);
+}
+
+/* bits first..last-1 of a byte, slow path for short and AC frames */
+static void manchester_put_bits(struct manchester_out *o, u_int8_t data,
+				int first, int last)
 {
 	int i;
-	u_int8_t sum_1 = 0;
-	u_int16_t *samples16 = *s16;
-
-	/* append 8 sample blobs, one for each bit */
-	for (i = 0; i < 8; i++) {
-		if (data & (1 << i)) {
-			*(samples16) = MANCHESTER_SEQ_D;
-			sum_1++;
-		} else {
-			*(samples16) = MANCHESTER_SEQ_E;
-		}
-		samples16++;
+
+	for (i = first; i < last; i++)
+		manchester_put_half(o, (data & (1 << i)) ?
+				    MANCHESTER_SEQ_D : MANCHESTER_SEQ_E);
+}
+
+static inline int manchester_parity(const iso14443_frame *frame, unsigned int i)
+{
+	switch (frame->parameters.a.parity) {
+	case GIVEN_PARITY:
+		return (frame->parity[i/8] & (1 << (i%8))) ? 1 : 0;
+	case NO_PARITY:
+		return 2;
+	case PARITY:
+	default:
+		return -1;
 	}
-	if(parity != PARITY_NONE) {
-		/* Append parity */
-		u_int8_t par=0;
-		switch(parity) {
-			case PARITY_NONE: break;
-			case PARITY_0: par = 0; break;
-			case PARITY_1: par = 1; break;
-			case ODD_PARITY:  par = (sum_1 & 0x1) ? 0 : 1; break;
-			case EVEN_PARITY: par = (sum_1 & 0x1) ? 1 : 0; break;
-		}
-		if (par)
-			*(samples16) = MANCHESTER_SEQ_D;
-		else
-			*(samples16) = MANCHESTER_SEQ_E;
-		samples16++;
+}
+
+struct manchester_layout {
+	unsigned int numbytes, bit_offset, numbits, crc;
+};
+
+static int manchester_layout(const iso14443_frame *frame,
+			     struct manchester_layout *l)
+{
+	unsigned int nbits;
+
+	if(frame->type != TYPE_A) return -EINVAL;
+
+	l->numbytes = frame->numbytes;
+	l->bit_offset = l->numbits = l->crc = 0;
+
+	switch (frame->parameters.a.format) {
+	case SHORT_FRAME:
+		l->numbytes = 0;
+		l->numbits = 7;
+		break;
+	case STANDARD_FRAME:
+		l->crc = frame->parameters.a.crc == CRC_APPEND;
+		break;
+	case AC_FRAME:
+		l->bit_offset = frame->bit_offset;
+		l->numbits = frame->numbits;
+		if (l->bit_offset > 7 || l->numbits > 7 ||
+		    (l->bit_offset && !l->numbytes))
+			return -EINVAL;
+		break;
+	default:
+		return -EINVAL;
 	}
-	*s16 = samples16;
+	if (l->numbytes + (l->numbits ? 1 : 0) > MAXIMUM_FRAME_SIZE)
+		return -EINVAL;
+
+	nbits = (l->numbytes + (l->crc ? 2 : 0)) *
+		((frame->parameters.a.parity != NO_PARITY) ? 9 : 8)
+		- l->bit_offset + l->numbits;
+
+	/* One bit data is 16 bit is 2 byte modulation data */
+	return (1 /* SOF */ + nbits + 1 /* EOF */) * 2;
 }
 
+int manchester_encoded_size(const iso14443_frame *frame)
+{
+	struct manchester_layout l;
+
+	return manchester_layout(frame, &l);
+}
+
+/* Encode a frame into subcarrier modulation samples, 2 bytes per bit.
+ *
+ * SHORT_FRAME:    7 bits of data[0], no parity
+ * STANDARD_FRAME: numbytes bytes, each followed by its parity bit, and
+ *                 the CRC_A with computed parity for CRC_APPEND
+ * AC_FRAME:       bit oriented anticollision frame; the first byte is
+ *                 sent from bit bit_offset on (followed by the parity of
+ *                 the whole byte), then the remaining complete bytes and
+ *                 finally numbits bits of data[numbytes] without parity
+ *
+ * sample_buf must be 16bit aligned.  Returns the number of sample bytes. */
 int manchester_encode(u_int8_t *sample_buf, u_int16_t sample_buf_len, 
 		      const iso14443_frame *frame)
 {
-	unsigned int i, enc_size;
-	u_int16_t *samples16;
+	unsigned int i, first = 0, numbytes, bit_offset, numbits;
+	struct manchester_layout l;
+	struct manchester_out o;
+	int parity, enc_size;
 	
-	if(frame->type != TYPE_A) return -EINVAL;
-	if(frame->parameters.a.format != STANDARD_FRAME) return -EINVAL; /* AC not implemented yet */
-	
-	/* One bit data is 16 bit is 2 byte modulation data */
-	enc_size = 1 /* SOF */ 
-		+ frame->numbytes * ((frame->parameters.a.parity != NO_PARITY) ? 9 : 8) /* bits per byte */
-		+ 1 /* EOF */;
-	enc_size = enc_size /* in bits */ * 2 /* bytes modulation data per bit raw data*/;
+	enc_size = manchester_layout(frame, &l);
+	if (enc_size < 0)
+		return enc_size;
+	numbytes = l.numbytes;
+	bit_offset = l.bit_offset;
+	numbits = l.numbits;
 
 	if (sample_buf_len < enc_size)
 		return -EINVAL;
 	
-	memset(sample_buf, 0, enc_size);
-	
-	samples16 = (u_int16_t*)sample_buf;
+	/* SOF, after which the output is word aligned */
+	if ((unsigned long) sample_buf & 2) {
+		*(u_int16_t *) sample_buf = MANCHESTER_SEQ_D;
+		o.w = (u_int32_t *) (sample_buf + 2);
+		o.half = 0;
+	} else {
+		o.w = (u_int32_t *) sample_buf;
+		o.pend = MANCHESTER_SEQ_D;
+		o.half = 1;
+	}
+
+	if (bit_offset) {
+		/* split byte of an anticollision frame */
+		manchester_put_bits(&o, frame->data[0], bit_offset, 8);
+		parity = manchester_parity(frame, 0);
+		if (parity < 0)
+			parity = manchester_tab[frame->data[0]][4] ==
+				MANCHESTER_SEQ_D;
+		if (parity <= 1)
+			manchester_put_half(&o, parity ?
+					    MANCHESTER_SEQ_D : MANCHESTER_SEQ_E);
+		first = 1;
+	}
+
+	if (frame->parameters.a.parity == PARITY) {
+		for (i = first; i < numbytes; i++)
+			manchester_put_byte(&o, frame->data[i], -1);
+	} else {
+		for (i = first; i < numbytes; i++)
+			manchester_put_byte(&o, frame->data[i],
+					    manchester_parity(frame, i));
+	}
+
+	if (numbits)
+		manchester_put_bits(&o, frame->data[numbytes], 0, numbits);
+
+	if (l.crc) {
+		u_int16_t crc = iso14443a_crc(frame->data, numbytes);
+		parity = frame->parameters.a.parity == NO_PARITY ? 2 : -1;
+		manchester_put_byte(&o, crc & 0xff, parity);
+		manchester_put_byte(&o, crc >> 8, parity);
+	}
 
-	/* SOF */
-	*(samples16++) = MANCHESTER_SEQ_D;
-	
-	if(frame->parameters.a.parity == NO_PARITY)
-		for (i = 0; i < frame->numbytes; i++)
-			manchester_enc_byte(&samples16, frame->data[i], PARITY_NONE);
-	else if(frame->parameters.a.parity == GIVEN_PARITY)
-		for (i = 0; i < frame->numbytes; i++)
-			manchester_enc_byte(&samples16, frame->data[i], 
-				(frame->parity[i/8]&(1<<(i%8))) ?PARITY_1:PARITY_0);
-	else if(frame->parameters.a.parity == PARITY)
-		for (i = 0; i < frame->numbytes; i++)
-			manchester_enc_byte(&samples16, frame->data[i], ODD_PARITY);
-		
 	/* EOF */
-	*(samples16++) = MANCHESTER_SEQ_F;
+	manchester_put_half(&o, MANCHESTER_SEQ_F);
+	if (o.half)
+		*(u_int16_t *) o.w = o.pend;
 
 	return enc_size;
 }
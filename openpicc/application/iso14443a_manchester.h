@@ -2,4 +2,6 @@
 #define ISO14443A_MANCHESTER_H_
 
 extern int manchester_encode(u_int8_t *sample_buf, u_int16_t sample_buf_len, const iso14443_frame *frame);
+/* sample bytes manchester_encode() will produce for frame, or -EINVAL */
+extern int manchester_encoded_size(const iso14443_frame *frame);
 #endif /*ISO14443A_MANCHESTER_H_*/
@@ -35,6 +35,7 @@
 #include "iso14443_layer2a.h"
 #include "iso14443a_pretender.h"
 #include "iso14443a_manchester.h"
+#include "response_cache.h"
 #include "usb_print.h"
 #include "cmd.h"
 extern volatile int fdt_offset;
@@ -66,10 +67,10 @@ static const iso14443_frame ATQA_FRAME = {
 static const iso14443_frame ATS_FRAME = {
 	TYPE_A,
 	FRAME_PREFILLED,
-	{{STANDARD_FRAME, PARITY, ISO14443A_LAST_BIT_NONE, CRC_UNCALCULATED}},
-	3,
+	{{STANDARD_FRAME, PARITY, ISO14443A_LAST_BIT_NONE, CRC_APPEND}},
+	1,
 	0, 0,
-	{0x08, 0xB6, 0xDD},
+	{0x08},
 	{}
 };
 
@@ -78,19 +79,65 @@ static iso14443_frame UID_FRAME, NONCE_FRAME;
 static u_int8_t UID[]   = {0x00, 0x00, 0x00, 0x00}; 
 static u_int8_t nonce[] = {0x00, 0x00, 0x00, 0x00};
 
-#define FRAME_SIZE(bytes) (2* (1+(9*bytes)+1) )
 #define BYTES_AND_BITS(bytes,bits) (bytes*9+bits)
-#define GET_BASE_SIZE(type) ((size_t) &(((type*)0)->data))
 
-static ssc_dma_tx_buffer_t *ATQA_BUFFER, *UID_BUFFER, *ATS_BUFFER, *NONCE_BUFFER;
+/* Bit periods before the nonce goes out, the nominal FDT as for all other
+ * responses. 50 was tuned on the board back when the nonce got encoded in
+ * the receive callback (52 ok, 26 not, 39 not, 45 not, 48 not, 50 ok, 49
+ * not), now it is modulated in advance like the others. */
+#ifndef AUTH_REPLY_BITS
+#define AUTH_REPLY_BITS 9
+#endif
+
+/* Handles into the response cache */
+static int ATQA_RESPONSE = -1, UID_RESPONSE = -1, ATS_RESPONSE = -1, NONCE_RESPONSE = -1;
+
+static void prepare_frame(iso14443_frame *frame, int len);
+
+/* Fill in the UID frame (UID and BCC) */
+static void fill_UID_frame(iso14443_frame *frame, const u_int8_t *uid, size_t len)
+{
+	u_int8_t bcc = 0;
+	unsigned int i;
+	
+	prepare_frame(frame, len+1);
+	for(i=0; i<len; i++) {
+		frame->data[i] = uid[i];
+		bcc ^= uid[i];
+	}
+	frame->data[i] = bcc;
+	frame->state = FRAME_PREFILLED;
+}
+
+/* Response cache update function: the UID is incremented on each HLTA */
+static void next_UID_frame(iso14443_frame *next, const iso14443_frame *cur)
+{
+	u_int8_t uid[4];
+	int i;
+	
+	memcpy(uid, cur->data, sizeof(uid));
+	for(i=sizeof(uid)-1; i>=0; i--)
+		if(++uid[i] != 0) break;
+	fill_UID_frame(next, uid, sizeof(uid));
+}
 
-static ssc_dma_tx_buffer_t *alloc_buffer_for_frame(const iso14443_frame *frame)
+/* Response cache update function: after each AUTH the nonce moves on like
+ * the PRNG of a MIFARE Classic card, the 16 bit LFSR x^16+x^14+x^13+x^11+1
+ * clocked 32 times (prng_successor() of crapto1). An all zero nonce stays
+ * zero. */
+static void next_nonce_frame(iso14443_frame *next, const iso14443_frame *cur)
 {
-	int datalen = FRAME_SIZE( BYTES_AND_BITS(frame->numbytes, frame->numbits) );
-	ssc_dma_tx_buffer_t *dst = pvPortMalloc( GET_BASE_SIZE(typeof(*dst)) + datalen );
-	if(dst == NULL) return NULL;
-	dst->len = datalen;
-	return dst;
+	u_int32_t x;
+	int i;
+	
+	x = cur->data[0] | cur->data[1] << 8 | cur->data[2] << 16 | (u_int32_t)cur->data[3] << 24;
+	for(i=0; i<32; i++)
+		x = x >> 1 | (x >> 16 ^ x >> 18 ^ x >> 19 ^ x >> 21) << 31;
+	
+	prepare_frame(next, 4);
+	for(i=0; i<4; i++)
+		next->data[i] = x >> (8*i);
+	next->state = FRAME_PREFILLED;
 }
 
 static void fast_receive_callback(ssc_dma_rx_buffer_t *buffer, iso14443_frame *frame, u_int8_t in_irq)
@@ -99,6 +146,8 @@ static void fast_receive_callback(ssc_dma_rx_buffer_t *buffer, iso14443_frame *f
 	u_int32_t cv = *AT91C_TC2_CV;
 	
 	ssc_dma_tx_buffer_t *tx_buffer=NULL;
+	const iso14443_frame *tx_frame=NULL;
+	int tx_response = -1;
 	int fdt = 0;
 	
 	switch(frame->parameters.a.last_bit) {
@@ -118,45 +167,40 @@ static void fast_receive_callback(ssc_dma_rx_buffer_t *buffer, iso14443_frame *f
 		switch(BYTES_AND_BITS(frame->numbytes,frame->numbits)) {
 		case BYTES_AND_BITS(0, 7): /* REQA or WUPA (7 bits) */
 			if(frame->data[0] == 0x26 || frame->data[0] == 0x52)
-				tx_buffer = ATQA_BUFFER;
+				tx_response = ATQA_RESPONSE;
 			fdt += 9*128;
 			break;
 		case BYTES_AND_BITS(2, 0): /* ANTICOL (2 bytes) */
 			if(frame->data[0] == 0x93 && frame->data[1] == 0x20)
-				tx_buffer = UID_BUFFER;
+				tx_response = UID_RESPONSE;
 			fdt += 9*128;
 			break;
 		case BYTES_AND_BITS(9, 0): /* SELECT (9 bytes) */
 			if(frame->data[0] == 0x93 && frame->data[1] == 0x70 && frame->parameters.a.crc &&
-					( *((u_int32_t*)&frame->data[2]) ==  *((u_int32_t*)&UID) ) )
-				tx_buffer = ATS_BUFFER;
+					memcmp(&frame->data[2], response_cache_frame(UID_RESPONSE)->data, 4) == 0 )
+				tx_response = ATS_RESPONSE;
 			fdt += 9*128;
 			break;
 		}
 	
-	if(tx_buffer == NULL) 
+	if(tx_response < 0) 
 		switch(BYTES_AND_BITS(frame->numbytes, frame->numbits)) {
 		case BYTES_AND_BITS(4, 0):
 			if( (frame->data[0] & 0xfe) == 0x60 && frame->parameters.a.crc) {
-				/* AUTH1A or AUTH1B */
-				if(NONCE_BUFFER == NULL) {
-					NONCE_BUFFER = alloc_buffer_for_frame(&NONCE_FRAME);
-				}
-				if(NONCE_BUFFER != NULL) {
-					int ret = manchester_encode(NONCE_BUFFER->data,  NONCE_BUFFER->len,  &NONCE_FRAME);
-					if(ret < 0) {
-					} else {
-						NONCE_BUFFER->len = ret;
-						tx_buffer = NONCE_BUFFER;
-					}
-				}
-				
-				/*fdt += ((cv / 128) + 10) * 128;*/
-				fdt += 50*128;  /* 52 ok, 26 not, 39 not, 45 not, 48 not, 50 ok, 49 not */
+				/* AUTH1A or AUTH1B, the nonce is already modulated */
+				tx_response = NONCE_RESPONSE;
+				fdt += AUTH_REPLY_BITS*128;
 			}
 			break;
 		}
 	
+	if(tx_response >= 0) {
+		tx_buffer = response_cache_get(tx_response);
+		tx_frame = response_cache_frame(tx_response);
+		/* Still being sent from the last time? */
+		if(tx_buffer->state != SSC_FREE) tx_buffer = NULL;
+	}
+	
 	/* Add some extra room to the fdt for testing */
 	//fdt += 3*128;
 	fdt += fdt_offset;
@@ -164,14 +208,18 @@ static void fast_receive_callback(ssc_dma_rx_buffer_t *buffer, iso14443_frame *f
 	if(tx_buffer != NULL) {
 		tx_buffer->state = SSC_FULL;
 		if(	iso14443_transmit(tx_buffer, fdt, 1, 0) < 0) {
+			tx_buffer->state = SSC_FREE;
 			usb_print_string_f("Tx failed ", 0);
+		} else if(tx_response == NONCE_RESPONSE) {
+			/* the next AUTH gets the precomputed next nonce */
+			response_cache_advance(NONCE_RESPONSE);
 		}
 	}
 	
 #if 0
 	u_int32_t cv2 = *AT91C_TC2_CV;
 	usb_print_string_f("\r\n",0);
-	if(tx_buffer == &NONCE_BUFFER) usb_print_string_f("---> ",0);
+	if(tx_response == NONCE_RESPONSE) usb_print_string_f("---> ",0);
 	int old=usb_print_set_default_flush(0);
 	DumpUIntToUSB(cv);
 	DumpStringToUSB(":");
@@ -182,28 +230,18 @@ static void fast_receive_callback(ssc_dma_rx_buffer_t *buffer, iso14443_frame *f
 	switch(BYTES_AND_BITS(frame->numbytes,frame->numbits)) {
 	case BYTES_AND_BITS(4, 0):
 		if(frame->parameters.a.crc && frame->data[0] == 0x50 && frame->data[1] == 0x00) {
-			/* HLTA */
-			UID[3]++;
-			if(UID[3]==0) {
-				UID[2]++;
-				if(UID[2]==0) {
-					UID[1]++;
-					if(UID[1]==0) {
-						UID[0]++;
-					}
-				}
-			}
-			set_UID(UID, sizeof(UID));
+			/* HLTA, switch to the precomputed next UID */
+			response_cache_advance(UID_RESPONSE);
 		}
 	break;
 	}
 	
 	if(tx_buffer) usb_print_string_f("\r\n",0);
-	if(tx_buffer == UID_BUFFER) {
-		memcpy(&challenge_response.UID, UID_FRAME.data, 5);
+	if(tx_buffer && tx_response == UID_RESPONSE) {
+		memcpy(&challenge_response.UID, tx_frame->data, 5);
 		usb_print_string_f("uid", 0);
-	} else if(tx_buffer == NONCE_BUFFER) {
-		memcpy(&challenge_response.nonce, NONCE_FRAME.data, 4);
+	} else if(tx_buffer && tx_response == NONCE_RESPONSE) {
+		memcpy(&challenge_response.nonce, tx_frame->data, 4);
 		challenge_response.waiting_for_response = 1;
 		usb_print_string_f("nonce", 0);
 	} else if(challenge_response.waiting_for_response) {
@@ -242,61 +280,45 @@ static void prepare_frame(iso14443_frame *frame, int len)
 
 int set_UID(u_int8_t *uid, size_t len)
 {
-	prepare_frame(&UID_FRAME, len+1);
-	
-	u_int8_t bcc = 0;
-	unsigned int i;
-	for(i=0; i<len; i++) {
-		UID_FRAME.data[i] = uid[i];
-		bcc ^= uid[i];
-	}
-	UID_FRAME.data[i] = bcc;
-	UID_FRAME.state = FRAME_PREFILLED;
+	if(len != 4) return -EINVAL;
+	fill_UID_frame(&UID_FRAME, uid, len);
 	memcpy(UID, uid, len);
 	
-	if(UID_BUFFER == NULL) {
-		UID_BUFFER = alloc_buffer_for_frame(&UID_FRAME);
-		if(UID_BUFFER == NULL) return -ENOMEM;
+	if(UID_RESPONSE < 0) {
+		UID_RESPONSE = response_cache_register(&UID_FRAME, next_UID_frame);
+		return UID_RESPONSE < 0 ? UID_RESPONSE : 0;
 	}
-	memset(UID_BUFFER->data, 0, UID_BUFFER->len);
-	
-	int ret = manchester_encode(UID_BUFFER->data,  UID_BUFFER->len,  &UID_FRAME);
-	if(ret < 0) return ret;
-	else UID_BUFFER->len = ret;
-	return 0;
+	return response_cache_set(UID_RESPONSE, &UID_FRAME);
 }
 
 int get_UID(u_int8_t *uid, size_t len)
 {
 	if(len < 4 || len > 4) return -1;
-	memcpy(uid, UID, len);
+	if(UID_RESPONSE < 0) memcpy(uid, UID, len);
+	else memcpy(uid, response_cache_frame(UID_RESPONSE)->data, len);
 	return 0;
 }
 
 int set_nonce(u_int8_t *_nonce, size_t len)
 {
+	if(len != 4) return -EINVAL;
 	prepare_frame(&NONCE_FRAME, len);
-	
 	memcpy(&NONCE_FRAME.data, _nonce, len);
 	NONCE_FRAME.state = FRAME_PREFILLED;
 	memcpy(nonce, _nonce, len);
 	
-	if(NONCE_BUFFER == NULL) {
-		NONCE_BUFFER = alloc_buffer_for_frame(&NONCE_FRAME);
-		if(NONCE_BUFFER == NULL) return -ENOMEM;
+	if(NONCE_RESPONSE < 0) {
+		NONCE_RESPONSE = response_cache_register(&NONCE_FRAME, next_nonce_frame);
+		return NONCE_RESPONSE < 0 ? NONCE_RESPONSE : 0;
 	}
-	memset(NONCE_BUFFER->data, 0, NONCE_BUFFER->len);
-	
-	int ret = manchester_encode(NONCE_BUFFER->data,  NONCE_BUFFER->len,  &NONCE_FRAME);
-	if(ret < 0) return ret;
-	else NONCE_BUFFER->len = ret;
-	return 0;
+	return response_cache_set(NONCE_RESPONSE, &NONCE_FRAME);
 }
 
 int get_nonce(u_int8_t *_nonce, size_t len)
 {
 	if(len < 4 || len > 4) return -1;
-	memcpy(_nonce, nonce, len);
+	if(NONCE_RESPONSE < 0) memcpy(_nonce, nonce, len);
+	else memcpy(_nonce, response_cache_frame(NONCE_RESPONSE)->data, len);
 	return 0;
 }
 
@@ -318,23 +340,12 @@ void iso14443a_pretender (void *pvParameters)
 		vTaskDelay(1*portTICK_RATE_MS);
 	}
 	
-	int ret;
-#define PREFILL_BUFFER(dst, src) dst = alloc_buffer_for_frame(&src); \
-	if(dst == 0) goto prefill_failed; \
-	ret = manchester_encode(dst->data,  dst->len,  &src); \
-	if(ret < 0) goto prefill_failed; else dst->len = ret;
-	
-	PREFILL_BUFFER(ATQA_BUFFER,  ATQA_FRAME);
-	//PREFILL_BUFFER(UID_BUFFER,   UID_FRAME);
-	PREFILL_BUFFER(ATS_BUFFER,   ATS_FRAME);
-	//PREFILL_BUFFER(NONCE_BUFFER, NONCE_FRAME);
-	
-	set_UID(UID, sizeof(UID));
-	set_nonce(nonce, sizeof(nonce));
+	ATQA_RESPONSE = response_cache_register(&ATQA_FRAME, NULL);
+	ATS_RESPONSE  = response_cache_register(&ATS_FRAME, NULL);
 	
-	if(0) {
-prefill_failed:
-		usb_print_string("Buffer prefilling failed\n\r");
+	if(ATQA_RESPONSE < 0 || ATS_RESPONSE < 0 ||
+			set_UID(UID, sizeof(UID)) < 0 || set_nonce(nonce, sizeof(nonce)) < 0) {
+		usb_print_string("Response cache prefilling failed\n\r");
 		while(1) {
 			for(i=1000; i<=3000; i++) {
 				vLedSetBrightness(LED_GREEN, abs(1000-(i%2000)));
@@ -380,6 +391,8 @@ prefill_failed:
 	while(true) {
 		iso14443_frame *frame = 0;
 		res = iso14443_receive(fast_receive_callback, &frame, 1000 * portTICK_RATE_MS);
+		/* Modulate the next UID and nonce while the reader is busy with us */
+		response_cache_process();
 		if(res >= 0) {
 			switch(BYTES_AND_BITS(frame->numbytes, frame->numbits) ) {
 			case BYTES_AND_BITS(0, 7): /* REQA (7 bits) */
@@ -395,9 +408,7 @@ prefill_failed:
 				break;
 			}
 			
-			portENTER_CRITICAL();
-			frame->state = FRAME_FREE;
-			portEXIT_CRITICAL();
+			iso14443_release(frame);
 		} else {
 			if(res != -ETIMEDOUT) {
 				usb_print_string("Receive error: ");
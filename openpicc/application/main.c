@@ -53,6 +53,7 @@
 #include "decoder.h"
 #include "tc_sniffer.h"
 #include "performance.h"
+#include "trace.h"
 
 static inline int detect_board(void)
 {
@@ -149,13 +150,13 @@ static inline void prvSetupHardware (void)
     AT91C_BASE_PMC->PMC_PCER = 1 << AT91C_ID_PIOB;    
 
     /* initialize environment variables */
+    env.mode=0;
+    env.reader_id=255;
+    env.fdt_offset=fdt_offset;
+    env.comparator=DA_BASELINE;
     env_init();
     if(!env_load())
-    {
-	env.e.mode=0;
-	env.e.reader_id=255;
 	env_store();
-    }
 }
 
 /**********************************************************************/
@@ -197,8 +198,8 @@ int main (void)
 {
     prvSetupHardware ();
     usb_print_init();
-    decoder_init();
     performance_init();
+    trace_init();
     
     pio_irq_init();
     
@@ -207,16 +208,23 @@ int main (void)
     da_init();
     adc_init();
     
+    /* The tuning saved with the 'w' command */
+    fdt_offset = env.fdt_offset;
+    da_comp_carr(env.comparator);
+    
     xTaskCreate (usb_print_flusher, (signed portCHAR *) "PRINT-FLUSH", TASK_USB_STACK,
 	NULL, TASK_USB_PRIORITY, NULL);
     /*xTaskCreate (iso14443_layer3a_state_machine, (signed portCHAR *) "ISO14443A-3", TASK_ISO_STACK,
 	NULL, TASK_ISO_PRIORITY, NULL);*/
     /*xTaskCreate (iso14443_sniffer, (signed portCHAR *) "ISO14443-SNIFF", TASK_ISO_STACK,
 	NULL, TASK_ISO_PRIORITY, NULL);*/
+#ifdef OPENPICC_SNIFFER
+    xTaskCreate (tc_sniffer, (signed portCHAR *) "RFID-SNIFFER", TASK_ISO_STACK,
+	NULL, TASK_ISO_PRIORITY, NULL);
+#else
     xTaskCreate (iso14443a_pretender, (signed portCHAR *) "ISO14443A-PRETEND", TASK_ISO_STACK,
 	NULL, TASK_ISO_PRIORITY, NULL);
-    /*xTaskCreate (tc_sniffer, (signed portCHAR *) "RFID-SNIFFER", TASK_ISO_STACK,
-		 	NULL, TASK_ISO_PRIORITY, NULL);*/
+#endif
 
 	    
     xTaskCreate (vUSBCDCTask, (signed portCHAR *) "USB", TASK_USB_STACK,
@@ -0,0 +1,26 @@
+#!/usr/bin/env python
+#
+# Generates manchester_tab.inc for iso14443a_manchester.c
+#
+# For every byte value the table holds the subcarrier modulation of its
+# eight data bits (LSB first, 16 samples per bit, two bits per word) and,
+# in the fifth word, the modulation of its odd parity bit.
+
+import sys
+
+SEQ_D = 0x0055	# logic 1
+SEQ_E = 0x5500	# logic 0
+
+def seq(bit):
+	if bit:
+		return SEQ_D
+	return SEQ_E
+
+sys.stdout.write("/* Autogenerated from manchester_tab.py */\n")
+sys.stdout.write("static const u_int32_t manchester_tab[256][5] = {\n")
+for b in range(256):
+	w = [seq((b >> i) & 1) | (seq((b >> (i + 1)) & 1) << 16)
+		for i in range(0, 8, 2)]
+	w.append(seq(1 - (bin(b).count("1") & 1)))
+	sys.stdout.write("\t{ " + ", ".join(["0x%08x" % x for x in w]) + " },\n")
+sys.stdout.write("};\n")
@@ -0,0 +1,131 @@
+/***************************************************************
+ *
+ * OpenPICC - metrics registry
+ *
+ * Counters, gauges and histograms are declared with the
+ * DEFINE_METRIC_* macros in metrics.h by the code they belong
+ * to. The descriptors end up in the "metrics" section, between
+ * __start_metrics and __stop_metrics, so this file finds them
+ * without any registration at run time.
+ *
+ * metrics_dump() puts a snapshot of all of them into a buffer
+ * and sends it over USB as one descriptor. host/metrics_poll
+ * asks for one at a fixed rate and shows what has changed.
+ *
+ ***************************************************************
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; version 2.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#include <FreeRTOS.h>
+#include <openpicc.h>
+#include <USB-CDC.h>
+#include <errno.h>
+#include <string.h>
+
+#include "metrics.h"
+#include "performance.h"
+#include "cmd.h"
+
+extern const struct metric __start_metrics[], __stop_metrics[];
+
+#define for_each_metric(m) \
+	for(m = __start_metrics; m < __stop_metrics; m++)
+
+static u_int8_t dump_buffer[METRICS_DUMP_SIZE];
+static xUSB_TX_DESCRIPTOR dump_desc;
+static volatile int dump_busy;
+
+static inline u_int32_t metric_value(const struct metric *m, unsigned int i)
+{
+	return m->read ? m->read() : m->value[i];
+}
+
+void metrics_print(void)
+{
+	const struct metric *m;
+	unsigned int i;
+
+	for_each_metric(m) {
+		DumpStringToUSB(" * \t");
+		DumpStringToUSB(m->name);
+		DumpStringToUSB(":");
+		for(i = 0; i < m->buckets; i++) {
+			DumpStringToUSB(" ");
+			DumpUIntToUSB(metric_value(m, i));
+		}
+		DumpStringToUSB("\n\r");
+	}
+}
+
+static void dump_done(xUSB_TX_DESCRIPTOR *desc)
+{
+	(void)desc;
+	dump_busy = 0;
+}
+
+int metrics_dump(void)
+{
+	struct metrics_dump_header *hdr = (struct metrics_dump_header *)dump_buffer;
+	const struct metric *m;
+	unsigned int pos = sizeof(*hdr), len, i;
+	u_int32_t v, sum = 0;
+	u_int16_t count = 0;
+
+	if(dump_busy)
+		return -EBUSY;
+	dump_busy = 1;
+
+	for_each_metric(m) {
+		len = strlen(m->name);
+		if(pos + 4 + len + 4*m->buckets > sizeof(dump_buffer)) {
+			dump_busy = 0;
+			return -ENOSPC;
+		}
+		dump_buffer[pos++] = m->type;
+		dump_buffer[pos++] = m->flags;
+		dump_buffer[pos++] = m->buckets;
+		dump_buffer[pos++] = len;
+		memcpy(dump_buffer + pos, m->name, len);
+		pos += len;
+		/* Each word is read atomically, a histogram as a whole is not */
+		for(i = 0; i < m->buckets; i++) {
+			v = metric_value(m, i);
+			dump_buffer[pos++] = v;
+			dump_buffer[pos++] = v >> 8;
+			dump_buffer[pos++] = v >> 16;
+			dump_buffer[pos++] = v >> 24;
+		}
+		count++;
+	}
+	for(i = sizeof(*hdr); i < pos; i++)
+		sum += dump_buffer[i];
+
+	hdr->magic = METRICS_DUMP_MAGIC;
+	hdr->time = performance_now();
+	hdr->clock_hz = PERFORMANCE_CLOCK_HZ;
+	hdr->count = count;
+	hdr->length = pos - sizeof(*hdr);
+	hdr->sum = sum;
+
+	dump_desc.pucData = dump_buffer;
+	dump_desc.usLength = pos;
+	dump_desc.vRelease = dump_done;
+	if(xUSBSendDescriptor(&dump_desc, portMAX_DELAY) != pdPASS) {
+		dump_busy = 0;
+		return -EIO;
+	}
+	return 0;
+}
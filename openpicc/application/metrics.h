@@ -0,0 +1,116 @@
+#ifndef METRICS_H_
+#define METRICS_H_
+
+/* Metrics registry, see metrics.c. The dump format is read by
+ * host/metrics_poll.c.
+ *
+ * A subsystem declares its metrics at file scope:
+ *
+ *	DEFINE_METRIC_COUNTER(rx_overflows, "ssc.rx_overflows", METRIC_F_ERROR);
+ *	DEFINE_METRIC_HISTOGRAM(latency, "tc_recv.frame_end", 16, 6);
+ *	DEFINE_METRIC_READ(free_rx, "ssc.free_rx_buffers", METRIC_GAUGE, 0, count_free);
+ *
+ * and updates them with metric_inc(rx_overflows), metric_observe(latency, v)
+ * and so on, from tasks or IRQ handlers. Nothing has to be registered at
+ * run time, the linker collects the descriptors in the "metrics" section.
+ */
+
+#include <FreeRTOS.h>
+
+enum metric_type {
+	METRIC_COUNTER,		/* only goes up, the host shows the increase */
+	METRIC_GAUGE,		/* a level, shown as it is */
+	METRIC_HISTOGRAM,	/* counts per bucket of value >> shift, the last
+				 * bucket takes everything above */
+};
+
+#define METRIC_F_ERROR	0x01	/* should not go up, the host flags it */
+
+struct metric {
+	const char *name;
+	u_int8_t type;
+	u_int8_t flags;
+	u_int8_t buckets;		/* 1 unless a histogram */
+	u_int8_t shift;
+	volatile u_int32_t *value;	/* buckets words */
+	u_int32_t (*read)(void);	/* for values kept elsewhere, instead of value */
+};
+
+#define __metric __attribute__ ((used, section("metrics"), aligned(sizeof(void*))))
+
+#define DEFINE_METRIC_COUNTER(var, _name, _flags) \
+	static volatile u_int32_t var; \
+	static const struct metric __metric_##var __metric = { \
+		.name = _name, .type = METRIC_COUNTER, .flags = _flags, \
+		.buckets = 1, .value = &var }
+
+#define DEFINE_METRIC_GAUGE(var, _name, _flags) \
+	static volatile u_int32_t var; \
+	static const struct metric __metric_##var __metric = { \
+		.name = _name, .type = METRIC_GAUGE, .flags = _flags, \
+		.buckets = 1, .value = &var }
+
+#define DEFINE_METRIC_HISTOGRAM(var, _name, _buckets, _shift) \
+	static volatile u_int32_t var[_buckets]; \
+	static const struct metric __metric_##var __metric = { \
+		.name = _name, .type = METRIC_HISTOGRAM, .buckets = _buckets, \
+		.shift = _shift, .value = var }
+
+/* For a word that lives elsewhere, e.g. in a struct. id only names the
+ * descriptor. */
+#define DEFINE_METRIC_VALUE(id, _name, _type, _flags, ptr) \
+	static const struct metric __metric_##id __metric = { \
+		.name = _name, .type = _type, .flags = _flags, \
+		.buckets = 1, .value = ptr }
+
+/* id only names the descriptor, fn is called when the metrics are read */
+#define DEFINE_METRIC_READ(id, _name, _type, _flags, fn) \
+	static u_int32_t fn(void); \
+	static const struct metric __metric_##id __metric = { \
+		.name = _name, .type = _type, .flags = _flags, \
+		.buckets = 1, .read = fn }
+
+static inline void __metric_add(volatile u_int32_t *value, u_int32_t n)
+{
+	unsigned portLONG mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	*value += n;
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+}
+
+static inline void __metric_observe(const struct metric *m, u_int32_t v)
+{
+	v >>= m->shift;
+	__metric_add(&m->value[v < m->buckets ? v : m->buckets - 1u], 1);
+}
+
+#define metric_inc(var)		__metric_add(&(var), 1)
+#define metric_add(var, n)	__metric_add(&(var), (n))
+/* A single store, no need to mask the IRQ */
+#define metric_set(var, v)	((var) = (v))
+#define metric_observe(var, v)	__metric_observe(&__metric_##var, (v))
+
+/* A dump is this header followed by count entries of
+ *	u_int8_t type, flags, buckets, name_length
+ *	char name[name_length]
+ *	u_int32_t value[buckets]
+ * without padding. sum is the sum of the bytes after the header. */
+#define METRICS_DUMP_MAGIC	0x3152544d	/* "MTR1" */
+#define METRICS_DUMP_SIZE	1024
+
+struct metrics_dump_header {
+	u_int32_t magic;
+	u_int32_t time;		/* performance_now() */
+	u_int32_t clock_hz;	/* of time */
+	u_int16_t count;
+	u_int16_t length;	/* of what follows */
+	u_int32_t sum;
+} __attribute__ ((packed));
+
+/* Print all metrics as text */
+extern void metrics_print(void);
+/* Send a dump over USB. Returns 0, -EBUSY while the previous dump is
+ * still being sent, -ENOSPC if the metrics do not fit METRICS_DUMP_SIZE
+ * or -EIO if USB is not up. */
+extern int metrics_dump(void);
+
+#endif /*METRICS_H_*/
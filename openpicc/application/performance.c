@@ -22,18 +22,11 @@
 #include <AT91SAM7.h>
 #include <openpicc.h>
 
-#include <string.h>
-
 #include "performance.h"
-#include "cmd.h"
+#include "metrics.h"
 
 static AT91PS_TC tc_perf = AT91C_BASE_TC1;
-static u_int32_t overruns = 0;
-
-#define NUMBER_OF_CHECKPOINTS 20
-static struct performance_checkpoint checkpoints[NUMBER_OF_CHECKPOINTS];
-static int current_checkpoint;
-static int running=0;
+DEFINE_METRIC_COUNTER(overruns, "performance.tc1_overflows", 0);
 
 static void __ramfunc tc_perf_irq(void) __attribute__ ((naked));
 static void __ramfunc tc_perf_irq(void)
@@ -45,6 +38,7 @@ static void __ramfunc tc_perf_irq(void)
 	portRESTORE_CONTEXT();
 }
 
+/* TC1 runs freely from here on, it is the time base of the trace */
 void performance_init(void)
 {
 	AT91F_PMC_EnablePeriphClock(AT91C_BASE_PMC, ((u_int32_t) 1 << AT91C_ID_TC1));
@@ -59,92 +53,19 @@ void performance_init(void)
 	AT91F_AIC_ClearIt(AT91C_ID_TC1);
 	AT91F_AIC_EnableIt(AT91C_ID_TC1);
 	
-	memset(checkpoints, 0, sizeof(checkpoints));
-}
-
-inline void performance_start(void)
-{
-	memset(checkpoints, 0, sizeof(checkpoints));
-	current_checkpoint = 0;
 	overruns = 0;
-	running = 1;
 	tc_perf->TC_CCR = AT91C_TC_SWTRG | AT91C_TC_CLKEN;
 }
 
-inline perf_time_t performance_get(void)
-{
-	u_int32_t cv = tc_perf->TC_CV;
-	perf_time_t result = {
-			.high = overruns,
-			.low = cv,
-	};
-	return result;
-}
-
-inline perf_time_t performance_stop(void)
-{
-	perf_time_t result = performance_get();
-	running = 0;
-	tc_perf->TC_CCR = AT91C_TC_CLKDIS;
-	return result;
-}
-
-void performance_print(perf_time_t time)
-{
-	DumpUIntToUSB(time.high);
-	DumpStringToUSB(":");
-	DumpUIntToUSB(time.low);
-}
-
-perf_time_t performance_diff(perf_time_t a, perf_time_t b)
+u_int32_t performance_now(void)
 {
-	// assert that a <= b
-	if( (a.high > b.high) || (a.high == b.high && a.low > b.low) ) return performance_diff(b, a);
-	perf_time_t result = { b.high - a.high, 0 };
-	if(b.high == a.high) result.low = b.low - a.low;
+	u_int32_t high, low;
 	
-	return result;
-}
-
-void performance_set_checkpoint(const char * const description)
-{
-	if(!running) return;
-	if(current_checkpoint < NUMBER_OF_CHECKPOINTS) {
-		perf_time_t time = performance_get();
-		checkpoints[current_checkpoint++] = (struct performance_checkpoint){
-				.time = time,
-				.description = description,
-		};
-	}
-}
-
-void performance_stop_report(void)
-{
-	if(!running) return;
-	perf_time_t _now = performance_stop();
-	struct performance_checkpoint now = {
-			.time = _now,
-			.description = "end of data collection",
-	};
-	perf_time_t last = {0,0};
-	int i;
-	DumpStringToUSB("Performance report: \n\r");
-	for(i = 0; i <= current_checkpoint; i++) {
-		struct performance_checkpoint current = (i<current_checkpoint ? checkpoints[i] : now);
-		
-		DumpStringToUSB("\t");
-		performance_print(current.time);
-		DumpStringToUSB("   \t");
-		
-		if(last.high == 0 && last.low == 0) 
-			DumpStringToUSB("       ");
-		else
-			performance_print(performance_diff(last, current.time));
-		last = current.time;
-		DumpStringToUSB("   \t");
-		
-		if(current.description)
-			DumpStringToUSB(current.description);
-		DumpStringToUSB("\n\r");
-	}
+	/* Read again should the counter have overflowed in between */
+	do {
+		high = overruns;
+		low = tc_perf->TC_CV;
+	} while(high != overruns);
+	
+	return (high << 16) | low;
 }
@@ -0,0 +1,113 @@
+/***************************************************************
+ *
+ * OpenPICC - fixed size block pools
+ *
+ * Each pool is an array of equal blocks defined at compile time
+ * with DEFINE_POOL(). The free ones are kept on a singly linked
+ * list through their first word, so alloc and free take the
+ * head of the list with the IRQ masked for a few instructions.
+ * Nothing comes from the FreeRTOS heap.
+ *
+ ***************************************************************
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; version 2.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#include <FreeRTOS.h>
+#include <openpicc.h>
+#include <string.h>
+
+#include "pool.h"
+
+#ifdef POOL_DEBUG
+/* Everything but the link word still is POOL_POISON */
+static int poisoned(const struct pool *pool, const u_int8_t *block)
+{
+	unsigned int i;
+
+	for(i = sizeof(void*); i < pool->size; i++)
+		if(block[i] != POOL_POISON)
+			return 0;
+	return 1;
+}
+#endif
+
+void pool_init(struct pool *pool)
+{
+	u_int8_t *block;
+	unsigned int i;
+
+	pool->free = NULL;
+	for(i = pool->count; i-- > 0; ) {
+		block = pool->base + i*pool->size;
+#ifdef POOL_DEBUG
+		memset(block, POOL_POISON, pool->size);
+#endif
+		*(void **)block = pool->free;
+		pool->free = block;
+	}
+	pool->in_use = pool->high_water = 0;
+}
+
+void *pool_alloc(struct pool *pool)
+{
+	unsigned portLONG mask;
+	void **block;
+
+	mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	block = pool->free;
+	if(block) {
+		pool->free = *block;
+		if(++pool->in_use > pool->high_water)
+			pool->high_water = pool->in_use;
+	} else
+		pool->failures++;
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+
+#ifdef POOL_DEBUG
+	/* Written to after it was freed */
+	if(block && !poisoned(pool, (u_int8_t *)block))
+		__metric_add(&pool->errors, 1);
+#endif
+	return block;
+}
+
+void pool_free(struct pool *pool, void *block)
+{
+	unsigned int offset = (u_int8_t *)block - pool->base;
+	unsigned portLONG mask;
+
+	if(block == NULL)
+		return;
+	if(offset >= (unsigned int)pool->size*pool->count || offset % pool->size) {
+		/* Not one of ours */
+		__metric_add(&pool->errors, 1);
+		return;
+	}
+#ifdef POOL_DEBUG
+	if(poisoned(pool, block)) {
+		/* Freed twice */
+		__metric_add(&pool->errors, 1);
+		return;
+	}
+	memset(block, POOL_POISON, pool->size);
+#endif
+
+	mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	*(void **)block = pool->free;
+	pool->free = block;
+	pool->in_use--;
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+}
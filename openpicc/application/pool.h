@@ -0,0 +1,49 @@
+#ifndef POOL_H_
+#define POOL_H_
+
+/* Fixed size block pools, see pool.c.
+ *
+ *	DEFINE_POOL(frame_pool, "tc_recv.frame_pool", iso14443_frame, 10);
+ *
+ * gives static storage for 10 frames, the typed frame_pool_alloc() and
+ * frame_pool_free() and the metrics <name>.in_use, .high_water, .failures
+ * and .errors. pool_init() must have been called before the first alloc.
+ *
+ * With POOL_DEBUG defined free blocks are filled with POOL_POISON, which
+ * is checked when they are handed out again, and freeing a block twice
+ * is caught. Both count as errors.
+ */
+
+#include "metrics.h"
+
+#define POOL_POISON	0x6b
+
+struct pool {
+	u_int8_t *base;
+	u_int16_t size, count;
+	void *free;			/* list of free blocks, linked through their first word */
+	volatile u_int32_t in_use, high_water;
+	volatile u_int32_t failures;	/* allocs that found the pool empty */
+	volatile u_int32_t errors;	/* bad frees, damaged free blocks */
+};
+
+#define DEFINE_POOL(var, _name, type, n) \
+	static type var##_blocks[n] __attribute__ ((aligned(sizeof(void*)))); \
+	static struct pool var = { \
+		.base = (u_int8_t *) var##_blocks, \
+		.size = sizeof(type), .count = n }; \
+	DEFINE_METRIC_VALUE(var##_in_use, _name ".in_use", METRIC_GAUGE, 0, &var.in_use); \
+	DEFINE_METRIC_VALUE(var##_high_water, _name ".high_water", METRIC_GAUGE, 0, &var.high_water); \
+	DEFINE_METRIC_VALUE(var##_failures, _name ".failures", METRIC_COUNTER, METRIC_F_ERROR, &var.failures); \
+	DEFINE_METRIC_VALUE(var##_errors, _name ".errors", METRIC_COUNTER, METRIC_F_ERROR, &var.errors); \
+	static inline type *var##_alloc(void) { return pool_alloc(&var); } \
+	static inline void var##_free(type *block) { pool_free(&var, block); }
+
+/* Put all blocks on the free list. None may be in use. */
+extern void pool_init(struct pool *pool);
+/* Both are O(1) and may be called from tasks and IRQ handlers.
+ * pool_alloc() returns NULL if the pool is empty. */
+extern void *pool_alloc(struct pool *pool);
+extern void pool_free(struct pool *pool, void *block);
+
+#endif /*POOL_H_*/
@@ -0,0 +1,218 @@
+/***************************************************************
+ *
+ * OpenPICC - Pre-modulated response cache for the PICC emulation
+ *
+ ***************************************************************
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; version 2.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <errno.h>
+#include <string.h>
+
+#include "openpicc.h"
+#include "ssc_buffer.h"
+#include "iso14443.h"
+#include "iso14443a_manchester.h"
+#include "response_cache.h"
+
+struct response_cache_entry {
+	iso14443_frame *frame[2];
+	ssc_dma_tx_buffer_t *buffer[2];
+	response_cache_update_t update;
+	u_int16_t size;			/* sample bytes per buffer */
+	volatile u_int8_t cur;		/* index being served */
+	volatile u_int8_t next_ready;
+	volatile unsigned int misses;
+};
+
+static struct response_cache_entry entries[RESPONSE_CACHE_ENTRIES];
+static int num_entries;
+
+static u_int32_t arena[RESPONSE_CACHE_ARENA / 4];
+static size_t arena_used;
+
+static void *arena_alloc(size_t len)
+{
+	void *ret;
+
+	len = (len + 3) & ~3;
+	if (arena_used + len > sizeof(arena))
+		return NULL;
+
+	ret = (u_int8_t *) arena + arena_used;
+	arena_used += len;
+	return ret;
+}
+
+static int encode(struct response_cache_entry *e, int idx)
+{
+	ssc_dma_tx_buffer_t *b = e->buffer[idx];
+	int ret;
+
+	ret = manchester_encode(b->data, e->size, e->frame[idx]);
+	if (ret < 0)
+		return ret;
+
+	b->len = ret;
+	b->source = e->frame[idx];
+	return 0;
+}
+
+int response_cache_register(const iso14443_frame *frame,
+			    response_cache_update_t update)
+{
+	struct response_cache_entry *e;
+	int i, ret;
+
+	if (num_entries >= RESPONSE_CACHE_ENTRIES)
+		return -ENOMEM;
+	e = &entries[num_entries];
+
+	ret = manchester_encoded_size(frame);
+	if (ret < 0)
+		return ret;
+	e->size = ret;
+
+	for (i = 0; i < 2; i++) {
+		e->buffer[i] = arena_alloc(sizeof(ssc_dma_tx_buffer_t) + e->size);
+		if (e->buffer[i] == NULL)
+			return -ENOMEM;
+		e->buffer[i]->state = SSC_FREE;
+
+		if (update) {
+			e->frame[i] = arena_alloc(sizeof(*frame));
+			if (e->frame[i] == NULL)
+				return -ENOMEM;
+			memcpy(e->frame[i], frame, sizeof(*frame));
+		} else
+			e->frame[i] = (iso14443_frame *) frame;
+	}
+
+	e->update = update;
+	e->cur = 0;
+	ret = encode(e, 0);
+	if (ret < 0)
+		return ret;
+
+	if (!update) {
+		/* both buffers are valid, only needed for response_cache_set */
+		ret = encode(e, 1);
+		if (ret < 0)
+			return ret;
+	}
+
+	return num_entries++;
+}
+
+ssc_dma_tx_buffer_t *response_cache_get(int handle)
+{
+	struct response_cache_entry *e = &entries[handle];
+
+	return e->buffer[e->cur];
+}
+
+const iso14443_frame *response_cache_frame(int handle)
+{
+	struct response_cache_entry *e = &entries[handle];
+
+	return e->frame[e->cur];
+}
+
+void response_cache_advance(int handle)
+{
+	struct response_cache_entry *e = &entries[handle];
+
+	if (!e->update)
+		return;
+
+	if (e->next_ready) {
+		e->cur ^= 1;
+		e->next_ready = 0;
+	} else
+		e->misses++;
+}
+
+unsigned int response_cache_misses(int handle)
+{
+	return entries[handle].misses;
+}
+
+int response_cache_set(int handle, const iso14443_frame *frame)
+{
+	struct response_cache_entry *e = &entries[handle];
+	int n, ret;
+
+	if (handle < 0 || handle >= num_entries)
+		return -EINVAL;
+	ret = manchester_encoded_size(frame);
+	if (ret < 0 || ret > e->size)
+		return -EINVAL;
+
+	/* keep response_cache_advance() from switching under our feet */
+	portENTER_CRITICAL();
+	e->next_ready = 0;
+	n = e->cur ^ 1;
+	portEXIT_CRITICAL();
+
+	/* the other buffer might still be on its way out */
+	while (e->buffer[n]->state != SSC_FREE)
+		vTaskDelay(1);
+
+	if (e->update)
+		memcpy(e->frame[n], frame, sizeof(*frame));
+	else
+		e->frame[n] = (iso14443_frame *) frame;
+
+	ret = encode(e, n);
+	if (ret < 0)
+		return ret;
+
+	portENTER_CRITICAL();
+	e->cur = n;
+	portEXIT_CRITICAL();
+
+	if (!e->update) {
+		e->frame[n ^ 1] = e->frame[n];
+		while (e->buffer[n ^ 1]->state != SSC_FREE)
+			vTaskDelay(1);
+		encode(e, n ^ 1);
+	}
+
+	return 0;
+}
+
+void response_cache_process(void)
+{
+	struct response_cache_entry *e;
+	int i, n;
+
+	for (i = 0; i < num_entries; i++) {
+		e = &entries[i];
+		if (!e->update || e->next_ready)
+			continue;
+
+		/* no advance can happen while next_ready is clear */
+		n = e->cur ^ 1;
+		if (e->buffer[n]->state != SSC_FREE)
+			continue;
+
+		e->update(e->frame[n], e->frame[e->cur]);
+		if (encode(e, n) == 0)
+			e->next_ready = 1;
+	}
+}
@@ -0,0 +1,45 @@
+#ifndef RESPONSE_CACHE_H_
+#define RESPONSE_CACHE_H_
+
+#include "iso14443.h"
+#include "ssc_buffer.h"
+
+/* Pre-modulated responses for the PICC emulation.  Frames are registered
+ * once and kept Manchester encoded in dedicated Tx buffers, so a receive
+ * callback only has to pick a buffer and can answer at the nominal FDT.
+ *
+ * Entries with an update function are double buffered: while one buffer
+ * is served, the frame following it is computed and encoded in the other
+ * by response_cache_process().  response_cache_advance() switches over,
+ * e.g. after HLTA for an incrementing UID.  Later frames of an entry must
+ * not be longer than the registered one. */
+
+#define RESPONSE_CACHE_ENTRIES	8
+#define RESPONSE_CACHE_ARENA	2048	/* bytes for buffers and frames */
+
+/* compute the frame after cur into next, called in task context */
+typedef void (*response_cache_update_t)(iso14443_frame *next,
+					const iso14443_frame *cur);
+
+/* Register a response, returns a handle or -ENOMEM.  Without an update
+ * function the frame is not copied and must stay valid. */
+extern int response_cache_register(const iso14443_frame *frame,
+				   response_cache_update_t update);
+
+/* These two may be called from the fast receive callback (IRQ) */
+extern ssc_dma_tx_buffer_t *response_cache_get(int handle);
+extern void response_cache_advance(int handle);
+
+/* the frame currently served by the handle's buffer */
+extern const iso14443_frame *response_cache_frame(int handle);
+
+/* Replace the contents of an entry, from task context */
+extern int response_cache_set(int handle, const iso14443_frame *frame);
+
+/* Prepare the next frame of all dynamic entries, from task context */
+extern void response_cache_process(void);
+
+/* number of advances that found no precomputed frame */
+extern unsigned int response_cache_misses(int handle);
+
+#endif /*RESPONSE_CACHE_H_*/
@@ -0,0 +1,46 @@
+#ifndef SNIFFER_PROTO_H_
+#define SNIFFER_PROTO_H_
+
+/* Binary record stream of the T/C sniffer (tc_sniffer.c), as sent over
+ * the CDC endpoint and read by host/sniff2pcapng.c.
+ *
+ * Each record is a struct sniffer_record header, followed by the frame
+ * data ((bits+7)/8 bytes, LSB first as received) and the parity bits
+ * (one bit per complete data byte, byte x in parity[x/8] & (1<<(x%8))).
+ * Multi-byte fields are little endian, like the ARM7. The type byte
+ * doubles as sync mark: a reader that lost track skips bytes until it
+ * finds SNIFFER_MAGIC in the upper nibble. */
+
+#define SNIFFER_MAGIC		0xa0
+#define SNIFFER_MAGIC_MASK	0xf0
+
+/* type */
+#define SNIFFER_REC_FRAME	(SNIFFER_MAGIC | 0x01)
+
+/* flags */
+#define SNIFFER_F_PICC		0x01	/* PICC to PCD, else PCD to PICC */
+#define SNIFFER_F_CRC_OK	0x02	/* neither CRC flag: no CRC (short frame) */
+#define SNIFFER_F_CRC_ERROR	0x04
+#define SNIFFER_F_DECODE_ERROR	0x08	/* a pause spacing that fit no symbol */
+#define SNIFFER_F_TRUNCATED	0x10	/* frame exceeded MAXIMUM_FRAME_SIZE */
+#define SNIFFER_F_OVERRUN	0x20	/* captures were lost before this frame */
+#define SNIFFER_F_GAP		0x40	/* TC2 saturated since the previous record,
+					 * the time in between is a lower bound */
+
+/* Carrier cycles per second, the unit of the timestamp */
+#define SNIFFER_CLOCK_HZ	13560000
+
+struct sniffer_record {
+	u_int8_t type;
+	u_int8_t flags;
+	u_int16_t bits;		/* data bits, parity not counted */
+	u_int32_t timestamp;	/* carrier cycles at the last pause of the
+				 * frame, wraps after 316 s */
+} __attribute__ ((packed));
+
+#define SNIFFER_DATA_LEN(bits)		(((bits)+7)/8)
+#define SNIFFER_PARITY_LEN(bits)	(((bits)/8+7)/8)
+#define SNIFFER_RECORD_LEN(bits)	(sizeof(struct sniffer_record) + \
+		SNIFFER_DATA_LEN(bits) + SNIFFER_PARITY_LEN(bits))
+
+#endif /*SNIFFER_PROTO_H_*/
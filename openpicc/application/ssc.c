@@ -41,6 +41,8 @@
 
 #include "usb_print.h"
 #include "cmd.h"
+#include "trace.h"
+#include "metrics.h"
 
 #define PRINT_DEBUG 0
 #define DEBUG_DATA_GATING 0
@@ -68,25 +70,16 @@ static const ssc_mode_def ssc_modes[] = {
 		ISO14443_BITS_PER_SSC_TRANSFER * ISO14443A_SAMPLE_LEN <= 8 ? 8 : 16, // transfersize_pdc 
 		DIV_ROUND_UP(ISO14443A_MAX_RX_FRAME_SIZE_IN_BITS, ISO14443_BITS_PER_SSC_TRANSFER) },
 };
-static struct {
-	ssc_metric metric;
-	char *name;
-	int value;
-} ssc_metrics[] = {
-		[METRIC_RX_OVERFLOWS]      = {METRIC_RX_OVERFLOWS, "Rx overflows", 0},
-		[METRIC_FREE_RX_BUFFERS]   = {METRIC_FREE_RX_BUFFERS, "Free Rx buffers", 0},
-		[METRIC_MANAGEMENT_ERRORS] = {METRIC_MANAGEMENT_ERRORS, "Internal buffer management error", 0},
-		[METRIC_MANAGEMENT_ERRORS_1] = {METRIC_MANAGEMENT_ERRORS_1, "Internal buffer management error type 1", 0},
-		[METRIC_MANAGEMENT_ERRORS_2] = {METRIC_MANAGEMENT_ERRORS_2, "Internal buffer management error type 2", 0},
-		[METRIC_MANAGEMENT_ERRORS_3] = {METRIC_MANAGEMENT_ERRORS_3, "Internal buffer management error type 3", 0},
-		[METRIC_LATE_TX_FRAMES]    = {METRIC_LATE_TX_FRAMES, "Late Tx frames", 0},
-		[METRIC_RX_FRAMES]         = {METRIC_RX_FRAMES, "Rx frames", 0},
-		[METRIC_TX_FRAMES]         = {METRIC_TX_FRAMES, "Tx frames", 0},
-		[METRIC_TX_ABORTED_FRAMES] = {METRIC_TX_ABORTED_FRAMES, "Aborted Tx frames", 0},
-};
+DEFINE_METRIC_COUNTER(rx_overflows, "ssc.rx_overflows", METRIC_F_ERROR);	/* No free buffer during Rx reload */
+DEFINE_METRIC_COUNTER(management_errors_1, "ssc.management_errors_1", METRIC_F_ERROR);
+DEFINE_METRIC_COUNTER(management_errors_2, "ssc.management_errors_2", METRIC_F_ERROR);
+DEFINE_METRIC_COUNTER(management_errors_3, "ssc.management_errors_3", METRIC_F_ERROR);
+DEFINE_METRIC_COUNTER(late_tx_frames, "ssc.late_tx_frames", METRIC_F_ERROR);	/* TF already was high */
+DEFINE_METRIC_COUNTER(tx_frames, "ssc.tx_frames", 0);
+DEFINE_METRIC_COUNTER(tx_aborted_frames, "ssc.tx_aborted_frames", 0);
+DEFINE_METRIC_READ(free_rx_buffers, "ssc.free_rx_buffers", METRIC_GAUGE, 0, ssc_free_rx_buffers);
 
 static ssc_dma_rx_buffer_t _rx_buffers[SSC_DMA_BUFFER_COUNT];
-ssc_dma_tx_buffer_t        _tx_buffer;
 
 /******* PRIVATE "meat" code *************************************************/
 
@@ -206,6 +199,7 @@ static void __ramfunc _ssc_tx_end(ssc_handle_t *sh, int is_an_abort)
 		sh->tx_buffer->state = SSC_FREE;
 		sh->tx_running = 0;
 	}
+	trace_event(TRACE_TX_ENDED, is_an_abort);
 	
 	if(sh->rx_running) {
 		/* Receiver has been suspended by the pending transmission. Restart it. */
@@ -227,6 +221,7 @@ static int __ramfunc _ssc_tx_irq(u_int32_t sr, portBASE_TYPE task_woken)
 	ssc_handle_t *sh = &_ssc;
 	
 	if( sr & AT91C_SSC_TXSYN ) {
+		trace_event(TRACE_TX_STARTED, *AT91C_TC2_CV);
 		/* Tx starting, hardwire TF pin to high */
 		AT91F_PIO_SetOutput(AT91C_BASE_PIOA, AT91C_PA15_TF);
 		AT91F_PIO_CfgOutput(AT91C_BASE_PIOA, AT91C_PA15_TF);
@@ -266,7 +261,7 @@ out:
 	
 	if( sr & AT91C_SSC_TXEMPTY ) {
 		/* Tx has ended */
-		ssc_metrics[METRIC_TX_FRAMES].value++;
+		metric_inc(tx_frames);
 		_ssc_tx_end(sh, 0);
 	}
 	
@@ -317,7 +312,7 @@ static __ramfunc int _reload_rx(ssc_handle_t *sh)
 {
 	int result = 0;
 	if(sh->rx_buffer[0] != NULL) {
-		ssc_metrics[METRIC_MANAGEMENT_ERRORS_1].value++;
+		metric_inc(management_errors_1);
 		result = 1;
 		goto out;
 	}
@@ -325,7 +320,7 @@ static __ramfunc int _reload_rx(ssc_handle_t *sh)
 	ssc_dma_rx_buffer_t *buffer = _get_buffer(SSC_FREE, SSC_PENDING);
 	
 	if(buffer == NULL) {
-		ssc_metrics[METRIC_RX_OVERFLOWS].value++;
+		metric_inc(rx_overflows);
 		goto out;
 	}
 
@@ -344,7 +339,7 @@ out:
 static __ramfunc ssc_dma_rx_buffer_t* _unload_rx(ssc_handle_t *sh)
 {
 	if(sh->rx_buffer[0] == NULL) {
-		ssc_metrics[METRIC_MANAGEMENT_ERRORS_2].value++;
+		metric_inc(management_errors_2);
 		return NULL;
 	}
 	
@@ -381,7 +376,7 @@ static __ramfunc ssc_dma_rx_buffer_t* _unload_rx(ssc_handle_t *sh)
 	}
 	
 	if((buffer->len_transfers - rcr) != (rpr - (unsigned int)buffer->data)*(buffer->reception_mode->transfersize_pdc/8)) {
-		ssc_metrics[METRIC_MANAGEMENT_ERRORS_3].value++;
+		metric_inc(management_errors_3);
 		buffer->state = SSC_FREE;
 		return NULL;
 	}
@@ -726,8 +721,9 @@ int ssc_send(ssc_handle_t* sh, ssc_dma_tx_buffer_t *buffer)
 	vLedSetGreen(1);
 	
 	if(AT91F_PIO_IsInputSet(AT91C_BASE_PIOA, OPENPICC_SSC_TF)) {
-		ssc_metrics[METRIC_LATE_TX_FRAMES].value++;
+		metric_inc(late_tx_frames);
 	}
+	trace_event(TRACE_TX_ARMED, *AT91C_TC2_CV);
 	
 	return 0;
 }
@@ -738,7 +734,7 @@ int ssc_send_abort(ssc_handle_t* sh)
 	if(!sh->tx_enabled) return -EINVAL;
 	if(!sh->tx_running) return -EINVAL;
 	
-	ssc_metrics[METRIC_TX_ABORTED_FRAMES].value++;
+	metric_inc(tx_aborted_frames);
 	_ssc_tx_end(sh, 1);
 	
 	return 0;
@@ -804,38 +800,12 @@ void ssc_hard_reset(ssc_handle_t *sh)
 }
 
 
-int ssc_get_metric(ssc_metric metric, char **description, int *value)
+static u_int32_t ssc_free_rx_buffers(void)
 {
-	char *_name="Undefined";
-	int _value=0;
-	int valid=0;
-	
-	if(metric < sizeof(ssc_metrics)/sizeof(ssc_metrics[0])) {
-		_name  = ssc_metrics[metric].name;
-		_value = ssc_metrics[metric].value;
-		valid = 1;
-	}
-		
-	switch(metric) {
-		case METRIC_FREE_RX_BUFFERS:
-			_value = 0;
-			int i;
-			for(i=0; i < SSC_DMA_BUFFER_COUNT; i++)
-				if(_rx_buffers[i].state == SSC_FREE) _value++;
-			break;
-		case METRIC_MANAGEMENT_ERRORS:
-			_value = ssc_metrics[METRIC_MANAGEMENT_ERRORS_1].value +
-				ssc_metrics[METRIC_MANAGEMENT_ERRORS_2].value +
-				ssc_metrics[METRIC_MANAGEMENT_ERRORS_3].value;
-			break;
-		default:
-			break;
-	}
-	
-	if(!valid) return 0;
-	
-	if(description != NULL) *description = _name;
-	if(value != NULL) *value = _value;
-	return 1;
+	u_int32_t result = 0;
+	int i;
+	for(i=0; i < SSC_DMA_BUFFER_COUNT; i++)
+		if(_rx_buffers[i].state == SSC_FREE) result++;
+	return result;
 }
 
@@ -4,22 +4,6 @@
 #include "board.h"
 #include "ssc_buffer.h"
 
-typedef enum { 
-	METRIC_RX_OVERFLOWS,      // No free buffer during Rx reload
-	METRIC_FREE_RX_BUFFERS,   // Free Rx buffers, calculated on-the-fly
-	METRIC_MANAGEMENT_ERRORS, // One of the diverse types of management errors
-	METRIC_MANAGEMENT_ERRORS_1, // Internal buffer management error type 1
-	METRIC_MANAGEMENT_ERRORS_2, // Internal buffer management error type 2
-	METRIC_MANAGEMENT_ERRORS_3, // Internal buffer management error type 3
-	METRIC_LATE_TX_FRAMES,    // Frames that only reached the SSC when TF already was high
-	METRIC_RX_FRAMES,         // Frames received
-	METRIC_TX_FRAMES,         // Frames sent
-	METRIC_TX_ABORTED_FRAMES, // Aborted send frames
-	_MAX_METRICS,
-} ssc_metric;
-
-extern int ssc_get_metric(ssc_metric metric, char **description, int *value);
-
 typedef enum {
 	SSC_CALLBACK_RX_STARTING,       // *data is ssh_handle_t *sh
 	SSC_CALLBACK_RX_STOPPED,        // *data is ssh_handle_t *sh
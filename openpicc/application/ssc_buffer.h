@@ -44,11 +44,13 @@ typedef struct {
 	u_int8_t data[SSC_RX_BUFFER_SIZE_AS_UINT8];
 } ssc_dma_rx_buffer_t;
 
+/* Tx buffers are allocated with room for the frame they hold, at most
+ * SSC_TX_BUFFER_SIZE_AS_UINT8 bytes of data (see response_cache.c) */
 typedef struct {
 	volatile ssc_dma_buffer_state_t state;
 	u_int32_t len;  /* Length of the content in bytes */
 	void *source; /* Source pointer for a prefilled buffer; set to NULL if not used */
-	u_int8_t data[SSC_TX_BUFFER_SIZE_AS_UINT8];
+	u_int8_t data[];
 } ssc_dma_tx_buffer_t;
 
 #endif /*SSC_BUFFER_H_*/
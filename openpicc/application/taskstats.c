@@ -0,0 +1,105 @@
+/***************************************************************
+ *
+ * OpenPICC - per task run time statistics
+ *
+ * The scheduler charges the TC1 ticks between two context
+ * switches to the task that was switched out and counts the
+ * switches of every task, see uxTaskGetRunTimeStats() in
+ * tasks.c. taskstats_dump() takes a snapshot of these figures
+ * together with the stack high water marks and sends it over
+ * USB as one table. host/task_stats asks for one at a fixed
+ * rate and shows the CPU share of each task in between.
+ *
+ * The header carries what the accounting costs per switch, as
+ * measured when the scheduler started, so that the host can
+ * tell how much of the CPU goes into the accounting itself.
+ *
+ ***************************************************************
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; version 2.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <openpicc.h>
+#include <USB-CDC.h>
+#include <errno.h>
+#include <string.h>
+
+#include "taskstats.h"
+#include "performance.h"
+
+static xTaskStatusType status[TASKSTATS_MAX_TASKS];
+
+static struct {
+	struct taskstats_dump_header hdr;
+	struct taskstats_record rec[TASKSTATS_MAX_TASKS];
+} __attribute__ ((packed)) dump;
+
+static xUSB_TX_DESCRIPTOR dump_desc;
+static volatile int dump_busy;
+
+/* Called by the USB task once the dump is in the FIFO */
+static void dump_done(xUSB_TX_DESCRIPTOR *desc)
+{
+	(void)desc;
+	dump_busy = 0;
+}
+
+int taskstats_dump(void)
+{
+	unsigned portBASE_TYPE count, i;
+	unsigned portLONG now;
+	struct taskstats_record *rec;
+	const u_int8_t *p;
+	u_int32_t sum = 0;
+
+	if(dump_busy)
+		return -EBUSY;
+	dump_busy = 1;
+
+	count = uxTaskGetRunTimeStats(status, TASKSTATS_MAX_TASKS, &now);
+	for(i = 0; i < count; i++) {
+		rec = &dump.rec[i];
+		strncpy(rec->name, (const char *)status[i].pcTaskName, sizeof(rec->name));
+		rec->number = status[i].uxTCBNumber;
+		rec->priority = status[i].uxPriority;
+		rec->state = status[i].cStatus;
+		rec->reserved = 0;
+		rec->stack_depth = status[i].usStackDepth;
+		rec->stack_free = status[i].usStackFree;
+		rec->run_time = status[i].ulRunTime;
+		rec->switches = status[i].ulSwitches;
+	}
+	for(p = (const u_int8_t *)dump.rec; p < (const u_int8_t *)&dump.rec[count]; p++)
+		sum += *p;
+
+	dump.hdr.magic = TASKSTATS_DUMP_MAGIC;
+	dump.hdr.time = now;
+	dump.hdr.clock_hz = PERFORMANCE_CLOCK_HZ;
+	dump.hdr.overhead = ulTaskGetRunTimeOverhead();
+	dump.hdr.count = count;
+	dump.hdr.record_size = sizeof(struct taskstats_record);
+	dump.hdr.sum = sum;
+
+	dump_desc.pucData = (const unsigned portCHAR *)&dump;
+	dump_desc.usLength = sizeof(dump.hdr) + count*sizeof(dump.rec[0]);
+	dump_desc.vRelease = dump_done;
+	if(xUSBSendDescriptor(&dump_desc, portMAX_DELAY) != pdPASS) {
+		dump_busy = 0;
+		return -EIO;
+	}
+	return 0;
+}
@@ -0,0 +1,38 @@
+#ifndef TASKSTATS_H_
+#define TASKSTATS_H_
+
+/* Per task CPU time, context switches and stack use, see taskstats.c.
+ * The dump format is read by host/task_stats.c. */
+
+#define TASKSTATS_MAX_TASKS	16
+
+/* A dump is this header followed by count records */
+#define TASKSTATS_DUMP_MAGIC	0x314b5354	/* "TSK1" */
+
+struct taskstats_dump_header {
+	u_int32_t magic;
+	u_int32_t time;		/* run time counter when the snapshot was taken */
+	u_int32_t clock_hz;	/* of time and taskstats_record.run_time */
+	u_int32_t overhead;	/* counter ticks the accounting adds to a switch */
+	u_int16_t count;
+	u_int16_t record_size;
+	u_int32_t sum;		/* of the bytes of the records */
+} __attribute__ ((packed));
+
+struct taskstats_record {
+	char name[16];
+	u_int8_t number;	/* in the order the tasks were created */
+	u_int8_t priority;
+	char state;		/* 'R'eady, 'B'locked, 'S'uspended, 'D'eleted */
+	u_int8_t reserved;
+	u_int16_t stack_depth;	/* in words */
+	u_int16_t stack_free;	/* words that were never used */
+	u_int32_t run_time;	/* counter ticks, wraps like time */
+	u_int32_t switches;	/* times the task was switched in */
+} __attribute__ ((packed));
+
+/* Send a snapshot over USB. Returns 0, -EBUSY while the previous dump is
+ * still being sent or -EIO if USB is not up. Must be called by a task. */
+extern int taskstats_dump(void);
+
+#endif /*TASKSTATS_H_*/
@@ -0,0 +1,65 @@
+/***************************************************************
+ *
+ * OpenPICC - FIQ to receiver capture ring
+ *
+ ***************************************************************
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; version 2.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#include <FreeRTOS.h>
+#include <openpicc.h>
+#include <string.h>
+
+#include "tc_fiq_ring.h"
+#include "metrics.h"
+
+struct tc_fiq_ring tc_fiq_ring;
+
+/* Starts over with tc_fiq_ring_start() */
+DEFINE_METRIC_READ(overruns, "tc_fiq_ring.overruns", METRIC_COUNTER, METRIC_F_ERROR, ring_overruns);
+
+/* Read by the FIQ, NULL means captures are not stored */
+struct tc_fiq_ring * volatile tc_fiq_ring_for_fiq = NULL;
+
+void tc_fiq_ring_start(struct tc_fiq_ring *ring)
+{
+	tc_fiq_ring_stop();
+	ring->head = ring->tail = 0;
+	memset((void*)ring->count, 0, sizeof(ring->count));
+	memset((void*)ring->overruns, 0, sizeof(ring->overruns));
+	tc_fiq_barrier();
+	tc_fiq_ring_for_fiq = ring;
+}
+
+void tc_fiq_ring_stop(void)
+{
+	tc_fiq_ring_for_fiq = NULL;
+	tc_fiq_barrier();
+}
+
+u_int32_t tc_fiq_ring_overruns(const struct tc_fiq_ring *ring)
+{
+	u_int32_t sum = 0;
+	int i;
+	for(i=0; i<TC_FIQ_BUFFERS; i++)
+		sum += ring->overruns[i];
+	return sum;
+}
+
+static u_int32_t ring_overruns(void)
+{
+	return tc_fiq_ring_overruns(&tc_fiq_ring);
+}
@@ -0,0 +1,68 @@
+#ifndef TC_FIQ_RING_H_
+#define TC_FIQ_RING_H_
+
+/* Single producer single consumer ring between the FIQ (my_fiq_handler in
+ * os/boot/boot.s), which appends a TC2 capture for every modulation pause,
+ * and the receive code, which decodes straight out of the ring.
+ *
+ * The FIQ fills buffer head, moving on to the next one when it is full and
+ * the ring has room.  The consumer reads buffer tail up to its count and
+ * hands a full, completely read buffer back by zeroing its count and then
+ * incrementing tail.  Captures that find all buffers in use are dropped and
+ * counted in overruns[] of the buffer being filled.
+ *
+ * The layout is shared with boot.s, change the .equ values there as well. */
+
+#define TC_FIQ_BUFFERS		8	/* power of two */
+#define TC_FIQ_BUFSIZE_LOG2	8
+#define TC_FIQ_BUFSIZE		(1 << TC_FIQ_BUFSIZE_LOG2)	/* captures per buffer */
+#define TC_FIQ_MASK		(TC_FIQ_BUFFERS - 1)
+
+struct tc_fiq_ring {
+	volatile u_int32_t head;			/* written by the FIQ only */
+	volatile u_int32_t tail;			/* written by the consumer only */
+	volatile u_int32_t count[TC_FIQ_BUFFERS];
+	volatile u_int32_t overruns[TC_FIQ_BUFFERS];
+	u_int32_t data[TC_FIQ_BUFFERS][TC_FIQ_BUFSIZE];
+};
+
+extern struct tc_fiq_ring tc_fiq_ring;
+
+/* Reset the ring and hand it to the FIQ, or take it away */
+extern void tc_fiq_ring_start(struct tc_fiq_ring *ring);
+extern void tc_fiq_ring_stop(void);
+extern u_int32_t tc_fiq_ring_overruns(const struct tc_fiq_ring *ring);
+
+/* The ARM7TDMI has neither caches nor write buffers that reorder, keeping
+ * the compiler from moving accesses is all that is needed */
+#define tc_fiq_barrier() __asm__ __volatile__ ("" : : : "memory")
+
+/* Buffer at tail and the number of captures in it; data before count is valid */
+static inline const u_int32_t *tc_fiq_ring_peek(struct tc_fiq_ring *ring, unsigned int *count)
+{
+	unsigned int i = ring->tail & TC_FIQ_MASK;
+	*count = ring->count[i];
+	tc_fiq_barrier();
+	return ring->data[i];
+}
+
+/* After reading up to *offset: release the tail buffer if it is full and
+ * done, returns 1 if there is a next buffer to look at */
+static inline int tc_fiq_ring_next(struct tc_fiq_ring *ring, unsigned int *offset)
+{
+	if(*offset < TC_FIQ_BUFSIZE || ring->tail == ring->head)
+		return 0;
+	ring->count[ring->tail & TC_FIQ_MASK] = 0;
+	tc_fiq_barrier();
+	ring->tail++;
+	*offset = 0;
+	return 1;
+}
+
+/* Anything left to read after offset? */
+static inline int tc_fiq_ring_pending(struct tc_fiq_ring *ring, unsigned int offset)
+{
+	return ring->tail != ring->head || offset < ring->count[ring->tail & TC_FIQ_MASK];
+}
+
+#endif /*TC_FIQ_RING_H_*/
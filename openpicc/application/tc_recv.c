@@ -37,38 +37,34 @@
 #include <string.h>
 
 #include <task.h>
-#include <queue.h>
+#include <mailbox.h>
 
 #include "tc_recv.h"
+#include "tc_fiq_ring.h"
 
 #include "iso14443a_diffmiller.h"
 #include "usb_print.h"
 #include "pio_irq.h"
 #include "led.h"
 #include "cmd.h"
+#include "trace.h"
+#include "metrics.h"
+#include "pool.h"
 
 struct tc_recv_handle {
 	u_int8_t initialized;
 	u_int8_t pauses_count;
 	struct diffmiller_state *decoder;
-	int current, next;
+	unsigned int offset;  /* read position in the tail buffer of the FIQ ring */
+	u_int32_t overruns;
 	tc_recv_callback_t callback;
 	iso14443_frame *current_frame;
-	xQueueHandle rx_queue;
+	xMailboxHandle rx_queue;	/* frames, passed by pointer */
 };
 
 static struct tc_recv_handle _tc;
 
-#define BUFSIZE 1024
-typedef struct {
-	u_int32_t count;
-	u_int32_t data[BUFSIZE];
-} fiq_buffer_t;
-fiq_buffer_t fiq_buffers[2];
-
-fiq_buffer_t *tc_sniffer_next_buffer_for_fiq = 0;
-
-iso14443_frame rx_frames[TC_RECV_NUMBER_OF_FRAME_BUFFERS];
+DEFINE_POOL(frame_pool, "tc_recv.frame_pool", iso14443_frame, TC_RECV_NUMBER_OF_FRAME_BUFFERS);
 
 /* The standard defines EOF as a logical 0 followed by 128 carrier cycles without modulation.
  * That means that the frame end is either 20+128+128 carrier cycles after the end of the
@@ -84,89 +80,88 @@ iso14443_frame rx_frames[TC_RECV_NUMBER_OF_FRAME_BUFFERS];
  */
 #define REAL_FRAME_END (20+128+64+20)
 
-static int tc_recv_buffer_overruns = 0;
+DEFINE_METRIC_COUNTER(frames_received, "tc_recv.rx_frames", 0);
+/* Carrier cycles from the last pause to the frame being handed on, 64 per bucket */
+DEFINE_METRIC_HISTOGRAM(frame_end, "tc_recv.frame_end", 16, 6);
 
 static inline iso14443_frame *get_frame_buffer(tc_recv_handle_t th)
 {
 	if(th->current_frame) return th->current_frame;
-	unsigned int i; iso14443_frame *result;
-	for(i=0; i<sizeof(rx_frames)/sizeof(rx_frames[0]); i++) {
-		if(rx_frames[i].state == FRAME_FREE) {
-			result = &rx_frames[i];
-			result->state = FRAME_PENDING;
-			th->current_frame = result;
-			return result;
-		}
-	}
-	tc_recv_buffer_overruns++;
-	return NULL;
+	iso14443_frame *result = frame_pool_alloc();
+	if(result == NULL) return NULL;
+	result->state = FRAME_PENDING;
+	th->current_frame = result;
+	return result;
+}
+
+void tc_recv_release(iso14443_frame *frame)
+{
+	frame->state = FRAME_FREE;
+	frame_pool_free(frame);
 }
 
 static portBASE_TYPE handle_frame(iso14443_frame *frame, portBASE_TYPE task_woken)
 {
+	u_int32_t cv = *AT91C_TC2_CV;
+	
+	trace_event(TRACE_RX_DECODED, cv);
 	if(_tc.callback) _tc.callback(TC_RECV_CALLBACK_RX_FRAME_ENDED, frame);
+	/* Not before the callback, it may arm the response */
+	metric_inc(frames_received);
+	metric_observe(frame_end, cv);
 	if(frame->state != FRAME_FREE) {
-		task_woken = xQueueSendFromISR(_tc.rx_queue, &frame, task_woken);
-	}
+		trace_event(TRACE_RX_QUEUED, frame->numbytes);
+		task_woken = xMailboxPostFromISR(_tc.rx_queue, frame, task_woken);
+	} else
+		frame_pool_free(frame);
 	_tc.current_frame = NULL;
-#ifdef PRINT_PERFORMANCE
-	int old=usb_print_set_default_flush(0);
-	iso14443a_diffmiller_print_performance(_tc.decoder);
-	usb_print_set_default_flush(old);
-#endif
-	return task_woken;
-}
-
-static portBASE_TYPE handle_buffer(u_int32_t data[], unsigned int count, portBASE_TYPE task_woken)
-{
-	unsigned int offset = 0;
-	while(offset < count) {
-		iso14443_frame *rx_frame = get_frame_buffer(&_tc);
-		if(rx_frame == NULL) return task_woken;
-		int ret = iso14443a_decode_diffmiller(_tc.decoder, rx_frame, data, &offset, count);
-		if(ret == 0) {
-			task_woken = handle_frame(rx_frame, task_woken);
-		}
-	}
 	return task_woken;
 }
 
-static inline portBASE_TYPE flush_buffer(fiq_buffer_t *buffer, portBASE_TYPE task_woken)
+/* Decode whatever the FIQ has put into the ring, straight from the ring buffers */
+static portBASE_TYPE handle_ring(portBASE_TYPE task_woken)
 {
-	if(buffer->count > 0) {
-		if(buffer->count >= BUFSIZE) {
-			usb_print_string_f("Warning: Possible buffer overrun detected\n\r",0);
-			//overruns++;
+	struct tc_fiq_ring * const ring = &tc_fiq_ring;
+	const u_int32_t *data;
+	unsigned int count;
+	
+	do {
+		data = tc_fiq_ring_peek(ring, &count);
+		while(_tc.offset < count) {
+			iso14443_frame *rx_frame = get_frame_buffer(&_tc);
+			if(rx_frame == NULL) {
+				/* No frame to decode into, drop the captures */
+				_tc.offset = count;
+				break;
+			}
+			int ret = iso14443a_decode_diffmiller(_tc.decoder, rx_frame, data, &_tc.offset, count);
+			if(ret == 0) {
+				task_woken = handle_frame(rx_frame, task_woken);
+			}
 		}
-		buffer->count = MIN(buffer->count, BUFSIZE);
-		task_woken = handle_buffer(buffer->data, buffer->count, task_woken);
-		buffer->count = 0;
+	} while(tc_fiq_ring_next(ring, &_tc.offset));
+	
+	u_int32_t overruns = tc_fiq_ring_overruns(ring);
+	if(overruns != _tc.overruns) {
+		trace_event(TRACE_FIQ_OVERRUN, overruns);
+		usb_print_string_f("Warning: FIQ ring overrun, captures lost\n\r",0);
+		_tc.overruns = overruns;
 	}
-	return task_woken;
-}
-
-#define NEXT_BUFFER(a) ((a+1)%(sizeof(fiq_buffers)/sizeof(fiq_buffers[0])))
-
-static portBASE_TYPE switch_buffers(portBASE_TYPE task_woken)
-{
-	_tc.next = NEXT_BUFFER(_tc.current);
-	task_woken = flush_buffer( &fiq_buffers[_tc.next] , task_woken);
 	
-	tc_sniffer_next_buffer_for_fiq = &fiq_buffers[_tc.current=_tc.next];
 	return task_woken;
 }
 
 static portBASE_TYPE tc_recv_irq(u_int32_t pio, portBASE_TYPE task_woken)
 {
 	(void)pio;
+	trace_event(TRACE_RX_IRQ, *AT91C_TC2_CV);
 	/* TODO There should be some emergency exit here to prevent the CPU from
 	 * spinning in the IRQ for excessive amounts of time. (Maximum transmission
 	 * time for 256 Byte frame is something like 21ms.)
 	 */ 
 	while(*AT91C_TC2_CV <= REAL_FRAME_END || 
-			fiq_buffers[NEXT_BUFFER(_tc.current)].count > 0 || 
-			fiq_buffers[_tc.current].count > 0) 
-		task_woken = switch_buffers(task_woken);
+			tc_fiq_ring_pending(&tc_fiq_ring, _tc.offset)) 
+		task_woken = handle_ring(task_woken);
 	
 	if(*AT91C_TC2_CV > REAL_FRAME_END) {
 		iso14443_frame *rx_frame = get_frame_buffer(&_tc);
@@ -185,14 +180,15 @@ int tc_recv_init(tc_recv_handle_t *_th, int pauses_count, tc_recv_callback_t cal
 	if(_tc.initialized) return -EBUSY;
 	tc_recv_handle_t th = &_tc;
 	
-	memset(fiq_buffers, 0, sizeof(fiq_buffers));
-	th->current = th->next = 0;
+	th->offset = 0;
+	th->overruns = 0;
+	tc_fiq_ring_start(&tc_fiq_ring);
 	
-	memset(rx_frames, 0, sizeof(rx_frames));
+	pool_init(&frame_pool);
 	th->current_frame = NULL;
 	
 	if(th->rx_queue == NULL) {
-		th->rx_queue = xQueueCreate(TC_RECV_NUMBER_OF_FRAME_BUFFERS, sizeof(iso14443_frame*));
+		th->rx_queue = xMailboxCreate(TC_RECV_NUMBER_OF_FRAME_BUFFERS);
 		if(th->rx_queue == NULL)
 			return -ENOMEM;
 	}
@@ -221,7 +217,7 @@ int tc_recv_receive(tc_recv_handle_t th, iso14443_frame* *frame, unsigned int ti
 	if(th == NULL) return -EINVAL;
 	if(!th->initialized) return -EINVAL;
 	
-	if(xQueueReceive(th->rx_queue, frame, timeout)){
+	if(xMailboxFetch(th->rx_queue, (void **)frame, timeout)){
 		if(*frame != NULL) return 0;
 		else return -EINTR;
 	}
@@ -17,5 +17,7 @@ typedef void (*tc_recv_callback_t)(tc_recv_callback_reason reason, void *data);
 
 extern int tc_recv_init(tc_recv_handle_t *th, int pauses_count, tc_recv_callback_t callback);
 extern int tc_recv_receive(tc_recv_handle_t th, iso14443_frame* *frame, unsigned int timeout);
+/* Hand a frame from tc_recv_receive() back, may be called from ISRs */
+extern void tc_recv_release(iso14443_frame *frame);
 
 #endif /*TC_RECV_H_*/
@@ -44,12 +44,15 @@
 #include "pio_irq.h"
 #include "led.h"
 #include "clock_switch.h"
-#include "performance.h"
+#include "trace.h"
+#include "metrics.h"
 
 #include "iso14443a_diffmiller.h"
+#include "tc_fiq_ring.h"
+#include "sniffer_proto.h"
 
 /* Problem: We want to receive data from the FIQ without locking (the FIQ must not be blocked ever)
- * Strategy: Double buffering.
+ * Strategy: Lock-free ring of capture buffers, see tc_fiq_ring.h.
  */
 
 static xSemaphoreHandle data_semaphore;
@@ -61,20 +64,118 @@ iso14443_frame rx_frame;
 portBASE_TYPE currently_sniffing = 0;
 enum { NONE, REQUEST_START, REQUEST_STOP } request_change = REQUEST_START;
 
+/* Print the raw TC2 captures as text instead of the decoded frames */
 //#define PRINT_TIMES
-//#define USE_BINARY_PROTOCOL
 
 #define MIN(a, b) ((a)>(b)?(b):(a))
 static int overruns = 0; 
-static void handle_buffer(u_int32_t data[], unsigned int count)
+
+/* Frames go out as binary records, see sniffer_proto.h. Text formatting
+ * every value took most of the CPU and of the USB bandwidth in busy
+ * exchanges. Records are collected in out_buffer[out_cur] and handed to
+ * the CDC driver in one piece once it is full or the air is quiet. The
+ * driver sends straight from the buffer, so collecting goes on in the
+ * other one until it has been released. */
+static u_int8_t out_buffer[2][512];
+static xUSB_TX_DESCRIPTOR out_desc[2];
+static volatile int out_busy[2];
+static xSemaphoreHandle out_released;
+static unsigned int out_cur, out_len;
+
+/* TC2 restarts this many carrier cycles after the start of a pause (see
+ * BIT_OFFSET in iso14443a_diffmiller.c) and stops at 0xffff */
+#define TC2_RESTART	(128/4 + 4 + 20)
+#define TC2_STOPPED	0xffff
+
+DEFINE_METRIC_COUNTER(sniffed_frames, "sniffer.frames", 0);
+DEFINE_METRIC_COUNTER(dropped_bytes, "sniffer.dropped_bytes", METRIC_F_ERROR);	/* USB too slow */
+
+static u_int32_t sniff_clock;	/* carrier cycles at the last pause */
+static u_int8_t next_flags;	/* for the next record */
+
+/* Called by the USB task */
+static void out_release(xUSB_TX_DESCRIPTOR *desc)
+{
+	out_busy[desc - out_desc] = 0;
+	xSemaphoreGive(out_released);
+}
+
+static void out_flush(void)
+{
+	unsigned int other = out_cur ^ 1;
+	
+	if(out_len == 0)
+		return;
+	
+	/* Nowhere to go on collecting, drop what is there */
+	while(out_busy[other])
+		if(xSemaphoreTake(out_released, WAIT_TICKS) == pdFALSE)
+			break;
+	if(out_busy[other]) {
+		metric_add(dropped_bytes, out_len);
+		out_len = 0;
+		return;
+	}
+	
+	out_desc[out_cur].pucData = out_buffer[out_cur];
+	out_desc[out_cur].usLength = out_len;
+	out_desc[out_cur].vRelease = out_release;
+	out_busy[out_cur] = 1;
+	if(xUSBSendDescriptor(&out_desc[out_cur], WAIT_TICKS) != pdPASS) {
+		out_busy[out_cur] = 0;
+		metric_add(dropped_bytes, out_len);
+		out_len = 0;
+		return;
+	}
+	out_cur = other;
+	out_len = 0;
+}
+
+static void put_frame(const iso14443_frame *frame, u_int32_t timestamp)
 {
-#ifdef USE_BINARY_PROTOCOL
-		vUSBSendBuffer_blocking((unsigned char*)(&data[0]), 0, MIN(count,BUFSIZE)*4, WAIT_TICKS);
-		if(count >= BUFSIZE)
-			vUSBSendBuffer_blocking((unsigned char*)"////", 0, 4, WAIT_TICKS);
-		else
-			vUSBSendBuffer_blocking((unsigned char*)"____", 0, 4, WAIT_TICKS);
-#elif defined(PRINT_TIMES)
+	const unsigned int bits = frame->numbytes*8 + frame->numbits;
+	const int errors = iso14443a_diffmiller_frame_errors(decoder);
+	u_int8_t *buf;
+	struct sniffer_record rec = {
+		.type = SNIFFER_REC_FRAME,
+		.flags = next_flags,
+		.bits = bits,
+		.timestamp = timestamp,
+	};
+	
+	/* Only frames of whole bytes that are long enough can carry a CRC */
+	if(frame->numbits == 0 && frame->numbytes >= 3)
+		rec.flags |= frame->parameters.a.crc == CRC_OK ? SNIFFER_F_CRC_OK : SNIFFER_F_CRC_ERROR;
+	if(errors & DIFFMILLER_ERROR)
+		rec.flags |= SNIFFER_F_DECODE_ERROR;
+	if(errors & DIFFMILLER_OVERFLOW)
+		rec.flags |= SNIFFER_F_TRUNCATED;
+	next_flags = 0;
+	metric_inc(sniffed_frames);
+	
+	/* A record of the largest frame fits, see MAXIMUM_FRAME_SIZE */
+	if(out_len + SNIFFER_RECORD_LEN(bits) > sizeof(out_buffer[0]))
+		out_flush();
+	
+	buf = out_buffer[out_cur];
+	memcpy(&buf[out_len], &rec, sizeof(rec));
+	out_len += sizeof(rec);
+	memcpy(&buf[out_len], frame->data, SNIFFER_DATA_LEN(bits));
+	out_len += SNIFFER_DATA_LEN(bits);
+	memcpy(&buf[out_len], frame->parity, SNIFFER_PARITY_LEN(bits));
+	out_len += SNIFFER_PARITY_LEN(bits);
+}
+
+static inline void advance_clock(u_int32_t capture)
+{
+	if(capture >= TC2_STOPPED)
+		next_flags |= SNIFFER_F_GAP;
+	sniff_clock += capture + TC2_RESTART;
+}
+
+static void handle_buffer(const u_int32_t data[], unsigned int count)
+{
+#ifdef PRINT_TIMES
 		unsigned int i=0;
 		for(i=0; i<count; i++) {
 			DumpUIntToUSB(data[i]);
@@ -84,46 +185,43 @@ static void handle_buffer(u_int32_t data[], unsigned int count)
 #else
 		unsigned int offset = 0;
 		while(offset < count) {
+			unsigned int start = offset;
 			int ret = iso14443a_decode_diffmiller(decoder, &rx_frame, data, &offset, count);
-			/*
-			DumpStringToUSB("\n\r");
-			if(ret < 0) {
-				DumpStringToUSB("-");
-				DumpUIntToUSB(-ret);
-			} else {
-				DumpUIntToUSB(ret);
-			}
-			DumpStringToUSB(" ");
-			DumpUIntToUSB(offset); DumpStringToUSB(" "); DumpUIntToUSB(count); DumpStringToUSB(" "); DumpUIntToUSB(overruns);
-			DumpStringToUSB("\n\r");
-			if(ret >= 0) {
-				DumpStringToUSB("Frame finished, ");
-				DumpUIntToUSB(rx_frame.numbytes);
-				DumpStringToUSB(" bytes, ");
-				DumpUIntToUSB(rx_frame.numbits);
-				DumpStringToUSB(" bits\n\r");
-				switch(rx_frame.parameters.a.crc) {
-				case CRC_OK: DumpStringToUSB("CRC OK\n\r"); break;
-				case CRC_ERROR: DumpStringToUSB("CRC ERROR\n\r"); break;
-				case CRC_UNCALCULATED: DumpStringToUSB("CRC UNCALCULATED\n\r"); break;
-				}
-			}*/
-			(void)ret;
+			u_int32_t frame_end;
+			
+			if(offset == start)
+				break;
+			/* The decoder sees the end of a frame in the capture after its last pause */
+			for(; start < offset-1; start++)
+				advance_clock(data[start]);
+			frame_end = sniff_clock;
+			advance_clock(data[start]);
+			
+			if(ret == 0)
+				put_frame(&rx_frame, frame_end);
 		}
 #endif
 }
 
-void flush_buffer(fiq_buffer_t *buffer)
+static unsigned int ring_offset;
+
+void flush_buffer(void)
 {
-	/* Write all data from the given buffer out, then zero the count */
-	if(buffer->count > 0) {
-		if(buffer->count >= BUFSIZE) {
-			DumpStringToUSB("Warning: Possible buffer overrun detected\n\r");
-			overruns++;
+	/* Write all data from the FIQ ring out */
+	const u_int32_t *data;
+	unsigned int count;
+	
+	do {
+		data = tc_fiq_ring_peek(&tc_fiq_ring, &count);
+		if(ring_offset < count) {
+			handle_buffer(&data[ring_offset], count-ring_offset);
+			ring_offset = count;
 		}
-		buffer->count = MIN(buffer->count, BUFSIZE);
-		handle_buffer(buffer->data, buffer->count);
-		buffer->count = 0;
+	} while(tc_fiq_ring_next(&tc_fiq_ring, &ring_offset));
+	
+	if(tc_fiq_ring_overruns(&tc_fiq_ring) != (u_int32_t)overruns) {
+		next_flags |= SNIFFER_F_OVERRUN;
+		overruns = tc_fiq_ring_overruns(&tc_fiq_ring);
 	}
 }
 
@@ -138,36 +236,27 @@ void start_stop_sniffing(void)
 static portBASE_TYPE tc_sniffer_irq(u_int32_t pio, portBASE_TYPE xTaskWoken)
 {
 	(void)pio;
-	usb_print_string_f("?", 0);
 	xTaskWoken = xSemaphoreGiveFromISR(data_semaphore, xTaskWoken);
 	return xTaskWoken;
 }
 
 static void main_loop(void)
 {
-	int current = 0;
-	
 	while(1) {
 		/* Main loop of the sniffer */
-		//vTaskDelay(1000 * portTICK_RATE_MS);
+		flush_buffer();
 		
-			u_int32_t start = *AT91C_TC2_CV;
-			int next = (current+1)%(sizeof(fiq_buffers)/sizeof(fiq_buffers[0]));
-			flush_buffer( &fiq_buffers[next] );
-			/* The buffer designated by next is now empty, give it to the fiq,
-			 * we'll just guess that this write is atomic */ 
-			tc_sniffer_next_buffer_for_fiq = &fiq_buffers[current=next];
-			u_int32_t stop = *AT91C_TC2_CV;
+		/* Pauses that came in after flush_buffer() are still to be decoded,
+		 * TC2 has been counting since the last one of those */
+		if(*AT91C_TC2_CV > 2*128 && !tc_fiq_ring_pending(&tc_fiq_ring, ring_offset)) {
+			/* No pause for longer than any symbol: the frame is over */
+			if(iso14443a_diffmiller_assert_frame_ended(decoder, &rx_frame) == 0)
+				put_frame(&rx_frame, sniff_clock);
 			
-			DumpStringToUSB("{"); DumpUIntToUSB(start); DumpStringToUSB(":"); DumpUIntToUSB(stop); DumpStringToUSB("}");
-			if(*AT91C_TC2_CV > 2*128) {
-				u_int32_t dummybuf[1] = {*AT91C_TC2_CV};
-				handle_buffer(dummybuf, 1);
-				
-				usb_print_string_f("[", 0);
-				while(xSemaphoreTake(data_semaphore, portMAX_DELAY) == pdFALSE) ;
-				usb_print_string_f("]", 0);
-			}
+			/* The air is quiet, send what has been collected and sleep until the next pause */
+			out_flush();
+			while(xSemaphoreTake(data_semaphore, portMAX_DELAY) == pdFALSE) ;
+		}
 	}	
 }
 
@@ -178,11 +267,12 @@ static void timing_loop(void)
 {
 	while(1) {
 		vTaskDelay(5000*portTICK_RATE_MS);
-		performance_start();
+		/* Dump the trace ('e') to see how long it took */
+		trace_event(TRACE_MARK, 0);
 		handle_buffer(testdata, sizeof(testdata)/sizeof(testdata[0]));
-		performance_set_checkpoint("end of first buffer");
+		trace_event(TRACE_MARK, 1);
 		handle_buffer(testdata2, sizeof(testdata2)/sizeof(testdata2[0]));
-		performance_stop_report();
+		trace_event(TRACE_MARK, 2);
 		DumpStringToUSB("Produced frame of "); DumpUIntToUSB(rx_frame.numbytes);
 		DumpStringToUSB(" bytes and "); DumpUIntToUSB(rx_frame.numbits);
 		DumpStringToUSB(" bits: "); DumpBufferToUSB((char*)rx_frame.data, rx_frame.numbytes + (rx_frame.numbits+7)/8 );
@@ -209,7 +299,11 @@ void tc_sniffer (void *pvParameters)
 	
 	tc_fdt_init();
 	
-	memset(fiq_buffers, 0, sizeof(fiq_buffers));
+	ring_offset = 0;
+	out_cur = out_len = 0;
+	sniff_clock = 0;
+	next_flags = SNIFFER_F_GAP;
+	tc_fiq_ring_start(&tc_fiq_ring);
 	
 	/* Wait for the USB and CMD threads to start up */
 	vTaskDelay(1000 * portTICK_RATE_MS);
@@ -231,6 +325,8 @@ void tc_sniffer (void *pvParameters)
 	if(!decoder) vLedHaltBlinking(1);
 	vSemaphoreCreateBinary(data_semaphore);
 	if(data_semaphore == NULL) vLedHaltBlinking(3);
+	vSemaphoreCreateBinary(out_released);
+	if(out_released == NULL) vLedHaltBlinking(3);
 	
 	// The change interrupt is going to be handled by the FIQ 
 	AT91F_PIO_CfgInput(AT91C_BASE_PIOA, OPENPICC_SSC_DATA);
@@ -238,8 +334,8 @@ void tc_sniffer (void *pvParameters)
 		vLedHaltBlinking(2);
 	pio_irq_enable(OPENPICC_SSC_DATA);
 
-	//main_loop();
-	timing_loop();
+	main_loop();
+	//timing_loop();
 	
 	(void)main_loop; (void)timing_loop;
 }
@@ -0,0 +1,135 @@
+/***************************************************************
+ *
+ * OpenPICC - system wide event trace
+ *
+ * A flight recorder: trace_event() puts a timestamped record into
+ * a fixed ring, overwriting the oldest one. Recording an event
+ * costs a read of TC1 and three stores with the IRQ masked, so it
+ * can be left in the receive and transmit paths. The FIQ is
+ * written in assembly and records nothing, the time of the last
+ * pause of a frame follows from TC2, which the receive events
+ * carry.
+ *
+ * trace_dump() sends the ring as it is, without copying it, over
+ * USB. Recording stops until the USB task has taken it.
+ *
+ ***************************************************************
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; version 2.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#include <FreeRTOS.h>
+#include <openpicc.h>
+#include <USB-CDC.h>
+#include <errno.h>
+
+#include "trace.h"
+#include "performance.h"
+
+#define TRACE_MASK	(TRACE_RECORDS-1)
+
+static struct trace_record trace_ring[TRACE_RECORDS];
+static u_int32_t trace_head;		/* records written, ever */
+static u_int32_t trace_start;		/* trace_head at the last dump */
+static u_int32_t trace_dropped;		/* while a dump was being sent */
+static volatile int trace_dumping;
+
+static struct trace_dump_header dump_header;
+static xUSB_TX_DESCRIPTOR dump_desc[3];
+
+void trace_init(void)
+{
+	trace_head = trace_start = trace_dropped = 0;
+	trace_dumping = 0;
+}
+
+void trace_event(u_int16_t id, u_int16_t arg)
+{
+	struct trace_record *rec;
+	unsigned portLONG mask;
+
+	mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	if(trace_dumping) {
+		trace_dropped++;
+	} else {
+		rec = &trace_ring[trace_head++ & TRACE_MASK];
+		rec->time = performance_now();
+		rec->id = id;
+		rec->arg = arg;
+	}
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+}
+
+/* Called by the USB task once the last part is in the FIFO */
+static void dump_done(xUSB_TX_DESCRIPTOR *desc)
+{
+	(void)desc;
+	trace_start = trace_head;
+	trace_dumping = 0;
+}
+
+static void dump_part(int i, const void *data, unsigned int len, int last)
+{
+	dump_desc[i].pucData = data;
+	dump_desc[i].usLength = len;
+	dump_desc[i].vRelease = last ? dump_done : NULL;
+}
+
+int trace_dump(void)
+{
+	u_int32_t head, dropped, written, count, first;
+	unsigned portLONG mask;
+	int parts = 0, i;
+
+	mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	if(trace_dumping) {
+		portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+		return -EBUSY;
+	}
+	trace_dumping = 1;
+	head = trace_head;
+	dropped = trace_dropped;
+	trace_dropped = 0;
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+
+	written = head - trace_start;
+	count = written < TRACE_RECORDS ? written : TRACE_RECORDS;
+	first = (head - count) & TRACE_MASK;
+
+	dump_header.magic = TRACE_DUMP_MAGIC;
+	dump_header.clock_hz = PERFORMANCE_CLOCK_HZ;
+	dump_header.count = count;
+	dump_header.lost = written - count + dropped;
+
+	/* The header, then the ring from the oldest record, in two pieces
+	 * if it wraps */
+	dump_part(parts++, &dump_header, sizeof(dump_header), count == 0);
+	if(count) {
+		u_int32_t n = first + count > TRACE_RECORDS ? TRACE_RECORDS - first : count;
+		dump_part(parts++, &trace_ring[first], n*sizeof(trace_ring[0]), n == count);
+		if(n < count)
+			dump_part(parts++, &trace_ring[0], (count-n)*sizeof(trace_ring[0]), 1);
+	}
+
+	for(i = 0; i < parts; i++) {
+		if(xUSBSendDescriptor(&dump_desc[i], portMAX_DELAY) != pdPASS) {
+			/* USB is not up, nothing has been queued after this */
+			if(i == 0)
+				trace_dumping = 0;
+			return -EIO;
+		}
+	}
+	return 0;
+}
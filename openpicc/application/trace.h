@@ -0,0 +1,52 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+/* System wide event trace, see trace.c. The records and the dump format
+ * are read by host/trace_analyse.c. */
+
+#define TRACE_RECORDS_LOG2	8
+#define TRACE_RECORDS		(1 << TRACE_RECORDS_LOG2)
+
+enum trace_id {
+	TRACE_NONE,
+	TRACE_MARK,		/* free for ad-hoc measurements */
+	TRACE_RX_IRQ,		/* tc_recv woken by the FIQ, arg: TC2 */
+	TRACE_DECODE,		/* decoder called, arg: captures to decode */
+	TRACE_RX_DECODED,	/* frame complete, arg: TC2, i.e. carrier
+				 * cycles since its last pause */
+	TRACE_RX_QUEUED,	/* frame handed to layer 2, arg: bytes */
+	TRACE_TX_ARMED,		/* ssc_send() set up the response, arg: TC2 */
+	TRACE_TX_STARTED,	/* SSC TXSYN, arg: TC2 */
+	TRACE_TX_ENDED,		/* arg: 1 if aborted */
+	TRACE_FIQ_OVERRUN,	/* captures lost, arg: overruns so far */
+	_MAX_TRACE_ID
+};
+
+/* time is TC1 (PERFORMANCE_CLOCK_HZ) with its overflows in the upper
+ * half. An event recorded while the overflow interrupt is pending is off
+ * by -0x10000, the reader fixes that up from the order of the records. */
+struct trace_record {
+	u_int32_t time;
+	u_int16_t id;
+	u_int16_t arg;
+} __attribute__ ((packed));
+
+/* A dump is this header followed by count records, oldest first */
+#define TRACE_DUMP_MAGIC	0x31435254	/* "TRC1" */
+
+struct trace_dump_header {
+	u_int32_t magic;
+	u_int32_t clock_hz;	/* of trace_record.time */
+	u_int32_t count;
+	u_int32_t lost;		/* records overwritten or not taken since
+				 * the last dump */
+} __attribute__ ((packed));
+
+extern void trace_init(void);
+/* May be called from tasks and IRQ handlers */
+extern void trace_event(u_int16_t id, u_int16_t arg);
+/* Send the ring over USB and start over. Returns 0, -EBUSY while the
+ * previous dump is still being sent or -EIO if USB is not up. */
+extern int trace_dump(void);
+
+#endif /*TRACE_H_*/
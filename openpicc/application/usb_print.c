@@ -21,46 +21,84 @@
 #include <task.h> 
 #include <semphr.h>
 #include <USB-CDC.h>
+#include <openpicc.h>
 #include <string.h>
 
 #include "usb_print.h"
+#include "metrics.h"
 
 #define BUFLEN (2*1024)
+#define MIN(a, b) ((a)>(b)?(b):(a))
 
+/* Single consumer (usb_print_flush), any number of producers in tasks and
+ * ISRs. Producers append with the IRQ masked, the flush only moves ringstart
+ * and sends from the ring directly, one contiguous span at a time. */
 static char ringbuffer[BUFLEN];
-static int ringstart, ringstop;
+static volatile int ringstart, ringstop;
 static int default_flush = 1, forced_silence = 0;
 static xSemaphoreHandle print_semaphore;
 
+DEFINE_METRIC_COUNTER(bytes_sent, "usb_print.sent", 0);	/* bytes handed to the CDC code */
+DEFINE_METRIC_COUNTER(bytes_dropped, "usb_print.dropped", METRIC_F_ERROR);	/* the ring was full */
+DEFINE_METRIC_COUNTER(flush_stalls, "usb_print.stalls", 0);	/* flushes that found the CDC queue full */
+DEFINE_METRIC_READ(tx_bytes, "usb.tx_bytes_queued", METRIC_GAUGE, 0, usb_tx_bytes);
+DEFINE_METRIC_READ(tx_descriptors, "usb.tx_descriptors_queued", METRIC_GAUGE, 0, usb_tx_descriptors);
+
+static u_int32_t usb_tx_bytes(void)
+{
+	return uxUSBTxBytesWaiting();
+}
+
+static u_int32_t usb_tx_descriptors(void)
+{
+	return uxUSBTxDescriptorsWaiting();
+}
+
+static inline int ring_free(void)
+{
+	return BUFLEN-1 - (((ringstop+BUFLEN)-ringstart) % BUFLEN);
+}
+
+/* Append as much as fits, returns the number of bytes taken. With drop
+ * set the rest is counted as dropped. Safe in ISR context. */
+static int ring_append(const char *buffer, int len, int drop)
+{
+	unsigned portLONG mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	int n = MIN(len, ring_free());
+	int first = MIN(n, BUFLEN - ringstop);
+	
+	memcpy(&ringbuffer[ringstop], buffer, first);
+	memcpy(&ringbuffer[0], buffer+first, n-first);
+	ringstop = (ringstop+n) % BUFLEN;
+	if(drop)
+		bytes_dropped += len-n;
+	
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+	return n;
+}
+
 void usb_print_buffer(const char* buffer, int start, int stop) {
 	usb_print_buffer_f(buffer,start,stop,default_flush);
 }
+/* With flush == 0 this may be called from ISRs: the ring is never flushed
+ * then, what does not fit is dropped. Returns 0 if the ring is full. */
 int usb_print_buffer_f(const char* buffer, int start, int stop, int flush)
 {
-	int pos=start, endpos=stop;
-	while(pos<stop) {
-		int available = BUFLEN-1 - (((ringstop+BUFLEN)-ringstart) % BUFLEN);
-		if(available == 0 && flush) { 
-			usb_print_flush();
-			continue;
-		}
-		if((endpos-pos)>available) endpos=pos+available;
-		
-		while(pos < endpos) {
-			ringbuffer[ringstop] = buffer[pos];
-			pos++;
-			available--;
-			ringstop = (ringstop+1) % BUFLEN;
-		}
-		
-		if(flush) usb_print_flush();
-		else if(available==0)
+	int pos = start;
+	
+	while(pos < stop) {
+		pos += ring_append(&buffer[pos], stop-pos, !flush);
+		/* Ring full: make room, unless the USB side does not take anything */
+		if(pos < stop && flush && usb_print_flush() == 0) {
+			ring_append(&buffer[pos], stop-pos, 1);
 			return 0;
-		endpos=stop;
-		if(pos>=stop)
-			return (available > 0);
+		}
+		if(!flush)
+			break;
 	}
-	return 0;
+	
+	if(flush) usb_print_flush();
+	return ring_free() > 0;
 }
 
 void usb_print_string(const char *string) {
@@ -100,38 +138,50 @@ int usb_print_set_force_silence(int silence)
 }
 
 
-/* Must NOT be called from ISR context */
-void usb_print_flush(void)
+/* Must NOT be called from ISR context. Returns the number of bytes sent */
+int usb_print_flush(void)
 {
-	int oldstop, newstart;
-	if(forced_silence) return;
+	int start, stop, len, sent, total = 0;
+	if(forced_silence) return 0;
 	
 	taskENTER_CRITICAL();
 	if(print_semaphore == NULL)
 		usb_print_init();
 	if(print_semaphore == NULL) {
 		taskEXIT_CRITICAL();
-		return;
+		return 0;
 	}
 	taskEXIT_CRITICAL();
 	
 	xSemaphoreTake(print_semaphore, portMAX_DELAY);
 	
 	taskENTER_CRITICAL();
-	oldstop = ringstop;
-	newstart = ringstart;
+	stop = ringstop;
+	start = ringstart;
 	taskEXIT_CRITICAL();
 	 
-	while(newstart != oldstop) {
-		vUSBSendByte_blocking(ringbuffer[newstart], 5*portTICK_RATE_MS);
-		newstart = (newstart+1) % BUFLEN;
+	while(start != stop) {
+		/* Up to stop or to the end of the ring, whichever comes first */
+		len = (stop > start ? stop : BUFLEN) - start;
+		sent = xUSBSendBuffer((unsigned char*)ringbuffer, start, len, 5*portTICK_RATE_MS);
+		total += sent;
+		start = (start+sent) % BUFLEN;
+		
+		/* Hand the space back right away, producers may be waiting for it */
+		taskENTER_CRITICAL();
+		ringstart = start;
+		taskEXIT_CRITICAL();
+		
+		/* The CDC queue is full, keep the rest for the next time */
+		if(sent < len) {
+			metric_inc(flush_stalls);
+			break;
+		}
 	}
-	
-	taskENTER_CRITICAL();
-	ringstart = newstart;
-	taskEXIT_CRITICAL();
+	metric_add(bytes_sent, total);
 	
 	xSemaphoreGive(print_semaphore);
+	return total;
 }
 
 void usb_print_init(void)
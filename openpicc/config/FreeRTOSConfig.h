@@ -63,6 +63,12 @@
 #define configUSE_16_BIT_TICKS		0
 #define configIDLE_SHOULD_YIELD		1
 
+/* Per task run time for uxTaskGetRunTimeStats(), counted by TC1 at MCK/2,
+   see performance.c */
+#define configGENERATE_RUN_TIME_STATS	1
+extern unsigned long performance_now( void );
+#define portGET_RUN_TIME_COUNTER_VALUE()	performance_now()
+
 //#define configDEBUG_CRITICAL_TIMING     AT91C_PIO_PA12
 #define configDEBUG_CRITICAL_TIMING     0
 
@@ -4,7 +4,7 @@
 	.extern exit
 	.extern AT91F_LowLevelInit
 	.extern pio_irq_isr_value
-	.extern tc_sniffer_next_buffer_for_fiq
+	.extern tc_fiq_ring_for_fiq
 
 	.text
 	.code 32
@@ -68,7 +68,15 @@
 .equ PIO_SECONDARY_IRQ, 31
 .equ PIO_SECONDARY_IRQ_BIT, (1 << PIO_SECONDARY_IRQ)
 
-.equ BUFSIZE, 1024
+/* struct tc_fiq_ring, must match application/tc_fiq_ring.h */
+.equ TC_FIQ_BUFFERS,      8
+.equ TC_FIQ_BUFSIZE_LOG2, 8
+.equ TC_FIQ_BUFSIZE,      (1 << TC_FIQ_BUFSIZE_LOG2)
+.equ RING_HEAD,           0
+.equ RING_TAIL,           4
+.equ RING_COUNT,          8
+.equ RING_OVERRUNS,       (RING_COUNT + 4*TC_FIQ_BUFFERS)
+.equ RING_DATA,           (RING_OVERRUNS + 4*TC_FIQ_BUFFERS)
 
 start:
 _start:
@@ -225,31 +233,53 @@ my_fiq_handler:
                 /* Load the TC2.CV into r9 */
                 ldr r9, [r12, #TC2_CV]
                 
-                ldr r11, =tc_sniffer_next_buffer_for_fiq
+                ldr r11, =tc_fiq_ring_for_fiq
                 ldr r11, [r11]
-                /* r11 now contains the value of tc_sniffer_next_buffer_for_fiq, e.q. the address
-                 * of the next buffer */
+                /* r11 now contains the address of the capture ring */
                 
-                /* Jump to .no_buffer if the pointer is 0, indicating that no buffer is set */
+                /* Jump to .no_buffer if the pointer is 0, indicating that no ring is set */
                 cmp r11, #0
                 beq .no_buffer 
                 
-		/* Increment the value at the location the pointer points to */
-		ldr r8, [r11]
-		add r8, r8, #1
-		str r8, [r11]
-		
-		/* At this point:
-		   r8  = count
-		   r9  = TC2.CV
-		   r11 = pointer to buffer
-		 */
-		
-		cmp r8, #BUFSIZE
-		bge .no_buffer
-		
-		str r9, [r11, r8, LSL #2]
-		
+                stmfd sp!, {r0-r2}
+                
+                /* r0 = head, r1 = head % TC_FIQ_BUFFERS, r8 = count[r1] */
+                ldr r0, [r11, #RING_HEAD]
+                and r1, r0, #(TC_FIQ_BUFFERS-1)
+                add r2, r11, #RING_COUNT
+                ldr r8, [r2, r1, LSL #2]
+                cmp r8, #TC_FIQ_BUFSIZE
+                blt .store_capture
+                
+                /* Buffer full, move on unless all buffers are in use (head-tail == N-1) */
+                ldr r2, [r11, #RING_TAIL]
+                sub r2, r0, r2
+                cmp r2, #(TC_FIQ_BUFFERS-1)
+                bge .ring_full
+                add r0, r0, #1
+                str r0, [r11, #RING_HEAD]
+                and r1, r0, #(TC_FIQ_BUFFERS-1)
+                mov r8, #0 /* the consumer zeroed the count before releasing it */
+                
+.store_capture:
+                /* Store the capture first, then publish it by writing the count */
+                add r2, r11, #RING_DATA
+                add r2, r2, r1, LSL #(TC_FIQ_BUFSIZE_LOG2+2)
+                str r9, [r2, r8, LSL #2]
+                add r8, r8, #1
+                add r2, r11, #RING_COUNT
+                str r8, [r2, r1, LSL #2]
+                b .ring_done
+                
+.ring_full:
+                add r2, r11, #RING_OVERRUNS
+                ldr r8, [r2, r1, LSL #2]
+                add r8, r8, #1
+                str r8, [r2, r1, LSL #2]
+                
+.ring_done:
+                ldmfd sp!, {r0-r2}
+                
 .no_buffer:
 /*                mov     r11, #PIO_LED2
                 str     r11, [r10, #PIOA_SODR] /* disable LED */
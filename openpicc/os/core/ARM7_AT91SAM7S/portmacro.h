@@ -259,6 +259,33 @@ extern void vPortExitCritical (void);
 #define portEXIT_CRITICAL()			vPortExitCritical();
 /*-----------------------------------------------------------*/
 
+/* Mask the IRQ and return the previous CPSR, for code that may run in
+task and in ISR context alike: portEXIT_CRITICAL() would unmask the IRQ
+in the middle of an ISR.  ARM mode only. */
+static inline unsigned portLONG ulPortSetInterruptMask( void )
+{
+unsigned portLONG ulCPSR, ulMasked;
+
+	asm volatile (
+		"MRS	%0, CPSR		\n\t"	/* Get CPSR.					*/
+		"ORR	%1, %0, #0x80	\n\t"	/* Disable IRQ, not FIQ.		*/
+		"MSR	CPSR_c, %1			"	/* Write back modified value.	*/
+		: "=&r" ( ulCPSR ), "=r" ( ulMasked ) : : "memory" );
+
+	return ulCPSR;
+}
+
+static inline void vPortClearInterruptMask( unsigned portLONG ulCPSR )
+{
+	asm volatile (
+		"MSR	CPSR_c, %0			"	/* Restore the IRQ bit.			*/
+		: : "r" ( ulCPSR ) : "memory" );
+}
+
+#define portSET_INTERRUPT_MASK_FROM_ISR()			ulPortSetInterruptMask()
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR( ulSaved )	vPortClearInterruptMask( ulSaved )
+/*-----------------------------------------------------------*/
+
 /* Task function macros as described on the FreeRTOS.org WEB site. */
 #define portTASK_FUNCTION_PROTO( vFunction, pvParameters ) void vFunction( void *pvParameters )
 #define portTASK_FUNCTION( vFunction, pvParameters ) void vFunction( void *pvParameters )
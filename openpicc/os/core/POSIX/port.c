@@ -0,0 +1,405 @@
+/***************************************************************
+ *
+ * OpenPICC - FreeRTOS port for POSIX hosts
+ * Runs the unmodified kernel as a Linux process so that the
+ * application can be simulated and profiled on a PC.
+ *
+ * Every task is a pthread, but only the thread of pxCurrentTCB
+ * is ever allowed to run, all others are parked on a condition
+ * variable. A context switch hands the CPU over and parks the
+ * calling thread, so the kernel still sees a single CPU.
+ *
+ * Interrupts are SIGUSR1 sent to the running thread. Blocking
+ * the signal is disabling interrupts: a signal raised meanwhile
+ * stays pending until the task enables interrupts again, just
+ * like an IRQ line on the AIC. The ISR then runs on the stack of
+ * the interrupted task and may switch to another task before it
+ * returns. The tick is an interrupt raised by a timer thread,
+ * further interrupt lines can be raised by threads that model
+ * the peripherals, see vPortGenerateInterrupt().
+ *
+ ***************************************************************
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; version 2.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+/* Standard includes. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+
+/* Scheduler includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#define portINTERRUPT_SIGNAL		SIGUSR1
+#define portNANOSECONDS_PER_TICK	( 1000000000L / configTICK_RATE_HZ )
+
+/* Lives in the (otherwise unused) task stack, pxTopOfStack points to it */
+typedef struct xTHREAD_STATE
+{
+  pthread_t xThread;
+  pdTASK_CODE pxCode;
+  void *pvParameters;
+} xThreadState;
+
+extern volatile void *volatile pxCurrentTCB;
+
+static pthread_mutex_t xSchedulerMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t xSchedulerCond = PTHREAD_COND_INITIALIZER;
+static xThreadState *volatile pxRunningThread = NULL;
+static volatile portBASE_TYPE xSchedulerRunning = pdFALSE;
+static pthread_t xTickThread;
+
+static volatile unsigned portLONG ulPendingInterrupts = 0;
+static pdISR_HANDLER pxInterruptHandlers[portMAX_INTERRUPTS];
+
+/* Each thread saves its own critical nesting, as the ARM7 port does in
+   the task context. */
+static __thread unsigned portLONG ulCriticalNesting = 0;
+
+static void prvInterruptHandler (int iSignal);
+/*-----------------------------------------------------------*/
+
+static void
+prvMaskInterrupts (int iHow, sigset_t * pxOldSet)
+{
+  sigset_t xSet;
+
+  sigemptyset (&xSet);
+  sigaddset (&xSet, portINTERRUPT_SIGNAL);
+  pthread_sigmask (iHow, &xSet, pxOldSet);
+}
+
+static void
+prvUnmaskInterrupts (void)
+{
+  prvMaskInterrupts (SIG_UNBLOCK, NULL);
+
+  /* An interrupt may have been raised while another thread had the CPU
+     and was about to park, take it now. */
+  if (ulPendingInterrupts)
+    pthread_kill (pthread_self (), portINTERRUPT_SIGNAL);
+}
+
+static void __attribute__ ((constructor)) prvSetupSignalHandler (void)
+{
+  struct sigaction xAction;
+
+  xAction.sa_handler = prvInterruptHandler;
+  xAction.sa_flags = SA_RESTART;
+  sigemptyset (&xAction.sa_mask);
+  sigaction (portINTERRUPT_SIGNAL, &xAction, NULL);
+}
+
+/*-----------------------------------------------------------*/
+
+/* Park the calling thread until pxThread has the CPU */
+static void
+prvWaitForCPU (xThreadState * pxThread)
+{
+  pthread_mutex_lock (&xSchedulerMutex);
+  while (pxRunningThread != pxThread)
+    pthread_cond_wait (&xSchedulerCond, &xSchedulerMutex);
+  pthread_mutex_unlock (&xSchedulerMutex);
+}
+
+/* Give the CPU to the thread of pxCurrentTCB, must be called with
+   interrupts disabled right after vTaskSwitchContext(). */
+static void
+prvSwitchThread (void)
+{
+  xThreadState *pxOld = pxRunningThread;
+  xThreadState *pxNew = *(xThreadState **) pxCurrentTCB;
+
+  if (pxNew == pxOld)
+    return;
+
+  pthread_mutex_lock (&xSchedulerMutex);
+  pxRunningThread = pxNew;
+  pthread_cond_broadcast (&xSchedulerCond);
+  while (pxRunningThread != pxOld)
+    pthread_cond_wait (&xSchedulerCond, &xSchedulerMutex);
+  pthread_mutex_unlock (&xSchedulerMutex);
+}
+
+static void *
+prvThreadEntry (void *pvParameters)
+{
+  xThreadState *pxThread = (xThreadState *) pvParameters;
+
+  prvWaitForCPU (pxThread);
+
+  /* Tasks start with interrupts enabled */
+  ulCriticalNesting = 0;
+  prvUnmaskInterrupts ();
+
+  pxThread->pxCode (pxThread->pvParameters);
+
+  /* Tasks must not return */
+  return NULL;
+}
+
+/*-----------------------------------------------------------*/
+
+/*
+ * The task itself runs on the pthread stack, the stack allocated by the
+ * kernel only holds the thread state.
+ *
+ * See header file for description.
+ */
+portSTACK_TYPE *
+pxPortInitialiseStack (portSTACK_TYPE * pxTopOfStack, pdTASK_CODE pxCode,
+		       void *pvParameters)
+{
+  xThreadState *pxThread;
+  pthread_attr_t xAttr;
+  sigset_t xOldSet;
+
+  pxTopOfStack -= sizeof (xThreadState) / sizeof (portSTACK_TYPE) + 1;
+  pxThread = (xThreadState *) pxTopOfStack;
+  pxThread->pxCode = pxCode;
+  pxThread->pvParameters = pvParameters;
+
+  /* The new thread inherits the blocked interrupt signal, it is unblocked
+     once the task runs for the first time. */
+  prvMaskInterrupts (SIG_BLOCK, &xOldSet);
+  pthread_attr_init (&xAttr);
+  pthread_attr_setdetachstate (&xAttr, PTHREAD_CREATE_DETACHED);
+  if (pthread_create (&pxThread->xThread, &xAttr, prvThreadEntry, pxThread)
+      != 0)
+    {
+      perror ("pxPortInitialiseStack");
+      abort ();
+    }
+  pthread_attr_destroy (&xAttr);
+  pthread_sigmask (SIG_SETMASK, &xOldSet, NULL);
+
+  return pxTopOfStack;
+}
+
+/*-----------------------------------------------------------*/
+
+static portBASE_TYPE
+prvTickISR (portBASE_TYPE xTaskWoken)
+{
+  vTaskIncrementTick ();
+
+#if configUSE_PREEMPTION == 1
+  xTaskWoken = pdTRUE;
+#endif
+
+  return xTaskWoken;
+}
+
+static void *
+prvTickThread (void *pvParameters)
+{
+  struct timespec xNext;
+
+  (void) pvParameters;
+
+  clock_gettime (CLOCK_MONOTONIC, &xNext);
+  while (xSchedulerRunning)
+    {
+      xNext.tv_nsec += portNANOSECONDS_PER_TICK;
+      if (xNext.tv_nsec >= 1000000000L)
+	{
+	  xNext.tv_nsec -= 1000000000L;
+	  xNext.tv_sec++;
+	}
+      clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &xNext, NULL);
+      vPortGenerateInterrupt (portTICK_INTERRUPT);
+    }
+
+  return NULL;
+}
+
+portBASE_TYPE
+xPortStartScheduler (void)
+{
+  vPortSetInterruptHandler (portTICK_INTERRUPT, prvTickISR);
+
+  xSchedulerRunning = pdTRUE;
+  if (pthread_create (&xTickThread, NULL, prvTickThread, NULL) != 0)
+    return pdFALSE;
+
+  /* Hand the CPU to the first task, this thread only waits for the end */
+  pthread_mutex_lock (&xSchedulerMutex);
+  pxRunningThread = *(xThreadState **) pxCurrentTCB;
+  pthread_cond_broadcast (&xSchedulerCond);
+  while (xSchedulerRunning)
+    pthread_cond_wait (&xSchedulerCond, &xSchedulerMutex);
+  pthread_mutex_unlock (&xSchedulerMutex);
+
+  pthread_join (xTickThread, NULL);
+  return pdFALSE;
+}
+
+void
+vPortEndScheduler (void)
+{
+  pthread_mutex_lock (&xSchedulerMutex);
+  xSchedulerRunning = pdFALSE;
+  pthread_cond_broadcast (&xSchedulerCond);
+  pthread_mutex_unlock (&xSchedulerMutex);
+}
+
+/*-----------------------------------------------------------*/
+
+void
+vPortYield (void)
+{
+  vPortEnterCritical ();
+  vTaskSwitchContext ();
+  prvSwitchThread ();
+  vPortExitCritical ();
+}
+
+void
+vPortDisableInterrupts (void)
+{
+  prvMaskInterrupts (SIG_BLOCK, NULL);
+}
+
+void
+vPortEnableInterrupts (void)
+{
+  prvUnmaskInterrupts ();
+}
+
+void
+vPortEnterCritical (void)
+{
+  prvMaskInterrupts (SIG_BLOCK, NULL);
+  ulCriticalNesting++;
+}
+
+void
+vPortExitCritical (void)
+{
+  if (ulCriticalNesting > 0)
+    {
+      if (--ulCriticalNesting == 0)
+	prvUnmaskInterrupts ();
+    }
+}
+
+unsigned portLONG
+ulPortSetInterruptMask (void)
+{
+  sigset_t xOldSet;
+
+  prvMaskInterrupts (SIG_BLOCK, &xOldSet);
+  return sigismember (&xOldSet, portINTERRUPT_SIGNAL);
+}
+
+void
+vPortClearInterruptMask (unsigned portLONG ulWasMasked)
+{
+  if (!ulWasMasked)
+    prvUnmaskInterrupts ();
+}
+
+/*-----------------------------------------------------------*/
+
+/* The run time stats counter, CLOCK_MONOTONIC at half the CPU clock like
+   TC1 on the board */
+unsigned long
+ulPortGetRunTimeCounter (void)
+{
+  struct timespec xNow;
+
+  clock_gettime (CLOCK_MONOTONIC, &xNow);
+  return (unsigned long) (xNow.tv_sec * (configCPU_CLOCK_HZ / 2) +
+			  xNow.tv_nsec * (configCPU_CLOCK_HZ / 2) /
+			  1000000000ULL);
+}
+
+/*-----------------------------------------------------------*/
+
+void
+vPortSetInterruptHandler (unsigned portBASE_TYPE uxLine,
+			  pdISR_HANDLER pxHandler)
+{
+  if (uxLine < portMAX_INTERRUPTS)
+    pxInterruptHandlers[uxLine] = pxHandler;
+}
+
+/* May be called from any thread, including ones that are not tasks */
+void
+vPortGenerateInterrupt (unsigned portBASE_TYPE uxLine)
+{
+  sigset_t xOldSet;
+
+  if (uxLine >= portMAX_INTERRUPTS)
+    return;
+
+  prvMaskInterrupts (SIG_BLOCK, &xOldSet);
+  __sync_fetch_and_or (&ulPendingInterrupts, 1UL << uxLine);
+  pthread_mutex_lock (&xSchedulerMutex);
+  if (pxRunningThread != NULL)
+    pthread_kill (pxRunningThread->xThread, portINTERRUPT_SIGNAL);
+  pthread_mutex_unlock (&xSchedulerMutex);
+  pthread_sigmask (SIG_SETMASK, &xOldSet, NULL);
+}
+
+static void
+prvInterruptHandler (int iSignal)
+{
+  unsigned portLONG ulPending, ulLine;
+  portBASE_TYPE xTaskWoken;
+  int iSavedErrno = errno;
+
+  (void) iSignal;
+
+  /* A stale signal of a thread that has given up the CPU meanwhile */
+  if (pxRunningThread == NULL
+      || !pthread_equal (pxRunningThread->xThread, pthread_self ()))
+    {
+      errno = iSavedErrno;
+      return;
+    }
+
+  /* The signal is blocked while the handler runs, keep it that way should
+     an ISR use a critical section. */
+  ulCriticalNesting++;
+
+  while ((ulPending = __sync_fetch_and_and (&ulPendingInterrupts, 0)) != 0)
+    {
+      /* Each line is a separate IRQ on the target, so every handler starts
+         with pdFALSE. Passing the result of the tick on would stop the
+         queue functions from waking a task on the next line. */
+      xTaskWoken = pdFALSE;
+      for (ulLine = 0; ulLine < portMAX_INTERRUPTS; ulLine++)
+	{
+	  if ((ulPending & (1UL << ulLine))
+	      && pxInterruptHandlers[ulLine] != NULL)
+	    xTaskWoken |= pxInterruptHandlers[ulLine] (pdFALSE);
+	}
+
+      if (xTaskWoken)
+	{
+	  vTaskSwitchContext ();
+	  prvSwitchThread ();
+	}
+    }
+
+  ulCriticalNesting--;
+  errno = iSavedErrno;
+}
@@ -0,0 +1,90 @@
+/***************************************************************
+ *
+ * OpenPICC - FreeRTOS port for POSIX hosts
+ * Port specific definitions for running the kernel as a Linux
+ * process, one pthread per task. See port.c for the details.
+ *
+ ***************************************************************
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; version 2.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#ifndef PORTMACRO_H
+#define PORTMACRO_H
+
+/* Type definitions. */
+#define portCHAR		char
+#define portFLOAT		float
+#define portDOUBLE		double
+#define portLONG		long
+#define portSHORT		short
+#define portSTACK_TYPE	unsigned portLONG
+#define portBASE_TYPE	portLONG
+
+#if( configUSE_16_BIT_TICKS == 1 )
+	typedef unsigned portSHORT portTickType;
+	#define portMAX_DELAY ( portTickType ) 0xffff
+#else
+	typedef unsigned portLONG portTickType;
+	#define portMAX_DELAY ( portTickType ) 0xffffffff
+#endif
+/*-----------------------------------------------------------*/
+
+/* Architecture specifics. */
+#define portSTACK_GROWTH			( -1 )
+#define portTICK_RATE_MS			( ( portTickType ) 1000 / configTICK_RATE_HZ )
+#define portBYTE_ALIGNMENT			8
+#define portNOP()					__asm__ __volatile__ ( "nop" )
+/*-----------------------------------------------------------*/
+
+/* Task utilities. */
+extern void vPortYield( void );
+#define portYIELD()					vPortYield()
+
+/* Interrupts are a signal that is blocked while disabled, see port.c */
+extern void vPortDisableInterrupts( void );
+extern void vPortEnableInterrupts( void );
+#define portDISABLE_INTERRUPTS()	vPortDisableInterrupts()
+#define portENABLE_INTERRUPTS()		vPortEnableInterrupts()
+
+extern void vPortEnterCritical( void );
+extern void vPortExitCritical( void );
+#define portENTER_CRITICAL()		vPortEnterCritical()
+#define portEXIT_CRITICAL()			vPortExitCritical()
+
+/* Block the signal and return whether it was blocked before, for code
+ * that runs in task and in ISR context alike. */
+extern unsigned portLONG ulPortSetInterruptMask( void );
+extern void vPortClearInterruptMask( unsigned portLONG ulWasMasked );
+#define portSET_INTERRUPT_MASK_FROM_ISR()			ulPortSetInterruptMask()
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR( ulSaved )	vPortClearInterruptMask( ulSaved )
+/*-----------------------------------------------------------*/
+
+/* Simulated interrupt lines. Line 0 is the tick, the others can be
+ * raised by threads that model the hardware. A handler gets and returns
+ * the task woken flag like the handlers behind portENTER_SWITCHING_ISR(). */
+#define portMAX_INTERRUPTS			32
+#define portTICK_INTERRUPT			0
+
+typedef portBASE_TYPE (*pdISR_HANDLER)( portBASE_TYPE xTaskWoken );
+extern void vPortSetInterruptHandler( unsigned portBASE_TYPE uxLine, pdISR_HANDLER pxHandler );
+extern void vPortGenerateInterrupt( unsigned portBASE_TYPE uxLine );
+/*-----------------------------------------------------------*/
+
+/* Task function macros as described on the FreeRTOS.org WEB site. */
+#define portTASK_FUNCTION_PROTO( vFunction, pvParameters ) void vFunction( void *pvParameters )
+#define portTASK_FUNCTION( vFunction, pvParameters ) void vFunction( void *pvParameters )
+
+#endif /* PORTMACRO_H */
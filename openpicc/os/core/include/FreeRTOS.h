@@ -111,4 +111,12 @@
 #error Missing definition:  configUSE_16_BIT_TICKS should be defined in FreeRTOSConfig.h as either 1 or 0.  See the Configuration section of the FreeRTOS API documentation for details.
 #endif
 
+#ifndef configGENERATE_RUN_TIME_STATS
+#define configGENERATE_RUN_TIME_STATS 0
+#endif
+
+#if ( configGENERATE_RUN_TIME_STATS == 1 ) && !defined( portGET_RUN_TIME_COUNTER_VALUE )
+#error Missing definition:  portGET_RUN_TIME_COUNTER_VALUE() should return a free running counter if configGENERATE_RUN_TIME_STATS is 1.
+#endif
+
 #endif
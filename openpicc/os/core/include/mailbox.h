@@ -0,0 +1,59 @@
+/*
+	Pointer mailbox on top of the FreeRTOS queue.
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "queue.h"
+
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+/*
+ * A mailbox passes buffers between tasks and ISRs by pointer.  Only the
+ * pointer is queued, with a single word store, and whoever posts a buffer
+ * gives up ownership of it until the receiver hands it back by whatever
+ * means the two agree on.  Posting and fetching take one critical section
+ * unless they have to block.  See xQueueSendPointer() in queue.h.
+ *
+	xMailboxHandle xFrames = xMailboxCreate( 4 );
+
+	// ISR
+	xTaskWoken = xMailboxPostFromISR( xFrames, pxFrame, xTaskWoken );
+
+	// Task
+	if( xMailboxFetch( xFrames, ( void ** ) &pxFrame, portMAX_DELAY ) )
+		...
+ */
+typedef xQueueHandle xMailboxHandle;
+
+/* Returns NULL if out of memory */
+#define xMailboxCreate( uxLength )	xQueueCreate( ( uxLength ), sizeof( void * ) )
+
+/* pdPASS, or errQUEUE_FULL if there was no space within xTicksToWait */
+#define xMailboxPost( xMailbox, pvBuffer, xTicksToWait )	\
+	xQueueSendPointer( ( xQueueHandle ) ( xMailbox ), ( pvBuffer ), ( xTicksToWait ) )
+
+/* Like xQueueSendFromISR(), the pointer is dropped if the mailbox is full */
+#define xMailboxPostFromISR( xMailbox, pvBuffer, xTaskPreviouslyWoken )	\
+	xQueueSendPointerFromISR( ( xQueueHandle ) ( xMailbox ), ( pvBuffer ), ( xTaskPreviouslyWoken ) )
+
+/* pdPASS, or errQUEUE_EMPTY if nothing arrived within xTicksToWait */
+#define xMailboxFetch( xMailbox, ppvBuffer, xTicksToWait )	\
+	xQueueReceivePointer( ( xQueueHandle ) ( xMailbox ), ( ppvBuffer ), ( xTicksToWait ) )
+
+#define uxMailboxWaiting( xMailbox )	uxQueueMessagesWaiting( ( xQueueHandle ) ( xMailbox ) )
+
+#endif
@@ -104,6 +104,10 @@ typedef void (__interrupt __far * pxISR) ();
 #include "../ARM7_AT91SAM7S/portmacro.h"
 #endif
 
+#ifdef POSIX_GCC
+#include "../POSIX/portmacro.h"
+#endif
+
 #ifdef SAM7_IAR
 #include "..\..\Source\portable\IAR\AtmelSAM7S64\portmacro.h"
 #endif
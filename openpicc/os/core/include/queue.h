@@ -466,6 +466,53 @@ signed portBASE_TYPE xQueueReceiveFromISR (xQueueHandle pxQueue,
 					   pxTaskWoken);
 
 
+/*
+ * Zero copy and batch transfers.  These are the kernel side of the pointer
+ * mailbox in mailbox.h and the byte stream in stream.h, use those.
+ *
+ * When the transfer can be made without blocking they take a single
+ * critical section, without suspending the scheduler or locking the queue
+ * as xQueueSend() and xQueueReceive() do.  Only when they have to block they
+ * fall back to the latter for one item.
+ *
+ * xQueueSendPointer(), xQueueSendPointerFromISR() and
+ * xQueueReceivePointer() are for queues with an item size of
+ * sizeof( void * ).  They store and fetch the pointer with a single word
+ * access, the buffer it points to changes hands without being touched.
+ *
+ * uxQueueSendItems() and uxQueueSendItemsFromISR() post as many of uxCount
+ * items as there is space for, with at most two memcpy() calls for all of
+ * them, and return the number posted.  The task version blocks for up to
+ * xTicksToWait whenever the queue is full, until all are posted or a wait
+ * times out.  uxQueueReceiveItems() takes up to uxCount items.  If there are
+ * none it blocks for up to xTicksToWait until at least one arrives, it does
+ * not wait for all of them.  It returns the number received.  Not for
+ * semaphores (an item size of 0).
+ */
+signed portBASE_TYPE xQueueSendPointer (xQueueHandle xQueue,
+					void *pvPointer,
+					portTickType xTicksToWait);
+signed portBASE_TYPE xQueueSendPointerFromISR (xQueueHandle pxQueue,
+					       void *pvPointer,
+					       signed portBASE_TYPE
+					       xTaskPreviouslyWoken);
+signed portBASE_TYPE xQueueReceivePointer (xQueueHandle xQueue,
+					   void **ppvPointer,
+					   portTickType xTicksToWait);
+unsigned portBASE_TYPE uxQueueSendItems (xQueueHandle xQueue,
+					 const void *pvItems,
+					 unsigned portBASE_TYPE uxCount,
+					 portTickType xTicksToWait);
+unsigned portBASE_TYPE uxQueueSendItemsFromISR (xQueueHandle pxQueue,
+						const void *pvItems,
+						unsigned portBASE_TYPE uxCount,
+						signed portBASE_TYPE *
+						pxTaskWoken);
+unsigned portBASE_TYPE uxQueueReceiveItems (xQueueHandle xQueue,
+					    void *pvItems,
+					    unsigned portBASE_TYPE uxCount,
+					    portTickType xTicksToWait);
+
 /* 
  * The functions defined above are for passing data to and from tasks.  The 
  * functions below are the equivalents for passing data to and from 
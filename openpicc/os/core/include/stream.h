@@ -0,0 +1,53 @@
+/*
+	Byte stream buffer on top of the FreeRTOS queue.
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "queue.h"
+
+#ifndef STREAM_H
+#define STREAM_H
+
+/*
+ * A stream is a queue of single bytes that is written and read in runs of
+ * any length: each call moves as many bytes as possible with one critical
+ * section and at most two memcpy() calls, instead of one queue operation
+ * per byte or fixed size chunk.  Byte boundaries between writes are not
+ * kept.  See uxQueueSendItems() in queue.h.
+ */
+typedef xQueueHandle xStreamHandle;
+
+/* Returns NULL if out of memory */
+#define xStreamCreate( uxBytes )	xQueueCreate( ( uxBytes ), 1 )
+
+/* Writes all uxLength bytes, blocking for up to xTicksToWait each time the
+stream is full.  Returns the number written. */
+#define uxStreamWrite( xStream, pvData, uxLength, xTicksToWait )	\
+	uxQueueSendItems( ( xQueueHandle ) ( xStream ), ( pvData ), ( uxLength ), ( xTicksToWait ) )
+
+/* Writes as many bytes as fit, returns the number written.  *pxTaskWoken is
+set if a task of the same or a higher priority was waiting for data. */
+#define uxStreamWriteFromISR( xStream, pvData, uxLength, pxTaskWoken )	\
+	uxQueueSendItemsFromISR( ( xQueueHandle ) ( xStream ), ( pvData ), ( uxLength ), ( pxTaskWoken ) )
+
+/* Reads up to uxLength bytes.  If the stream is empty it blocks for up to
+xTicksToWait until some arrive.  Returns the number read. */
+#define uxStreamRead( xStream, pvData, uxLength, xTicksToWait )	\
+	uxQueueReceiveItems( ( xQueueHandle ) ( xStream ), ( pvData ), ( uxLength ), ( xTicksToWait ) )
+
+#define uxStreamBytesWaiting( xStream )	uxQueueMessagesWaiting( ( xQueueHandle ) ( xStream ) )
+
+#endif
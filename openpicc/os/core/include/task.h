@@ -66,6 +66,21 @@ typedef struct xTIME_OUT
   portTickType xTimeOnEntering;
 } xTimeOutType;
 
+/*
+ * One entry of the table filled by uxTaskGetRunTimeStats().
+ */
+typedef struct xTASK_STATUS
+{
+  const signed portCHAR *pcTaskName;
+  unsigned portBASE_TYPE uxTCBNumber;
+  unsigned portBASE_TYPE uxPriority;
+  signed portCHAR cStatus;	/* 'R', 'B', 'S' or 'D' as in vTaskList() */
+  unsigned portSHORT usStackDepth;	/* in portSTACK_TYPE words */
+  unsigned portSHORT usStackFree;	/* words that were never used */
+  unsigned portLONG ulRunTime;	/* in portGET_RUN_TIME_COUNTER_VALUE() units */
+  unsigned portLONG ulSwitches;	/* times the task was switched in */
+} xTaskStatusType;
+
 /*
  * Defines the priority used by the idle task.  This must not be modified.
  *
@@ -819,6 +834,59 @@ unsigned portBASE_TYPE uxTaskGetNumberOfTasks (void);
  */
 void vTaskList (signed portCHAR * pcWriteBuffer);
 
+/**
+ * task. h
+ * <PRE>unsigned portBASE_TYPE uxTaskGetRunTimeStats( xTaskStatusType *pxTaskStatusArray, unsigned portBASE_TYPE uxArraySize, unsigned portLONG *pulTotalRunTime );</PRE>
+ *
+ * configGENERATE_RUN_TIME_STATS must be defined as 1 for this function to be
+ * available, and portGET_RUN_TIME_COUNTER_VALUE() must return a free running
+ * counter.
+ *
+ * Each context switch adds the counter ticks since the last one to the
+ * task that is switched out and counts the switch for the task that is
+ * switched in.  This function takes a snapshot of these figures together
+ * with the state and the stack high water mark of every task.  The run time
+ * of the running task is brought up to date first.
+ *
+ * The scheduler is suspended while the lists are walked, interrupts stay
+ * enabled.  Checking the stacks takes time proportional to their unused
+ * part.
+ *
+ * @param pxTaskStatusArray Receives one entry per task.
+ *
+ * @param uxArraySize Number of entries in pxTaskStatusArray.  Tasks beyond
+ * it are left out.
+ *
+ * @param pulTotalRunTime Receives the counter value the snapshot was taken
+ * at, may be NULL.
+ *
+ * @return The number of entries written.
+ *
+ * \page uxTaskGetRunTimeStats uxTaskGetRunTimeStats
+ * \ingroup TaskUtils
+ */
+unsigned portBASE_TYPE uxTaskGetRunTimeStats (xTaskStatusType *
+					      pxTaskStatusArray,
+					      unsigned portBASE_TYPE
+					      uxArraySize,
+					      unsigned portLONG *
+					      pulTotalRunTime);
+
+/**
+ * task. h
+ * <PRE>unsigned portLONG ulTaskGetRunTimeOverhead( void );</PRE>
+ *
+ * configGENERATE_RUN_TIME_STATS must be defined as 1 for this function to be
+ * available.
+ *
+ * @return The counter ticks the run time accounting adds to every context
+ * switch, measured once when the scheduler was started.
+ *
+ * \page ulTaskGetRunTimeOverhead ulTaskGetRunTimeOverhead
+ * \ingroup TaskUtils
+ */
+unsigned portLONG ulTaskGetRunTimeOverhead (void);
+
 /**
  * task. h
  * <PRE>void vTaskStartTrace( portCHAR * pcBuffer, unsigned portBASE_TYPE uxBufferSize );</PRE>
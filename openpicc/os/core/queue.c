@@ -143,6 +143,29 @@ signed portBASE_TYPE xQueueReceiveFromISR (xQueueHandle pxQueue,
 					   void *pvBuffer,
 					   signed portBASE_TYPE *
 					   pxTaskWoken);
+signed portBASE_TYPE xQueueSendPointer (xQueueHandle pxQueue,
+					void *pvPointer,
+					portTickType xTicksToWait);
+signed portBASE_TYPE xQueueSendPointerFromISR (xQueueHandle pxQueue,
+					       void *pvPointer,
+					       signed portBASE_TYPE
+					       xTaskPreviouslyWoken);
+signed portBASE_TYPE xQueueReceivePointer (xQueueHandle pxQueue,
+					   void **ppvPointer,
+					   portTickType xTicksToWait);
+unsigned portBASE_TYPE uxQueueSendItems (xQueueHandle pxQueue,
+					 const void *pvItems,
+					 unsigned portBASE_TYPE uxCount,
+					 portTickType xTicksToWait);
+unsigned portBASE_TYPE uxQueueSendItemsFromISR (xQueueHandle pxQueue,
+						const void *pvItems,
+						unsigned portBASE_TYPE uxCount,
+						signed portBASE_TYPE *
+						pxTaskWoken);
+unsigned portBASE_TYPE uxQueueReceiveItems (xQueueHandle pxQueue,
+					    void *pvItems,
+					    unsigned portBASE_TYPE uxCount,
+					    portTickType xTicksToWait);
 
 #if configUSE_CO_ROUTINES == 1
 signed portBASE_TYPE xQueueCRSendFromISR (xQueueHandle pxQueue,
@@ -170,6 +193,31 @@ signed portBASE_TYPE xQueueCRReceive (xQueueHandle pxQueue, void *pvBuffer,
  */
 static void prvUnlockQueue (xQueueHandle pxQueue);
 
+/*
+ * Copy uxCount items into or out of the queue storage area, with a second
+ * memcpy() for the part that wraps around.  Must be called with interrupts
+ * disabled, uxCount must be at least one and no more than there is space
+ * for or items in the queue respectively.
+ */
+static void prvCopyItemsToQueue (xQueueHandle pxQueue,
+				 const signed portCHAR * pcItems,
+				 unsigned portBASE_TYPE uxCount);
+static void prvCopyItemsFromQueue (xQueueHandle pxQueue,
+				   signed portCHAR * pcItems,
+				   unsigned portBASE_TYPE uxCount);
+
+/*
+ * Called with interrupts disabled after items were added to or removed
+ * from a queue.  Readies the highest priority task waiting on pxEventList,
+ * unless the queue is locked, in which case the lock count is incremented
+ * so the task that unlocks the queue does it instead.
+ *
+ * @return pdTRUE if a task was readied that has a priority at least as high
+ * as that of the current one.
+ */
+static signed portBASE_TYPE prvUnblockTask (xList * pxEventList,
+					    signed portBASE_TYPE * pxLock);
+
 /*
  * Uses a critical section to determine if there is any data in a queue.
  *
@@ -201,6 +249,35 @@ static signed portBASE_TYPE prvIsQueueFull (const xQueueHandle pxQueue);
 }
 /*-----------------------------------------------------------*/
 
+/*
+ * Macros that store and fetch a pointer item with a single word access
+ * instead of memcpy().  Used for queues created with an item size of
+ * sizeof( void * ), the storage area comes from pvPortMalloc() so the items
+ * are aligned.
+ */
+#define prvWritePointer( pxQueue, pvPointer )									\
+{																				\
+	*( void ** ) pxQueue->pcWriteTo = ( pvPointer );							\
+	++( pxQueue->uxMessagesWaiting );											\
+	pxQueue->pcWriteTo += sizeof( void * );										\
+	if( pxQueue->pcWriteTo >= pxQueue->pcTail )									\
+	{																			\
+		pxQueue->pcWriteTo = pxQueue->pcHead;									\
+	}																			\
+}
+
+#define prvReadPointer( pxQueue, ppvPointer )									\
+{																				\
+	pxQueue->pcReadFrom += sizeof( void * );									\
+	if( pxQueue->pcReadFrom >= pxQueue->pcTail )								\
+	{																			\
+		pxQueue->pcReadFrom = pxQueue->pcHead;									\
+	}																			\
+	--( pxQueue->uxMessagesWaiting );											\
+	*( ppvPointer ) = *( void ** ) pxQueue->pcReadFrom;							\
+}
+/*-----------------------------------------------------------*/
+
 /*
  * Macro to mark a queue as locked.  Locking a queue prevents an ISR from
  * accessing the queue event lists.
@@ -662,6 +739,273 @@ xQueueReceiveFromISR (xQueueHandle pxQueue, void *pvBuffer,
 
 /*-----------------------------------------------------------*/
 
+/*
+ * The pointer and item functions below take the fast way whenever the
+ * transfer can be done without blocking: a single critical section in which
+ * the data is copied and a waiting task is readied, without suspending the
+ * scheduler and locking the queue.  This is safe from a task because a
+ * queue is only ever locked with the scheduler suspended, so no other task
+ * can hold the lock while we run.  Only when they have to block they fall
+ * back to xQueueSend() and xQueueReceive(), for a single item.
+ */
+
+signed portBASE_TYPE
+xQueueSendPointer (xQueueHandle pxQueue, void *pvPointer,
+		   portTickType xTicksToWait)
+{
+  signed portBASE_TYPE xReturn = errQUEUE_FULL, xYield = pdFALSE;
+
+  taskENTER_CRITICAL ();
+  {
+    if (pxQueue->uxMessagesWaiting < pxQueue->uxLength)
+      {
+	prvWritePointer (pxQueue, pvPointer);
+	xYield =
+	  prvUnblockTask (&(pxQueue->xTasksWaitingToReceive),
+			  &(pxQueue->xTxLock));
+	xReturn = pdPASS;
+      }
+  }
+  taskEXIT_CRITICAL ();
+
+  if (xYield)
+    {
+      taskYIELD ();
+    }
+
+  if (xReturn != pdPASS && xTicksToWait > (portTickType) 0)
+    {
+      xReturn = xQueueSend (pxQueue, &pvPointer, xTicksToWait);
+    }
+
+  return xReturn;
+}
+
+/*-----------------------------------------------------------*/
+
+signed portBASE_TYPE
+xQueueSendPointerFromISR (xQueueHandle pxQueue, void *pvPointer,
+			  signed portBASE_TYPE xTaskPreviouslyWoken)
+{
+  if (pxQueue->uxMessagesWaiting < pxQueue->uxLength)
+    {
+      prvWritePointer (pxQueue, pvPointer);
+
+      /* We only want to wake one task per ISR.  A locked queue still needs
+         its lock count updated though. */
+      if (!xTaskPreviouslyWoken || pxQueue->xTxLock != queueUNLOCKED)
+	{
+	  if (prvUnblockTask (&(pxQueue->xTasksWaitingToReceive),
+			      &(pxQueue->xTxLock)) != pdFALSE)
+	    {
+	      return pdTRUE;
+	    }
+	}
+    }
+
+  return xTaskPreviouslyWoken;
+}
+
+/*-----------------------------------------------------------*/
+
+signed portBASE_TYPE
+xQueueReceivePointer (xQueueHandle pxQueue, void **ppvPointer,
+		      portTickType xTicksToWait)
+{
+  signed portBASE_TYPE xReturn = errQUEUE_EMPTY, xYield = pdFALSE;
+
+  taskENTER_CRITICAL ();
+  {
+    if (pxQueue->uxMessagesWaiting > (unsigned portBASE_TYPE) 0)
+      {
+	prvReadPointer (pxQueue, ppvPointer);
+	xYield =
+	  prvUnblockTask (&(pxQueue->xTasksWaitingToSend),
+			  &(pxQueue->xRxLock));
+	xReturn = pdPASS;
+      }
+  }
+  taskEXIT_CRITICAL ();
+
+  if (xYield)
+    {
+      taskYIELD ();
+    }
+
+  if (xReturn != pdPASS && xTicksToWait > (portTickType) 0)
+    {
+      xReturn = xQueueReceive (pxQueue, ppvPointer, xTicksToWait);
+    }
+
+  return xReturn;
+}
+
+/*-----------------------------------------------------------*/
+
+/* As many of the uxCount items as there is space for, without blocking */
+static unsigned portBASE_TYPE
+prvSendItems (xQueueHandle pxQueue, const signed portCHAR * pcItems,
+	      unsigned portBASE_TYPE uxCount)
+{
+  unsigned portBASE_TYPE uxSpace;
+  signed portBASE_TYPE xYield = pdFALSE;
+
+  taskENTER_CRITICAL ();
+  {
+    uxSpace = pxQueue->uxLength - pxQueue->uxMessagesWaiting;
+    if (uxSpace > uxCount)
+      {
+	uxSpace = uxCount;
+      }
+
+    if (uxSpace > (unsigned portBASE_TYPE) 0)
+      {
+	prvCopyItemsToQueue (pxQueue, pcItems, uxSpace);
+	xYield =
+	  prvUnblockTask (&(pxQueue->xTasksWaitingToReceive),
+			  &(pxQueue->xTxLock));
+      }
+  }
+  taskEXIT_CRITICAL ();
+
+  if (xYield)
+    {
+      taskYIELD ();
+    }
+
+  return uxSpace;
+}
+
+unsigned portBASE_TYPE
+uxQueueSendItems (xQueueHandle pxQueue, const void *pvItems,
+		  unsigned portBASE_TYPE uxCount, portTickType xTicksToWait)
+{
+  const signed portCHAR *pcItems = (const signed portCHAR *) pvItems;
+  unsigned portBASE_TYPE uxSent = 0;
+
+  while (uxSent < uxCount)
+    {
+      uxSent +=
+	prvSendItems (pxQueue, pcItems + uxSent * pxQueue->uxItemSize,
+		      uxCount - uxSent);
+      if (uxSent == uxCount || xTicksToWait == (portTickType) 0)
+	{
+	  break;
+	}
+
+      /* The queue is full.  Wait for space for the next item, then go on
+         with as many as fit again. */
+      if (xQueueSend (pxQueue, pcItems + uxSent * pxQueue->uxItemSize,
+		      xTicksToWait) != pdPASS)
+	{
+	  break;
+	}
+      uxSent++;
+    }
+
+  return uxSent;
+}
+
+/*-----------------------------------------------------------*/
+
+unsigned portBASE_TYPE
+uxQueueSendItemsFromISR (xQueueHandle pxQueue, const void *pvItems,
+			 unsigned portBASE_TYPE uxCount,
+			 signed portBASE_TYPE * pxTaskWoken)
+{
+  unsigned portBASE_TYPE uxSpace;
+
+  uxSpace = pxQueue->uxLength - pxQueue->uxMessagesWaiting;
+  if (uxSpace > uxCount)
+    {
+      uxSpace = uxCount;
+    }
+
+  if (uxSpace > (unsigned portBASE_TYPE) 0)
+    {
+      prvCopyItemsToQueue (pxQueue, (const signed portCHAR *) pvItems,
+			   uxSpace);
+
+      if (!(*pxTaskWoken) || pxQueue->xTxLock != queueUNLOCKED)
+	{
+	  if (prvUnblockTask (&(pxQueue->xTasksWaitingToReceive),
+			      &(pxQueue->xTxLock)) != pdFALSE)
+	    {
+	      *pxTaskWoken = pdTRUE;
+	    }
+	}
+    }
+
+  return uxSpace;
+}
+
+/*-----------------------------------------------------------*/
+
+/* As many of the uxCount items as there are, without blocking */
+static unsigned portBASE_TYPE
+prvReceiveItems (xQueueHandle pxQueue, signed portCHAR * pcItems,
+		 unsigned portBASE_TYPE uxCount)
+{
+  unsigned portBASE_TYPE uxAvailable;
+  signed portBASE_TYPE xYield = pdFALSE;
+
+  taskENTER_CRITICAL ();
+  {
+    uxAvailable = pxQueue->uxMessagesWaiting;
+    if (uxAvailable > uxCount)
+      {
+	uxAvailable = uxCount;
+      }
+
+    if (uxAvailable > (unsigned portBASE_TYPE) 0)
+      {
+	prvCopyItemsFromQueue (pxQueue, pcItems, uxAvailable);
+	xYield =
+	  prvUnblockTask (&(pxQueue->xTasksWaitingToSend),
+			  &(pxQueue->xRxLock));
+      }
+  }
+  taskEXIT_CRITICAL ();
+
+  if (xYield)
+    {
+      taskYIELD ();
+    }
+
+  return uxAvailable;
+}
+
+unsigned portBASE_TYPE
+uxQueueReceiveItems (xQueueHandle pxQueue, void *pvItems,
+		     unsigned portBASE_TYPE uxCount,
+		     portTickType xTicksToWait)
+{
+  signed portCHAR *pcItems = (signed portCHAR *) pvItems;
+  unsigned portBASE_TYPE uxReceived;
+
+  if (uxCount == (unsigned portBASE_TYPE) 0)
+    {
+      return 0;
+    }
+
+  uxReceived = prvReceiveItems (pxQueue, pcItems, uxCount);
+
+  /* Nothing there.  Wait for the first item, then take whatever else has
+     arrived with it. */
+  if (uxReceived == (unsigned portBASE_TYPE) 0
+      && xTicksToWait > (portTickType) 0
+      && xQueueReceive (pxQueue, pcItems, xTicksToWait) == pdPASS)
+    {
+      uxReceived = 1 +
+	prvReceiveItems (pxQueue, pcItems + pxQueue->uxItemSize,
+			 uxCount - 1);
+    }
+
+  return uxReceived;
+}
+
+/*-----------------------------------------------------------*/
+
 unsigned portBASE_TYPE
 uxQueueMessagesWaiting (xQueueHandle pxQueue)
 {
@@ -745,6 +1089,96 @@ prvUnlockQueue (xQueueHandle pxQueue)
 
 /*-----------------------------------------------------------*/
 
+static void
+prvCopyItemsToQueue (xQueueHandle pxQueue, const signed portCHAR * pcItems,
+		     unsigned portBASE_TYPE uxCount)
+{
+  size_t xBytes = (size_t) uxCount * pxQueue->uxItemSize;
+  size_t xFirst = (size_t) (pxQueue->pcTail - pxQueue->pcWriteTo);
+
+  if (xFirst > xBytes)
+    {
+      xFirst = xBytes;
+    }
+
+  memcpy ((void *) pxQueue->pcWriteTo, pcItems, xFirst);
+  memcpy ((void *) pxQueue->pcHead, pcItems + xFirst, xBytes - xFirst);
+
+  if (xFirst < xBytes)
+    {
+      pxQueue->pcWriteTo = pxQueue->pcHead + (xBytes - xFirst);
+    }
+  else
+    {
+      pxQueue->pcWriteTo += xBytes;
+      if (pxQueue->pcWriteTo >= pxQueue->pcTail)
+	{
+	  pxQueue->pcWriteTo = pxQueue->pcHead;
+	}
+    }
+
+  pxQueue->uxMessagesWaiting += uxCount;
+}
+
+/*-----------------------------------------------------------*/
+
+static void
+prvCopyItemsFromQueue (xQueueHandle pxQueue, signed portCHAR * pcItems,
+		       unsigned portBASE_TYPE uxCount)
+{
+  size_t xBytes = (size_t) uxCount * pxQueue->uxItemSize;
+  signed portCHAR *pcFrom = pxQueue->pcReadFrom + pxQueue->uxItemSize;
+  size_t xFirst;
+
+  /* pcReadFrom points to the last item read, not the next one */
+  if (pcFrom >= pxQueue->pcTail)
+    {
+      pcFrom = pxQueue->pcHead;
+    }
+
+  xFirst = (size_t) (pxQueue->pcTail - pcFrom);
+  if (xFirst > xBytes)
+    {
+      xFirst = xBytes;
+    }
+
+  memcpy (pcItems, (void *) pcFrom, xFirst);
+  memcpy (pcItems + xFirst, (void *) pxQueue->pcHead, xBytes - xFirst);
+
+  if (xFirst < xBytes)
+    {
+      pcFrom = pxQueue->pcHead + (xBytes - xFirst);
+    }
+  else
+    {
+      pcFrom += xBytes;
+    }
+  pxQueue->pcReadFrom = pcFrom - pxQueue->uxItemSize;
+
+  pxQueue->uxMessagesWaiting -= uxCount;
+}
+
+/*-----------------------------------------------------------*/
+
+static signed portBASE_TYPE
+prvUnblockTask (xList * pxEventList, signed portBASE_TYPE * pxLock)
+{
+  if (*pxLock != queueUNLOCKED)
+    {
+      ++(*pxLock);
+      return pdFALSE;
+    }
+
+  if (!listLIST_IS_EMPTY (pxEventList))
+    {
+      return xTaskRemoveFromEventList (pxEventList);
+    }
+
+  return pdFALSE;
+}
+
+/*-----------------------------------------------------------*/
+
 static signed portBASE_TYPE
 prvIsQueueEmpty (const xQueueHandle pxQueue)
 {
@@ -250,6 +250,10 @@ typedef struct tskTaskControlBlock
   unsigned portBASE_TYPE uxTCBNumber;	/*< This is used for tracing the scheduler and making debugging easier only. */
   signed portCHAR pcTaskName[configMAX_TASK_NAME_LEN];	/*< Descriptive name given to the task when created.  Facilitates debugging only. */
   unsigned portSHORT usStackDepth;	/*< Total depth of the stack (when empty).  This is defined as the number of variables the stack can hold, not the number of bytes. */
+#if ( configGENERATE_RUN_TIME_STATS == 1 )
+  unsigned portLONG ulRunTimeCounter;	/*< portGET_RUN_TIME_COUNTER_VALUE() ticks the task has been running for. */
+  unsigned portLONG ulSwitchCount;	/*< Times the task was switched in. */
+#endif
 } tskTCB;
 
 /*lint -e956 */
@@ -284,7 +288,7 @@ static volatile unsigned portBASE_TYPE uxCurrentNumberOfTasks =
   (unsigned portBASE_TYPE) 0;
 static volatile portTickType xTickCount = (portTickType) 0;
 static unsigned portBASE_TYPE uxTopUsedPriority = tskIDLE_PRIORITY;
-static volatile unsigned portBASE_TYPE uxTopReadyPriority = tskIDLE_PRIORITY;
+static volatile unsigned portLONG ulReadyPriorities = (unsigned portLONG) 0;	/*< Bit n is set while pxReadyTasksLists[n] is not empty.  configMAX_PRIORITIES must not be more than 32. */
 static volatile signed portBASE_TYPE xSchedulerRunning = pdFALSE;
 static volatile unsigned portBASE_TYPE uxSchedulerSuspended =
   (unsigned portBASE_TYPE) pdFALSE;
@@ -292,6 +296,13 @@ static volatile unsigned portBASE_TYPE uxMissedTicks =
   (unsigned portBASE_TYPE) 0;
 static volatile portBASE_TYPE xMissedYield = (portBASE_TYPE) pdFALSE;
 static volatile portBASE_TYPE xNumOfOverflows = (portBASE_TYPE) 0;
+
+#if ( configGENERATE_RUN_TIME_STATS == 1 )
+
+static unsigned portLONG ulTaskSwitchedInTime = (unsigned portLONG) 0;	/*< Counter value when the running task was switched in. */
+static unsigned portLONG ulRunTimeOverhead = (unsigned portLONG) 0;	/*< What prvAccountRunTime() costs, see vTaskStartScheduler(). */
+
+#endif
 /* Debugging and trace facilities private variables and macros. ------------*/
 
 /*
@@ -359,6 +370,60 @@ static signed portBASE_TYPE xTracing = pdFALSE;
 
 #endif
 
+/*
+ * Charges the time since the last switch to pxOldTCB and counts a switch
+ * for pxNewTCB.  Called by vTaskSwitchContext() only when the task really
+ * changes, so a tick that keeps the running task costs nothing but the
+ * comparison.
+ */
+#if ( configGENERATE_RUN_TIME_STATS == 1 )
+
+#define prvAccountRunTime( pxOldTCB, pxNewTCB )											\
+{																						\
+	unsigned portLONG ulNow = portGET_RUN_TIME_COUNTER_VALUE();							\
+																						\
+	( pxOldTCB )->ulRunTimeCounter += ulNow - ulTaskSwitchedInTime;						\
+	ulTaskSwitchedInTime = ulNow;														\
+	( pxNewTCB )->ulSwitchCount++;														\
+}
+
+#endif
+
+/*
+ * Number of the highest bit set in ulBits, which must not be 0.  The
+ * ARM7TDMI has no count leading zeros instruction, so this halves the
+ * word as often as configMAX_PRIORITIES needs and looks the last nibble up
+ * in a table.  The tests against configMAX_PRIORITIES are constant and
+ * compiled away, so finding the highest ready priority takes the same few
+ * instructions however many priorities are empty.
+ */
+static const unsigned portCHAR ucHighestBitInNibble[16] =
+  { 0, 0, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3 };
+
+static unsigned portBASE_TYPE
+prvHighestBit (unsigned portLONG ulBits)
+{
+  unsigned portBASE_TYPE uxBit = 0;
+
+  if (configMAX_PRIORITIES > 16 && (ulBits & 0xffff0000UL))
+    {
+      ulBits >>= 16;
+      uxBit += 16;
+    }
+  if (configMAX_PRIORITIES > 8 && (ulBits & 0xff00UL))
+    {
+      ulBits >>= 8;
+      uxBit += 8;
+    }
+  if (configMAX_PRIORITIES > 4 && (ulBits & 0xf0UL))
+    {
+      ulBits >>= 4;
+      uxBit += 4;
+    }
+
+  return uxBit + ucHighestBitInNibble[ulBits];
+}
+
 
 /*
  * Place the task represented by pxTCB into the appropriate ready queue for
@@ -369,11 +434,20 @@ static signed portBASE_TYPE xTracing = pdFALSE;
  */
 #define prvAddTaskToReadyQueue( pxTCB )																			\
 {																												\
-	if( pxTCB->uxPriority > uxTopReadyPriority )																\
+	ulReadyPriorities |= ( unsigned portLONG ) 1 << pxTCB->uxPriority;											\
+	vListInsertEnd( ( xList * ) &( pxReadyTasksLists[ pxTCB->uxPriority ] ), &( pxTCB->xGenericListItem ) );	\
+}
+
+/*
+ * Must follow the removal of a task from a list that may be the ready list of
+ * uxPriority.  Clears the bit in ulReadyPriorities once that list is empty.
+ */
+#define prvResetReadyPriority( uxPriority )																		\
+{																												\
+	if( listLIST_IS_EMPTY( &( pxReadyTasksLists[ ( uxPriority ) ] ) ) )											\
 	{																											\
-		uxTopReadyPriority = pxTCB->uxPriority;																	\
+		ulReadyPriorities &= ~( ( unsigned portLONG ) 1 << ( uxPriority ) );									\
 	}																											\
-	vListInsertEnd( ( xList * ) &( pxReadyTasksLists[ pxTCB->uxPriority ] ), &( pxTCB->xGenericListItem ) );	\
 }
 
 /*
@@ -489,13 +563,42 @@ static void prvListTaskWithinSingleList (signed portCHAR * pcWriteBuffer,
  * This function determines the 'high water mark' of the task stack by
  * determining how much of the stack remains at the original preset value.
  */
-#if ( configUSE_TRACE_FACILITY == 1 )
+#if ( ( configUSE_TRACE_FACILITY == 1 ) || ( configGENERATE_RUN_TIME_STATS == 1 ) )
 
 unsigned portSHORT usTaskCheckFreeStackSpace (const unsigned portCHAR *
 					      pucStackByte);
 
 #endif
 
+/*
+ * Called from uxTaskGetRunTimeStats.  Adds an entry for each task in pxList
+ * to pxTaskStatusArray, starting at uxIndex, and returns the next index.
+ */
+#if ( configGENERATE_RUN_TIME_STATS == 1 )
+
+static unsigned portBASE_TYPE prvStatusOfTasksWithinSingleList (xTaskStatusType
+								 *
+								 pxTaskStatusArray,
+								 unsigned
+								 portBASE_TYPE
+								 uxIndex,
+								 unsigned
+								 portBASE_TYPE
+								 uxArraySize,
+								 xList *
+								 pxList,
+								 signed
+								 portCHAR
+								 cStatus);
+
+/*
+ * Times prvAccountRunTime() with interrupts disabled and stores the result
+ * in ulRunTimeOverhead.  Called once by vTaskStartScheduler().
+ */
+static void prvMeasureRunTimeOverhead (void);
+
+#endif
+
 /*lint +e956 */
 
 
@@ -648,6 +751,7 @@ vTaskDelete (xTaskHandle pxTaskToDelete)
        the termination list and free up any memory allocated by the
        scheduler for the TCB and stack. */
     vListRemove (&(pxTCB->xGenericListItem));
+    prvResetReadyPriority (pxTCB->uxPriority);
 
     /* Is the task waiting on an event also? */
     if (pxTCB->xEventListItem.pvContainer)
@@ -732,6 +836,7 @@ vTaskDelayUntil (portTickType * pxPreviousWakeTime,
 	   ourselves to the blocked list as the same list item is used for
 	   both lists. */
 	vListRemove ((xListItem *) & (pxCurrentTCB->xGenericListItem));
+	prvResetReadyPriority (pxCurrentTCB->uxPriority);
 
 	/* The list item will be inserted in wake time order. */
 	listSET_LIST_ITEM_VALUE (&(pxCurrentTCB->xGenericListItem),
@@ -795,6 +900,7 @@ vTaskDelay (portTickType xTicksToDelay)
 	   ourselves to the blocked list as the same list item is used for
 	   both lists. */
 	vListRemove ((xListItem *) & (pxCurrentTCB->xGenericListItem));
+	prvResetReadyPriority (pxCurrentTCB->uxPriority);
 
 	/* The list item will be inserted in wake time order. */
 	listSET_LIST_ITEM_VALUE (&(pxCurrentTCB->xGenericListItem),
@@ -912,6 +1018,7 @@ vTaskPrioritySet (xTaskHandle pxTask, unsigned portBASE_TYPE uxNewPriority)
 	       it to it's new ready list.  As we are in a critical section we
 	       can do this even if the scheduler is suspended. */
 	    vListRemove (&(pxTCB->xGenericListItem));
+	    prvResetReadyPriority (uxCurrentPriority);
 	    prvAddTaskToReadyQueue (pxTCB);
 	  }
 
@@ -948,6 +1055,7 @@ vTaskSuspend (xTaskHandle pxTaskToSuspend)
 
     /* Remove task from the ready/delayed list and place in the     suspended list. */
     vListRemove (&(pxTCB->xGenericListItem));
+    prvResetReadyPriority (pxTCB->uxPriority);
 
     /* Is the task waiting on an event also? */
     if (pxTCB->xEventListItem.pvContainer)
@@ -1089,6 +1197,12 @@ vTaskStartScheduler (void)
          DEBUGGER ALLOWS INTERRUPTS TO BE PROCESSED. */
       portDISABLE_INTERRUPTS ();
 
+#if ( configGENERATE_RUN_TIME_STATS == 1 )
+      prvMeasureRunTimeOverhead ();
+      ulTaskSwitchedInTime = portGET_RUN_TIME_COUNTER_VALUE ();
+      pxCurrentTCB->ulSwitchCount++;
+#endif
+
       xSchedulerRunning = pdTRUE;
       xTickCount = (portTickType) 0;
 
@@ -1348,6 +1462,109 @@ ulTaskEndTrace (void)
 }
 
 #endif
+/*----------------------------------------------------------*/
+
+#if ( configGENERATE_RUN_TIME_STATS == 1 )
+
+unsigned portBASE_TYPE
+uxTaskGetRunTimeStats (xTaskStatusType * pxTaskStatusArray,
+		       unsigned portBASE_TYPE uxArraySize,
+		       unsigned portLONG * pulTotalRunTime)
+{
+  unsigned portBASE_TYPE uxQueue, uxTask = 0;
+  unsigned portLONG ulNow;
+
+  vTaskSuspendAll ();
+  {
+    /* Charge the running task up to now, as a switch would. */
+    portENTER_CRITICAL ();
+    {
+      ulNow = portGET_RUN_TIME_COUNTER_VALUE ();
+      pxCurrentTCB->ulRunTimeCounter += ulNow - ulTaskSwitchedInTime;
+      ulTaskSwitchedInTime = ulNow;
+    }
+    portEXIT_CRITICAL ();
+
+    if (pulTotalRunTime != NULL)
+      {
+	*pulTotalRunTime = ulNow;
+      }
+
+    uxQueue = uxTopUsedPriority + 1;
+
+    do
+      {
+	uxQueue--;
+
+	if (!listLIST_IS_EMPTY (&(pxReadyTasksLists[uxQueue])))
+	  {
+	    uxTask =
+	      prvStatusOfTasksWithinSingleList (pxTaskStatusArray, uxTask,
+						uxArraySize,
+						(xList *) &
+						(pxReadyTasksLists[uxQueue]),
+						tskREADY_CHAR);
+	  }
+      }
+    while (uxQueue > (unsigned portSHORT) tskIDLE_PRIORITY);
+
+    if (!listLIST_IS_EMPTY (pxDelayedTaskList))
+      {
+	uxTask =
+	  prvStatusOfTasksWithinSingleList (pxTaskStatusArray, uxTask,
+					    uxArraySize,
+					    (xList *) pxDelayedTaskList,
+					    tskBLOCKED_CHAR);
+      }
+
+    if (!listLIST_IS_EMPTY (pxOverflowDelayedTaskList))
+      {
+	uxTask =
+	  prvStatusOfTasksWithinSingleList (pxTaskStatusArray, uxTask,
+					    uxArraySize,
+					    (xList *) pxOverflowDelayedTaskList,
+					    tskBLOCKED_CHAR);
+      }
+
+#if ( INCLUDE_vTaskDelete == 1 )
+    if (!listLIST_IS_EMPTY (&xTasksWaitingTermination))
+      {
+	uxTask =
+	  prvStatusOfTasksWithinSingleList (pxTaskStatusArray, uxTask,
+					    uxArraySize,
+					    (xList *) & xTasksWaitingTermination,
+					    tskDELETED_CHAR);
+      }
+#endif
+
+#if ( INCLUDE_vTaskSuspend == 1 )
+    if (!listLIST_IS_EMPTY (&xSuspendedTaskList))
+      {
+	uxTask =
+	  prvStatusOfTasksWithinSingleList (pxTaskStatusArray, uxTask,
+					    uxArraySize,
+					    (xList *) & xSuspendedTaskList,
+					    tskSUSPENDED_CHAR);
+      }
+#endif
+  }
+  xTaskResumeAll ();
+
+  return uxTask;
+}
+
+#endif
+/*----------------------------------------------------------*/
+
+#if ( configGENERATE_RUN_TIME_STATS == 1 )
+
+unsigned portLONG
+ulTaskGetRunTimeOverhead (void)
+{
+  return ulRunTimeOverhead;
+}
+
+#endif
 
 
 
@@ -1479,6 +1696,11 @@ vTaskCleanUpResources (void)
 void
 vTaskSwitchContext (void)
 {
+  unsigned portBASE_TYPE uxTopReadyPriority;
+#if ( configGENERATE_RUN_TIME_STATS == 1 )
+  tskTCB *pxPreviousTCB = pxCurrentTCB;
+#endif
+
   if (uxSchedulerSuspended != (unsigned portBASE_TYPE) pdFALSE)
     {
       /* The scheduler is currently suspended - do not allow a context
@@ -1487,16 +1709,22 @@ vTaskSwitchContext (void)
       return;
     }
 
-  /* Find the highest priority queue that contains ready tasks. */
-  while (listLIST_IS_EMPTY (&(pxReadyTasksLists[uxTopReadyPriority])))
-    {
-      --uxTopReadyPriority;
-    }
+  /* Find the highest priority queue that contains ready tasks.  There is
+     always one, the idle task never blocks. */
+  uxTopReadyPriority = prvHighestBit (ulReadyPriorities);
 
   /* listGET_OWNER_OF_NEXT_ENTRY walks through the list, so the tasks of the
      same priority get an equal share of the processor time. */
   listGET_OWNER_OF_NEXT_ENTRY (pxCurrentTCB,
 			       &(pxReadyTasksLists[uxTopReadyPriority]));
+
+#if ( configGENERATE_RUN_TIME_STATS == 1 )
+  if (pxCurrentTCB != pxPreviousTCB)
+    {
+      prvAccountRunTime (pxPreviousTCB, pxCurrentTCB);
+    }
+#endif
+
   vWriteTraceToBuffer ();
 }
 
@@ -1520,6 +1748,7 @@ vTaskPlaceOnEventList (xList * pxEventList, portTickType xTicksToWait)
      to the blocked list as the same list item is used for both lists.  We have
      exclusive access to the ready lists as the scheduler is locked. */
   vListRemove ((xListItem *) & (pxCurrentTCB->xGenericListItem));
+  prvResetReadyPriority (pxCurrentTCB->uxPriority);
 
 
 #if ( INCLUDE_vTaskSuspend == 1 )
@@ -1787,6 +2016,11 @@ prvInitialiseTCBVariables (tskTCB * pxTCB, unsigned portSHORT usStackDepth,
   listSET_LIST_ITEM_VALUE (&(pxTCB->xEventListItem),
 			   configMAX_PRIORITIES - (portTickType) uxPriority);
   listSET_LIST_ITEM_OWNER (&(pxTCB->xEventListItem), pxTCB);
+
+#if ( configGENERATE_RUN_TIME_STATS == 1 )
+  pxTCB->ulRunTimeCounter = (unsigned portLONG) 0;
+  pxTCB->ulSwitchCount = (unsigned portLONG) 0;
+#endif
 }
 
 /*-----------------------------------------------------------*/
@@ -1932,7 +2166,87 @@ prvListTaskWithinSingleList (signed portCHAR * pcWriteBuffer, xList * pxList,
 #endif
 /*-----------------------------------------------------------*/
 
-#if ( configUSE_TRACE_FACILITY == 1 )
+#if ( configGENERATE_RUN_TIME_STATS == 1 )
+
+static unsigned portBASE_TYPE
+prvStatusOfTasksWithinSingleList (xTaskStatusType * pxTaskStatusArray,
+				  unsigned portBASE_TYPE uxIndex,
+				  unsigned portBASE_TYPE uxArraySize,
+				  xList * pxList, signed portCHAR cStatus)
+{
+  volatile tskTCB *pxNextTCB, *pxFirstTCB;
+  xTaskStatusType *pxStatus;
+
+  listGET_OWNER_OF_NEXT_ENTRY (pxFirstTCB, pxList);
+  do
+    {
+      listGET_OWNER_OF_NEXT_ENTRY (pxNextTCB, pxList);
+      if (uxIndex >= uxArraySize)
+	{
+	  break;
+	}
+
+      pxStatus = &(pxTaskStatusArray[uxIndex++]);
+      pxStatus->pcTaskName = (const signed portCHAR *) pxNextTCB->pcTaskName;
+      pxStatus->uxTCBNumber = pxNextTCB->uxTCBNumber;
+      pxStatus->uxPriority = pxNextTCB->uxPriority;
+      pxStatus->cStatus = cStatus;
+      pxStatus->usStackDepth = pxNextTCB->usStackDepth;
+      pxStatus->usStackFree =
+	usTaskCheckFreeStackSpace ((unsigned portCHAR *) pxNextTCB->pxStack);
+      pxStatus->ulRunTime = pxNextTCB->ulRunTimeCounter;
+      pxStatus->ulSwitches = pxNextTCB->ulSwitchCount;
+    }
+  while (pxNextTCB != pxFirstTCB);
+
+  return uxIndex;
+}
+
+#endif
+/*-----------------------------------------------------------*/
+
+#if ( configGENERATE_RUN_TIME_STATS == 1 )
+
+static void
+prvMeasureRunTimeOverhead (void)
+{
+  unsigned portLONG ulStart, ulEmpty, ulFull;
+  unsigned portLONG ulMinEmpty = 0xffffffffUL, ulMinFull = 0xffffffffUL;
+  unsigned portBASE_TYPE uxRun;
+
+  /* Time a back to back read of the counter and one with the accounting in
+     between, on the first task to run.  Interrupts are disabled, so the
+     counter may overflow unnoticed during a run; the smallest of a few runs
+     is taken. */
+  for (uxRun = 0; uxRun < (unsigned portBASE_TYPE) 8; uxRun++)
+    {
+      ulStart = portGET_RUN_TIME_COUNTER_VALUE ();
+      ulEmpty = portGET_RUN_TIME_COUNTER_VALUE () - ulStart;
+
+      ulStart = portGET_RUN_TIME_COUNTER_VALUE ();
+      prvAccountRunTime (pxCurrentTCB, pxCurrentTCB);
+      ulFull = portGET_RUN_TIME_COUNTER_VALUE () - ulStart;
+
+      if (ulEmpty < ulMinEmpty)
+	{
+	  ulMinEmpty = ulEmpty;
+	}
+      if (ulFull < ulMinFull)
+	{
+	  ulMinFull = ulFull;
+	}
+    }
+
+  ulRunTimeOverhead = ulMinFull > ulMinEmpty ? ulMinFull - ulMinEmpty : 0;
+
+  pxCurrentTCB->ulRunTimeCounter = (unsigned portLONG) 0;
+  pxCurrentTCB->ulSwitchCount = (unsigned portLONG) 0;
+}
+
+#endif
+/*-----------------------------------------------------------*/
+
+#if ( ( configUSE_TRACE_FACILITY == 1 ) || ( configGENERATE_RUN_TIME_STATS == 1 ) )
 unsigned portSHORT
 usTaskCheckFreeStackSpace (const unsigned portCHAR * pucStackByte)
 {
@@ -54,7 +54,8 @@
 /* Scheduler includes. */
 #include <FreeRTOS.h>
 #include <task.h>
-#include <queue.h>
+#include <mailbox.h>
+#include <stream.h>
 
 /* Demo app includes. */
 #include <USB-CDC.h>
@@ -115,15 +116,12 @@ static eDRIVER_STATE eDriverState = eNOTHING;
 static xCONTROL_MESSAGE pxControlTx;
 static xCONTROL_MESSAGE pxControlRx;
 
-/* Queue holding pointers to pending messages */
-xQueueHandle xUSBInterruptQueue;
+/* Mailbox holding pointers to pending messages */
+xMailboxHandle xUSBInterruptQueue;
 
-/* Queues used to hold received characters, and characters waiting to be
-transmitted.  Rx queue must be larger than FIFO size. */
-static xQueueHandle xRxCDC;
-static xQueueHandle xTxCDC;
-
-#define CHUNK_SIZE 9
+/* Stream used to hold received characters.  It must be larger than the
+FIFO size.  Characters waiting to be transmitted are queued in USBTx.c. */
+static xStreamHandle xRxCDC;
 
 /* Line coding - 115,200 baud, N-8-1 */
 static const unsigned portCHAR pxLineCoding[] =
@@ -142,11 +140,8 @@ vUSBCDCTask (void *pvParameters)
 {
   xISRStatus *pxMessage;
   unsigned portLONG ulStatus;
-  unsigned portLONG ulRxBytes;
-  unsigned portCHAR ucByte;
-  unsigned char chunk[CHUNK_SIZE]; 
-  portBASE_TYPE i;
-  portBASE_TYPE xByte;
+  unsigned portLONG ulRxBytes, ulByte;
+  unsigned portCHAR ucRxData[usbBULK_FIFO_LENGTH];
 
   (void) pvParameters;
 
@@ -167,7 +162,8 @@ vUSBCDCTask (void *pvParameters)
   for (;;)
     {
       /* Look for data coming from the ISR. */
-      if (xQueueReceive (xUSBInterruptQueue, &pxMessage, usbSHORTEST_DELAY))
+      if (xMailboxFetch
+	  (xUSBInterruptQueue, (void **) &pxMessage, usbSHORTEST_DELAY))
 	{
 	  if (pxMessage->ulISR & AT91C_UDP_EPINT0)
 	    {
@@ -185,26 +181,8 @@ vUSBCDCTask (void *pvParameters)
       /* See if we're ready to send and receive data. */
       if (eDriverState == eREADY_TO_SEND && ucControlState)
 	{
-	  if ((!
-	       (AT91C_BASE_UDP->UDP_CSR[usbEND_POINT_2] & AT91C_UDP_TXPKTRDY))
-	      && uxQueueMessagesWaiting (xTxCDC))
-	    {
-	      for (xByte = 0; xByte < 64-CHUNK_SIZE+1; xByte++)
-		{
-		  if (!xQueueReceive (xTxCDC, &chunk, 0))
-		    {
-		      /* No data buffered to transmit. */
-		      break;
-		    }
-
-		  /* Got a byte (or more) to transmit. */
-		  for(i=0; i<chunk[0]; i++) {
-			  AT91C_BASE_UDP->UDP_FDR[usbEND_POINT_2] = chunk[1+i];
-			  xByte++;
-		  }
-		}
-	      AT91C_BASE_UDP->UDP_CSR[usbEND_POINT_2] |= AT91C_UDP_TXPKTRDY;
-	    }
+	  /* Keep both banks of endpoint 2 busy. */
+	  vUSBTxService ();
 
 	  /* Check for incoming data (host-to-device) on endpoint 1. */
 	  while (AT91C_BASE_UDP->
@@ -215,15 +193,13 @@ vUSBCDCTask (void *pvParameters)
 		(AT91C_BASE_UDP->
 		 UDP_CSR[usbEND_POINT_1] >> 16) & usbRX_COUNT_MASK;
 
-	      /* Only process FIFO if there's room to store it in the queue */
+	      /* Only process FIFO if there's room to store it in the stream */
 	      if (ulRxBytes <
-		  (USB_CDC_QUEUE_SIZE - uxQueueMessagesWaiting (xRxCDC)))
+		  (USB_CDC_QUEUE_SIZE - uxStreamBytesWaiting (xRxCDC)))
 		{
-		  while (ulRxBytes--)
-		    {
-		      ucByte = AT91C_BASE_UDP->UDP_FDR[usbEND_POINT_1];
-		      xQueueSend (xRxCDC, &ucByte, 0);
-		    }
+		  for (ulByte = 0; ulByte < ulRxBytes; ulByte++)
+		    ucRxData[ulByte] = AT91C_BASE_UDP->UDP_FDR[usbEND_POINT_1];
+		  uxStreamWrite (xRxCDC, ucRxData, ulRxBytes, 0);
 
 		  /* Release the FIFO */
 		  portENTER_CRITICAL ();
@@ -257,59 +233,19 @@ vUSBCDCTask (void *pvParameters)
     }
 }
 
-/*------------------------------------------------------------*/
-
-void
-vUSBSendByte (portCHAR cByte)
-{
-	vUSBSendByte_blocking(cByte, usbNO_BLOCK);
-}
-
-void
-vUSBSendByte_blocking (portCHAR cByte, portTickType xTicksToWait)
-{
-	char chunk[CHUNK_SIZE];
-	chunk[0] = 1;
-	chunk[1] = cByte;
-  /* Queue the byte to be sent.  The USB task will send it. */
-  xQueueSend (xTxCDC, &chunk, xTicksToWait);
-}
-
-#define MIN(a,b) ((a)>(b)?(b):(a))
-void
-vUSBSendBuffer_blocking (unsigned char *buffer, portBASE_TYPE offset, portBASE_TYPE length, portTickType xTicksToWait)
-{
-	unsigned char chunk[CHUNK_SIZE];
-	while(length > 0) {
-		int next_size = MIN(length, CHUNK_SIZE-1);
-		chunk[0] = next_size;
-		memcpy(chunk+1, buffer+offset, next_size);
-		/* Queue the bytes to be sent.  The USB task will send it. */
-		xQueueSend (xTxCDC, &chunk, xTicksToWait);
-		length -= next_size;
-		offset += next_size;
-	}
-}
-
-void
-vUSBSendBuffer (unsigned char *buffer, portBASE_TYPE offset, portBASE_TYPE length)
-{
-	vUSBSendBuffer_blocking(buffer, offset, length, usbNO_BLOCK);
-}
-
-
 /*------------------------------------------------------------*/
 
 portLONG
 vUSBRecvByte (portCHAR *cByte, portLONG size, portTickType xTicksToWait)
 {
-    portLONG res;
+    portLONG res, n;
     if(size<=0 || !cByte || !xRxCDC)
         return 0;
 
+    /* Whatever is there in one go, wait only when it has run dry */
     res=0;
-    while(size-- && xQueueReceive(xRxCDC, cByte++, xTicksToWait))
-        res++;
+    while(res < size && (n = uxStreamRead(xRxCDC, cByte+res, size-res, xTicksToWait)) > 0)
+        res+=n;
 
     return res;
 }
@@ -387,6 +323,7 @@ prvResetEndPoints (void)
   }
   portEXIT_CRITICAL ();
   uiCurrentBank = AT91C_UDP_RX_DATA_BK0;
+  vUSBTxReset ();
 }
 
 /*------------------------------------------------------------*/
@@ -812,19 +749,13 @@ vInitUSBInterface (void)
 {
   extern void (vUSB_ISR) (void);
 
-  /* Create the queue used to communicate between the USB ISR and task. */
-  xUSBInterruptQueue =
-    xQueueCreate (usbQUEUE_LENGTH + 1, sizeof (xISRStatus *));
+  /* Create the mailbox used to communicate between the USB ISR and task. */
+  xUSBInterruptQueue = xMailboxCreate (usbQUEUE_LENGTH + 1);
 
-  /* Create the queues used to hold Rx and Tx characters. */
-  xRxCDC =
-    xQueueCreate (USB_CDC_QUEUE_SIZE,
-		  (unsigned portCHAR) sizeof (signed portCHAR));
-  xTxCDC =
-    xQueueCreate ( (USB_CDC_QUEUE_SIZE/CHUNK_SIZE) + 1,
-		  (unsigned portCHAR) CHUNK_SIZE * sizeof (signed portCHAR));
+  /* Create the streams used to hold Rx and Tx characters. */
+  xRxCDC = xStreamCreate (USB_CDC_QUEUE_SIZE);
 
-  if ((!xUSBInterruptQueue) || (!xRxCDC) || (!xTxCDC))
+  if ((!xUSBInterruptQueue) || (!xRxCDC) || (xUSBTxInit () != pdPASS))
     {
       /* Not enough RAM to create queues!. */
       return;
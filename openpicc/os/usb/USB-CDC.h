@@ -39,6 +39,7 @@
 #include "usb.h"
 
 #define USB_CDC_QUEUE_SIZE    1024
+#define USB_TX_DESCRIPTORS    8
 
 /* Structure used to take a snapshot of the USB status from within the ISR. */
 typedef struct X_ISR_STATUS
@@ -76,6 +77,20 @@ typedef struct
   unsigned portLONG ulTotalDataLength;
 } xCONTROL_MESSAGE;
 
+/* A caller owned buffer queued for transmission with xUSBSendDescriptor().
+The driver copies pucData straight into the endpoint FIFO.  Once the last
+byte is there it calls vRelease (if set) from the USB task, until then
+neither the buffer nor the descriptor may be touched.  pvContext is left
+alone by the driver. */
+typedef struct xUSB_TX_DESCRIPTOR
+{
+  const unsigned portCHAR *pucData;
+  unsigned portSHORT usLength;
+  unsigned portSHORT usSent;	/* Driver private */
+  void (*vRelease) (struct xUSB_TX_DESCRIPTOR * pxDescriptor);
+  void *pvContext;
+} xUSB_TX_DESCRIPTOR;
+
 /*-----------------------------------------------------------*/
 void vUSBCDCTask (void *pvParameters);
 
@@ -85,6 +100,22 @@ void vUSBSendByte (portCHAR cByte);
 void vUSBSendByte_blocking (portCHAR cByte, portTickType xTicksToWait);
 void vUSBSendBuffer (unsigned char *buffer, portBASE_TYPE offset, portBASE_TYPE length);
 void vUSBSendBuffer_blocking (unsigned char *buffer, portBASE_TYPE offset, portBASE_TYPE length, portTickType xTicksToWait);
+portBASE_TYPE xUSBSendBuffer (unsigned char *buffer, portBASE_TYPE offset, portBASE_TYPE length, portTickType xTicksToWait);
 portLONG vUSBRecvByte (portCHAR *cByte,portLONG size, portTickType xTicksToWait);
 
+/* Queue pxDescriptor without copying its data.  Descriptors go out in the
+order they were queued, before any bytes queued with the functions above.
+Returns pdPASS if it was queued, the release callback is not called
+otherwise. */
+portBASE_TYPE xUSBSendDescriptor (xUSB_TX_DESCRIPTOR *pxDescriptor, portTickType xTicksToWait);
+
+/* Bytes and descriptors queued and not taken by the CDC task yet */
+unsigned portBASE_TYPE uxUSBTxBytesWaiting (void);
+unsigned portBASE_TYPE uxUSBTxDescriptorsWaiting (void);
+
+/* Bulk IN path, for the CDC task only.  See USBTx.c. */
+portBASE_TYPE xUSBTxInit (void);
+void vUSBTxReset (void);
+void vUSBTxService (void);
+
 #endif
@@ -43,7 +43,7 @@
 /* Scheduler includes. */
 #include <FreeRTOS.h>
 #include <task.h>
-#include <queue.h>
+#include <mailbox.h>
 
 /* Demo application includes. */
 #include <board.h>
@@ -55,7 +55,7 @@
 
 /* Messages and queue used to communicate between the ISR and the USB task. */
 static xISRStatus xISRMessages[usbQUEUE_LENGTH + 1];
-extern xQueueHandle xUSBInterruptQueue;
+extern xMailboxHandle xUSBInterruptQueue;
 /*-----------------------------------------------------------*/
 
 /* The ISR can cause a context switch so is declared naked. */
@@ -160,7 +160,7 @@ vUSB_ISR (void)
 
   /* Post ISR data to queue for task-level processing */
   cTaskWokenByPost =
-    xQueueSendFromISR (xUSBInterruptQueue, &pxMessage, cTaskWokenByPost);
+    xMailboxPostFromISR (xUSBInterruptQueue, pxMessage, cTaskWokenByPost);
 
   /* Clear AIC to complete ISR processing */
   AT91C_BASE_AIC->AIC_EOICR = 0;
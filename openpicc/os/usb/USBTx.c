@@ -0,0 +1,242 @@
+/*
+	USB Communications Device Class driver, bulk IN (device to host) path.
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/*
+	Data for endpoint 2 comes from two queues.  xTxDescriptors holds
+	pointers to caller owned buffers (xUSB_TX_DESCRIPTOR), these are
+	copied straight into the endpoint FIFO and handed back through their
+	release callback.  xTxCDC is a byte stream holding copies of what is
+	passed to vUSBSendByte() and friends, taken out up to a packet at a
+	time.  Whatever is queued as a descriptor goes out first, the stream
+	fills the gaps in between.
+
+	Endpoint 2 has two banks.  While one packet is on the wire, the next
+	one is written into the other bank and topped up until it is full or
+	the first one has been sent, so that every TXCOMP interrupt finds a
+	packet ready to go.  A packet takes data from as many descriptors as
+	fit into it.
+
+	vUSBTxService() is called by the CDC task, and only by it, whenever it
+	wakes up.  The FIFO and the descriptor being sent are only touched
+	there.
+*/
+
+/* Demo board includes. */
+#include <board.h>
+
+/* Scheduler includes. */
+#include <FreeRTOS.h>
+#include <task.h>
+#include <mailbox.h>
+#include <stream.h>
+
+/* Demo app includes. */
+#include <USB-CDC.h>
+#include <metrics.h>
+
+#define usbNO_BLOCK ( ( portTickType ) 0 )
+
+/* Descriptor pointers and copied bytes waiting to be transmitted. */
+static xMailboxHandle xTxDescriptors = NULL;
+static xStreamHandle xTxCDC = NULL;
+
+/* The descriptor being copied into the FIFO, if any.  Bytes taken from
+the stream are sent through xStreamDescriptor as well. */
+static xUSB_TX_DESCRIPTOR *pxTxCurrent = NULL;
+static xUSB_TX_DESCRIPTOR xStreamDescriptor;
+static unsigned portCHAR ucStreamData[usbBULK_FIFO_LENGTH];
+
+/* Bytes in the bank that is being filled and has not been handed to the
+hardware yet. */
+static unsigned portLONG ulTxBankFill = 0;
+
+/* Bytes thrown away by an endpoint reset */
+DEFINE_METRIC_COUNTER(ulTxDropped, "usb.tx_dropped", METRIC_F_ERROR);
+
+/*------------------------------------------------------------*/
+
+portBASE_TYPE
+xUSBTxInit (void)
+{
+  if (!xTxDescriptors)
+    xTxDescriptors = xMailboxCreate (USB_TX_DESCRIPTORS);
+  if (!xTxCDC)
+    xTxCDC = xStreamCreate (USB_CDC_QUEUE_SIZE);
+
+  return xTxDescriptors && xTxCDC ? pdPASS : pdFAIL;
+}
+
+void
+vUSBTxReset (void)
+{
+  /* The endpoint reset has emptied both banks.  What was in them is lost,
+     the current descriptor goes on where it was.  Only the bank being
+     filled is counted, a packet that was on the wire may or may not have
+     reached the host. */
+  metric_add (ulTxDropped, ulTxBankFill);
+  ulTxBankFill = 0;
+}
+
+/*------------------------------------------------------------*/
+
+/* The next descriptor to send, or NULL if there is nothing to send */
+static xUSB_TX_DESCRIPTOR *
+prvNextDescriptor (void)
+{
+  xUSB_TX_DESCRIPTOR *pxDescriptor;
+  unsigned portBASE_TYPE uxLength;
+
+  if (xMailboxFetch (xTxDescriptors, (void **) &pxDescriptor, usbNO_BLOCK))
+    return pxDescriptor;
+
+  uxLength =
+    uxStreamRead (xTxCDC, ucStreamData, sizeof (ucStreamData), usbNO_BLOCK);
+  if (uxLength)
+    {
+      xStreamDescriptor.pucData = ucStreamData;
+      xStreamDescriptor.usLength = uxLength;
+      xStreamDescriptor.usSent = 0;
+      xStreamDescriptor.vRelease = NULL;
+      return &xStreamDescriptor;
+    }
+
+  return NULL;
+}
+
+/* Write up to ulSpace bytes into the bank being filled, returns the number
+of bytes written. */
+static unsigned portLONG
+prvFillBank (unsigned portLONG ulSpace)
+{
+  unsigned portLONG ulWritten = 0, ulCount;
+  const unsigned portCHAR *pucData;
+
+  while (ulWritten < ulSpace)
+    {
+      if (!pxTxCurrent && !(pxTxCurrent = prvNextDescriptor ()))
+	break;
+
+      ulCount = pxTxCurrent->usLength - pxTxCurrent->usSent;
+      if (ulCount > ulSpace - ulWritten)
+	ulCount = ulSpace - ulWritten;
+
+      pucData = pxTxCurrent->pucData + pxTxCurrent->usSent;
+      pxTxCurrent->usSent += ulCount;
+      ulWritten += ulCount;
+      while (ulCount--)
+	usbFIFO_WRITE (usbEND_POINT_2, *pucData++);
+
+      /* All of it is in the FIFO, the buffer may be reused */
+      if (pxTxCurrent->usSent == pxTxCurrent->usLength)
+	{
+	  if (pxTxCurrent->vRelease)
+	    pxTxCurrent->vRelease (pxTxCurrent);
+	  pxTxCurrent = NULL;
+	}
+    }
+
+  return ulWritten;
+}
+
+void
+vUSBTxService (void)
+{
+  unsigned portLONG ulStatus;
+
+  /* Fill, or top up, the bank that is not on the wire */
+  if (ulTxBankFill < usbBULK_FIFO_LENGTH)
+    ulTxBankFill += prvFillBank (usbBULK_FIFO_LENGTH - ulTxBankFill);
+
+  /* Hand it over once the other bank has gone out, and start on the next
+     one right away */
+  if (ulTxBankFill
+      && !(AT91C_BASE_UDP->UDP_CSR[usbEND_POINT_2] & AT91C_UDP_TXPKTRDY))
+    {
+      portENTER_CRITICAL ();
+      {
+	ulStatus = AT91C_BASE_UDP->UDP_CSR[usbEND_POINT_2];
+	usbCSR_SET_BIT (&ulStatus, AT91C_UDP_TXPKTRDY);
+	AT91C_BASE_UDP->UDP_CSR[usbEND_POINT_2] = ulStatus;
+      }
+      portEXIT_CRITICAL ();
+
+      ulTxBankFill = prvFillBank (usbBULK_FIFO_LENGTH);
+    }
+}
+
+/*------------------------------------------------------------*/
+
+portBASE_TYPE
+xUSBSendDescriptor (xUSB_TX_DESCRIPTOR * pxDescriptor,
+		    portTickType xTicksToWait)
+{
+  if (!xTxDescriptors || !pxDescriptor->usLength)
+    return pdFAIL;
+
+  pxDescriptor->usSent = 0;
+  return xMailboxPost (xTxDescriptors, pxDescriptor, xTicksToWait);
+}
+
+unsigned portBASE_TYPE
+uxUSBTxBytesWaiting (void)
+{
+  return xTxCDC ? uxStreamBytesWaiting (xTxCDC) : 0;
+}
+
+unsigned portBASE_TYPE
+uxUSBTxDescriptorsWaiting (void)
+{
+  return xTxDescriptors ? uxMailboxWaiting (xTxDescriptors) : 0;
+}
+
+void
+vUSBSendByte (portCHAR cByte)
+{
+	vUSBSendByte_blocking(cByte, usbNO_BLOCK);
+}
+
+void
+vUSBSendByte_blocking (portCHAR cByte, portTickType xTicksToWait)
+{
+  /* Queue the byte to be sent.  The USB task will send it. */
+  uxStreamWrite (xTxCDC, &cByte, 1, xTicksToWait);
+}
+
+/* Queue up to length bytes, as many at a time as there is space for. Stops
+ * when the stream stays full for xTicksToWait, returns the number of bytes
+ * queued. */
+portBASE_TYPE
+xUSBSendBuffer (unsigned char *buffer, portBASE_TYPE offset, portBASE_TYPE length, portTickType xTicksToWait)
+{
+	if(length <= 0)
+		return 0;
+	/* Queue the bytes to be sent.  The USB task will send them. */
+	return uxStreamWrite (xTxCDC, buffer+offset, length, xTicksToWait);
+}
+
+void
+vUSBSendBuffer_blocking (unsigned char *buffer, portBASE_TYPE offset, portBASE_TYPE length, portTickType xTicksToWait)
+{
+	xUSBSendBuffer(buffer, offset, length, xTicksToWait);
+}
+
+void
+vUSBSendBuffer (unsigned char *buffer, portBASE_TYPE offset, portBASE_TYPE length)
+{
+	vUSBSendBuffer_blocking(buffer, offset, length, usbNO_BLOCK);
+}
@@ -89,6 +89,7 @@
 #define usbINTERRUPT_PRIORITY				( 3 )
 #define usbQUEUE_LENGTH					( 0x3 )	/* Must have all bits set! */
 #define usbFIFO_LENGTH					( ( unsigned portLONG ) 8 )
+#define usbBULK_FIFO_LENGTH				( ( unsigned portLONG ) 64 )	/* Per bank */
 #define usbEND_POINT_0					( 0 )
 #define usbEND_POINT_1					( 1 )
 #define usbEND_POINT_2					( 2 )
@@ -102,6 +103,12 @@
 #define usbDATA_INC					( ( portCHAR ) 5 )
 #define usbEXPECTED_NUMBER_OF_BYTES			( ( unsigned portLONG ) 8 )
 
+/* Write a byte into an endpoint FIFO.  The POSIX simulation replaces it with
+its mock UDP, see sim/sim_udp.c. */
+#ifndef usbFIFO_WRITE
+#define usbFIFO_WRITE( ulEndPoint, ucByte )		( AT91C_BASE_UDP->UDP_FDR[ ( ulEndPoint ) ] = ( ucByte ) )
+#endif
+
 /* Control request types. */
 #define usbSTANDARD_DEVICE_REQUEST			( 0 )
 #define usbSTANDARD_INTERFACE_REQUEST			( 1 )
@@ -0,0 +1,142 @@
+/***************************************************************
+ *
+ * OpenPICC - board definitions for the POSIX simulation build
+ *
+ * Stands in for config/board.h and lib_AT91SAM7.h. Only the
+ * registers and pins that the simulated modules touch exist,
+ * they are plain variables driven by sim_hw.c.
+ *
+ ***************************************************************
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; version 2.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+#ifndef Board_h
+#define Board_h
+
+#define RAMFUNC
+#define IRQFUNC
+#define FIQFUNC
+#define __ramfunc
+
+#define true	-1
+#define false	0
+
+/*-----------------*/
+/* Master Clock    */
+/*-----------------*/
+
+#define MCK		47923200
+#define CARRIER_HZ	13560000
+
+/*-----------------*/
+/* Board version   */
+/*-----------------*/
+enum openpicc_release {
+	OPENPICC_v0_4,
+	OPENPICC_v0_4_p1,
+	OPENPICC_v0_4_p2,
+	OPENPICC_v0_4_karsten,
+};
+enum clock_source {
+	CLOCK_SELECT_PLL,
+	CLOCK_SELECT_CARRIER,
+};
+
+struct openpicc_hardware {
+	enum openpicc_release release;
+	char *release_name;
+	struct {
+		int data_gating:1;
+		int clock_gating:1;
+		int clock_switching:1;
+	} features;
+	enum clock_source default_clock;
+
+	int PLL_LOCK;
+
+	int CLOCK_GATE;
+	int DATA_GATE;
+	int CLOCK_SWITCH;
+};
+
+extern const struct openpicc_hardware *OPENPICC;
+
+/*-----------------*/
+/* Registers       */
+/*-----------------*/
+
+typedef volatile unsigned int AT91_REG;
+
+typedef struct _AT91S_PIO {
+	AT91_REG PIO_ISR;	/* latched by the FIQ, see sim_hw.c */
+	AT91_REG PIO_PDSR;
+} AT91S_PIO, *AT91PS_PIO;
+
+typedef struct _AT91S_TCB *AT91PS_TCB;
+
+/* Only the endpoint status of the UDP, the FIFO is written through
+ * usbFIFO_WRITE. Both are driven by sim_udp.c. */
+typedef struct _AT91S_UDP {
+	AT91_REG UDP_CSR[8];
+} AT91S_UDP, *AT91PS_UDP;
+
+#define AT91C_UDP_TXCOMP	(0x1 <<  0)
+#define AT91C_UDP_TXPKTRDY	(0x1 <<  4)
+
+extern AT91S_PIO sim_pioa;
+/* TC2 is derived from the clock whenever it is read */
+extern AT91_REG *sim_tc2_cv(void);
+
+#define AT91C_BASE_PIOA	(&sim_pioa)
+#define AT91C_TC2_CV	(sim_tc2_cv())
+
+extern AT91S_UDP sim_udp;
+extern void sim_udp_fifo_write(unsigned int ep, unsigned char c);
+
+#define AT91C_BASE_UDP	(&sim_udp)
+#define usbFIFO_WRITE(ep, c)	sim_udp_fifo_write(ep, c)
+
+static inline void AT91F_PIO_CfgInput(AT91PS_PIO pPio, unsigned int inputEnable)
+{
+	(void)pPio; (void)inputEnable;
+}
+
+static inline int AT91F_PIO_IsInputSet(AT91PS_PIO pPio, unsigned int flag)
+{
+	return pPio->PIO_PDSR & flag;
+}
+
+/*-----------------*/
+/* Pins            */
+/*-----------------*/
+
+#define LED_GREEN	(1 << 25)
+#define LED_RED		(1 << 12)
+#define LED_MASK	(LED_GREEN|LED_RED)
+
+#define OPENPICC_SSC_DATA	   (1 << 18)
+#define OPENPICC_PIO_FRAME         (1 << 20)
+
+/*-----------------*/
+/* task priorities */
+/*-----------------*/
+
+#define TASK_USB_PRIORITY	( tskIDLE_PRIORITY + 2 )
+#define TASK_USB_STACK		( 512 )
+
+#define TASK_ISO_PRIORITY	( tskIDLE_PRIORITY + 3 )
+#define TASK_ISO_STACK		( 512 )
+
+#endif /* Board_h */
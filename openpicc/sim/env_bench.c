@@ -0,0 +1,223 @@
+/***************************************************************
+ *
+ * OpenPICC - env_log.c against an emulated flash
+ *
+ * The flash is modelled as the AT91SAM7 one behaves: a page is
+ * programmed as a whole, with an erase first all of it takes
+ * the new contents, without bits can only go from 1 to 0. A
+ * run saves random values of a few keys, the way tuning from
+ * the console does, and checks after every save that a fresh
+ * env_log_init() finds exactly what was saved.
+ *
+ * With -c every program operation is cut short with that
+ * probability, as by a power loss: the erase or the programming
+ * of the page stops at a random byte and bit. After a cut the
+ * log is indexed again and every key must still have its last
+ * saved value, the one that was being saved may have the new or
+ * the old one.
+ *
+ * Shown are the erases and programs per save and the spread of
+ * the erases over the pages, compared with erasing and writing
+ * a page on every save as env_store() used to, and the time
+ * env_log_init() takes.
+ *
+ ***************************************************************
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; version 2.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include <FreeRTOS.h>
+
+#include "env_log.h"
+
+#define PAGES		4	/* ENVIRONMENT_SIZE / page size */
+#define KEYS		6
+
+static u_int8_t flash[PAGES * ENV_LOG_PAGE_SIZE];
+static unsigned long erases[PAGES], programs, cuts;
+static double cut_probability;
+
+static struct {
+	u_int8_t value[8];
+	unsigned int len;
+	int saved;
+} model[KEYS];
+
+static int flash_program(unsigned int page, const u_int32_t *data, int erase)
+{
+	u_int8_t *p = flash + page * ENV_LOG_PAGE_SIZE;
+	const u_int8_t *d = (const u_int8_t *)data;
+	unsigned int i, cut = ENV_LOG_PAGE_SIZE;
+	int cut_erase = 0;
+
+	programs++;
+	if (erase)
+		erases[page]++;
+	if (cut_probability > 0 && drand48() < cut_probability) {
+		cut = lrand48() % ENV_LOG_PAGE_SIZE;
+		cut_erase = erase && (lrand48() & 1);
+	}
+
+	if (erase) {
+		for (i = 0; i < ENV_LOG_PAGE_SIZE; i++) {
+			if (cut_erase && i == cut) {
+				/* Half erased bits */
+				p[i] |= lrand48();
+				return -EIO;
+			}
+			p[i] = 0xff;
+		}
+	}
+	for (i = 0; i < ENV_LOG_PAGE_SIZE; i++) {
+		if (i == cut) {
+			p[i] &= d[i] | lrand48();
+			return -EIO;
+		}
+		p[i] &= d[i];
+	}
+	return 0;
+}
+
+static const struct env_log_flash emulated = {
+	.base = flash,
+	.pages = PAGES,
+	.program = flash_program,
+};
+
+/* Returns the number of keys that do not match, in flight may have either
+ * value */
+static int check(struct env_log *log, int in_flight, const u_int8_t *new_value)
+{
+	u_int8_t value[ENV_LOG_MAX_VALUE];
+	int k, ret, bad = 0;
+
+	env_log_init(log, &emulated);
+	for (k = 0; k < KEYS; k++) {
+		ret = env_log_get(log, k, value, sizeof(value));
+		if (k == in_flight && ret == (int)model[k].len &&
+		    !memcmp(value, new_value, ret)) {
+			memcpy(model[k].value, new_value, ret);
+			model[k].saved = 1;
+			continue;
+		}
+		if (!model[k].saved) {
+			if (ret != -ENOENT)
+				bad++;
+			continue;
+		}
+		if (ret != (int)model[k].len || memcmp(value, model[k].value, ret))
+			bad++;
+	}
+	return bad;
+}
+
+static double now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void help(void)
+{
+	printf("env_bench [-n saves] [-c cut probability] [-s seed]\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct env_log log;
+	unsigned long saves = 100000, i, failures = 0, unchanged = 0;
+	unsigned long max_erases = 0, min_erases = ~0UL, total_erases = 0;
+	u_int8_t value[8];
+	double t;
+	int c, k, ret;
+
+	while ((c = getopt(argc, argv, "n:c:s:h")) != -1) {
+		switch (c) {
+		case 'n':
+			saves = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			cut_probability = atof(optarg);
+			break;
+		case 's':
+			srand48(strtoul(optarg, NULL, 0));
+			break;
+		default:
+			help();
+			exit(c == 'h' ? 0 : 2);
+		}
+	}
+
+	memset(flash, 0xff, sizeof(flash));
+	for (k = 0; k < KEYS; k++)
+		model[k].len = 1 + k % 4 * 2;	/* 1, 3, 5, 7 bytes */
+	env_log_init(&log, &emulated);
+
+	for (i = 0; i < saves; i++) {
+		/* Mostly the same two keys, like stepping fdt_offset */
+		k = lrand48() % 4 ? lrand48() % 2 : lrand48() % KEYS;
+		memcpy(value, model[k].value, sizeof(value));
+		value[lrand48() % model[k].len] = lrand48();
+		if (model[k].saved && !memcmp(value, model[k].value, model[k].len))
+			unchanged++;
+
+		ret = env_log_set(&log, k, value, model[k].len);
+		if (ret == 0) {
+			memcpy(model[k].value, value, model[k].len);
+			model[k].saved = 1;
+			ret = check(&log, -1, NULL);
+		} else {
+			/* Power loss, boot again */
+			cuts++;
+			ret = check(&log, k, value);
+		}
+		if (ret) {
+			failures++;
+			fprintf(stderr, "save %lu: %d keys wrong\n", i, ret);
+		}
+	}
+
+	for (k = 0; k < PAGES; k++) {
+		total_erases += erases[k];
+		if (erases[k] > max_erases)
+			max_erases = erases[k];
+		if (erases[k] < min_erases)
+			min_erases = erases[k];
+	}
+
+	t = now_us();
+	for (i = 0; i < 1000; i++)
+		env_log_init(&log, &emulated);
+	t = (now_us() - t) / 1000;
+
+	printf("%lu saves (%lu of an unchanged value), %lu cut short\n",
+	       saves, unchanged, cuts);
+	printf("page erases:   %lu, %.4f per save (was 1)\n", total_erases,
+	       (double)total_erases / saves);
+	printf("page programs: %lu, %.4f per save\n", programs,
+	       (double)programs / saves);
+	printf("erases per page: %lu to %lu\n", min_erases, max_erases);
+	printf("env_log_init: %.2f us on this host\n", t);
+	printf("%lu saves not found as saved\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,3 @@
+/* The simulation build has no AT91 library, what the simulated modules
+ * need of it is in board.h */
+#include "board.h"
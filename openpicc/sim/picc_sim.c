@@ -0,0 +1,684 @@
+/***************************************************************
+ *
+ * OpenPICC - simulation of the card emulation on a PC
+ *
+ * Runs the pretender task together with layer 2, tc_recv, the
+ * differential Miller decoder and the response cache on the
+ * POSIX FreeRTOS port, against the simulated peripherals in
+ * sim_hw.c. A reader thread plays the PCD: it polls with REQA
+ * until the PICC is up and then runs anticollision, select,
+ * authentication and halt rounds, or replays recorded traces.
+ *
+ * For every answered reader frame the time from the last pause
+ * to the moment the response was handed to the SSC is reported,
+ * in carrier cycles (the unit of TC2 and the FDT) and in us. A
+ * response that is queued after TC2 has passed the FDT would go
+ * out late on the board and is counted as such.
+ *
+ * With -t the event trace (application/trace.c) of the last
+ * frames is written to a file for host/trace_analyse. With -m
+ * a metrics dump (application/metrics.c) is written to a file
+ * after start up and every 100 transactions or trace file, for
+ * host/metrics_poll. With -s the run times of the tasks
+ * (application/taskstats.c) are written at the end, for
+ * host/task_stats.
+ *
+ * Trace files hold TC2 captures like the tc_sniffer output, see
+ * host/diffmiller_replay.c. A capture of 300 or more starts a new
+ * frame.
+ *
+ * With -S the T/C sniffer (application/tc_sniffer.c) runs instead
+ * of the pretender and its record stream is written to a file, for
+ * host/sniff2pcapng. Nothing answers then, the reader sends its
+ * frames one after the other. At the end the records are read back
+ * and compared with the frames sent.
+ *
+ ***************************************************************
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; version 2.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "openpicc.h"
+#include "iso14443.h"
+#include "iso14443_crc.h"
+#include "iso14443a_pretender.h"
+#include "usb_print.h"
+#include "trace.h"
+#include "metrics.h"
+#include "taskstats.h"
+#include "tc_sniffer.h"
+#include "sniffer_proto.h"
+
+#include "sim_hw.h"
+
+extern volatile int fdt_offset;
+
+#define BIT_LEN		128
+#define CAPTURE_OFFSET	SIM_TC2_RESTART
+#define TC2_MAX		SIM_TC2_MAX
+#define FRAME_GAP	300
+/* How long to wait for ssc_send() after the last pause, the pretender
+ * gives up at 870 anyway */
+#define RESPONSE_WINDOW	2048
+
+#define MAX_FRAME	64
+#define MAX_PAUSES	(2 + 9*MAX_FRAME + 2)
+
+struct reader_frame {
+	u_int32_t capture[MAX_PAUSES];
+	int count;
+};
+
+struct stats {
+	const char *name;
+	unsigned int sent, answered, late;
+	u_int32_t *cv;
+	double sum_us;
+	u_int32_t fdt;
+};
+
+enum { CMD_REQA, CMD_ANTICOL, CMD_SELECT, CMD_AUTH, CMD_AUTH2, CMD_HLTA, CMD_TRACE, NUM_CMDS };
+
+static struct stats stats[NUM_CMDS] = {
+	[CMD_REQA]	= { .name = "REQA" },
+	[CMD_ANTICOL]	= { .name = "ANTICOL" },
+	[CMD_SELECT]	= { .name = "SELECT" },
+	[CMD_AUTH]	= { .name = "AUTH" },
+	[CMD_AUTH2]	= { .name = "AUTH2" },
+	[CMD_HLTA]	= { .name = "HLTA" },
+	[CMD_TRACE]	= { .name = "trace" },
+};
+
+static unsigned int rounds = 1000, gap_us = 500, jitter = 0, max_samples;
+static char **trace_files;
+static const char *event_file;
+static int metrics_fd = -1;
+static int taskstats_fd = -1;
+static volatile int taskstats_wanted;
+static int num_trace_files;
+
+static unsigned long long last_pause;
+static unsigned int stale;
+
+/* Frames sent while the sniffer runs, to compare its records with */
+static const char *sniff_file;
+static struct reader_bytes {
+	u_int8_t data[MAX_FRAME];
+	int bits;
+} *sniff_sent;
+static unsigned int sniff_count, sniff_max;
+
+/****************************** Reader *******************************/
+
+/* Sleep rather than spin, the tasks may need the CPU meanwhile. TC2 is
+ * derived from the clock, so it keeps counting regardless. */
+static void run_until(unsigned long long t)
+{
+	struct timespec ts = { t / 1000000000ULL, t % 1000000000ULL };
+
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+/* Send the frame: at each pause the FIQ captures TC2, which restarts.
+ *
+ * The pauses go out back to back with TC2 held at 0 meanwhile, so the
+ * frame takes no time as far as the PICC can tell. The decoder only looks
+ * at the captures, but tc_recv ends a frame once TC2 passes REAL_FRAME_END,
+ * which the nominal spacing would trigger whenever the reader thread loses
+ * the CPU within a frame. All the decoding is left for after the last
+ * pause, so the measured response times are an upper bound. */
+static void send_frame(const struct reader_frame *f)
+{
+	u_int32_t capture = *AT91C_TC2_CV;
+	int i;
+
+	/* Hold TC2 before the first pause, a task that runs in between
+	 * would see it count on and end the frame right away */
+	sim_tc2_hold();
+	sim_fiq(capture);
+	for(i = 1; i < f->count; i++)
+		sim_fiq(f->capture[i]);
+	last_pause = sim_tc2_release();
+}
+
+/* Modified Miller: 1 is X (pause at half bit), 0 after 1 is Y (no
+ * pause), any other 0 and SOF are Z (pause at the start of the bit).
+ * EOF is a logic 0 followed by Y. */
+enum { SYM_X, SYM_Y, SYM_Z };
+
+static void encode_frame(struct reader_frame *f, const u_int8_t *data, int nbits)
+{
+	u_int8_t sym[1 + 9*MAX_FRAME + 2];
+	int nsym = 0, i, bit, prev = 0, last = -1;
+	/* Short frames have no parity */
+	int with_parity = nbits >= 8;
+	int total = with_parity ? nbits + nbits/8 : nbits;
+
+	sym[nsym++] = SYM_Z;
+	for(i = 0; i < total; i++) {
+		int byte = with_parity ? i / 9 : i / 8, pos = with_parity ? i % 9 : i % 8;
+
+		if(pos < 8)
+			bit = (data[byte] >> pos) & 1;
+		else
+			bit = !__builtin_parity(data[byte]);
+		if(bit)
+			sym[nsym++] = SYM_X;
+		else
+			sym[nsym++] = prev ? SYM_Y : SYM_Z;
+		prev = bit;
+	}
+	sym[nsym++] = prev ? SYM_Y : SYM_Z;
+	sym[nsym++] = SYM_Y;
+
+	f->count = 0;
+	for(i = 0; i < nsym; i++) {
+		int pos;
+
+		if(sym[i] == SYM_Y)
+			continue;
+		pos = i * BIT_LEN + (sym[i] == SYM_X ? BIT_LEN/2 : 0);
+		if(last >= 0) {
+			int d = pos - last - CAPTURE_OFFSET;
+			if(jitter)
+				d += random() % (2*jitter + 1) - jitter;
+			f->capture[f->count++] = d;
+		} else
+			f->capture[f->count++] = TC2_MAX;
+		last = pos;
+	}
+}
+
+/* Send a frame and wait for the response, returns the response frame */
+static const iso14443_frame *transceive(int cmd, const struct reader_frame *f)
+{
+	struct stats *s = &stats[cmd];
+	const iso14443_frame *response = NULL;
+	struct sim_tx tx;
+
+	/* Nobody answers, the sniffer ends the frame once TC2 passes 2*128 */
+	if(sniff_file) {
+		send_frame(f);
+		s->sent++;
+		run_until(last_pause + gap_us * 1000ULL);
+		return NULL;
+	}
+
+	/* A response that missed the window of the previous frame */
+	if(sim_hw_get_tx(&tx) == 0) {
+		sim_hw_tx_end();
+		stale++;
+	}
+
+	send_frame(f);
+	s->sent++;
+
+	run_until(last_pause + sim_cycles_to_ns(CAPTURE_OFFSET + RESPONSE_WINDOW));
+	if(sim_hw_get_tx(&tx) == 0) {
+		response = tx.buffer->source;
+		if(s->answered < max_samples)
+			s->cv[s->answered++] = tx.cv;
+		s->sum_us += ((long long)tx.ns - (long long)last_pause) / 1000.0;
+		s->fdt = tx.fdt;
+		if(tx.cv >= tx.fdt)
+			s->late++;
+
+		/* The SSC is done 8 carrier cycles per bit of the buffer after the FDT */
+		run_until(last_pause + sim_cycles_to_ns(CAPTURE_OFFSET + tx.fdt + tx.buffer->len*8*8));
+		sim_hw_tx_end();
+	}
+
+	run_until(sim_now() + gap_us * 1000ULL);
+	return response;
+}
+
+static void sniff_expect(const u_int8_t *data, int nbits)
+{
+	struct reader_bytes *b;
+
+	if(!sniff_file || sniff_count == sniff_max)
+		return;
+	b = &sniff_sent[sniff_count++];
+	memset(b->data, 0, sizeof(b->data));
+	memcpy(b->data, data, (nbits+7)/8);
+	b->bits = nbits;
+}
+
+static const iso14443_frame *transceive_bytes(int cmd, const u_int8_t *data, int len, int crc)
+{
+	struct reader_frame f;
+	u_int8_t buf[MAX_FRAME];
+
+	memcpy(buf, data, len);
+	if(crc) {
+		u_int16_t c = iso14443a_crc(buf, len);
+		buf[len++] = c & 0xff;
+		buf[len++] = c >> 8;
+	}
+	encode_frame(&f, buf, len*8);
+	sniff_expect(buf, len*8);
+	return transceive(cmd, &f);
+}
+
+static const iso14443_frame *reqa(void)
+{
+	static const u_int8_t reqa_cmd = 0x26;
+	struct reader_frame f;
+
+	encode_frame(&f, &reqa_cmd, 7);
+	sniff_expect(&reqa_cmd, 7);
+	return transceive(CMD_REQA, &f);
+}
+
+/* One card transaction as a MIFARE Classic reader would run it */
+static void transaction(void)
+{
+	static const u_int8_t ANTICOL[] = {0x93, 0x20};
+	static const u_int8_t AUTH[] = {0x60, 0x00};
+	static const u_int8_t HLTA[] = {0x50, 0x00};
+	static u_int8_t select[7] = {0x93, 0x70};
+	const iso14443_frame *uid;
+	u_int8_t auth2[8];
+	int i;
+
+	reqa();
+	uid = transceive_bytes(CMD_ANTICOL, ANTICOL, sizeof(ANTICOL), 0);
+	if(uid != NULL)
+		memcpy(&select[2], uid->data, 5);
+	transceive_bytes(CMD_SELECT, select, sizeof(select), 1);
+	transceive_bytes(CMD_AUTH, AUTH, sizeof(AUTH), 1);
+	for(i = 0; i < (int)sizeof(auth2); i++)
+		auth2[i] = random();
+	transceive_bytes(CMD_AUTH2, auth2, sizeof(auth2), 0);
+	transceive_bytes(CMD_HLTA, HLTA, sizeof(HLTA), 1);
+}
+
+static int replay_trace(const char *fname)
+{
+	static struct reader_frame f;
+	u_int32_t capture;
+	FILE *fp = fopen(fname, "r");
+
+	if(!fp) {
+		perror(fname);
+		return -1;
+	}
+
+	f.count = 0;
+	for(;;) {
+		int more = fscanf(fp, "%u", &capture) == 1;
+
+		if(!more || capture >= FRAME_GAP) {
+			/* A lone pause is not a frame */
+			if(f.count > 1)
+				transceive(CMD_TRACE, &f);
+			f.count = 0;
+		}
+		if(!more)
+			break;
+		if(f.count < MAX_PAUSES)
+			f.capture[f.count++] = capture;
+	}
+
+	fclose(fp);
+	return 0;
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+	u_int32_t x = *(const u_int32_t *)a, y = *(const u_int32_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+static void report(void)
+{
+	int i;
+
+	printf("\nframe end to response queued, carrier cycles (us) after the last pause\n");
+	printf("%-8s %7s %8s %5s %6s %6s %6s %6s %8s %5s\n", "frame", "sent", "answered",
+	       "late", "min", "median", "99%", "max", "avg us", "FDT");
+	for(i = 0; i < NUM_CMDS; i++) {
+		struct stats *s = &stats[i];
+		unsigned int n = s->answered;
+
+		if(s->sent == 0)
+			continue;
+		printf("%-8s %7u %8u %5u", s->name, s->sent, n, s->late);
+		if(n) {
+			qsort(s->cv, n, sizeof(s->cv[0]), compare_u32);
+			printf(" %6u %6u %6u %6u %8.1f %5u", (unsigned int)s->cv[0],
+			       (unsigned int)s->cv[n/2], (unsigned int)s->cv[(n*99)/100],
+			       (unsigned int)s->cv[n-1], s->sum_us / n, (unsigned int)s->fdt);
+		}
+		printf("\n");
+	}
+	if(stale)
+		printf("%u responses came after the response window\n", stale);
+}
+
+/* Read the records back and compare them with the frames sent. Trace
+ * files are only counted, there is nothing to compare with. */
+static int check_sniffed(void)
+{
+	struct sniffer_record rec;
+	u_int8_t data[MAX_FRAME], parity[MAX_FRAME/8];
+	unsigned int n = 0, errors = 0, crc_ok = 0, i;
+	u_int32_t last_ts = 0;
+	FILE *fp = fopen(sniff_file, "rb");
+
+	if(!fp) {
+		perror(sniff_file);
+		return -1;
+	}
+
+	while(fread(&rec, sizeof(rec), 1, fp) == 1) {
+		unsigned int len = SNIFFER_DATA_LEN(rec.bits), plen = SNIFFER_PARITY_LEN(rec.bits);
+		const struct reader_bytes *b = &sniff_sent[n];
+		u_int8_t flags = 0;
+
+		if(rec.type != SNIFFER_REC_FRAME || len > sizeof(data) ||
+		   fread(data, 1, len, fp) != len || fread(parity, 1, plen, fp) != plen) {
+			printf("record %u is broken\n", n);
+			errors++;
+			break;
+		}
+		if(rec.flags & SNIFFER_F_CRC_OK)
+			crc_ok++;
+		if(n && rec.timestamp <= last_ts) {
+			printf("record %u is not later than the one before\n", n);
+			errors++;
+		}
+		last_ts = rec.timestamp;
+		if(num_trace_files) {
+			n++;
+			continue;
+		}
+		if(n == sniff_count) {
+			printf("record %u was never sent\n", n);
+			errors++;
+			break;
+		}
+		n++;
+
+		if(rec.bits != b->bits || memcmp(data, b->data, len)) {
+			printf("record %u has %u bits (flags 0x%02x), ", n-1, rec.bits, rec.flags);
+			for(i = 0; i < len; i++)
+				printf("%02x", data[i]);
+			printf(", sent were %d bits, ", b->bits);
+			for(i = 0; i < (unsigned int)(b->bits+7)/8; i++)
+				printf("%02x", b->data[i]);
+			printf("\n");
+			errors++;
+			continue;
+		}
+		for(i = 0; i < (unsigned int)rec.bits/8; i++)
+			if(((parity[i/8] >> (i%8)) & 1) == __builtin_parity(data[i])) {
+				printf("record %u: wrong parity of byte %u\n", n-1, i);
+				errors++;
+			}
+
+		/* The reader appends a CRC to all frames of 3 bytes or more but
+		 * AUTH2, whose random bytes only pass by chance */
+		if(rec.bits % 8 == 0 && len >= 3)
+			flags = iso14443a_crc(data, len-2) == (data[len-2] | data[len-1] << 8) ?
+				SNIFFER_F_CRC_OK : SNIFFER_F_CRC_ERROR;
+		if((rec.flags & (SNIFFER_F_CRC_OK | SNIFFER_F_CRC_ERROR |
+				 SNIFFER_F_DECODE_ERROR | SNIFFER_F_TRUNCATED)) != flags) {
+			printf("record %u has flags 0x%02x\n", n-1, rec.flags);
+			errors++;
+		}
+	}
+	fclose(fp);
+
+	if(!num_trace_files && n < sniff_count) {
+		printf("%u of %u frames were not sniffed\n", sniff_count - n, sniff_count);
+		errors++;
+	}
+	printf("sniffer: %u records, %u with a good CRC, %u errors\n", n, crc_ok, errors);
+	return errors ? -1 : 0;
+}
+
+static void write_metrics(void)
+{
+	if(metrics_fd < 0)
+		return;
+	sim_usb_bin_fd = metrics_fd;
+	if(metrics_dump() < 0)
+		fprintf(stderr, "metrics dump failed\n");
+	sim_usb_bin_fd = -1;
+}
+
+static void *reader_thread(void *arg)
+{
+	unsigned long long start;
+	unsigned int polls = 0, i;
+	int ret = 0;
+
+	(void)arg;
+
+	while(!sim_hw_rx_ready())
+		usleep(1000);
+
+	if(sniff_file)
+		goto run;
+
+	/* Poll until the pretender is through its start up */
+	start = sim_now();
+	do {
+		if(sim_now() - start > 10000000000ULL) {
+			fprintf(stderr, "No answer to REQA, giving up\n");
+			exit(1);
+		}
+		polls++;
+	} while(reqa() == NULL);
+	printf("PICC answered REQA after %u polls (%.0f ms)\n", polls,
+	       (sim_now() - start) / 1e6);
+	stats[CMD_REQA].sent = stats[CMD_REQA].answered = stats[CMD_REQA].late = 0;
+	stats[CMD_REQA].sum_us = 0;
+	write_metrics();
+
+run:
+	if(num_trace_files) {
+		for(i = 0; i < (unsigned int)num_trace_files; i++) {
+			if(replay_trace(trace_files[i]) < 0)
+				ret = 1;
+			write_metrics();
+		}
+	} else {
+		for(i = 0; i < rounds; i++) {
+			transaction();
+			if(i % 100 == 99 || i == rounds-1)
+				write_metrics();
+		}
+	}
+
+	/* Only a task may take the snapshot, see usb_print_flusher() */
+	if(taskstats_fd >= 0) {
+		taskstats_wanted = 1;
+		while(taskstats_wanted)
+			usleep(1000);
+	}
+
+	if(sniff_file) {
+		/* Let the sniffer send what it has collected */
+		run_until(sim_now() + 100000000ULL);
+		if(check_sniffed() < 0)
+			ret = 1;
+	} else
+		report();
+	fflush(stdout);
+	if(event_file) {
+		sim_usb_bin_fd = open(event_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if(sim_usb_bin_fd < 0 || trace_dump() < 0) {
+			perror(event_file);
+			ret = 1;
+		}
+		if(sim_usb_bin_fd >= 0)
+			close(sim_usb_bin_fd);
+	}
+	exit(ret);
+}
+
+/****************************** Tasks ********************************/
+
+static void usb_print_flusher(void *pvParameters)
+{
+	(void)pvParameters;
+	while(1) {
+		usb_print_flush();
+		if(taskstats_wanted) {
+			sim_usb_bin_fd = taskstats_fd;
+			if(taskstats_dump() < 0)
+				fprintf(stderr, "task stats dump failed\n");
+			sim_usb_bin_fd = -1;
+			taskstats_wanted = 0;
+		}
+		vTaskDelay(100*portTICK_RATE_MS);
+	}
+}
+
+/* Wait for the next interrupt instead of spinning */
+void vApplicationIdleHook(void)
+{
+	pause();
+}
+
+static void print_help(void)
+{
+	printf("picc_sim [-n rounds] [-g gap_us] [-j jitter] [-o fdt_offset] [-t file] [-m file] [-s file] [-S file] [-v] [trace ...]\n"
+	       "  -n  reader transactions to run (default %u)\n"
+	       "  -g  idle time between reader frames in us (default %u)\n"
+	       "  -j  random jitter of the reader timing in carrier cycles\n"
+	       "  -o  fdt_offset of the pretender (default %d)\n"
+	       "  -t  write the event trace of the last frames to file\n"
+	       "  -m  write metrics dumps to file\n"
+	       "  -s  write the task run times to file at the end\n"
+	       "  -S  run the sniffer instead, write its records to file\n"
+	       "  -v  show the PICC's USB output\n", rounds, gap_us, fdt_offset);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t reader;
+	int c, i;
+
+	while((c = getopt(argc, argv, "n:g:j:o:t:m:s:S:vh")) != -1) {
+		switch(c) {
+		case 'n':
+			rounds = atoi(optarg);
+			break;
+		case 'g':
+			gap_us = atoi(optarg);
+			break;
+		case 'j':
+			jitter = atoi(optarg);
+			break;
+		case 'o':
+			fdt_offset = atoi(optarg);
+			break;
+		case 't':
+			event_file = optarg;
+			break;
+		case 'm':
+			metrics_fd = open(optarg, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			if(metrics_fd < 0) {
+				perror(optarg);
+				exit(1);
+			}
+			break;
+		case 's':
+			taskstats_fd = open(optarg, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			if(taskstats_fd < 0) {
+				perror(optarg);
+				exit(1);
+			}
+			break;
+		case 'S':
+			sniff_file = optarg;
+			break;
+		case 'v':
+			sim_usb_echo = 1;
+			break;
+		default:
+			print_help();
+			exit(c == 'h' ? 0 : 2);
+		}
+	}
+	trace_files = &argv[optind];
+	num_trace_files = argc - optind;
+
+	/* The records go out the way the dumps do */
+	if(sniff_file) {
+		if(event_file || metrics_fd >= 0 || taskstats_fd >= 0) {
+			fprintf(stderr, "-S does not go with -t, -m or -s\n");
+			exit(2);
+		}
+		sim_usb_bin_fd = open(sniff_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if(sim_usb_bin_fd < 0) {
+			perror(sniff_file);
+			exit(1);
+		}
+		sniff_max = rounds * 6;
+		sniff_sent = calloc(sniff_max, sizeof(sniff_sent[0]));
+		if(sniff_sent == NULL) {
+			perror("calloc");
+			exit(1);
+		}
+	}
+
+	/* Each frame of a trace or a round is answered at most once */
+	max_samples = num_trace_files ? 65536 : rounds + 1;
+	for(i = 0; i < NUM_CMDS; i++) {
+		stats[i].cv = calloc(max_samples, sizeof(stats[i].cv[0]));
+		if(stats[i].cv == NULL) {
+			perror("calloc");
+			exit(1);
+		}
+	}
+	srandom(1);
+
+	sim_hw_init();
+	usb_print_init();
+	trace_init();
+
+	xTaskCreate(usb_print_flusher, (signed portCHAR *) "PRINT-FLUSH", TASK_USB_STACK,
+		NULL, TASK_USB_PRIORITY, NULL);
+	if(sniff_file)
+		xTaskCreate(tc_sniffer, (signed portCHAR *) "RFID-SNIFFER", TASK_ISO_STACK,
+			NULL, TASK_ISO_PRIORITY, NULL);
+	else
+		xTaskCreate(iso14443a_pretender, (signed portCHAR *) "ISO14443A-PRETEND", TASK_ISO_STACK,
+			NULL, TASK_ISO_PRIORITY, NULL);
+
+	if(pthread_create(&reader, NULL, reader_thread, NULL) != 0) {
+		perror("pthread_create");
+		exit(1);
+	}
+
+	vTaskStartScheduler();
+	return 1;
+}
@@ -0,0 +1,416 @@
+/***************************************************************
+ *
+ * OpenPICC - cost of the FreeRTOS queue primitives
+ *
+ * Runs on the POSIX FreeRTOS port and compares the pointer
+ * mailbox (mailbox.h) and the byte stream (stream.h) with doing
+ * the same through xQueueSend()/xQueueReceive():
+ *
+ *  - pointers posted by a task and by an "ISR" (a task with the
+ *    interrupts masked, as tc_recv does from its IRQ) and taken
+ *    by a task, as xQueue items and through the mailbox
+ *  - bytes written in runs of -r by an ISR and by a task and
+ *    read by a task, one xQueue item per byte, in 9 byte chunks
+ *    as USBTx.c used to, and through the stream
+ *  - a hand off to a higher priority task blocked on the
+ *    receiving end, which adds a context switch per item
+ *
+ * Every item that comes out is checked against what went in.
+ * The POSIX port masks the interrupts with a system call, so
+ * the numbers overstate the cost of a critical section compared
+ * to the ARM, where it is a few instructions. What counts is
+ * how many of them each variant needs.
+ *
+ ***************************************************************
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; version 2.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
+#include <mailbox.h>
+#include <stream.h>
+
+#define QUEUE_LENGTH	16
+#define STREAM_SIZE	1024
+#define CHUNK_SIZE	9
+#define MAX_RUN		512
+
+static unsigned long count = 200000;
+static unsigned int run = 64;
+static unsigned long errors;
+
+static xQueueHandle pointer_queue, byte_queue, chunk_queue;
+static xMailboxHandle mailbox;
+static xStreamHandle stream;
+
+static unsigned long long now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void report(const char *name, const char *unit, unsigned long items,
+	unsigned long long t0)
+{
+	double ns = now() - t0;
+
+	printf("%-26s %9lu %-8s %8.1f ns/%s %9.2f M%s/s\n", name, items, unit,
+		ns / items, unit, items / ns * 1000.0, unit);
+	fflush(stdout);
+}
+
+static void check(const char *name, unsigned long got, unsigned long expected)
+{
+	if(got != expected) {
+		printf("%s: got %lu, expected %lu\n", name, got, expected);
+		errors++;
+	}
+}
+
+static inline u_int8_t pattern(unsigned long offset)
+{
+	return offset ^ (offset >> 8);
+}
+
+/*************************** Pointers ********************************/
+
+/* Posts and takes QUEUE_LENGTH at a time, so that nothing blocks */
+static void pointers_task_to_task(void)
+{
+	unsigned long i, j, next = 0;
+	unsigned long long t0;
+	void *p;
+
+	t0 = now();
+	for(i = 0; i < count; i += QUEUE_LENGTH) {
+		for(j = 0; j < QUEUE_LENGTH; j++) {
+			p = (void *)(i + j);
+			xQueueSend(pointer_queue, &p, 0);
+		}
+		for(j = 0; j < QUEUE_LENGTH; j++)
+			if(xQueueReceive(pointer_queue, &p, 0) && p == (void *)next)
+				next++;
+	}
+	report("xQueueSend/Receive", "pointer", i, t0);
+	check("xQueueSend/Receive", next, i);
+
+	next = 0;
+	t0 = now();
+	for(i = 0; i < count; i += QUEUE_LENGTH) {
+		for(j = 0; j < QUEUE_LENGTH; j++)
+			xMailboxPost(mailbox, (void *)(i + j), 0);
+		for(j = 0; j < QUEUE_LENGTH; j++)
+			if(xMailboxFetch(mailbox, &p, 0) && p == (void *)next)
+				next++;
+	}
+	report("xMailboxPost/Fetch", "pointer", i, t0);
+	check("xMailboxPost/Fetch", next, i);
+}
+
+/* One frame per "interrupt", as tc_recv posts them */
+static void pointers_isr_to_task(void)
+{
+	unsigned long i, next = 0;
+	unsigned long long t0;
+	void *p;
+
+	t0 = now();
+	for(i = 0; i < count; i++) {
+		p = (void *)i;
+		portENTER_CRITICAL();
+		xQueueSendFromISR(pointer_queue, &p, pdFALSE);
+		portEXIT_CRITICAL();
+		if(xQueueReceive(pointer_queue, &p, 0) && p == (void *)next)
+			next++;
+	}
+	report("xQueueSendFromISR/Receive", "pointer", i, t0);
+	check("xQueueSendFromISR/Receive", next, i);
+
+	next = 0;
+	t0 = now();
+	for(i = 0; i < count; i++) {
+		portENTER_CRITICAL();
+		xMailboxPostFromISR(mailbox, (void *)i, pdFALSE);
+		portEXIT_CRITICAL();
+		if(xMailboxFetch(mailbox, &p, 0) && p == (void *)next)
+			next++;
+	}
+	report("xMailboxPostFromISR/Fetch", "pointer", i, t0);
+	check("xMailboxPostFromISR/Fetch", next, i);
+}
+
+/***************************** Bytes *********************************/
+
+static u_int8_t data[MAX_RUN], out[MAX_RUN];
+
+static void fill(unsigned long offset)
+{
+	unsigned int i;
+
+	for(i = 0; i < run; i++)
+		data[i] = pattern(offset + i);
+}
+
+static unsigned long verify(unsigned long offset, const u_int8_t *buf, unsigned int len)
+{
+	unsigned int i;
+
+	for(i = 0; i < len; i++)
+		if(buf[i] != pattern(offset + i))
+			errors++;
+	return offset + len;
+}
+
+/* A receive interrupt that has run bytes to hand over */
+static void bytes_isr_to_task(void)
+{
+	unsigned long i, received;
+	unsigned long long t0;
+	signed portBASE_TYPE woken;
+	unsigned int j, n;
+	u_int8_t c;
+
+	received = 0;
+	t0 = now();
+	for(i = 0; i < count; i += run) {
+		fill(i);
+		portENTER_CRITICAL();
+		for(j = 0; j < run; j++)
+			xQueueSendFromISR(byte_queue, &data[j], pdFALSE);
+		portEXIT_CRITICAL();
+		while(xQueueReceive(byte_queue, &c, 0))
+			received = verify(received, &c, 1);
+	}
+	report("byte xQueueSendFromISR", "byte", i, t0);
+	check("byte xQueueSendFromISR", received, i);
+
+	received = 0;
+	t0 = now();
+	for(i = 0; i < count; i += run) {
+		fill(i);
+		woken = pdFALSE;
+		portENTER_CRITICAL();
+		uxStreamWriteFromISR(stream, data, run, &woken);
+		portEXIT_CRITICAL();
+		while((n = uxStreamRead(stream, out, sizeof(out), 0)) > 0)
+			received = verify(received, out, n);
+	}
+	report("uxStreamWriteFromISR/Read", "byte", i, t0);
+	check("uxStreamWriteFromISR/Read", received, i);
+}
+
+/* What vUSBSendBuffer() and the USB task do with it */
+static void bytes_task_to_task(void)
+{
+	unsigned long i, received;
+	unsigned long long t0;
+	u_int8_t chunk[CHUNK_SIZE];
+	unsigned int j, n;
+
+	received = 0;
+	t0 = now();
+	for(i = 0; i < count; i += run) {
+		fill(i);
+		for(j = 0; j < run; j++)
+			xQueueSend(byte_queue, &data[j], 0);
+		while(xQueueReceive(byte_queue, &chunk[0], 0))
+			received = verify(received, chunk, 1);
+	}
+	report("byte xQueueSend/Receive", "byte", i, t0);
+	check("byte xQueueSend/Receive", received, i);
+
+	received = 0;
+	t0 = now();
+	for(i = 0; i < count; i += run) {
+		fill(i);
+		for(j = 0; j < run; j += n) {
+			n = run - j < CHUNK_SIZE - 1 ? run - j : CHUNK_SIZE - 1;
+			chunk[0] = n;
+			memcpy(chunk + 1, data + j, n);
+			xQueueSend(chunk_queue, chunk, 0);
+		}
+		while(xQueueReceive(chunk_queue, chunk, 0))
+			received = verify(received, chunk + 1, chunk[0]);
+	}
+	report("chunk xQueueSend/Receive", "byte", i, t0);
+	check("chunk xQueueSend/Receive", received, i);
+
+	received = 0;
+	t0 = now();
+	for(i = 0; i < count; i += run) {
+		fill(i);
+		uxStreamWrite(stream, data, run, 0);
+		while((n = uxStreamRead(stream, out, sizeof(out), 0)) > 0)
+			received = verify(received, out, n);
+	}
+	report("uxStreamWrite/Read", "byte", i, t0);
+	check("uxStreamWrite/Read", received, i);
+}
+
+/**************************** Hand off *******************************/
+
+static volatile unsigned long consumed;
+
+enum { HANDOFF_QUEUE, HANDOFF_MAILBOX, HANDOFF_STREAM };
+
+/* One per mode, created up front, since the POSIX port cannot delete
+ * tasks. Higher priority than the producer, so the one in use runs on
+ * every post, the others stay blocked. */
+static void consumer_task(void *pvParameters)
+{
+	int mode = (long)pvParameters;
+	unsigned long next = 0;
+	unsigned int n;
+	void *p;
+
+	while(1) {
+		switch(mode) {
+		case HANDOFF_QUEUE:
+			if(xQueueReceive(pointer_queue, &p, portMAX_DELAY))
+				next += p == (void *)next;
+			break;
+		case HANDOFF_MAILBOX:
+			if(xMailboxFetch(mailbox, &p, portMAX_DELAY))
+				next += p == (void *)next;
+			break;
+		case HANDOFF_STREAM:
+			n = uxStreamRead(stream, out, sizeof(out), portMAX_DELAY);
+			next = verify(next, out, n);
+			break;
+		}
+		consumed = next;
+	}
+}
+
+static void start_consumers(void)
+{
+	long mode;
+
+	for(mode = HANDOFF_QUEUE; mode <= HANDOFF_STREAM; mode++)
+		xTaskCreate(consumer_task, (signed portCHAR *) "CONSUMER",
+			configMINIMAL_STACK_SIZE * 4, (void *)mode,
+			tskIDLE_PRIORITY + 2, NULL);
+}
+
+static void handoff(void)
+{
+	unsigned long i, n = count / 10;
+	unsigned long long t0;
+	void *p;
+
+	start_consumers();
+
+	consumed = 0;
+	t0 = now();
+	for(i = 0; i < n; i++) {
+		p = (void *)i;
+		xQueueSend(pointer_queue, &p, portMAX_DELAY);
+	}
+	report("hand off xQueueSend", "pointer", i, t0);
+	check("hand off xQueueSend", consumed, i);
+
+	consumed = 0;
+	t0 = now();
+	for(i = 0; i < n; i++)
+		xMailboxPost(mailbox, (void *)i, portMAX_DELAY);
+	report("hand off xMailboxPost", "pointer", i, t0);
+	check("hand off xMailboxPost", consumed, i);
+
+	consumed = 0;
+	t0 = now();
+	for(i = 0; i < count; i += run) {
+		fill(i);
+		uxStreamWrite(stream, data, run, portMAX_DELAY);
+	}
+	report("hand off uxStreamWrite", "byte", i, t0);
+	check("hand off uxStreamWrite", consumed, i);
+}
+
+static void bench_task(void *pvParameters)
+{
+	(void)pvParameters;
+
+	pointers_task_to_task();
+	pointers_isr_to_task();
+	bytes_isr_to_task();
+	bytes_task_to_task();
+	handoff();
+
+	if(errors)
+		printf("%lu errors\n", errors);
+	exit(errors != 0);
+}
+
+/* Wait for the next interrupt instead of spinning */
+void vApplicationIdleHook(void)
+{
+	pause();
+}
+
+static void print_help(void)
+{
+	printf("queue_bench [-n count] [-r run]\n"
+	       "  -n  items per test (default %lu)\n"
+	       "  -r  bytes per stream write (default %u, max %u)\n",
+	       count, run, MAX_RUN);
+}
+
+int main(int argc, char **argv)
+{
+	int c;
+
+	while((c = getopt(argc, argv, "n:r:h")) != -1) {
+		switch(c) {
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			run = atoi(optarg);
+			break;
+		default:
+			print_help();
+			exit(c == 'h' ? 0 : 2);
+		}
+	}
+	/* A run has to fit the byte queue and the stream */
+	if(run == 0 || run > MAX_RUN || count == 0) {
+		print_help();
+		exit(2);
+	}
+
+	pointer_queue = xQueueCreate(QUEUE_LENGTH, sizeof(void *));
+	mailbox = xMailboxCreate(QUEUE_LENGTH);
+	byte_queue = xQueueCreate(STREAM_SIZE, 1);
+	chunk_queue = xQueueCreate(STREAM_SIZE / CHUNK_SIZE + 1, CHUNK_SIZE);
+	stream = xStreamCreate(STREAM_SIZE);
+	if(!pointer_queue || !mailbox || !byte_queue || !chunk_queue || !stream) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+
+	xTaskCreate(bench_task, (signed portCHAR *) "BENCH", configMINIMAL_STACK_SIZE * 4,
+		NULL, tskIDLE_PRIORITY + 1, NULL);
+	vTaskStartScheduler();
+	return 1;
+}
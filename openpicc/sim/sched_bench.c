@@ -0,0 +1,229 @@
+/***************************************************************
+ *
+ * OpenPICC - context switch latency of the scheduler
+ *
+ * Runs on the POSIX FreeRTOS port. A host thread raises an
+ * interrupt whose handler gives a semaphore, as the PIO IRQ
+ * does for tc_recv, and a task at the highest priority waits
+ * for it. Measured are
+ *
+ *  - irq -> task: from raising the interrupt until the woken
+ *    task runs
+ *  - block -> next: from the moment the task blocks again until
+ *    the highest priority task that is still ready runs, a
+ *    spinning task at the lowest priority above idle, with
+ *    blocked tasks on all priorities in between
+ *
+ * Both include the thread switch of the POSIX port, which is
+ * far more expensive than vTaskSwitchContext() itself. Run it
+ * against different versions of tasks.c to compare them.
+ *
+ ***************************************************************
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; version 2.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <errno.h>
+#include <time.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+
+#include "sim_hw.h"
+
+#define MAX_SAMPLES	100000
+
+static unsigned long count = 20000;
+static unsigned int gap_us = 100;
+
+static xSemaphoreHandle irq_sem;
+static volatile unsigned long long t_irq, t_block;
+static volatile unsigned long woken, switched;
+
+static unsigned long irq_ns[MAX_SAMPLES], switch_ns[MAX_SAMPLES];
+
+static unsigned long long now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void run_until(unsigned long long t)
+{
+	struct timespec ts = { t / 1000000000ULL, t % 1000000000ULL };
+
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+static int compare(const void *a, const void *b)
+{
+	unsigned long x = *(const unsigned long *)a, y = *(const unsigned long *)b;
+	return x < y ? -1 : x > y;
+}
+
+static void print(const char *name, unsigned long *ns, unsigned long n)
+{
+	char line[160];
+
+	if(n == 0)
+		return;
+	qsort(ns, n, sizeof(*ns), compare);
+	snprintf(line, sizeof(line),
+		"%-15s %7lu samples  min %7.2f  median %7.2f  99%% %7.2f  max %8.2f us\n",
+		name, n, ns[0] / 1e3, ns[n / 2] / 1e3, ns[n * 99 / 100] / 1e3,
+		ns[n - 1] / 1e3);
+	if(write(STDOUT_FILENO, line, strlen(line)) < 0)
+		exit(1);
+}
+
+/* Plays the FIQ and the pin change: one interrupt every gap_us */
+static void *host_thread(void *arg)
+{
+	unsigned long i, n;
+
+	(void)arg;
+	/* Let the tasks settle */
+	run_until(now() + 10000000);
+
+	for(i = 0; i < count; i++) {
+		n = woken;
+		t_irq = now();
+		vPortGenerateInterrupt(SIM_IRQ_PIO);
+		while(woken == n)
+			run_until(now() + 1000);
+		run_until(now() + gap_us * 1000ULL);
+	}
+
+	print("irq -> task", irq_ns, woken);
+	print("block -> next", switch_ns, switched);
+	exit(0);
+}
+
+static portBASE_TYPE irq_handler(portBASE_TYPE task_woken)
+{
+	return xSemaphoreGiveFromISR(irq_sem, task_woken);
+}
+
+static void wake_task(void *pvParameters)
+{
+	unsigned long long t;
+
+	(void)pvParameters;
+	/* The binary semaphore is created full */
+	xSemaphoreTake(irq_sem, 0);
+	while(1) {
+		t_block = now();
+		if(xSemaphoreTake(irq_sem, portMAX_DELAY) != pdPASS)
+			continue;
+		t = now();
+		if(woken < MAX_SAMPLES)
+			irq_ns[woken] = t - t_irq;
+		woken++;
+	}
+}
+
+/* Never runs, only takes up a priority */
+static void blocked_task(void *pvParameters)
+{
+	(void)pvParameters;
+	while(1)
+		vTaskSuspend(NULL);
+}
+
+/* Runs whenever the wake task is blocked */
+static void spin_task(void *pvParameters)
+{
+	unsigned long long t;
+
+	(void)pvParameters;
+	while(1) {
+		t = t_block;
+		if(t) {
+			t_block = 0;
+			if(switched < MAX_SAMPLES)
+				switch_ns[switched] = now() - t;
+			switched++;
+		}
+	}
+}
+
+/* Wait for the next interrupt instead of spinning */
+void vApplicationIdleHook(void)
+{
+	pause();
+}
+
+static void print_help(void)
+{
+	printf("sched_bench [-n count] [-g us]\n"
+	       "  -n  interrupts to raise (default %lu, max %u)\n"
+	       "  -g  time between them (default %u)\n",
+	       count, MAX_SAMPLES, gap_us);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned portBASE_TYPE priority;
+	pthread_t host;
+	int c;
+
+	while((c = getopt(argc, argv, "n:g:h")) != -1) {
+		switch(c) {
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		case 'g':
+			gap_us = atoi(optarg);
+			break;
+		default:
+			print_help();
+			exit(c == 'h' ? 0 : 2);
+		}
+	}
+	if(count == 0 || count > MAX_SAMPLES) {
+		print_help();
+		exit(2);
+	}
+
+	vSemaphoreCreateBinary(irq_sem);
+	if(irq_sem == NULL) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+	vPortSetInterruptHandler(SIM_IRQ_PIO, irq_handler);
+
+	xTaskCreate(wake_task, (signed portCHAR *) "WAKE", configMINIMAL_STACK_SIZE * 4,
+		NULL, configMAX_PRIORITIES - 1, NULL);
+	for(priority = tskIDLE_PRIORITY + 2; priority < configMAX_PRIORITIES - 1; priority++)
+		xTaskCreate(blocked_task, (signed portCHAR *) "BLOCKED", configMINIMAL_STACK_SIZE,
+			NULL, priority, NULL);
+	xTaskCreate(spin_task, (signed portCHAR *) "SPIN", configMINIMAL_STACK_SIZE * 4,
+		NULL, tskIDLE_PRIORITY + 1, NULL);
+
+	if(pthread_create(&host, NULL, host_thread, NULL) != 0) {
+		perror("pthread_create");
+		exit(1);
+	}
+
+	vTaskStartScheduler();
+	return 1;
+}
@@ -0,0 +1,47 @@
+/***************************************************************
+ *
+ * OpenPICC - POSIX simulation build
+ *
+ * Included before every source file of the simulation build
+ * (gcc -include). It takes the place of application/openpicc.h,
+ * whose u_int32_t is an unsigned long and would clash with the
+ * host C library, and pulls in the simulated board.h.
+ *
+ ***************************************************************
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; version 2.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#ifndef SIM_H_
+#define SIM_H_
+
+#include <sys/types.h>
+
+/* Keep application/openpicc.h out */
+#define __OPENPICC_H__
+
+#include "board.h"
+
+typedef unsigned char bool_t;
+typedef signed char s_int8_t;
+typedef signed short s_int16_t;
+typedef int s_int32_t;
+
+#define DA_BASELINE 200
+
+#define DIV_ROUND_UP(a,b) ( (a+(b-1)) / b)
+#define MIN(a, b) ((a)>(b)?(b):(a))
+
+#endif /*SIM_H_*/
@@ -0,0 +1,427 @@
+/***************************************************************
+ *
+ * OpenPICC - simulated peripherals for the POSIX build
+ *
+ * Stand-ins for the PIO, TC, SSC, PLL, load modulation and LED
+ * drivers with the interfaces of their counterparts in
+ * application/, plus the FIQ of os/boot/boot.s written in C.
+ *
+ * The reader side (picc_sim.c) runs in its own thread, like the
+ * hardware it keeps TC2_CV counting and calls sim_fiq() at every
+ * modulation pause. sim_fiq() fills the capture ring exactly as
+ * the FIQ does and then asserts the secondary PIO IRQ, which the
+ * POSIX port delivers to the running task like the AIC would.
+ * Transmissions are only recorded, the reader side takes them
+ * with sim_hw_get_tx() and ends them with sim_hw_tx_end().
+ *
+ ***************************************************************
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; version 2.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <errno.h>
+#include <strings.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "openpicc.h"
+#include "ssc.h"
+#include "pll.h"
+#include "tc_fdt.h"
+#include "tc_cdiv.h"
+#include "tc_cdiv_sync.h"
+#include "tc_fiq_ring.h"
+#include "load_modulation.h"
+#include "clock_switch.h"
+#include "pio_irq.h"
+#include "led.h"
+#include "performance.h"
+#include "trace.h"
+
+#include "sim_hw.h"
+
+static const struct openpicc_hardware sim_hardware = {
+	OPENPICC_v0_4_karsten, "Simulation",
+	{0, 0, 0,},
+	CLOCK_SELECT_CARRIER,
+	-1, -1, -1, -1,
+};
+const struct openpicc_hardware *OPENPICC = &sim_hardware;
+
+AT91S_PIO sim_pioa;
+
+static volatile unsigned long long last_pause;
+static volatile int tc2_held;
+static __thread AT91_REG tc2_cv;
+
+unsigned long long sim_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+unsigned long long sim_ns_to_cycles(unsigned long long ns)
+{
+	return ns * CARRIER_HZ / 1000000000ULL;
+}
+
+unsigned long long sim_cycles_to_ns(unsigned long long cycles)
+{
+	return cycles * 1000000000ULL / CARRIER_HZ;
+}
+
+/* TC2 counts carrier cycles from SIM_TC2_RESTART after the last pause */
+AT91_REG *sim_tc2_cv(void)
+{
+	unsigned long long now = sim_now(), pause = last_pause, c = 0;
+
+	if(!tc2_held && now > pause)
+		c = sim_ns_to_cycles(now - pause);
+	tc2_cv = c > SIM_TC2_RESTART ? MIN(c - SIM_TC2_RESTART, SIM_TC2_MAX) : 0;
+	return &tc2_cv;
+}
+
+/******************************* FIQ *********************************/
+
+/* In tc_fiq_ring.c, only the FIQ reads it */
+extern struct tc_fiq_ring * volatile tc_fiq_ring_for_fiq;
+
+void sim_tc2_hold(void)
+{
+	tc2_held = 1;
+}
+
+unsigned long long sim_tc2_release(void)
+{
+	unsigned long long now = sim_now();
+
+	last_pause = now;
+	__sync_synchronize();
+	tc2_held = 0;
+	return now;
+}
+
+void sim_fiq(u_int32_t capture)
+{
+	struct tc_fiq_ring *ring = tc_fiq_ring_for_fiq;
+
+	last_pause = sim_now();
+
+	__sync_fetch_and_or(&sim_pioa.PIO_ISR, OPENPICC_SSC_DATA);
+
+	if(ring != NULL) {
+		u_int32_t head = ring->head;
+		unsigned int i = head & TC_FIQ_MASK;
+		u_int32_t count = ring->count[i];
+
+		if(count >= TC_FIQ_BUFSIZE) {
+			/* Buffer full, move on unless all buffers are in use */
+			if(head - ring->tail >= TC_FIQ_BUFFERS-1) {
+				ring->overruns[i]++;
+				goto no_buffer;
+			}
+			ring->head = ++head;
+			i = head & TC_FIQ_MASK;
+			count = 0;
+		}
+
+		/* Store the capture first, then publish it by writing the count */
+		ring->data[i][count] = capture;
+		tc_fiq_barrier();
+		ring->count[i] = count + 1;
+	}
+
+no_buffer:
+	vPortGenerateInterrupt(SIM_IRQ_PIO);
+}
+
+/******************************* PIO *********************************/
+
+static irq_handler_t *pio_handlers[NR_PIO];
+static volatile u_int32_t pio_enabled;
+static long pio_count;
+
+/* The secondary IRQ, see pio_irq.c */
+static portBASE_TYPE sim_pio_irq(portBASE_TYPE task_woken)
+{
+	u_int32_t pio = __sync_fetch_and_and(&sim_pioa.PIO_ISR, 0);
+	int i;
+
+	pio_count++;
+	for(i = 0; i < NR_PIO; i++)
+		if((pio & pio_enabled & (1 << i)) && pio_handlers[i])
+			task_woken = pio_handlers[i](i, task_woken);
+	return task_woken;
+}
+
+void pio_irq_enable(u_int32_t pio)
+{
+	__sync_fetch_and_or(&pio_enabled, pio);
+}
+
+void pio_irq_disable(u_int32_t pio)
+{
+	__sync_fetch_and_and(&pio_enabled, ~pio);
+}
+
+long pio_irq_get_count(void)
+{
+	return pio_count;
+}
+
+int pio_irq_register(u_int32_t pio, irq_handler_t *handler)
+{
+	u_int8_t num = ffs(pio);
+
+	if(num == 0)
+		return -EINVAL;
+	num--;
+
+	if(pio_handlers[num])
+		return -EBUSY;
+
+	pio_irq_disable(pio);
+	pio_handlers[num] = handler;
+	return 0;
+}
+
+void pio_irq_unregister(u_int32_t pio)
+{
+	u_int8_t num = ffs(pio);
+
+	if(num == 0)
+		return;
+	num--;
+
+	pio_irq_disable(pio);
+	pio_handlers[num] = NULL;
+}
+
+/* The interrupt line is set up by sim_hw_init() */
+void pio_irq_init(void)
+{
+}
+
+void pio_irq_init_once(void)
+{
+	pio_irq_init();
+}
+
+int sim_hw_rx_ready(void)
+{
+	return (pio_enabled & OPENPICC_SSC_DATA) && tc_fiq_ring_for_fiq != NULL;
+}
+
+/******************************* SSC *********************************/
+
+struct _ssc_handle {
+	ssc_callback_t callback;
+	ssc_dma_tx_buffer_t *tx_buffer;
+	volatile int tx_running;
+};
+
+static ssc_handle_t _ssc;
+static volatile u_int16_t fdt;
+static struct sim_tx last_tx;
+static volatile int tx_started;
+
+ssc_handle_t* ssc_open(u_int8_t init_rx, u_int8_t init_tx, enum ssc_mode mode, ssc_callback_t callback)
+{
+	(void)init_rx; (void)init_tx; (void)mode;
+	ssc_handle_t *sh = &_ssc;
+
+	if(sh->callback != NULL)
+		return NULL;
+	sh->callback = callback;
+	if(sh->callback != NULL)
+		sh->callback(SSC_CALLBACK_SETUP, sh);
+	return sh;
+}
+
+int ssc_close(ssc_handle_t* sh)
+{
+	sh->callback = NULL;
+	return 0;
+}
+
+void ssc_set_gate(int data_enabled)
+{
+	(void)data_enabled;
+}
+
+int ssc_send(ssc_handle_t* sh, ssc_dma_tx_buffer_t *buffer)
+{
+	if(sh == NULL) return -EINVAL;
+	if(sh->tx_running) return -EBUSY;
+
+	sh->tx_buffer = buffer;
+	sh->tx_running = 1;
+	buffer->state = SSC_PENDING;
+
+	last_tx.buffer = buffer;
+	last_tx.fdt = fdt;
+	last_tx.cv = *AT91C_TC2_CV;
+	last_tx.ns = sim_now();
+	__sync_synchronize();
+	tx_started = 1;
+	trace_event(TRACE_TX_ARMED, last_tx.cv);
+	return 0;
+}
+
+static void ssc_tx_end(ssc_handle_t *sh, int is_an_abort)
+{
+	if(sh->tx_buffer) {
+		sh->tx_buffer->state = SSC_FREE;
+		sh->tx_running = 0;
+	}
+	trace_event(TRACE_TX_ENDED, is_an_abort);
+
+	if(sh->callback) {
+		if(is_an_abort)
+			sh->callback(SSC_CALLBACK_TX_FRAME_ABORTED, sh->tx_buffer);
+		else
+			sh->callback(SSC_CALLBACK_TX_FRAME_ENDED, sh->tx_buffer);
+	}
+
+	sh->tx_buffer = NULL;
+}
+
+int ssc_send_abort(ssc_handle_t* sh)
+{
+	if(!sh) return -EINVAL;
+	if(!sh->tx_running) return -EINVAL;
+
+	ssc_tx_end(sh, 1);
+	return 0;
+}
+
+static portBASE_TYPE sim_ssc_irq(portBASE_TYPE task_woken)
+{
+	if(_ssc.tx_running)
+		ssc_tx_end(&_ssc, 0);
+	return task_woken;
+}
+
+int sim_hw_get_tx(struct sim_tx *tx)
+{
+	if(!tx_started)
+		return -EAGAIN;
+	__sync_synchronize();
+	*tx = last_tx;
+	tx_started = 0;
+	return 0;
+}
+
+void sim_hw_tx_end(void)
+{
+	vPortGenerateInterrupt(SIM_IRQ_SSC);
+}
+
+/************************** TC, PLL and friends **************************/
+
+void tc_fdt_init(void)
+{
+}
+
+void tc_fdt_set(u_int16_t count)
+{
+	fdt = count;
+}
+
+void tc_cdiv_init(void)
+{
+}
+
+void tc_cdiv_set_divider(u_int16_t div)
+{
+	(void)div;
+}
+
+void tc_cdiv_sync_init(void)
+{
+}
+
+void tc_cdiv_sync_enable(void)
+{
+}
+
+void tc_cdiv_sync_reset(void)
+{
+}
+
+void pll_init(void)
+{
+}
+
+void pll_inhibit(int inhibit)
+{
+	(void)inhibit;
+}
+
+void clock_switch_init(void)
+{
+}
+
+void clock_switch(enum clock_source clock)
+{
+	(void)clock;
+}
+
+void load_mod_init(void)
+{
+}
+
+void load_mod_level(u_int8_t level)
+{
+	(void)level;
+}
+
+void vLedSetBrightness(unsigned int led, int brightness)
+{
+	(void)led; (void)brightness;
+}
+
+void vLedSetRed(bool_t on)
+{
+	(void)on;
+}
+
+void vLedSetGreen(bool_t on)
+{
+	(void)on;
+}
+
+/* The board blinks the reason forever */
+void vLedHaltBlinking(int reason)
+{
+	fprintf(stderr, "vLedHaltBlinking(%d)\n", reason);
+	exit(1);
+}
+
+/* TC1 as a 32 bit counter, for the trace */
+u_int32_t performance_now(void)
+{
+	return sim_now() * (PERFORMANCE_CLOCK_HZ/1000) / 1000000ULL;
+}
+
+void sim_hw_init(void)
+{
+	vPortSetInterruptHandler(SIM_IRQ_PIO, sim_pio_irq);
+	vPortSetInterruptHandler(SIM_IRQ_SSC, sim_ssc_irq);
+}
@@ -0,0 +1,49 @@
+#ifndef SIM_HW_H_
+#define SIM_HW_H_
+
+#include "ssc_buffer.h"
+
+/* Interrupt lines of the simulated AIC, line 0 is the FreeRTOS tick */
+#define SIM_IRQ_PIO	1	/* PIO_SECONDARY_IRQ, asserted by the FIQ */
+#define SIM_IRQ_SSC	2	/* SSC Tx end */
+#define SIM_IRQ_UDP	3	/* UDP endpoint, see sim_udp.c */
+
+/* TC2 does not count during the pause and restarts a bit after it,
+ * see BIT_OFFSET in iso14443a_diffmiller.c. In carrier cycles. */
+#define SIM_TC2_RESTART	(128/4 + 4 + 20)
+#define SIM_TC2_MAX	0xffff
+
+/* A transmission the application handed to ssc_send() */
+struct sim_tx {
+	ssc_dma_tx_buffer_t *buffer;
+	u_int32_t fdt;			/* last tc_fdt_set() */
+	u_int32_t cv;			/* TC2 at ssc_send() */
+	unsigned long long ns;		/* sim_now() at ssc_send() */
+};
+
+extern void sim_hw_init(void);
+extern unsigned long long sim_now(void);
+extern unsigned long long sim_ns_to_cycles(unsigned long long ns);
+extern unsigned long long sim_cycles_to_ns(unsigned long long cycles);
+
+/* The FIQ: a modulation pause, TC2 has been captured and restarts now */
+extern void sim_fiq(u_int32_t capture);
+/* While held TC2 reads 0, on release it restarts from then. Returns the
+ * time of the release. */
+extern void sim_tc2_hold(void);
+extern unsigned long long sim_tc2_release(void);
+
+/* Non-zero once the receiver has registered its PIO handler */
+extern int sim_hw_rx_ready(void);
+
+/* Take the transmission started since the last call, 0 if there is one */
+extern int sim_hw_get_tx(struct sim_tx *tx);
+/* Let the SSC signal the end of the current transmission */
+extern void sim_hw_tx_end(void);
+
+/* Echo what the application prints to stdout */
+extern int sim_usb_echo;
+/* Where binary data sent with xUSBSendDescriptor() goes, -1 to drop it */
+extern int sim_usb_bin_fd;
+
+#endif /*SIM_HW_H_*/
@@ -0,0 +1,96 @@
+/***************************************************************
+ *
+ * OpenPICC - simulated USB device port, bulk IN endpoint
+ *
+ * Enough of the UDP to run os/usb/USBTx.c: endpoint 2 with its
+ * two 64 byte banks. Bytes written through usbFIFO_WRITE go into
+ * the bank that is filled, setting TXPKTRDY hands it over. As on
+ * the SAM7S, while TXPKTRDY is set the FIFO writes go to the other
+ * bank.
+ *
+ * The host side calls sim_udp_in_token() for every IN token it
+ * sends. Like the hardware it gets the committed packet or a NAK,
+ * and on a packet TXPKTRDY is cleared, TXCOMP is set and the
+ * endpoint interrupt (SIM_IRQ_UDP) asserted.
+ *
+ ***************************************************************
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; version 2.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#include <FreeRTOS.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "sim_hw.h"
+#include "sim_udp.h"
+
+AT91S_UDP sim_udp;
+
+struct udp_bank {
+	u_int8_t data[SIM_UDP_BANK_SIZE];
+	int len;
+};
+
+static struct udp_bank banks[2];
+static int next_bank;		/* the one TXPKTRDY sends */
+static unsigned long overflows;
+static pthread_mutex_t udp_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void sim_udp_fifo_write(unsigned int ep, unsigned char c)
+{
+	struct udp_bank *bank;
+
+	if(ep != SIM_UDP_BULK_IN)
+		return;
+
+	pthread_mutex_lock(&udp_lock);
+	bank = &banks[next_bank ^ !!(sim_udp.UDP_CSR[ep] & AT91C_UDP_TXPKTRDY)];
+	if(bank->len < SIM_UDP_BANK_SIZE)
+		bank->data[bank->len++] = c;
+	else
+		overflows++;
+	pthread_mutex_unlock(&udp_lock);
+}
+
+int sim_udp_in_token(u_int8_t *buffer)
+{
+	struct udp_bank *bank;
+	int len;
+
+	pthread_mutex_lock(&udp_lock);
+	if(!(sim_udp.UDP_CSR[SIM_UDP_BULK_IN] & AT91C_UDP_TXPKTRDY)) {
+		pthread_mutex_unlock(&udp_lock);
+		return -1;
+	}
+
+	bank = &banks[next_bank];
+	len = bank->len;
+	memcpy(buffer, bank->data, len);
+	bank->len = 0;
+	next_bank ^= 1;
+
+	__sync_fetch_and_and(&sim_udp.UDP_CSR[SIM_UDP_BULK_IN], ~AT91C_UDP_TXPKTRDY);
+	__sync_fetch_and_or(&sim_udp.UDP_CSR[SIM_UDP_BULK_IN], AT91C_UDP_TXCOMP);
+	pthread_mutex_unlock(&udp_lock);
+
+	vPortGenerateInterrupt(SIM_IRQ_UDP);
+	return len;
+}
+
+unsigned long sim_udp_get_overflows(void)
+{
+	return overflows;
+}
@@ -0,0 +1,14 @@
+#ifndef SIM_UDP_H_
+#define SIM_UDP_H_
+
+#define SIM_UDP_BULK_IN		2	/* usbEND_POINT_2 */
+#define SIM_UDP_BANK_SIZE	64
+
+/* An IN token on the bulk endpoint: copies the packet the device has
+ * committed to buffer and returns its length, or -1 for a NAK */
+extern int sim_udp_in_token(u_int8_t *buffer);
+
+/* Bytes written to a full bank */
+extern unsigned long sim_udp_get_overflows(void);
+
+#endif /*SIM_UDP_H_*/
@@ -0,0 +1,148 @@
+/***************************************************************
+ *
+ * OpenPICC - USB CDC and command console for the POSIX build
+ *
+ * usb_print.c is used unmodified, the bytes it flushes end up
+ * on stdout (if asked to). The Dump*ToUSB() helpers and the FDT
+ * offset come from cmd.c on the board.
+ *
+ ***************************************************************
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; version 2.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#include <FreeRTOS.h>
+#include <USB-CDC.h>
+#include <unistd.h>
+
+#include "openpicc.h"
+#include "usb_print.h"
+#include "cmd.h"
+
+#include "sim_hw.h"
+
+int sim_usb_echo = 0;
+int sim_usb_bin_fd = -1;
+
+volatile int fdt_offset=-20  -16; // as in cmd.c
+
+static char line[128];
+static unsigned int line_len;
+
+/* Only called from usb_print_flush(), with the print semaphore held.
+ * write() is all that may be used here, the task can be interrupted
+ * and switched out anywhere. The host never stalls, all of it is
+ * taken. */
+portBASE_TYPE xUSBSendBuffer(unsigned char *buffer, portBASE_TYPE offset, portBASE_TYPE length, portTickType xTicksToWait)
+{
+	portBASE_TYPE i;
+
+	(void)xTicksToWait;
+	for(i = offset; i < offset + length && sim_usb_echo; i++) {
+		line[line_len++] = buffer[i];
+		if(buffer[i] == '\n' || line_len == sizeof(line)) {
+			if(write(STDOUT_FILENO, line, line_len) < 0)
+				sim_usb_echo = 0;
+			line_len = 0;
+		}
+	}
+	return length;
+}
+
+/* Binary data, a trace or metrics dump. Taken right away. */
+portBASE_TYPE xUSBSendDescriptor(xUSB_TX_DESCRIPTOR *pxDescriptor, portTickType xTicksToWait)
+{
+	(void)xTicksToWait;
+	if(sim_usb_bin_fd >= 0 &&
+	   write(sim_usb_bin_fd, pxDescriptor->pucData, pxDescriptor->usLength) < 0)
+		sim_usb_bin_fd = -1;
+	if(pxDescriptor->vRelease)
+		pxDescriptor->vRelease(pxDescriptor);
+	return pdPASS;
+}
+
+unsigned portBASE_TYPE uxUSBTxBytesWaiting(void)
+{
+	return 0;
+}
+
+unsigned portBASE_TYPE uxUSBTxDescriptorsWaiting(void)
+{
+	return 0;
+}
+
+void DumpUIntToUSB(unsigned int data)
+{
+	int i=0;
+	unsigned char buffer[10],*p=&buffer[sizeof(buffer)];
+
+	do {
+		*--p='0'+(unsigned char)(data%10);
+		data/=10;
+		i++;
+	} while(data);
+
+	usb_print_buffer((char*)p, 0, i);
+}
+
+void DumpStringToUSB(const char* text)
+{
+	usb_print_string(text);
+}
+
+static inline unsigned char HexChar(unsigned char nibble)
+{
+	return nibble + ((nibble<0x0A) ? '0':('A'-0xA));
+}
+
+void DumpBufferToUSB(char* buffer, int len)
+{
+	char hex[32];
+	int i, n = 0;
+
+	for(i=0; i<len; i++) {
+		hex[n++] = HexChar( *buffer  >>   4);
+		hex[n++] = HexChar( *buffer++ & 0xf);
+		if(n == sizeof(hex) || i == len-1) {
+			usb_print_buffer(hex, 0, n);
+			n = 0;
+		}
+	}
+}
+
+void DumpTimeToUSB(long ticks)
+{
+	int h, s, m, ms;
+	ms = ticks;
+
+	s=ms/1000;
+	ms%=1000;
+	h=s/3600;
+	s%=3600;
+	m=s/60;
+	s%=60;
+	DumpUIntToUSB(h);
+	DumpStringToUSB("h:");
+	if(m < 10) DumpStringToUSB("0");
+	DumpUIntToUSB(m);
+	DumpStringToUSB("m:");
+	if(s < 10) DumpStringToUSB("0");
+	DumpUIntToUSB(s);
+	DumpStringToUSB("s.");
+	if(ms < 10) DumpStringToUSB("0");
+	if(ms < 100) DumpStringToUSB("0");
+	DumpUIntToUSB(ms);
+	DumpStringToUSB("ms");
+}
@@ -0,0 +1,305 @@
+/***************************************************************
+ *
+ * OpenPICC - throughput of the USB CDC bulk IN path
+ *
+ * Runs os/usb/USBTx.c on the POSIX FreeRTOS port against the
+ * mock UDP in sim_udp.c. A producer task pushes a known byte
+ * pattern through the driver, once with the copying
+ * xUSBSendBuffer() and once as zero copy descriptors. A host
+ * thread plays the USB host: it sends IN tokens, checks every
+ * byte of the packets it gets and allows at most -k packets per
+ * 1 ms frame (19 is what full speed bulk can carry).
+ *
+ * For each mode the wall clock throughput, the packet fill and
+ * the CPU time spent per MB, all threads counted, are reported.
+ *
+ ***************************************************************
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; version 2.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <errno.h>
+#include <time.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
+#include <semphr.h>
+#include <USB-CDC.h>
+
+#include "sim_hw.h"
+#include "sim_udp.h"
+
+#define MAX_BLOCK	4096
+#define NUM_BUFFERS	4
+
+enum { MODE_COPY, MODE_ZERO, NUM_MODES };
+static const char * const mode_names[NUM_MODES] = { "copy", "zero-copy" };
+
+static unsigned long total = 1024*1024;
+static unsigned int block = 512, packets_per_frame = 19;
+static int modes = (1 << MODE_COPY) | (1 << MODE_ZERO);
+
+static volatile int producer_mode = -1, host_done = -1;
+
+static xSemaphoreHandle udp_irq;
+static xQueueHandle free_buffers;
+static u_int8_t buffers[NUM_BUFFERS][MAX_BLOCK];
+static xUSB_TX_DESCRIPTOR descriptors[NUM_BUFFERS];
+
+static inline u_int8_t pattern(unsigned long offset)
+{
+	return offset ^ (offset >> 8);
+}
+
+/****************************** Host *********************************/
+
+static unsigned long long now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned long long cpu_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void run_until(unsigned long long t)
+{
+	struct timespec ts = { t / 1000000000ULL, t % 1000000000ULL };
+
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+/* Time between the IN tokens the host retries after a NAK */
+#define NAK_RETRY_NS	10000
+#define FRAME_NS	1000000
+
+static void *host_thread(void *arg)
+{
+	u_int8_t packet[SIM_UDP_BANK_SIZE];
+	unsigned long long t0, cpu0, t, frame_end;
+	unsigned long received, packets, naks, errors = 0, bad;
+	unsigned int in_frame;
+	int mode, len, i;
+	char line[160];
+
+	(void)arg;
+	for(mode = 0; mode < NUM_MODES; mode++) {
+		if(!(modes & (1 << mode)))
+			continue;
+		while(producer_mode != mode)
+			run_until(now() + 100000);
+
+		t0 = now();
+		cpu0 = cpu_now();
+		frame_end = t0 + FRAME_NS;
+		received = packets = naks = bad = 0;
+		in_frame = 0;
+
+		while(received < total) {
+			len = sim_udp_in_token(packet);
+			if(len < 0) {
+				naks++;
+				run_until(now() + NAK_RETRY_NS);
+			} else {
+				for(i = 0; i < len; i++)
+					if(packet[i] != pattern(received + i))
+						bad++;
+				received += len;
+				packets++;
+				in_frame++;
+			}
+
+			t = now();
+			if(packets_per_frame && in_frame >= packets_per_frame) {
+				/* Bus time of this frame used up */
+				if(t < frame_end)
+					run_until(frame_end);
+				t = now();
+			}
+			if(t >= frame_end) {
+				frame_end += FRAME_NS * ((t - frame_end) / FRAME_NS + 1);
+				in_frame = 0;
+			}
+		}
+
+		t = now() - t0;
+		snprintf(line, sizeof(line),
+			"%-9s %8lu bytes %7.3f s %8.1f kB/s %6lu packets %5.1f bytes/packet "
+			"%6lu NAKs %7.1f ms CPU/MB %lu bad\n",
+			mode_names[mode], received, t / 1e9, received / 1024.0 / (t / 1e9),
+			packets, packets ? (double)received / packets : 0.0, naks,
+			(cpu_now() - cpu0) / 1e6 / (received / 1048576.0), bad);
+		if(write(STDOUT_FILENO, line, strlen(line)) < 0)
+			break;
+		errors += bad;
+		host_done = mode;
+	}
+
+	if(sim_udp_get_overflows()) {
+		snprintf(line, sizeof(line), "%lu bytes written to a full bank\n",
+			sim_udp_get_overflows());
+		if(write(STDOUT_FILENO, line, strlen(line)) < 0)
+			errors++;
+		errors++;
+	}
+	exit(errors != 0);
+}
+
+/****************************** Tasks ********************************/
+
+/* The bulk IN part of vUSBCDCTask() */
+static void usb_task(void *pvParameters)
+{
+	(void)pvParameters;
+	while(1) {
+		xSemaphoreTake(udp_irq, usbSHORTEST_DELAY);
+		vUSBTxService();
+	}
+}
+
+static portBASE_TYPE udp_irq_handler(portBASE_TYPE task_woken)
+{
+	return xSemaphoreGiveFromISR(udp_irq, task_woken);
+}
+
+/* Called by the USB task */
+static void release_buffer(xUSB_TX_DESCRIPTOR *desc)
+{
+	int i = desc - descriptors;
+	xQueueSend(free_buffers, &i, 0);
+}
+
+static void fill(u_int8_t *buf, unsigned long offset, unsigned int len)
+{
+	unsigned int i;
+
+	for(i = 0; i < len; i++)
+		buf[i] = pattern(offset + i);
+}
+
+static void producer_task(void *pvParameters)
+{
+	unsigned long offset;
+	unsigned int len;
+	int mode, i;
+
+	(void)pvParameters;
+	for(mode = 0; mode < NUM_MODES; mode++) {
+		if(!(modes & (1 << mode)))
+			continue;
+		producer_mode = mode;
+
+		for(offset = 0; offset < total; offset += len) {
+			len = MIN(block, total - offset);
+			if(mode == MODE_COPY) {
+				fill(buffers[0], offset, len);
+				xUSBSendBuffer(buffers[0], 0, len, portMAX_DELAY);
+			} else {
+				xQueueReceive(free_buffers, &i, portMAX_DELAY);
+				fill(buffers[i], offset, len);
+				descriptors[i].pucData = buffers[i];
+				descriptors[i].usLength = len;
+				descriptors[i].vRelease = release_buffer;
+				xUSBSendDescriptor(&descriptors[i], portMAX_DELAY);
+			}
+		}
+
+		while(host_done != mode)
+			vTaskDelay(1);
+	}
+
+	while(1)
+		vTaskDelay(1000);
+}
+
+/* Wait for the next interrupt instead of spinning */
+void vApplicationIdleHook(void)
+{
+	pause();
+}
+
+static void print_help(void)
+{
+	printf("usb_bench [-m copy|zero] [-s bytes] [-b block] [-k packets]\n"
+	       "  -m  only run one mode (default both)\n"
+	       "  -s  bytes to send per mode (default %lu)\n"
+	       "  -b  bytes per send call or descriptor (default %u, max %u)\n"
+	       "  -k  packets the host takes per 1 ms frame, 0 for no limit (default %u)\n",
+	       total, block, MAX_BLOCK, packets_per_frame);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t host;
+	int c, i;
+
+	while((c = getopt(argc, argv, "m:s:b:k:h")) != -1) {
+		switch(c) {
+		case 'm':
+			modes = strcmp(optarg, "copy") ? 1 << MODE_ZERO : 1 << MODE_COPY;
+			break;
+		case 's':
+			total = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			block = atoi(optarg);
+			break;
+		case 'k':
+			packets_per_frame = atoi(optarg);
+			break;
+		default:
+			print_help();
+			exit(c == 'h' ? 0 : 2);
+		}
+	}
+	if(block == 0 || block > MAX_BLOCK || total == 0) {
+		print_help();
+		exit(2);
+	}
+
+	vSemaphoreCreateBinary(udp_irq);
+	free_buffers = xQueueCreate(NUM_BUFFERS, sizeof(int));
+	if(udp_irq == NULL || free_buffers == NULL || xUSBTxInit() != pdPASS) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+	for(i = 0; i < NUM_BUFFERS; i++)
+		xQueueSend(free_buffers, &i, 0);
+	vPortSetInterruptHandler(SIM_IRQ_UDP, udp_irq_handler);
+
+	xTaskCreate(usb_task, (signed portCHAR *) "USB", TASK_USB_STACK,
+		NULL, TASK_USB_PRIORITY, NULL);
+	xTaskCreate(producer_task, (signed portCHAR *) "PRODUCER", TASK_USB_STACK,
+		NULL, tskIDLE_PRIORITY + 1, NULL);
+
+	if(pthread_create(&host, NULL, host_thread, NULL) != 0) {
+		perror("pthread_create");
+		exit(1);
+	}
+
+	vTaskStartScheduler();
+	return 1;
+}